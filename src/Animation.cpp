@@ -80,6 +80,11 @@ Vector2 Animation::GetSize()
     return Vector2(pFirstFrameSprite->GetWidth(), pFirstFrameSprite->GetHeight());
 }
 
+string Animation::GetFirstFrameSpriteId()
+{
+    return frameList.empty() ? "" : frameList[0]->spriteId;
+}
+
 void Animation::Begin()
 {
     Reset();
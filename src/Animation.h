@@ -70,6 +70,7 @@ public:
     bool IsFinished();
 
     Sprite * GetFrameSprite();
+    string GetFirstFrameSpriteId();
 
     class Frame
     {
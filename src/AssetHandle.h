@@ -0,0 +1,53 @@
+/**
+ * Handle used to load a file from the mounted archives without looking its path up again.
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ASSETHANDLE_H
+#define ASSETHANDLE_H
+
+// Identifies a file in the mounted archives, so that it can be loaded again
+// without looking its path up every time.  Handles are resolved against whichever
+// archives are mounted at the time, and are re-resolved automatically
+// if a different case has been mounted since.
+class AssetHandle
+{
+    friend class ResourceLoader;
+
+public:
+    AssetHandle()
+    {
+        assetIndexGeneration = 0;
+        entryIndex = -1;
+    }
+
+private:
+    unsigned int assetIndexGeneration;
+    int entryIndex;
+};
+
+#endif
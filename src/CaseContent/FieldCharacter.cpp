@@ -676,6 +676,12 @@ int FieldCharacter::GetZOrder()
     }
 }
 
+string FieldCharacter::GetStandingSpriteId()
+{
+    Animation *pAnimation = GetCharacterStandingAnimationForDirection(spriteDirection);
+    return pAnimation != NULL ? pAnimation->GetFirstFrameSpriteId() : "";
+}
+
 Animation * FieldCharacter::GetCharacterStandingAnimationForDirection(FieldCharacterDirection spriteDirection)
 {
     if (spriteDirection == FieldCharacterDirectionNone)
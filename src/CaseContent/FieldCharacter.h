@@ -125,6 +125,9 @@ public:
     Vector2 GetVectorAnchorPosition();
     Vector2 GetMidPoint();
 
+    // The sprite this character is first drawn with when standing still, facing the way it's facing now.
+    string GetStandingSpriteId();
+
     Vector2 GetCenterPoint()
     {
         return IsInteractionPointExact() ? interactionLocation : GetVectorAnchorPosition();
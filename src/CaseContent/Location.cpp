@@ -57,6 +57,14 @@ const int CursorHighThreshold = 100; // px
 const int CursorMidThreshold = 200; // px
 const int CursorLowThreshold = 300; // px
 
+const double PathfindingTileSize = 20; // px
+
+const int MaxCollisionBroadphaseCandidates = 64;
+const double CollisionBroadphaseMargin = 1; // px
+const double CollisionBroadphaseCharacterMargin = 32; // px
+
+const int NeighboringLocationPrefetchIntervalMs = 500;
+
 const int WalkingSpeed = 300; // px / s
 const int RunningSpeed = 600; // px / s
 
@@ -69,16 +77,6 @@ Image *Location::pFadeSprite = NULL;
 FieldCharacter *Location::pCurrentPlayerCharacter = NULL;
 string Location::pendingTransitionEndSfxId = "";
 
-Location::PathfindingThreadParameters::PathfindingThreadParameters(Location *pLocation, FieldCharacter *pCharacter, Vector2 startPosition, Vector2 endPosition, FieldCharacterState characterStateIfMoving, int threadId)
-    : pLocation(pLocation)
-    , pCharacter(pCharacter)
-    , startPosition(startPosition)
-    , endPosition(endPosition)
-    , characterStateIfMoving(characterStateIfMoving)
-    , threadId(threadId)
-{
-}
-
 Location * Location::Transition::GetTargetLocation()
 {
     if (pTargetLocation == NULL)
@@ -230,9 +228,9 @@ Location::Location(XmlReader *pReader)
     pAreaHitBox = NULL;
     animationOffsetPartner = gScreenWidth;
     movingDirectly = false;
-    pPathfindingThread = NULL;
-    pPathfindingValuesSemaphore = SDL_CreateSemaphore(1);
-    lastPathfindingThreadId = 0;
+    pPathfindingService = new PathfindingService(this);
+    pNavigationGridSemaphore = SDL_CreateSemaphore(1);
+    pCollisionBroadphase = NULL;
 
     pEvidenceTab = new Tab(gScreenWidth - 3 * (TabWidth + 7), true /* isClickable */, "EVIDENCE", false /* useCancelClickSoundEffect */, TabRowBottom, true /* canPulse */);
     pEvidenceSelector = new EvidenceSelector(true /* isCancelable */, true /* isForCombination */);
@@ -262,6 +260,7 @@ Location::Location(XmlReader *pReader)
     pQuitConfirmOverlay->FinalizeButtons();
 
     shouldAutosave = false;
+    msUntilNeighboringLocationPrefetchUpdate = NeighboringLocationPrefetchIntervalMs;
 
     pReader->StartElement("Location");
 
@@ -453,9 +452,9 @@ Location::Location(const Location &other)
     pAreaHitBox = NULL;
     animationOffsetPartner = gScreenWidth;
     movingDirectly = false;
-    pPathfindingThread = NULL;
-    pPathfindingValuesSemaphore = SDL_CreateSemaphore(1);
-    lastPathfindingThreadId = 0;
+    pPathfindingService = new PathfindingService(this);
+    pNavigationGridSemaphore = SDL_CreateSemaphore(1);
+    pCollisionBroadphase = NULL;
 
     pEvidenceTab = new Tab(gScreenWidth - 3 * (TabWidth + 7), true /* isClickable */, "EVIDENCE", false /* useCancelClickSoundEffect */, TabRowBottom);
     pEvidenceSelector = new EvidenceSelector(true /* isCancelable */, true /* isForCombination */);
@@ -490,6 +489,7 @@ Location::Location(const Location &other)
 
     fadeOpacity = 1;
     shouldAutosave = false;
+    msUntilNeighboringLocationPrefetchUpdate = NeighboringLocationPrefetchIntervalMs;
 
     pEvidenceTab->SetIsHidden(true, false);
     pPartnerTab->SetIsHidden(true, false);
@@ -582,12 +582,21 @@ Location::~Location()
     delete pQuitTab;
     pQuitTab = NULL;
 
-    if (pPathfindingThread != NULL)
+    // Deleting the pathfinding service waits for any in-progress search to wrap up,
+    // so it needs to go before the navigation grids that the search might be using.
+    delete pPathfindingService;
+    pPathfindingService = NULL;
+
+    for (map<string, NavigationGrid *>::iterator iter = navigationGridByCharacterIdMap.begin(); iter != navigationGridByCharacterIdMap.end(); ++iter)
     {
-        SDL_WaitThread(pPathfindingThread, NULL);
+        delete iter->second;
     }
 
-    SDL_DestroySemaphore(pPathfindingValuesSemaphore);
+    navigationGridByCharacterIdMap.clear();
+    SDL_DestroySemaphore(pNavigationGridSemaphore);
+
+    delete pCollisionBroadphase;
+    pCollisionBroadphase = NULL;
 
     EventProviders::GetPromptOverlayEventProvider()->ClearListener(this);
 }
@@ -683,11 +692,18 @@ void Location::UpdateLoadedTextures(bool waitUntilLoaded)
         }
     }
 
-    Case::GetInstance()->UpdateLoadedTextures(GetId(), waitUntilLoaded);
+    vector<string> firstFrameSpriteIdList;
+    GetFirstFrameSpriteIds(&firstFrameSpriteIdList);
+
+    Case::GetInstance()->UpdateLoadedTextures(GetId(), waitUntilLoaded, firstFrameSpriteIdList);
 }
 
 void Location::Begin(string transitionId)
 {
+    // We're about to replace the partner character, so we can't have
+    // the pathfinding thread still working with the old one.
+    pPathfindingService->CancelAllRequests(true /* waitForCurrentRequest */);
+
     if (pPlayerCharacter == NULL)
     {
         pPlayerCharacter = Case::GetInstance()->GetFieldCharacterManager()->GetPlayerCharacter();
@@ -791,6 +807,9 @@ void Location::Begin(string transitionId)
 
     pTargetInteractiveElement = NULL;
 
+    BuildNavigationGrids();
+    BuildCollisionBroadphase();
+
     vector<FieldCharacter *> fieldCharacterList;
 
     fieldCharacterList.push_back(pPlayerCharacter);
@@ -886,6 +905,9 @@ void Location::Begin(string transitionId)
     // setting it true, and then another cutscene transported us to a new location.
     shouldAutosave = false;
 
+    // We'll give the new location's own textures a moment to load before we start on its neighbors'.
+    msUntilNeighboringLocationPrefetchUpdate = NeighboringLocationPrefetchIntervalMs;
+
     CheckForTransitionUnderPlayer();
 }
 
@@ -896,6 +918,10 @@ void Location::Update(int delta)
         SaveDialogsSeenListForCase(Case::GetInstance()->GetUuid());
     }
 
+    UpdateNavigationGridPresence();
+    UpdateCollisionBroadphase();
+    ApplyPathfindingResults();
+
     vector<PositionalSound> soundsToPlayList;
 
     if (pendingBgm.length() > 0)
@@ -1402,6 +1428,9 @@ void Location::Update(int delta)
 
         if (currentPartnerId.length() == 0)
         {
+            // Any search in progress may be testing collisions against the partner,
+            // so we need to stop it before the partner goes away.
+            pPathfindingService->CancelAllRequests(true /* waitForCurrentRequest */);
             characterStateMap.erase(pPartnerCharacter);
             characterTargetPositionQueueMap.erase(pPartnerCharacter);
             characterTargetPositionMap.erase(pPartnerCharacter);
@@ -1413,6 +1442,7 @@ void Location::Update(int delta)
         {
             if (pPartnerCharacter != NULL)
             {
+                pPathfindingService->CancelAllRequests(true /* waitForCurrentRequest */);
                 characterStateMap.erase(pPartnerCharacter);
                 characterTargetPositionQueueMap.erase(pPartnerCharacter);
                 characterTargetPositionMap.erase(pPartnerCharacter);
@@ -1518,6 +1548,8 @@ void Location::Update(int delta)
             shouldAutosave = false;
         }
 
+        UpdateNeighboringLocationPrefetch(delta);
+
         pEvidenceTab->SetIsPulsing(Case::GetInstance()->GetEvidenceManager()->GetAreEvidenceCombinations() && gEnableHints);
         pEvidenceTab->Update(delta);
 
@@ -1975,7 +2007,7 @@ void Location::Update(int delta)
                     endPosition = pPlayerCharacter->GetVectorAnchorPosition();
                 }
 
-                SDL_SemWait(pPathfindingValuesSemaphore);
+                pPathfindingService->CancelRequests(pPlayerCharacter);
 
                 movingDirectly = true;
                 pTargetInteractiveElement = NULL;
@@ -1989,8 +2021,6 @@ void Location::Update(int delta)
                     characterTargetPositionMap[pPartnerCharacter] = Vector2(-1, -1);
                     characterStateMap[pPartnerCharacter] = FieldCharacterStateStanding;
                 }
-
-                SDL_SemPost(pPathfindingValuesSemaphore);
             }
             else if (MouseHelper::DoublePressedAndHeldAnywhere())
             {
@@ -2004,7 +2034,7 @@ void Location::Update(int delta)
                     endPosition = pPlayerCharacter->GetVectorAnchorPosition();
                 }
 
-                SDL_SemWait(pPathfindingValuesSemaphore);
+                pPathfindingService->CancelRequests(pPlayerCharacter);
 
                 movingDirectly = true;
                 pTargetInteractiveElement = NULL;
@@ -2018,8 +2048,6 @@ void Location::Update(int delta)
                     characterTargetPositionMap[pPartnerCharacter] = Vector2(-1, -1);
                     characterStateMap[pPartnerCharacter] = FieldCharacterStateStanding;
                 }
-
-                SDL_SemPost(pPathfindingValuesSemaphore);
             }
             else if (movingDirectly)
             {
@@ -2030,8 +2058,6 @@ void Location::Update(int delta)
         }
     }
 
-    SDL_SemWait(pPathfindingValuesSemaphore);
-
     if (pTargetInteractiveElement != NULL)
     {
         // If we're close enough to the interactive element,
@@ -2424,16 +2450,18 @@ void Location::Update(int delta)
         pPartnerCharacter->SetState(FieldCharacterStateStanding);
     }
 
-    SDL_SemPost(pPathfindingValuesSemaphore);
-
     if (pPartnerCharacter != NULL)
     {
         pPartnerCharacter->UpdateAnimation(delta);
     }
 
-    if (shouldDoPartnerPathfinding)
+    // The partner's path is found on the pathfinding thread like the player's is,
+    // so that we never hold up the frame waiting on a search.  We'll only ask for a new one
+    // once the last one has come back, since each new request cancels the one before it.
+    if (shouldDoPartnerPathfinding && !pPathfindingService->HasPendingRequest(pPartnerCharacter))
     {
-        StartCharacterOnPath(pPartnerCharacter, pPlayerCharacter->GetVectorAnchorPosition(), FieldCharacterStateWalking, false /* doAsync */);
+        UpdateCollisionBroadphase();
+        StartCharacterOnPath(pPartnerCharacter, pPlayerCharacter->GetVectorAnchorPosition(), FieldCharacterStateWalking);
     }
 
     for (unsigned int i = 0; i < characterList.size(); i++)
@@ -2863,6 +2891,8 @@ void Location::SaveToSaveFile(XmlWriter *pWriter)
 
 void Location::LoadFromSaveFile(XmlReader *pReader)
 {
+    pPathfindingService->CancelAllRequests(true /* waitForCurrentRequest */);
+
     if (pPlayerCharacter == NULL)
     {
         pPlayerCharacter = Case::GetInstance()->GetFieldCharacterManager()->GetPlayerCharacter();
@@ -2936,6 +2966,9 @@ void Location::LoadFromSaveFile(XmlReader *pReader)
 
     pTargetInteractiveElement = NULL;
 
+    BuildNavigationGrids();
+    BuildCollisionBroadphase();
+
     vector<FieldCharacter *> fieldCharacterList;
 
     fieldCharacterList.push_back(pPlayerCharacter);
@@ -3167,31 +3200,26 @@ bool Location::GetIsPlayerCharacterCloseToInteractiveElement()
             (playerAnchorPosition.GetY() >= boundsForInteraction.GetY() && playerAnchorPosition.GetY() <= boundsForInteraction.GetY() + boundsForInteraction.GetHeight() + allowedDistanceOffset)));
 }
 
-void Location::StartCharacterOnPath(FieldCharacter *pCharacter, Vector2 endPosition, FieldCharacterState characterStateIfMoving, bool doAsync)
+void Location::StartCharacterOnPath(FieldCharacter *pCharacter, Vector2 endPosition, FieldCharacterState characterStateIfMoving)
 {
     Vector2 currentPosition = pCharacter->GetVectorAnchorPosition();
 
-    if (doAsync)
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_PATHFINDING_BENCHMARK
+    if (pCharacter == pPlayerCharacter)
     {
-        SDL_SemWait(pPathfindingValuesSemaphore);
+        recordedPathfindingQueries.push_back(pair<Vector2, Vector2>(currentPosition, endPosition));
     }
+    #endif
+#endif
 
     if (pCharacter == pPlayerCharacter)
     {
         movingDirectly = false;
     }
 
-    lastPathfindingThreadId++;
-
-    if (doAsync)
-    {
-        pPathfindingThread = SDL_CreateThread(Location::PerformPathfindingStatic, "PathfindingThread", new PathfindingThreadParameters(this, pCharacter, currentPosition, endPosition, characterStateIfMoving, lastPathfindingThreadId));
-        SDL_SemPost(pPathfindingValuesSemaphore);
-    }
-    else
-    {
-        PerformPathfinding(pCharacter, currentPosition, endPosition, characterStateIfMoving, lastPathfindingThreadId);
-    }
+    // The result will be picked up in a later call to Update().
+    pPathfindingService->QueueRequest(pCharacter, currentPosition, endPosition, characterStateIfMoving);
 
     MouseHelper::HandleClick();
     MouseHelper::HandleDoubleClick();
@@ -3199,164 +3227,189 @@ void Location::StartCharacterOnPath(FieldCharacter *pCharacter, Vector2 endPosit
 
 void Location::OnExited(Location *pLocation, string transitionId)
 {
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_PATHFINDING_BENCHMARK
+    BenchmarkPathfinding();
+    recordedPathfindingQueries.clear();
+    #endif
+
+    #ifdef MLI_DEBUG_COLLISION_BROADPHASE
+    if (pCollisionBroadphase != NULL)
+    {
+        CollisionBroadphase::Statistics statistics = pCollisionBroadphase->GetStatistics();
+
+        cout << "Collision broadphase for location \"" << GetId() << "\": "
+             << statistics.Probes << " probes against " << pCollisionBroadphase->GetEntryCount() << " objects, "
+             << statistics.Candidates << " candidates, "
+             << statistics.NarrowphaseTests << " SAT tests" << endl;
+
+        pCollisionBroadphase->ResetStatistics();
+    }
+    #endif
+#endif
+
     EventProviders::GetLocationEventProvider()->RaiseExited(this, pLocation, transitionId);
 }
 
-int Location::PerformPathfindingStatic(void *pData)
+queue<Vector2> Location::FindPathForRequest(FieldCharacter *pCharacter, Vector2 startPosition, Vector2 endPosition, Pathfinder *pPathfinder, SDL_atomic_t *pCancellationFlag)
 {
-    PathfindingThreadParameters *pParams = reinterpret_cast<PathfindingThreadParameters *>(pData);
+    queue<Vector2> targetPositionQueue;
+
+    SDL_SemWait(pNavigationGridSemaphore);
+
+    endPosition = FindClosestPassablePositionForCharacter(pCharacter, endPosition);
+
+    if (pCancellationFlag == NULL || SDL_AtomicGet(pCancellationFlag) == 0)
+    {
+        targetPositionQueue = GetPathForCharacterBetweenPoints(pCharacter, startPosition, endPosition, pPathfinder, pCancellationFlag);
+    }
 
-    Location *pThis = pParams->pLocation;
-    FieldCharacter *pCharacter = pParams->pCharacter;
-    Vector2 startPosition = pParams->startPosition;
-    Vector2 endPosition = pParams->endPosition;
-    FieldCharacterState characterStateIfMoving = pParams->characterStateIfMoving;
-    int threadId = pParams->threadId;
+    if (!targetPositionQueue.empty())
+    {
+        targetPositionQueue = RemoveUnnecessaryStepsFromPath(pCharacter, startPosition, targetPositionQueue);
+    }
+
+    SDL_SemPost(pNavigationGridSemaphore);
 
-    delete pParams;
+    return targetPositionQueue;
+}
 
-    pThis->PerformPathfinding(pCharacter, startPosition, endPosition, characterStateIfMoving, threadId);
+void Location::ApplyPathfindingResults()
+{
+    PathfindingService::Result result;
 
-    return 0;
+    while (pPathfindingService->TryGetResult(&result))
+    {
+        ApplyPathfindingResult(result.request.pCharacter, result.request.startPosition, result.request.characterStateIfMoving, result.path);
+    }
 }
 
-void Location::PerformPathfinding(FieldCharacter *pCharacter, Vector2 startPosition, Vector2 endPosition, FieldCharacterState characterStateIfMoving, int threadId)
+void Location::ApplyPathfindingResult(FieldCharacter *pCharacter, Vector2 startPosition, FieldCharacterState characterStateIfMoving, queue<Vector2> targetPositionQueue)
 {
-    queue<Vector2> targetPositionQueue;
     Vector2 targetPosition;
 
-    endPosition = FindClosestPassablePositionForCharacter(pCharacter, endPosition);
-    targetPositionQueue = GetPathForCharacterBetweenPoints(pCharacter, startPosition, endPosition);
-
-    if (targetPositionQueue.empty())
+    if (targetPositionQueue.empty() || (movingDirectly && pCharacter == pPlayerCharacter))
     {
         return;
     }
 
-    targetPositionQueue = RemoveUnnecessaryStepsFromPath(pCharacter, startPosition, targetPositionQueue);
-
-    SDL_SemWait(pPathfindingValuesSemaphore);
+    targetPosition = targetPositionQueue.front();
+    characterTargetPositionQueueMap[pCharacter] = targetPositionQueue;
+    characterTargetPositionMap[pCharacter] = targetPosition;
+    characterTargetPositionQueueMap[pCharacter].pop();
 
-    if ((!movingDirectly || pCharacter != pPlayerCharacter) && lastPathfindingThreadId == threadId)
+    if (characterTargetPositionMap[pCharacter].GetX() >= 0)
     {
-        targetPosition = targetPositionQueue.front();
-        characterTargetPositionQueueMap[pCharacter] = targetPositionQueue;
-        characterTargetPositionMap[pCharacter] = targetPosition;
-        characterTargetPositionQueueMap[pCharacter].pop();
+        Vector2 displacementDelta = characterTargetPositionMap[pCharacter] - startPosition;
 
-        if (characterTargetPositionMap[pCharacter].GetX() >= 0)
+        if (displacementDelta.Length() > 0.001)
         {
-            Vector2 displacementDelta = characterTargetPositionMap[pCharacter] - startPosition;
-
-            if (displacementDelta.Length() > 0.001)
+            if (displacementDelta.GetX() < 0)
             {
-                if (displacementDelta.GetX() < 0)
-                {
-                    pCharacter->SetDirection(CharacterDirectionLeft);
-                }
-                else if (displacementDelta.GetX() > 0)
-                {
-                    pCharacter->SetDirection(CharacterDirectionRight);
-                }
-
-                characterStateMap[pCharacter] = characterStateIfMoving;
+                pCharacter->SetDirection(CharacterDirectionLeft);
             }
-        }
-        else
-        {
-            characterStateMap[pCharacter] = FieldCharacterStateStanding;
+            else if (displacementDelta.GetX() > 0)
+            {
+                pCharacter->SetDirection(CharacterDirectionRight);
+            }
+
+            characterStateMap[pCharacter] = characterStateIfMoving;
         }
     }
-
-    pPathfindingThread = NULL;
-    SDL_SemPost(pPathfindingValuesSemaphore);
+    else
+    {
+        characterStateMap[pCharacter] = FieldCharacterStateStanding;
+    }
 }
 
 queue<Vector2> Location::RemoveUnnecessaryStepsFromPath(FieldCharacter *pCharacter, Vector2 startPosition, queue<Vector2> pathPositionQueue)
 {
     queue<Vector2> optimizedPath;
-    bool optimizationOccurred = true;
+    Vector2 anchorPosition = startPosition;
 
-    while (pathPositionQueue.size() > 1 && optimizationOccurred)
+    // We'll walk the path once, heading in a straight line from the last step we kept
+    // for as long as we can.  A step only needs to be kept if we can't get
+    // directly from the last kept step to the one after it.
+    while (!pathPositionQueue.empty())
     {
-        Vector2 previousPosition = startPosition;
         Vector2 currentPosition = pathPositionQueue.front();
         pathPositionQueue.pop();
-        Vector2 nextPosition = pathPositionQueue.front();
 
-        optimizationOccurred = false;
-        optimizedPath = queue<Vector2>();
-
-        while (!pathPositionQueue.empty())
+        if (pathPositionQueue.empty())
         {
-            // If a collision occurs when we remove the current step,
-            // then this step is needed in the path, so we'll add it
-            // to the optimized path.  Otherwise, we'll leave it out,
-            // and note that an optimization occurred.
-            if (IsCollisionBetweenTwoPositions(pCharacter, previousPosition, nextPosition))
-            {
-                optimizedPath.push(currentPosition);
-                previousPosition = currentPosition;
-                currentPosition = pathPositionQueue.front();
-                pathPositionQueue.pop();
-            }
-            else
-            {
-                optimizationOccurred = true;
-
-                if (pathPositionQueue.size() > 1)
-                {
-                    optimizedPath.push(nextPosition);
-                    previousPosition = pathPositionQueue.front();
-                    pathPositionQueue.pop();
-                    currentPosition = pathPositionQueue.front();
-                    pathPositionQueue.pop();
-                }
-                else
-                {
-                    // If we've only got one item left in the queue,
-                    // set it to the current position so it'll get
-                    // added to the optimized path.
-                    currentPosition = pathPositionQueue.front();
-                    pathPositionQueue.pop();
-                }
-            }
-
-            if (!pathPositionQueue.empty())
-            {
-                nextPosition = pathPositionQueue.front();
-            }
+            // We always need the last step to be in the path.
+            optimizedPath.push(currentPosition);
+        }
+        else if (IsCollisionBetweenTwoPositions(pCharacter, anchorPosition, pathPositionQueue.front()))
+        {
+            optimizedPath.push(currentPosition);
+            anchorPosition = currentPosition;
         }
-
-        // We always need the last step to be in the path.
-        optimizedPath.push(currentPosition);
-        pathPositionQueue = optimizedPath;
     }
 
-    return pathPositionQueue;
+    return optimizedPath;
 }
 
 bool Location::IsCollisionBetweenTwoPositions(FieldCharacter *pCharacter, Vector2 startPosition, Vector2 endPosition)
 {
-    double totalDistance = (endPosition - startPosition).Length();
-    // TODO: Reconsider this magic number.
-    double stepSize = 10;
-    Vector2 directionVector = (endPosition - startPosition).Normalize() * stepSize;
-    Vector2 currentPosition = startPosition;
+    HitBox *pCharacterHitBox = pCharacter->GetHitBox();
 
-    for (double i = 0; i < totalDistance; i += stepSize)
+    if (pCharacterHitBox == NULL)
     {
-        if (TestCollisionWithLocationElements(pCharacter, currentPosition))
-        {
-            return true;
-        }
-        else
+        return false;
+    }
+
+    Vector2 anchorOffset = pCharacter->GetVectorAnchorPosition() - pCharacter->GetPosition();
+    Vector2 startOffset = startPosition - anchorOffset;
+    Vector2 endOffset = endPosition - anchorOffset;
+    int narrowphaseTestCount = 0;
+    bool isCollision = false;
+
+    // Rather than testing positions along the way, which can step right over thin obstacles,
+    // we sweep the character's hitbox along the whole line, which finds every collision exactly.
+    if (pCharacterHitBox->IsSweptCollision(startOffset, endOffset, GetAreaHitBox(), Vector2(0, 0)))
+    {
+        return true;
+    }
+
+    RectangleWH startBounds = pCharacterHitBox->GetCollisionBoundingBox(startOffset);
+    RectangleWH endBounds = pCharacterHitBox->GetCollisionBoundingBox(endOffset);
+    double left = min(startBounds.GetX(), endBounds.GetX());
+    double top = min(startBounds.GetY(), endBounds.GetY());
+    double right = max(startBounds.GetX() + startBounds.GetWidth(), endBounds.GetX() + endBounds.GetWidth());
+    double bottom = max(startBounds.GetY() + startBounds.GetHeight(), endBounds.GetY() + endBounds.GetHeight());
+
+    int candidateIndices[MaxCollisionBroadphaseCandidates];
+    int candidateCount = -1;
+
+    if (pCollisionBroadphase != NULL)
+    {
+        candidateCount = pCollisionBroadphase->Query(RectangleWH(left, top, right - left, bottom - top), candidateIndices, MaxCollisionBroadphaseCandidates);
+    }
+
+    int entryCount = candidateCount < 0 ? GetCollisionBroadphaseEntryCount() : candidateCount;
+
+    for (int i = 0; i < entryCount && !isCollision; i++)
+    {
+        int entryIndex = candidateCount < 0 ? i : candidateIndices[i];
+        HitBox *pHitBox = NULL;
+        Vector2 hitBoxOffset;
+
+        if (!GetCollisionBroadphaseEntryHitBox(pCharacter, entryIndex, true /* includeStaticElements */, &pHitBox, &hitBoxOffset))
         {
-            currentPosition += directionVector;
+            continue;
         }
+
+        narrowphaseTestCount++;
+        isCollision = pCharacterHitBox->IsSweptCollision(startOffset, endOffset, pHitBox, hitBoxOffset);
     }
 
-    return false;
+    if (pCollisionBroadphase != NULL)
+    {
+        pCollisionBroadphase->AddNarrowphaseTests(narrowphaseTestCount);
+    }
+
+    return isCollision;
 }
 
 Vector2 Location::FindClosestPassablePositionForCharacter(FieldCharacter *pCharacter, Vector2 position)
@@ -3425,239 +3478,461 @@ void Location::FindClosestPassablePositionForCharacter(FieldCharacter *pCharacte
     }
 }
 
-queue<Vector2> Location::GetPathForCharacterBetweenPoints(FieldCharacter *pCharacter, Vector2 start, Vector2 goal)
+queue<Vector2> Location::GetPathForCharacterBetweenPoints(FieldCharacter *pCharacter, Vector2 start, Vector2 goal, Pathfinder *pPathfinder, SDL_atomic_t *pCancellationFlag)
+{
+    return pPathfinder->FindPath(this, pCharacter, GetBounds(), start, goal, PathfindingTileSize, pCancellationFlag);
+}
+
+bool Location::TestCollisionWithLocationElements(FieldCharacter *pCharacter, Vector2 position)
+{
+    position -= pCharacter->GetVectorAnchorPosition() - pCharacter->GetPosition();
+
+    // If the character is itself the target, then it doesn't collide with static elements at all,
+    // which the navigation grid doesn't account for, so we'll just test everything in that case.
+    NavigationGrid *pNavigationGrid = pCharacter != pTargetInteractiveElement ? GetNavigationGridForCharacter(pCharacter) : NULL;
+    NavigationGridCellState cellState = NavigationGridCellStateUnknown;
+
+    if (pNavigationGrid != NULL)
+    {
+        cellState = pNavigationGrid->GetCellState(position, GetNavigationGridLayerIndex(pTargetInteractiveElement));
+    }
+
+    if (cellState == NavigationGridCellStateBlocked)
+    {
+        return true;
+    }
+
+    bool includeStaticElements = cellState == NavigationGridCellStateUnknown;
+
+    // We only need a yes or no here, so we'll pass no collision parameter
+    // in order to skip working out how far we're overlapping everything.
+    if (includeStaticElements && pCharacter->TestCollisionAtPosition(position, GetAreaHitBox(), NULL))
+    {
+        return true;
+    }
+
+    return TestCollisionWithLocationObjects(pCharacter, position, includeStaticElements, NULL);
+}
+
+bool Location::TestCollisionWithLocationElements(FieldCharacter *pCharacter, Vector2 position, CollisionParameter *pParam)
 {
-    list<Vector2> closedSet;
-    list<Vector2> openSet;
-    map<Vector2, Vector2> cameFrom;
+    position -= pCharacter->GetVectorAnchorPosition() - pCharacter->GetPosition();
 
-    // Initialize the open set to have the start position.
-    openSet.push_back(start);
+    if (pCharacter->TestCollisionAtPosition(position, GetAreaHitBox(), pParam))
+    {
+        return true;
+    }
 
-    map<Vector2, double> gScore;
-    map<Vector2, double> hScore;
-    map<Vector2, double> fScore;
+    return TestCollisionWithLocationObjects(pCharacter, position, true /* includeStaticElements */, pParam);
+}
 
-    gScore[start] = 0.0;
-    hScore[start] = HeuristicCostEstimate(start, goal);
-    fScore[start] = gScore[start] + hScore[start];
+bool Location::TestCollisionWithLocationObjects(FieldCharacter *pCharacter, Vector2 position, bool includeStaticElements, CollisionParameter *pParam)
+{
+    int candidateIndices[MaxCollisionBroadphaseCandidates];
+    int candidateCount = -1;
+    int narrowphaseTestCount = 0;
+    bool isCollision = false;
 
-    double tileSize = 20;
+    if (pCollisionBroadphase != NULL && pCharacter->GetHitBox() != NULL)
+    {
+        candidateCount = pCollisionBroadphase->Query(pCharacter->GetHitBox()->GetCollisionBoundingBox(position), candidateIndices, MaxCollisionBroadphaseCandidates);
+    }
 
-    double closestPointDistance = numeric_limits<double>::infinity();
-    Vector2 closestPoint(0, 0);
+    // If we don't have a broadphase to go on, we'll just test everything.
+    if (candidateCount < 0)
+    {
+        int entryCount = GetCollisionBroadphaseEntryCount();
 
-    while (!openSet.empty())
+        for (int i = 0; i < entryCount && !isCollision; i++)
+        {
+            isCollision = TestCollisionWithCollisionBroadphaseEntry(pCharacter, position, i, includeStaticElements, pParam, &narrowphaseTestCount);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < candidateCount && !isCollision; i++)
+        {
+            isCollision = TestCollisionWithCollisionBroadphaseEntry(pCharacter, position, candidateIndices[i], includeStaticElements, pParam, &narrowphaseTestCount);
+        }
+    }
+
+    if (pCollisionBroadphase != NULL)
     {
-        Vector2 current = GetVectorWithLowestFScore(openSet, fScore);
+        pCollisionBroadphase->AddNarrowphaseTests(narrowphaseTestCount);
+    }
+
+    return isCollision;
+}
+
+void Location::TestCollisionBatch(FieldCharacter *pCharacter, const Vector2 *pPositions, int positionCount, unsigned int *pCollisionMask)
+{
+    Vector2 offsets[MaxCollisionBatchSize];
+    Vector2 anchorOffset = pCharacter->GetVectorAnchorPosition() - pCharacter->GetPosition();
+    HitBox *pCharacterHitBox = pCharacter->GetHitBox();
+    unsigned int collisionMask = 0;
+    unsigned int staticTestMask = 0;
+    int narrowphaseTestCount = 0;
 
-        if (IsPointInTileAtPoint(goal, current, tileSize))
+    positionCount = min(positionCount, MaxCollisionBatchSize);
+
+    unsigned int positionMask = positionCount == MaxCollisionBatchSize ? 0xFFFFFFFF : (1u << positionCount) - 1;
+
+    // As with testing one position at a time, the navigation grid answers for the static elements
+    // wherever it can, so those only need to be tested at the positions where it can't.
+    NavigationGrid *pNavigationGrid = pCharacter != pTargetInteractiveElement ? GetNavigationGridForCharacter(pCharacter) : NULL;
+    int excludedLayerIndex = GetNavigationGridLayerIndex(pTargetInteractiveElement);
+    double left = numeric_limits<double>::infinity();
+    double top = numeric_limits<double>::infinity();
+    double right = -numeric_limits<double>::infinity();
+    double bottom = -numeric_limits<double>::infinity();
+
+    for (int i = 0; i < positionCount; i++)
+    {
+        offsets[i] = pPositions[i] - anchorOffset;
+
+        NavigationGridCellState cellState = pNavigationGrid != NULL ? pNavigationGrid->GetCellState(offsets[i], excludedLayerIndex) : NavigationGridCellStateUnknown;
+
+        if (cellState == NavigationGridCellStateBlocked)
         {
-            closestPoint = current;
-            break;
+            collisionMask |= 1u << i;
+            continue;
         }
-        else if ((goal - current).Length() < closestPointDistance)
+        else if (cellState == NavigationGridCellStateUnknown)
         {
-            closestPointDistance = (goal - current).Length();
-            closestPoint = current;
+            staticTestMask |= 1u << i;
         }
 
-        openSet.remove(current);
-        closedSet.push_back(current);
+        RectangleWH probeBounds = pCharacterHitBox->GetCollisionBoundingBox(offsets[i]);
+
+        left = min(left, probeBounds.GetX());
+        top = min(top, probeBounds.GetY());
+        right = max(right, probeBounds.GetX() + probeBounds.GetWidth());
+        bottom = max(bottom, probeBounds.GetY() + probeBounds.GetHeight());
+    }
+
+    if (staticTestMask != 0)
+    {
+        collisionMask |= pCharacterHitBox->IsCollisionBatch(offsets, positionCount, staticTestMask, GetAreaHitBox(), Vector2(0, 0));
+    }
 
-        list<Vector2> neighborNodes = GetNeighbors(pCharacter, current, goal, tileSize);
+    if ((positionMask & ~collisionMask) != 0)
+    {
+        // A single broadphase query covering every remaining position gets us
+        // everything that any of them could be colliding with.
+        int candidateIndices[MaxCollisionBroadphaseCandidates];
+        int candidateCount = -1;
 
-        for (list<Vector2>::iterator iter = neighborNodes.begin(); iter != neighborNodes.end(); ++iter)
+        if (pCollisionBroadphase != NULL)
         {
-            Vector2 neighborNode = *iter;
+            candidateCount = pCollisionBroadphase->Query(RectangleWH(left, top, right - left, bottom - top), candidateIndices, MaxCollisionBroadphaseCandidates);
+        }
+
+        int entryCount = candidateCount < 0 ? GetCollisionBroadphaseEntryCount() : candidateCount;
 
-            if (find(closedSet.begin(), closedSet.end(), neighborNode) != closedSet.end())
+        for (int i = 0; i < entryCount; i++)
+        {
+            int entryIndex = candidateCount < 0 ? i : candidateIndices[i];
+            unsigned int remainingMask = positionMask & ~collisionMask;
+            HitBox *pHitBox = NULL;
+            Vector2 hitBoxOffset;
+
+            if (remainingMask == 0)
             {
-                continue;
+                break;
             }
 
-            double tentativeGScore = gScore[current] + (neighborNode - current).Length();
-            bool tentativeIsBetter = false;
-
-            if (find(openSet.begin(), openSet.end(), neighborNode) == openSet.end())
+            if (!GetCollisionBroadphaseEntryHitBox(pCharacter, entryIndex, true /* includeStaticElements */, &pHitBox, &hitBoxOffset))
             {
-                openSet.push_back(neighborNode);
-                hScore[neighborNode] = HeuristicCostEstimate(neighborNode, goal);
-                tentativeIsBetter = true;
+                continue;
             }
-            else if (tentativeGScore < gScore[neighborNode])
+
+            // Static elements only need testing where the navigation grid couldn't tell us about them.
+            if (entryIndex > (int)characterList.size())
             {
-                tentativeIsBetter = true;
+                remainingMask &= staticTestMask;
             }
 
-            if (tentativeIsBetter)
+            if (remainingMask != 0)
             {
-                cameFrom[neighborNode] = current;
-                gScore[neighborNode] = tentativeGScore;
-                fScore[neighborNode] = tentativeGScore + hScore[neighborNode];
+                narrowphaseTestCount++;
+                collisionMask |= pCharacterHitBox->IsCollisionBatch(offsets, positionCount, remainingMask, pHitBox, hitBoxOffset);
             }
         }
     }
 
-    return *ReconstructPath(&cameFrom, closestPoint, goal);
+    if (pCollisionBroadphase != NULL)
+    {
+        pCollisionBroadphase->AddNarrowphaseTests(narrowphaseTestCount);
+    }
+
+    *pCollisionMask = collisionMask;
 }
 
-double Location::HeuristicCostEstimate(Vector2 start, Vector2 end)
+bool Location::TestCollisionForPathfinding(FieldCharacter *pCharacter, Vector2 position)
 {
-    return (end - start).Length();
+    return TestCollisionWithLocationElements(pCharacter, position);
 }
 
-bool Location::IsPointInTileAtPoint(Vector2 point, Vector2 tilePoint, double tileSize)
+void Location::TestCollisionBatchForPathfinding(FieldCharacter *pCharacter, const Vector2 *pPositions, int positionCount, unsigned int *pCollisionMask)
 {
-    return
-        point.GetX() - tilePoint.GetX() < tileSize / 2 && point.GetX() - tilePoint.GetX() >= -tileSize / 2 &&
-        point.GetY() - tilePoint.GetY() < tileSize / 2 && point.GetY() - tilePoint.GetY() >= -tileSize / 2;
+    TestCollisionBatch(pCharacter, pPositions, positionCount, pCollisionMask);
 }
 
-Vector2 Location::GetVectorWithLowestFScore(list<Vector2> openSet, map<Vector2, double> fScore)
+void Location::BuildNavigationGrids()
 {
-    double lowestFScore = numeric_limits<double>::infinity();
-    Vector2 vectorWithLowestFScore(0, 0);
+    SDL_SemWait(pNavigationGridSemaphore);
 
-    for (list<Vector2>::iterator iter = openSet.begin(); iter != openSet.end(); ++iter)
+    for (map<string, NavigationGrid *>::iterator iter = navigationGridByCharacterIdMap.begin(); iter != navigationGridByCharacterIdMap.end(); ++iter)
     {
-        Vector2 currentVector = *iter;
-        double currentFScore = fScore[currentVector];
+        delete iter->second;
+    }
 
-        if (currentFScore < lowestFScore)
-        {
-            lowestFScore = currentFScore;
-            vectorWithLowestFScore = currentVector;
-        }
+    navigationGridByCharacterIdMap.clear();
+    foregroundElementPresenceList.clear();
+
+    for (unsigned int i = 0; i < foregroundElementList.size(); i++)
+    {
+        foregroundElementPresenceList.push_back(foregroundElementList[i]->IsPresent());
     }
 
-    return vectorWithLowestFScore;
-}
+    // We'll build the grids for the player and partner up front,
+    // since they're the ones that will be pathfinding the most.
+    // Anyone else will get theirs built the first time they need one.
+    GetNavigationGridForCharacter(pPlayerCharacter);
 
-list<Vector2> Location::GetNeighbors(FieldCharacter *pCharacter, Vector2 position, Vector2 goal, double tileSize)
-{
-    list<Vector2> neighborNodes;
+    if (pPartnerCharacter != NULL)
+    {
+        GetNavigationGridForCharacter(pPartnerCharacter);
+    }
 
-    Vector2 topLeftNeighbor(position.GetX() - tileSize, position.GetY() - tileSize);
+    SDL_SemPost(pNavigationGridSemaphore);
+}
 
-    if (IsPointInTileAtPoint(goal, topLeftNeighbor, tileSize))
+void Location::UpdateNavigationGridPresence()
+{
+    // If pathfinding is currently using the navigation grids,
+    // we'll just try again next frame rather than waiting for it to finish.
+    if (SDL_SemTryWait(pNavigationGridSemaphore) != 0)
     {
-        topLeftNeighbor = goal;
+        return;
     }
 
-    if (!TestCollisionWithLocationElements(pCharacter, topLeftNeighbor))
+    for (unsigned int i = 0; i < foregroundElementList.size() && i < foregroundElementPresenceList.size(); i++)
     {
-        neighborNodes.push_back(topLeftNeighbor);
+        bool isPresent = foregroundElementList[i]->IsPresent();
+
+        if (isPresent != foregroundElementPresenceList[i])
+        {
+            for (map<string, NavigationGrid *>::iterator iter = navigationGridByCharacterIdMap.begin(); iter != navigationGridByCharacterIdMap.end(); ++iter)
+            {
+                iter->second->SetLayerEnabled(GetNavigationGridLayerIndex(foregroundElementList[i]), isPresent);
+            }
+
+            foregroundElementPresenceList[i] = isPresent;
+        }
     }
 
-    Vector2 topNeighbor(position.GetX(), position.GetY() - tileSize);
+    SDL_SemPost(pNavigationGridSemaphore);
+}
 
-    if (IsPointInTileAtPoint(goal, topNeighbor, tileSize))
+NavigationGrid * Location::GetNavigationGridForCharacter(FieldCharacter *pCharacter)
+{
+    if (pCharacter->GetHitBox() == NULL || GetAreaHitBox() == NULL || foregroundElementPresenceList.size() != foregroundElementList.size())
     {
-        topNeighbor = goal;
+        return NULL;
     }
 
-    if (!TestCollisionWithLocationElements(pCharacter, topNeighbor))
+    if (navigationGridByCharacterIdMap.count(pCharacter->GetId()) == 0)
     {
-        neighborNodes.push_back(topNeighbor);
+        // The layers need to be added in the order that GetNavigationGridLayerIndex expects.
+        NavigationGrid *pNavigationGrid = new NavigationGrid(pCharacter->GetHitBox(), GetBounds());
+
+        pNavigationGrid->AddLayer(GetAreaHitBox(), Vector2(0, 0));
+
+        for (unsigned int i = 0; i < foregroundElementList.size(); i++)
+        {
+            pNavigationGrid->AddLayer(foregroundElementList[i]->GetHitBox(), Vector2(0, 0), foregroundElementPresenceList[i]);
+        }
+
+        for (unsigned int i = 0; i < crowdList.size(); i++)
+        {
+            pNavigationGrid->AddLayer(crowdList[i]->GetHitBox(), Vector2(0, 0));
+        }
+
+        navigationGridByCharacterIdMap[pCharacter->GetId()] = pNavigationGrid;
     }
 
-    Vector2 topRightNeighbor(position.GetX() + tileSize, position.GetY() - tileSize);
+    return navigationGridByCharacterIdMap[pCharacter->GetId()];
+}
+
+void Location::BuildCollisionBroadphase()
+{
+    delete pCollisionBroadphase;
+    pCollisionBroadphase = new CollisionBroadphase(GetBounds());
+
+    int entryCount = GetCollisionBroadphaseEntryCount();
 
-    if (IsPointInTileAtPoint(goal, topRightNeighbor, tileSize))
+    for (int i = 0; i < entryCount; i++)
     {
-        topRightNeighbor = goal;
+        pCollisionBroadphase->AddEntry(GetCollisionBroadphaseEntryBounds(i));
     }
+}
 
-    if (!TestCollisionWithLocationElements(pCharacter, topRightNeighbor))
+void Location::UpdateCollisionBroadphase()
+{
+    if (pCollisionBroadphase == NULL)
     {
-        neighborNodes.push_back(topRightNeighbor);
+        return;
     }
 
-    Vector2 leftNeighbor(position.GetX() - tileSize, position.GetY());
-
-    if (IsPointInTileAtPoint(goal, leftNeighbor, tileSize))
+    // Only the characters move around, and they come first.
+    for (unsigned int i = 0; i <= characterList.size(); i++)
     {
-        topNeighbor = goal;
+        pCollisionBroadphase->UpdateEntry(i, GetCollisionBroadphaseEntryBounds(i));
     }
+}
 
-    if (!TestCollisionWithLocationElements(pCharacter, leftNeighbor))
+void Location::GetFirstFrameSpriteIds(vector<string> *pSpriteIdList)
+{
+    pSpriteIdList->push_back(GetBackgroundSpriteId());
+
+    if (pPlayerCharacter != NULL)
     {
-        neighborNodes.push_back(leftNeighbor);
+        pSpriteIdList->push_back(pPlayerCharacter->GetStandingSpriteId());
     }
 
-    Vector2 rightNeighbor(position.GetX() + tileSize, position.GetY());
-
-    if (IsPointInTileAtPoint(goal, rightNeighbor, tileSize))
+    if (pPartnerCharacter != NULL)
     {
-        rightNeighbor = goal;
+        pSpriteIdList->push_back(pPartnerCharacter->GetStandingSpriteId());
     }
 
-    if (!TestCollisionWithLocationElements(pCharacter, rightNeighbor))
+    for (unsigned int i = 0; i < characterList.size(); i++)
     {
-        neighborNodes.push_back(rightNeighbor);
+        pSpriteIdList->push_back(characterList[i]->GetStandingSpriteId());
     }
+}
 
-    Vector2 bottomLeftNeighbor(position.GetX() - tileSize, position.GetY() + tileSize);
+void Location::UpdateNeighboringLocationPrefetch(int delta)
+{
+    msUntilNeighboringLocationPrefetchUpdate -= delta;
 
-    if (IsPointInTileAtPoint(goal, bottomLeftNeighbor, tileSize))
+    if (msUntilNeighboringLocationPrefetchUpdate > 0 || pPlayerCharacter == NULL)
     {
-        bottomLeftNeighbor = goal;
+        return;
     }
 
-    if (!TestCollisionWithLocationElements(pCharacter, bottomLeftNeighbor))
+    msUntilNeighboringLocationPrefetchUpdate = NeighboringLocationPrefetchIntervalMs;
+
+    Vector2 playerPosition = pPlayerCharacter->GetMidPoint();
+    vector<pair<double, string> > distanceAndLocationIdList;
+
+    for (unsigned int i = 0; i < transitionList.size(); i++)
     {
-        neighborNodes.push_back(bottomLeftNeighbor);
+        Transition *pTransition = transitionList[i];
+
+        // There's no sense prefetching a location that the player can't get to yet.
+        if (pTransition->GetHitBox() == NULL || (pTransition->GetCondition() != NULL && !pTransition->GetCondition()->IsTrue()))
+        {
+            continue;
+        }
+
+        RectangleWH bounds = pTransition->GetHitBox()->GetCollisionBoundingBox(Vector2(0, 0));
+        double distanceX = max(0.0, max(bounds.GetX() - playerPosition.GetX(), playerPosition.GetX() - (bounds.GetX() + bounds.GetWidth())));
+        double distanceY = max(0.0, max(bounds.GetY() - playerPosition.GetY(), playerPosition.GetY() - (bounds.GetY() + bounds.GetHeight())));
+
+        distanceAndLocationIdList.push_back(pair<double, string>(distanceX * distanceX + distanceY * distanceY, pTransition->targetLocationId));
     }
 
-    Vector2 bottomNeighbor(position.GetX(), position.GetY() + tileSize);
+    sort(distanceAndLocationIdList.begin(), distanceAndLocationIdList.end());
+
+    // A location can be reachable through more than one transition, in which case the nearest one decides its place.
+    vector<string> locationIdList;
 
-    if (IsPointInTileAtPoint(goal, bottomNeighbor, tileSize))
+    for (unsigned int i = 0; i < distanceAndLocationIdList.size(); i++)
     {
-        bottomNeighbor = goal;
+        string locationId = distanceAndLocationIdList[i].second;
+
+        if (locationId != GetId() && find(locationIdList.begin(), locationIdList.end(), locationId) == locationIdList.end())
+        {
+            locationIdList.push_back(locationId);
+        }
     }
 
-    if (!TestCollisionWithLocationElements(pCharacter, bottomNeighbor))
+    Case::GetInstance()->PrefetchLocations(locationIdList);
+}
+
+int Location::GetCollisionBroadphaseEntryCount()
+{
+    return 1 + characterList.size() + foregroundElementList.size() + crowdList.size();
+}
+
+RectangleWH Location::GetCollisionBroadphaseEntryBounds(int entryIndex)
+{
+    HitBox *pHitBox = NULL;
+    Vector2 offset(0, 0);
+    double margin = CollisionBroadphaseMargin;
+    int characterCount = characterList.size();
+    int foregroundElementCount = foregroundElementList.size();
+
+    if (entryIndex <= characterCount)
     {
-        neighborNodes.push_back(bottomNeighbor);
-    }
+        FieldCharacter *pCharacter = entryIndex == 0 ? pPlayerCharacter : characterList[entryIndex - 1];
 
-    Vector2 bottomRightNeighbor(position.GetX() + tileSize, position.GetY() + tileSize);
+        if (pCharacter != NULL)
+        {
+            pHitBox = pCharacter->GetHitBox();
+            offset = pCharacter->GetPosition();
+        }
 
-    if (IsPointInTileAtPoint(goal, bottomRightNeighbor, tileSize))
+        // Characters keep moving after we last updated their entries,
+        // so we'll give them some extra room to account for that.
+        margin = CollisionBroadphaseCharacterMargin;
+    }
+    else if (entryIndex <= characterCount + foregroundElementCount)
     {
-        bottomRightNeighbor = goal;
+        pHitBox = foregroundElementList[entryIndex - characterCount - 1]->GetHitBox();
+    }
+    else
+    {
+        pHitBox = crowdList[entryIndex - characterCount - foregroundElementCount - 1]->GetHitBox();
     }
 
-    if (!TestCollisionWithLocationElements(pCharacter, bottomRightNeighbor))
+    if (pHitBox == NULL)
     {
-        neighborNodes.push_back(bottomRightNeighbor);
+        return RectangleWH(0, 0, 0, 0);
     }
 
-    return neighborNodes;
+    RectangleWH bounds = pHitBox->GetCollisionBoundingBox(offset);
+
+    return RectangleWH(
+        bounds.GetX() - margin,
+        bounds.GetY() - margin,
+        bounds.GetWidth() + margin * 2,
+        bounds.GetHeight() + margin * 2);
 }
 
-bool Location::TestCollisionWithLocationElements(FieldCharacter *pCharacter, Vector2 position)
+bool Location::GetCollisionBroadphaseEntryHitBox(FieldCharacter *pCharacter, int entryIndex, bool includeStaticElements, HitBox **ppHitBox, Vector2 *pHitBoxOffset)
 {
-    CollisionParameter param;
-    position -= pCharacter->GetVectorAnchorPosition() - pCharacter->GetPosition();
+    int characterCount = characterList.size();
+    int foregroundElementCount = foregroundElementList.size();
 
-    if (pCharacter->TestCollisionAtPosition(position, GetAreaHitBox(), &param))
-    {
-        return true;
-    }
+    *ppHitBox = NULL;
+    *pHitBoxOffset = Vector2(0, 0);
 
-    if (pCharacter != pPlayerCharacter &&
-        pCharacter != pPartnerCharacter &&
-        pCharacter->IsVisible() &&
-        pCharacter->TestCollisionAtPosition(position, pPlayerCharacter, &param))
+    if (entryIndex == 0)
     {
-        return true;
+        if (pCharacter != pPlayerCharacter &&
+            pCharacter != pPartnerCharacter &&
+            pCharacter->IsVisible())
+        {
+            *ppHitBox = pPlayerCharacter->GetHitBox();
+            *pHitBoxOffset = pPlayerCharacter->GetPosition();
+            return true;
+        }
     }
-
-    for (unsigned int i = 0; i < characterList.size(); i++)
+    else if (entryIndex <= characterCount)
     {
-        FieldCharacter *pCharacterToTest = characterList[i];
+        FieldCharacter *pCharacterToTest = characterList[entryIndex - 1];
 
         if (pCharacterToTest->IsVisible() &&
             pCharacter != pCharacterToTest &&
@@ -3665,147 +3940,128 @@ bool Location::TestCollisionWithLocationElements(FieldCharacter *pCharacter, Vec
             pCharacterToTest != pTargetInteractiveElement &&
             (pPartnerCharacter == NULL || pCharacterToTest->GetId() != pPartnerCharacter->GetId()))
         {
-            if (pCharacter->TestCollisionAtPosition(position, pCharacterToTest, &param))
-            {
-                return true;
-            }
+            *ppHitBox = pCharacterToTest->GetHitBox();
+            *pHitBoxOffset = pCharacterToTest->GetPosition();
+            return true;
         }
     }
-
-    for (unsigned int i = 0; i < foregroundElementList.size(); i++)
+    else if (!includeStaticElements)
     {
-        ForegroundElement *pElement = foregroundElementList[i];
+        return false;
+    }
+    else if (entryIndex <= characterCount + foregroundElementCount)
+    {
+        ForegroundElement *pElement = foregroundElementList[entryIndex - characterCount - 1];
 
         if (pElement->IsPresent() &&
             pCharacter != pTargetInteractiveElement &&
             pElement != pTargetInteractiveElement)
         {
-            if (pCharacter->TestCollisionAtPosition(position, pElement, &param))
-            {
-                return true;
-            }
+            *ppHitBox = pElement->GetHitBox();
+            return true;
         }
     }
-
-    for (unsigned int i = 0; i < crowdList.size(); i++)
+    else
     {
-        Crowd *pCrowd = crowdList[i];
+        Crowd *pCrowd = crowdList[entryIndex - characterCount - foregroundElementCount - 1];
 
         if (pCharacter != pTargetInteractiveElement &&
             pCrowd != pTargetInteractiveElement)
         {
-            if (pCharacter->TestCollisionAtPosition(position, pCrowd, &param))
-            {
-                return true;
-            }
+            *ppHitBox = pCrowd->GetHitBox();
+            return true;
         }
     }
 
     return false;
 }
 
-bool Location::TestCollisionWithLocationElements(FieldCharacter *pCharacter, Vector2 position, CollisionParameter *pParam)
+bool Location::TestCollisionWithCollisionBroadphaseEntry(FieldCharacter *pCharacter, Vector2 position, int entryIndex, bool includeStaticElements, CollisionParameter *pParam, int *pNarrowphaseTestCount)
 {
-    position -= pCharacter->GetVectorAnchorPosition() - pCharacter->GetPosition();
+    HitBox *pHitBox = NULL;
+    Vector2 hitBoxOffset;
 
-    if (pCharacter->TestCollisionAtPosition(position, GetAreaHitBox(), pParam))
+    if (!GetCollisionBroadphaseEntryHitBox(pCharacter, entryIndex, includeStaticElements, &pHitBox, &hitBoxOffset))
     {
-        return true;
+        return false;
     }
 
-    if (pCharacter != pPlayerCharacter &&
-        pCharacter != pPartnerCharacter &&
-        pCharacter->IsVisible() &&
-        pCharacter->TestCollisionAtPosition(position, pPlayerCharacter, pParam))
-    {
-        return true;
-    }
+    (*pNarrowphaseTestCount)++;
+    return pCharacter->GetHitBox()->IsCollision(position, pHitBox, hitBoxOffset, pParam);
+}
 
-    for (unsigned int i = 0; i < characterList.size(); i++)
+int Location::GetNavigationGridLayerIndex(InteractiveElement *pElement)
+{
+    if (pElement == NULL)
     {
-        FieldCharacter *pCharacterToTest = characterList[i];
-
-        if (pCharacterToTest->IsVisible() &&
-            pCharacter != pCharacterToTest &&
-            pCharacter != pTargetInteractiveElement &&
-            pCharacterToTest != pTargetInteractiveElement &&
-            (pPartnerCharacter == NULL || pCharacterToTest->GetId() != pPartnerCharacter->GetId()))
-        {
-            if (pCharacter->TestCollisionAtPosition(position, pCharacterToTest, pParam))
-            {
-                return true;
-            }
-        }
+        return -1;
     }
 
+    // Layer 0 is the area hitbox, followed by each foreground element and then each crowd.
     for (unsigned int i = 0; i < foregroundElementList.size(); i++)
     {
-        ForegroundElement *pElement = foregroundElementList[i];
-
-        if (pElement->IsPresent() &&
-            pCharacter != pTargetInteractiveElement &&
-            pElement != pTargetInteractiveElement)
+        if (foregroundElementList[i] == pElement)
         {
-            if (pCharacter->TestCollisionAtPosition(position, pElement, pParam))
-            {
-                return true;
-            }
+            return 1 + i;
         }
     }
 
     for (unsigned int i = 0; i < crowdList.size(); i++)
     {
-        Crowd *pCrowd = crowdList[i];
-
-        if (pCharacter != pTargetInteractiveElement &&
-            pCrowd != pTargetInteractiveElement)
+        if (crowdList[i] == pElement)
         {
-            if (pCharacter->TestCollisionAtPosition(position, pCrowd, pParam))
-            {
-                return true;
-            }
+            return 1 + foregroundElementList.size() + i;
         }
     }
 
-    return false;
+    return -1;
 }
 
-queue<Vector2> * Location::ReconstructPath(map<Vector2, Vector2> *pCameFrom, Vector2 currentNode, Vector2 goalNode)
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_PATHFINDING_BENCHMARK
+void Location::BenchmarkPathfinding()
 {
-    queue<Vector2> *pCurrentQueue = NULL;
+    // Replays every click target the player has pathed to in this location
+    // against the location's current hitboxes, reusing a single pathfinder
+    // so that the allocation counts reflect the steady state.
+    Pathfinder pathfinder;
+    Pathfinder::Statistics totalStatistics;
 
-    if (pCameFrom->count(currentNode) > 0)
-    {
-        pCurrentQueue = ReconstructPath(pCameFrom, (*pCameFrom)[currentNode]);
-        pCurrentQueue->push(goalNode);
-    }
-    else
-    {
-        pCurrentQueue = new queue<Vector2>();
+    SDL_SemWait(pNavigationGridSemaphore);
 
-        // Don't add the current node here - there's no reason to
-        // add the start node to the queue, as we're already there.
-    }
+    cout << "Pathfinding benchmark for location \"" << GetId() << "\" (" << recordedPathfindingQueries.size() << " queries):" << endl;
 
-    return pCurrentQueue;
-}
+    for (unsigned int i = 0; i < recordedPathfindingQueries.size(); i++)
+    {
+        Vector2 startPosition = recordedPathfindingQueries[i].first;
+        Vector2 endPosition = FindClosestPassablePositionForCharacter(pPlayerCharacter, recordedPathfindingQueries[i].second);
 
-queue<Vector2> * Location::ReconstructPath(map<Vector2, Vector2> *pCameFrom, Vector2 currentNode)
-{
-    queue<Vector2> *pCurrentQueue = NULL;
+        queue<Vector2> path = pathfinder.FindPath(this, pPlayerCharacter, GetBounds(), startPosition, endPosition, PathfindingTileSize);
+        const Pathfinder::Statistics &statistics = pathfinder.GetLastStatistics();
 
-    if (pCameFrom->count(currentNode) > 0)
-    {
-        pCurrentQueue = ReconstructPath(pCameFrom, (*pCameFrom)[currentNode]);
-        pCurrentQueue->push(currentNode);
+        cout << "    (" << startPosition.GetX() << ", " << startPosition.GetY() << ") -> (" << endPosition.GetX() << ", " << endPosition.GetY() << "): "
+             << statistics.NodesExpanded << " nodes expanded, "
+             << statistics.CollisionTests << " collision tests, "
+             << statistics.Allocations << " allocations, "
+             << statistics.ElapsedMilliseconds << " ms, "
+             << path.size() << " steps" << endl;
+
+        totalStatistics.NodesExpanded += statistics.NodesExpanded;
+        totalStatistics.CollisionTests += statistics.CollisionTests;
+        totalStatistics.Allocations += statistics.Allocations;
+        totalStatistics.ElapsedMilliseconds += statistics.ElapsedMilliseconds;
     }
-    else
-    {
-        pCurrentQueue = new queue<Vector2>();
 
-        // Don't add the current node here - there's no reason to
-        // add the start node to the queue, as we're already there.
+    if (!recordedPathfindingQueries.empty())
+    {
+        cout << "    Average: "
+             << (double)totalStatistics.NodesExpanded / recordedPathfindingQueries.size() << " nodes expanded, "
+             << (double)totalStatistics.CollisionTests / recordedPathfindingQueries.size() << " collision tests, "
+             << (double)totalStatistics.Allocations / recordedPathfindingQueries.size() << " allocations, "
+             << totalStatistics.ElapsedMilliseconds / recordedPathfindingQueries.size() << " ms" << endl;
     }
 
-    return pCurrentQueue;
+    SDL_SemPost(pNavigationGridSemaphore);
 }
+    #endif
+#endif
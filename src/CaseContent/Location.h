@@ -36,6 +36,10 @@
 #include "ForegroundElement.h"
 #include "ZoomedView.h"
 #include "../enums.h"
+#include "../CollisionBroadphase.h"
+#include "../NavigationGrid.h"
+#include "../Pathfinder.h"
+#include "../PathfindingService.h"
 #include "../Vector2.h"
 #include "../Events/PromptOverlayEventProvider.h"
 #include "../UserInterface/PromptOverlay.h"
@@ -49,22 +53,9 @@
 class FieldCharacter;
 class HeightMap;
 
-class Location : public PromptOverlayEventListener
+class Location : public PromptOverlayEventListener, public PathfindingCollisionTester, public PathfindingRequestHandler
 {
 public:
-    class PathfindingThreadParameters
-    {
-    public:
-        PathfindingThreadParameters(Location *pLocation, FieldCharacter *pCharacter, Vector2 startPosition, Vector2 endPosition, FieldCharacterState characterStateIfMoving, int threadId);
-
-        Location *pLocation;
-        FieldCharacter *pCharacter;
-        Vector2 startPosition;
-        Vector2 endPosition;
-        FieldCharacterState characterStateIfMoving;
-        int threadId;
-    };
-
     class Transition : public InteractiveElement, public ZOrderableObject
     {
         friend class Location;
@@ -235,6 +226,16 @@ public:
 
     void OnPromptOverlayValueReturned(PromptOverlay *pSender, string value);
 
+    bool TestCollisionForPathfinding(FieldCharacter *pCharacter, Vector2 position);
+    void TestCollisionBatchForPathfinding(FieldCharacter *pCharacter, const Vector2 *pPositions, int positionCount, unsigned int *pCollisionMask);
+    queue<Vector2> FindPathForRequest(FieldCharacter *pCharacter, Vector2 startPosition, Vector2 endPosition, Pathfinder *pPathfinder, SDL_atomic_t *pCancellationFlag);
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_PATHFINDING_BENCHMARK
+    void BenchmarkPathfinding();
+    #endif
+#endif
+
 private:
     void SetLoopingSoundLevels();
     Sprite * GetBackgroundSprite();
@@ -243,10 +244,10 @@ private:
     StartPosition * GetPartnerStartPositionFromTransitionId(string transitionId);
     void SetTargetInteractiveElement(InteractiveElement *pInteractiveElement, FieldCharacterState characterStateIfMoving);
     bool GetIsPlayerCharacterCloseToInteractiveElement();
-    void StartCharacterOnPath(FieldCharacter *pCharacter, Vector2 endPosition, FieldCharacterState characterStateIfMoving, bool doAsync = true);
+    void StartCharacterOnPath(FieldCharacter *pCharacter, Vector2 endPosition, FieldCharacterState characterStateIfMoving);
     void OnExited(Location *pLocation, string transitionId);
-    static int PerformPathfindingStatic(void *pData);
-    void PerformPathfinding(FieldCharacter *pCharacter, Vector2 startPosition, Vector2 endPosition, FieldCharacterState characterStateIfMoving, int threadId);
+    void ApplyPathfindingResults();
+    void ApplyPathfindingResult(FieldCharacter *pCharacter, Vector2 startPosition, FieldCharacterState characterStateIfMoving, queue<Vector2> targetPositionQueue);
 
     static bool CompareByZOrder(ZOrderableObject *pObject1, ZOrderableObject *pObject2)
     {
@@ -263,16 +264,35 @@ private:
     Vector2 FindClosestPassablePositionForCharacter(FieldCharacter *pCharacter, Vector2 position);
     void FindClosestPassablePositionForCharacter(FieldCharacter *pCharacter, Vector2 position, deque<OverlapEntry> *pOverlapEntriesThusFar, stack<Vector2> *pPositionsThusFar, list<Vector2> *pPossiblePositions);
 
-    // Implements the A* search algorithm.
-    queue<Vector2> GetPathForCharacterBetweenPoints(FieldCharacter *pCharacter, Vector2 start, Vector2 goal);
-    double HeuristicCostEstimate(Vector2 start, Vector2 end);
-    bool IsPointInTileAtPoint(Vector2 point, Vector2 tilePoint, double tileSize);
-    Vector2 GetVectorWithLowestFScore(list<Vector2> openSet, map<Vector2, double> fScore);
-    list<Vector2> GetNeighbors(FieldCharacter *pCharacter, Vector2 position, Vector2 goal, double tileSize);
+    queue<Vector2> GetPathForCharacterBetweenPoints(FieldCharacter *pCharacter, Vector2 start, Vector2 goal, Pathfinder *pPathfinder, SDL_atomic_t *pCancellationFlag);
     bool TestCollisionWithLocationElements(FieldCharacter *pCharacter, Vector2 position);
     bool TestCollisionWithLocationElements(FieldCharacter *pCharacter, Vector2 position, CollisionParameter *pParam);
-    queue<Vector2> * ReconstructPath(map<Vector2, Vector2> *pCameFrom, Vector2 currentNode, Vector2 goalNode);
-    queue<Vector2> * ReconstructPath(map<Vector2, Vector2> *pCameFrom, Vector2 currentNode);
+    bool TestCollisionWithLocationObjects(FieldCharacter *pCharacter, Vector2 position, bool includeStaticElements, CollisionParameter *pParam);
+    void TestCollisionBatch(FieldCharacter *pCharacter, const Vector2 *pPositions, int positionCount, unsigned int *pCollisionMask);
+
+    // The navigation grids cache collisions with the area hitbox, foreground elements and crowds,
+    // none of which move, so pathfinding only needs to test characters directly.
+    void BuildNavigationGrids();
+    void UpdateNavigationGridPresence();
+    NavigationGrid * GetNavigationGridForCharacter(FieldCharacter *pCharacter);
+    int GetNavigationGridLayerIndex(InteractiveElement *pElement);
+
+    // The collision broadphase holds the bounding boxes of the player, the other characters,
+    // the foreground elements and the crowds, in that order, so that collision tests
+    // only run the narrowphase against objects that are actually nearby.
+    void BuildCollisionBroadphase();
+    void UpdateCollisionBroadphase();
+    int GetCollisionBroadphaseEntryCount();
+    RectangleWH GetCollisionBroadphaseEntryBounds(int entryIndex);
+    bool GetCollisionBroadphaseEntryHitBox(FieldCharacter *pCharacter, int entryIndex, bool includeStaticElements, HitBox **ppHitBox, Vector2 *pHitBoxOffset);
+    bool TestCollisionWithCollisionBroadphaseEntry(FieldCharacter *pCharacter, Vector2 position, int entryIndex, bool includeStaticElements, CollisionParameter *pParam, int *pNarrowphaseTestCount);
+
+    // The sprites that will be on screen as soon as we've finished loading, which we want loaded before anything else.
+    void GetFirstFrameSpriteIds(vector<string> *pSpriteIdList);
+
+    // While the player is free to walk around, we prefetch the locations that are one transition away,
+    // starting with the one whose transition is closest to the player.
+    void UpdateNeighboringLocationPrefetch(int delta);
 
     static Image *pFadeSprite;
     static FieldCharacter *pCurrentPlayerCharacter;
@@ -347,9 +367,19 @@ private:
 
     bool movingDirectly;
 
-    SDL_Thread *pPathfindingThread;
-    SDL_sem *pPathfindingValuesSemaphore;
-    int lastPathfindingThreadId;
+    PathfindingService *pPathfindingService;
+
+    map<string, NavigationGrid *> navigationGridByCharacterIdMap;
+    vector<bool> foregroundElementPresenceList;
+    SDL_sem *pNavigationGridSemaphore;
+
+    CollisionBroadphase *pCollisionBroadphase;
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_PATHFINDING_BENCHMARK
+    vector<pair<Vector2, Vector2> > recordedPathfindingQueries;
+    #endif
+#endif
 
     Vector2 drawingOffsetVector;
 
@@ -364,6 +394,7 @@ private:
     vector<string> cutsceneIdList;
 
     bool shouldAutosave;
+    int msUntilNeighboringLocationPrefetchUpdate;
 };
 
 #endif
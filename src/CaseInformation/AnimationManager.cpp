@@ -139,6 +139,30 @@ void AnimationManager::FinishUpdateLoadedTextures(string newLocationId)
     }
 }
 
+void AnimationManager::PrefetchVideosForLocation(string locationId)
+{
+    // Videos that we prefetch but don't end up needing will be unloaded
+    // the next time we update which textures are loaded.
+    for (map<string, Video *>::iterator iter = videoByIdMap.begin(); iter != videoByIdMap.end(); ++iter)
+    {
+        bool loadVideo = false;
+        bool deleteVideo = false;
+        Video *pVideo = iter->second;
+
+        if (pVideo == NULL)
+        {
+            continue;
+        }
+
+        pVideo->UpdateReadiness(locationId, &loadVideo, &deleteVideo);
+
+        if (loadVideo)
+        {
+            ResourceLoader::GetInstance()->AddVideoToBackgroundLoadList(pVideo);
+        }
+    }
+}
+
 void AnimationManager::UnloadResources()
 {
     for (map<string, Video *>::iterator iter = videoByIdMap.begin(); iter != videoByIdMap.end(); ++iter)
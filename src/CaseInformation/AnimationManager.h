@@ -56,6 +56,7 @@ public:
     Video * GetVideoFromId(string videoId);
     void LoadFromXml(XmlReader *pReader);
     void FinishUpdateLoadedTextures(string newLocationId);
+    void PrefetchVideosForLocation(string locationId);
     void UnloadResources();
 
 private:
@@ -39,12 +39,34 @@
 
 #include <ctime>
 
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_CASE_LOAD_BENCHMARK
+    #include <iostream>
+    #endif
+#endif
+
+// What we show on the loading screen while each load task is running.
+const char *CaseLoadTaskStages[CaseLoadTaskCount] =
+{
+    "animations",
+    "audio",
+    "case information",
+    "dialog resources",
+    "evidence",
+    "field resources",
+    "flags",
+    "partner information",
+    "sprite sheets",
+    "locations",
+};
+
 Case *Case::pInstance = NULL;
 SDL_sem *Case::pInstanceSemaphore = SDL_CreateSemaphore(1);
 
 Case::Case()
     : playerCharacterId("")
-    , loadStage("")
+    , loadTask(CaseLoadTaskAnimations)
+    , hasStartedLoading(false)
 {
     pAnimationManager = new AnimationManager(ManagerSourceCaseFile);
     pAudioManager = new AudioManager();
@@ -71,7 +93,8 @@ Case::Case()
 
 Case::Case(const Case &other)
     : playerCharacterId("")
-    , loadStage("")
+    , loadTask(CaseLoadTaskAnimations)
+    , hasStartedLoading(false)
 {
     pAnimationManager = new AnimationManager(ManagerSourceCaseFile);
     pAudioManager = new AudioManager();
@@ -138,80 +161,42 @@ void Case::LoadFromXml(string caseFilePath)
         XmlReader reader("case.xml");
         reader.StartElement("Case");
 
-        pInstance->SetLoadStage("animations");
-        pInstance->pAnimationManager->LoadFromXml(&reader);
-
-        pInstance->SetLoadStage("audio");
-        pInstance->pAudioManager->LoadFromXml(&reader);
-
-        pInstance->SetLoadStage("case information");
-        pInstance->pContentManager->LoadFromXml(&reader);
-
-        pInstance->SetLoadStage("dialog resources");
-        pInstance->pDialogCharacterManager->LoadFromXml(&reader);
-        pInstance->pDialogCutsceneManager->LoadFromXml(&reader);
-
-        pInstance->SetLoadStage("evidence");
-        pInstance->pEvidenceManager->LoadFromXml(&reader);
-
-        pInstance->SetLoadStage("field resources");
-        pInstance->pFieldCharacterManager->LoadFromXml(&reader);
-        pInstance->pFieldCutsceneManager->LoadFromXml(&reader);
-
-        pInstance->SetLoadStage("flags");
-        pInstance->pFlagManager->LoadFromXml(&reader);
-
-        pInstance->SetLoadStage("partner information");
-        pInstance->pPartnerManager->LoadFromXml(&reader);
-
-        pInstance->SetLoadStage("sprite sheets");
-        pInstance->pSpriteManager->LoadFromXml(&reader);
-
-        reader.StartElement("ParentLocationListsBySpriteSheetId");
-        reader.StartList("Entry");
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_CASE_LOAD_BENCHMARK
+        Uint64 loadTaskStartTime = SDL_GetPerformanceCounter();
+        Uint64 loadTaskTimes[CaseLoadTaskCount];
+    #endif
+#endif
 
-        while (reader.MoveToNextListItem())
+        for (int i = 0; i < CaseLoadTaskCount; i++)
         {
-            string spriteSheetId = reader.ReadTextElement("SpriteSheetId");
-
-            reader.StartElement("LocationList");
-            reader.StartList("Entry");
-
-            while (reader.MoveToNextListItem())
-            {
-                string locationId = reader.ReadTextElement("LocationId");
-
-                pInstance->parentLocationListsBySpriteSheetId[spriteSheetId].push_back(locationId);
-            }
-
-            reader.EndElement();
+            CaseLoadTask loadTask = (CaseLoadTask)i;
+            pInstance->SetLoadStage(loadTask);
+            pInstance->RunLoadTask(loadTask, &reader);
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_CASE_LOAD_BENCHMARK
+            Uint64 loadTaskEndTime = SDL_GetPerformanceCounter();
+            loadTaskTimes[i] = loadTaskEndTime - loadTaskStartTime;
+            loadTaskStartTime = loadTaskEndTime;
+    #endif
+#endif
         }
 
         reader.EndElement();
 
-        reader.StartElement("ParentLocationListsByVideoId");
-        reader.StartList("Entry");
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_CASE_LOAD_BENCHMARK
+        cout << "Case load tasks:";
 
-        while (reader.MoveToNextListItem())
+        for (int i = 0; i < CaseLoadTaskCount; i++)
         {
-            string videoId = reader.ReadTextElement("VideoId");
-
-            reader.StartElement("LocationList");
-            reader.StartList("Entry");
-
-            while (reader.MoveToNextListItem())
-            {
-                string locationId = reader.ReadTextElement("LocationId");
-
-                pInstance->parentLocationListsByVideoId[videoId].push_back(locationId);
-            }
-
-            reader.EndElement();
+            cout << (i > 0 ? "," : "") << " " << CaseLoadTaskStages[i] << " in " << (double)loadTaskTimes[i] * 1000.0 / SDL_GetPerformanceFrequency() << " ms";
         }
 
-        reader.EndElement();
-
-        reader.EndElement();
+        cout << endl;
+    #endif
+#endif
     }
 
     pInstance->playerCharacterId = pInstance->pFieldCharacterManager->playerCharacterId;
@@ -351,7 +336,7 @@ void Case::Reset()
     pFlagManager->Reset();
 
     SetIsFinished(false);
-    SetLoadStage("");
+    ClearLoadStage();
 
     pCurrentArea = Case::GetInstance()->GetContentManager()->GetAreaFromId(Case::GetInstance()->GetContentManager()->GetInitialAreaId());
 }
@@ -440,7 +425,7 @@ void Case::LoadFromSaveFile(string filePath)
     reader.EndElement();
 
     SetIsFinished(false);
-    SetLoadStage("");
+    ClearLoadStage();
 }
 
 void Case::CacheState()
@@ -457,21 +442,135 @@ void Case::LoadCachedState()
     pPartnerManager->LoadCachedState();
 }
 
+void Case::RunLoadTask(CaseLoadTask loadTask, XmlReader *pReader)
+{
+    switch (loadTask)
+    {
+    case CaseLoadTaskAnimations:
+        pAnimationManager->LoadFromXml(pReader);
+        break;
+
+    case CaseLoadTaskAudio:
+        // This only queues up the audio to be loaded - the audio preload threads do the rest.
+        pAudioManager->LoadFromXml(pReader);
+        break;
+
+    case CaseLoadTaskCaseInformation:
+        pContentManager->LoadFromXml(pReader);
+        break;
+
+    case CaseLoadTaskDialogResources:
+        pDialogCharacterManager->LoadFromXml(pReader);
+        pDialogCutsceneManager->LoadFromXml(pReader);
+        break;
+
+    case CaseLoadTaskEvidence:
+        pEvidenceManager->LoadFromXml(pReader);
+        break;
+
+    case CaseLoadTaskFieldResources:
+        pFieldCharacterManager->LoadFromXml(pReader);
+        pFieldCutsceneManager->LoadFromXml(pReader);
+        break;
+
+    case CaseLoadTaskFlags:
+        pFlagManager->LoadFromXml(pReader);
+        break;
+
+    case CaseLoadTaskPartnerInformation:
+        pPartnerManager->LoadFromXml(pReader);
+        break;
+
+    case CaseLoadTaskSpriteSheets:
+        pSpriteManager->LoadFromXml(pReader);
+        break;
+
+    case CaseLoadTaskParentLocationLists:
+        pReader->StartElement("ParentLocationListsBySpriteSheetId");
+        pReader->StartList("Entry");
+
+        while (pReader->MoveToNextListItem())
+        {
+            string spriteSheetId = pReader->ReadTextElement("SpriteSheetId");
+
+            pReader->StartElement("LocationList");
+            pReader->StartList("Entry");
+
+            while (pReader->MoveToNextListItem())
+            {
+                string locationId = pReader->ReadTextElement("LocationId");
+
+                parentLocationListsBySpriteSheetId[spriteSheetId].push_back(locationId);
+            }
+
+            pReader->EndElement();
+        }
+
+        pReader->EndElement();
+
+        pReader->StartElement("ParentLocationListsByVideoId");
+        pReader->StartList("Entry");
+
+        while (pReader->MoveToNextListItem())
+        {
+            string videoId = pReader->ReadTextElement("VideoId");
+
+            pReader->StartElement("LocationList");
+            pReader->StartList("Entry");
+
+            while (pReader->MoveToNextListItem())
+            {
+                string locationId = pReader->ReadTextElement("LocationId");
+
+                parentLocationListsByVideoId[videoId].push_back(locationId);
+            }
+
+            pReader->EndElement();
+        }
+
+        pReader->EndElement();
+        break;
+
+    default:
+        break;
+    }
+}
+
 string Case::GetLoadStage()
 {
-    string loadStage;
+    CaseLoadTask loadTask = CaseLoadTaskAnimations;
+    bool hasStartedLoading = false;
 
     SDL_SemWait(pLoadStageSemaphore);
-    loadStage = this->loadStage;
+    loadTask = this->loadTask;
+    hasStartedLoading = this->hasStartedLoading;
     SDL_SemPost(pLoadStageSemaphore);
 
-    return loadStage;
+    if (!hasStartedLoading)
+    {
+        return "";
+    }
+
+    // Every task before the current one has been completed.
+    char percentageString[8];
+    sprintf(percentageString, "%d%%", (int)loadTask * 100 / CaseLoadTaskCount);
+
+    return string(CaseLoadTaskStages[loadTask]) + " (" + percentageString + ")";
 }
 
-void Case::SetLoadStage(string loadStage)
+void Case::SetLoadStage(CaseLoadTask loadTask)
 {
     SDL_SemWait(pLoadStageSemaphore);
-    this->loadStage = loadStage;
+    this->loadTask = loadTask;
+    this->hasStartedLoading = true;
+    SDL_SemPost(pLoadStageSemaphore);
+}
+
+void Case::ClearLoadStage()
+{
+    SDL_SemWait(pLoadStageSemaphore);
+    this->loadTask = CaseLoadTaskAnimations;
+    this->hasStartedLoading = false;
     SDL_SemPost(pLoadStageSemaphore);
 }
 
@@ -506,13 +605,19 @@ void Case::LoadResources()
     ResourceLoader::GetInstance()->SnapLoadStepQueue();
 }
 
-void Case::UpdateLoadedTextures(string newLocationId, bool waitUntilLoaded)
+void Case::UpdateLoadedTextures(string newLocationId, bool waitUntilLoaded, const vector<string> &firstFrameSpriteIdList)
 {
     SetWaitUntilLoaded(waitUntilLoaded);
     SetIsLoadingSprites(true);
     cout << "Loading sprites for location \"" << newLocationId << "\"." << endl;
-    pSpriteManager->FinishUpdateLoadedTextures(newLocationId);
+    pSpriteManager->FinishUpdateLoadedTextures(newLocationId, firstFrameSpriteIdList);
     pAnimationManager->FinishUpdateLoadedTextures(newLocationId);
+
+    // Whatever we were prefetching was for the location we were at before,
+    // so we'll keep only what the new location's load steps want.
+    ResourceLoader::GetInstance()->ClearBackgroundLoadSteps();
+    prefetchedLocationIdList.clear();
+
     SetWantsToLoadResources(true);
 }
 
@@ -537,8 +642,29 @@ void Case::FinishUpdateLoadedTextures(string newLocationId)
     SetWantsToLoadResources(true);
 }
 
+void Case::PrefetchLocations(const vector<string> &locationIdList)
+{
+    if (locationIdList == prefetchedLocationIdList)
+    {
+        return;
+    }
+
+    prefetchedLocationIdList = locationIdList;
+    ResourceLoader::GetInstance()->ClearBackgroundLoadSteps();
+
+    for (unsigned int i = 0; i < locationIdList.size(); i++)
+    {
+        pSpriteManager->PrefetchTexturesForLocation(locationIdList[i]);
+        pAnimationManager->PrefetchVideosForLocation(locationIdList[i]);
+    }
+}
+
 void Case::UnloadResources()
 {
+    // Any images the background load steps were decoding will be flushed when the case is unloaded,
+    // but we'll close any videos they opened now, while the videos are still around.
+    ResourceLoader::GetInstance()->ClearBackgroundLoadSteps();
+    prefetchedLocationIdList.clear();
     pAnimationManager->UnloadResources();
     pSpriteManager->UnloadResources();
     isUnloaded = true;
@@ -50,6 +50,24 @@
 
 using namespace std;
 
+// The tasks that Case::LoadFromXml() works through, in order.  They all read from the same
+// case.xml document, which ticpp only lets one thread walk at a time, so they run one after another;
+// the audio they come across is loaded on worker threads, and needn't be done before the case begins.
+enum CaseLoadTask
+{
+    CaseLoadTaskAnimations,
+    CaseLoadTaskAudio,
+    CaseLoadTaskCaseInformation,
+    CaseLoadTaskDialogResources,
+    CaseLoadTaskEvidence,
+    CaseLoadTaskFieldResources,
+    CaseLoadTaskFlags,
+    CaseLoadTaskPartnerInformation,
+    CaseLoadTaskSpriteSheets,
+    CaseLoadTaskParentLocationLists,
+    CaseLoadTaskCount,
+};
+
 class Case
 {
 public:
@@ -140,15 +158,21 @@ public:
     bool GetIsUnloaded() const { return this->isUnloaded; }
 
     string GetLoadStage();
-    void SetLoadStage(string loadStage);
+    void SetLoadStage(CaseLoadTask loadTask);
+    void ClearLoadStage();
+    void RunLoadTask(CaseLoadTask loadTask, XmlReader *pReader);
     bool IsLoading();
     bool IsReady();
     void LoadResources();
 
-    void UpdateLoadedTextures(string newLocationId, bool waitUntilLoaded = true);
+    void UpdateLoadedTextures(string newLocationId, bool waitUntilLoaded = true, const vector<string> &firstFrameSpriteIdList = vector<string>());
     static int FinishUpdateLoadedTexturesStatic(void *pData);
     void FinishUpdateLoadedTextures(string newLocationId);
 
+    // Loads the textures and videos of the given locations in the background, in order,
+    // replacing whatever we were loading in the background before, unless it was for the same locations.
+    void PrefetchLocations(const vector<string> &locationIdList);
+
     void UnloadResources();
 
     vector<string> GetParentLocationListForSpriteSheetId(string id);
@@ -183,8 +207,10 @@ private:
     bool waitUntilLoaded;
     bool wantsToLoadResources;
     bool isUnloaded;
-    string loadStage;
+    CaseLoadTask loadTask;
+    bool hasStartedLoading;
     SDL_sem *pLoadStageSemaphore;
+    vector<string> prefetchedLocationIdList;
 
     Area *pCurrentArea;
 
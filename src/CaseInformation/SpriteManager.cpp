@@ -30,8 +30,20 @@
 #include "SpriteManager.h"
 #include "Case.h"
 #include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include "../globals.h"
 #include "../ResourceLoader.h"
 
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_RESOURCE_LOADER
+    #include <iostream>
+    #endif
+#endif
+
+vector<Image *> SpriteManager::retiredImageList;
+SDL_SpinLock SpriteManager::retiredImageListLock = 0;
+
 SpriteManager::SpriteManager(ManagerSource managerSource)
 {
     this->managerSource = managerSource;
@@ -45,6 +57,11 @@ SpriteManager::~SpriteManager()
     {
         delete iter->second;
     }
+
+    for (map<string, SpriteSheetImageSlot *>::iterator iter = imageSlotByIdMap.begin(); iter != imageSlotByIdMap.end(); ++iter)
+    {
+        delete iter->second;
+    }
     SDL_SemPost(pImageByIdSemaphore);
 
     SDL_DestroySemaphore(pImageByIdSemaphore);
@@ -63,13 +80,28 @@ Sprite * SpriteManager::GetSpriteFromId(string id)
 
 Image * SpriteManager::GetImageFromId(string id)
 {
-    Image *pSprite = NULL;
+    return GetImageSlotFromId(id)->GetImage();
+}
+
+SpriteSheetImageSlot * SpriteManager::GetImageSlotFromId(string id)
+{
+    SpriteSheetImageSlot *pSlot = NULL;
 
     SDL_SemWait(pImageByIdSemaphore);
-    pSprite = smartSpriteByIdMap[id];
+    map<string, SpriteSheetImageSlot *>::iterator iter = imageSlotByIdMap.find(id);
+
+    if (iter != imageSlotByIdMap.end())
+    {
+        pSlot = iter->second;
+    }
+    else
+    {
+        pSlot = new SpriteSheetImageSlot();
+        imageSlotByIdMap[id] = pSlot;
+    }
     SDL_SemPost(pImageByIdSemaphore);
 
-    return pSprite;
+    return pSlot;
 }
 
 void SpriteManager::AddSprite(string id, string spriteSheetId, RectangleWH spriteClipRect)
@@ -80,29 +112,75 @@ void SpriteManager::AddSprite(string id, string spriteSheetId, RectangleWH sprit
 
 void SpriteManager::AddImage(string id, Image *pSprite)
 {
-    SDL_SemWait(pImageByIdSemaphore);
-    if (smartSpriteByIdMap[id] != NULL)
+    Image *pOldSprite = GetImageSlotFromId(id)->SetImage(pSprite);
+
+    if (pOldSprite != NULL && pOldSprite != pSprite)
     {
-        delete smartSpriteByIdMap[id];
+        RetireImage(pOldSprite);
     }
-    smartSpriteByIdMap[id] = pSprite;
-    SDL_SemPost(pImageByIdSemaphore);
+}
+
+string SpriteManager::GetImageFilePathFromId(string id)
+{
+    map<string, string>::iterator iter = smartSpriteFilePathByIdMap.find(id);
+    return iter != smartSpriteFilePathByIdMap.end() ? iter->second : "";
 }
 
 void SpriteManager::LoadImageFromFilePath(string id)
 {
+    // There's no sense loading a sprite sheet again if it's already been loaded.
+    if (IsImageLoaded(id))
+    {
+        return;
+    }
+
     AddImage(id, ResourceLoader::GetInstance()->LoadImage(smartSpriteFilePathByIdMap[id]));
 }
 
+void SpriteManager::PrefetchImageFromFilePath(string id)
+{
+    string filePath = GetImageFilePathFromId(id);
+
+    // We only prefetch sprite sheets while we have room in our budget for them,
+    // since otherwise we'd only have to unload something else to make room for them.
+    if (IsImageLoaded(id) || GetLoadedImageBytes() >= (Uint64)gTextureMemoryBudgetMegabytes * 1024 * 1024)
+    {
+        ResourceLoader::GetInstance()->CancelPrefetchedImage(filePath);
+        return;
+    }
+
+    AddImage(id, ResourceLoader::GetInstance()->LoadImage(filePath, true /* loadImmediately */));
+}
+
 void SpriteManager::DeleteImage(string id)
 {
-    SDL_SemWait(pImageByIdSemaphore);
-    if (smartSpriteByIdMap[id] != NULL)
+    Image *pOldSprite = GetImageSlotFromId(id)->SetImage(NULL);
+
+    if (pOldSprite != NULL)
     {
-        delete smartSpriteByIdMap[id];
+        RetireImage(pOldSprite);
     }
-    smartSpriteByIdMap.erase(id);
-    SDL_SemPost(pImageByIdSemaphore);
+}
+
+void SpriteManager::ReclaimRetiredImages()
+{
+    vector<Image *> imagesToDeleteList;
+
+    SDL_AtomicLock(&retiredImageListLock);
+    imagesToDeleteList.swap(retiredImageList);
+    SDL_AtomicUnlock(&retiredImageListLock);
+
+    for (unsigned int i = 0; i < imagesToDeleteList.size(); i++)
+    {
+        delete imagesToDeleteList[i];
+    }
+}
+
+void SpriteManager::RetireImage(Image *pImage)
+{
+    SDL_AtomicLock(&retiredImageListLock);
+    retiredImageList.push_back(pImage);
+    SDL_AtomicUnlock(&retiredImageListLock);
 }
 
 void SpriteManager::LoadFromXml(XmlReader *pReader)
@@ -137,13 +215,61 @@ void SpriteManager::LoadFromXml(XmlReader *pReader)
     pReader->EndElement();
 }
 
-void SpriteManager::FinishUpdateLoadedTextures(string newLocationId)
+void SpriteManager::FinishUpdateLoadedTextures(string newLocationId, const vector<string> &firstFrameSpriteIdList)
 {
+    vector<string> spriteSheetIdsToLoad;
+    residencyManager.BeginUpdate();
+
+    set<string> firstFrameSpriteSheetIdSet;
+
+    for (unsigned int i = 0; i < firstFrameSpriteIdList.size(); i++)
+    {
+        map<string, Sprite *>::iterator iter = spriteByIdMap.find(firstFrameSpriteIdList[i]);
+
+        if (iter != spriteByIdMap.end() && iter->second != NULL)
+        {
+            firstFrameSpriteSheetIdSet.insert(iter->second->GetSpriteSheetImageId());
+        }
+    }
+
+    // First we'll pin every sprite sheet the new location needs, and note any that aren't already loaded.
+    for (map<string, Sprite *>::iterator iter = spriteByIdMap.begin(); iter != spriteByIdMap.end(); ++iter)
+    {
+        Sprite *pSprite = iter->second;
+
+        if (pSprite == NULL || !pSprite->IsNeededAtLocation(newLocationId))
+        {
+            continue;
+        }
+
+        string spriteSheetId = pSprite->GetSpriteSheetImageId();
+
+        if (residencyManager.IsPinned(spriteSheetId))
+        {
+            continue;
+        }
+
+        bool isResident = IsImageLoaded(spriteSheetId);
+        residencyManager.Pin(spriteSheetId, isResident);
+
+        if (!isResident)
+        {
+            spriteSheetIdsToLoad.push_back(spriteSheetId);
+        }
+    }
+
+    // We won't know how big the sprite sheets we're loading are until we've loaded them,
+    // but each one is at least big enough to hold every sprite clipped from it.
+    map<string, pair<int, int> > incomingSizeBySpriteSheetIdMap;
+    Uint64 incomingBytes = 0;
+
+    for (unsigned int i = 0; i < spriteSheetIdsToLoad.size(); i++)
+    {
+        incomingSizeBySpriteSheetIdMap[spriteSheetIdsToLoad[i]] = pair<int, int>(0, 0);
+    }
+
     for (map<string, Sprite *>::iterator iter = spriteByIdMap.begin(); iter != spriteByIdMap.end(); ++iter)
     {
-        bool loadSprite = false;
-        bool deleteSprite = false;
-        string spriteId = iter->first;
         Sprite *pSprite = iter->second;
 
         if (pSprite == NULL)
@@ -151,25 +277,128 @@ void SpriteManager::FinishUpdateLoadedTextures(string newLocationId)
             continue;
         }
 
-        pSprite->UpdateReadiness(newLocationId, &loadSprite, &deleteSprite);
+        map<string, pair<int, int> >::iterator sizeIter = incomingSizeBySpriteSheetIdMap.find(pSprite->GetSpriteSheetImageId());
+
+        if (sizeIter != incomingSizeBySpriteSheetIdMap.end())
+        {
+            RectangleWH spriteClipRect = pSprite->GetSpriteClipRect();
+
+            sizeIter->second.first = max(sizeIter->second.first, (int)ceil(spriteClipRect.GetX() + spriteClipRect.GetWidth()));
+            sizeIter->second.second = max(sizeIter->second.second, (int)ceil(spriteClipRect.GetY() + spriteClipRect.GetHeight()));
+        }
+    }
+
+    for (map<string, pair<int, int> >::iterator iter = incomingSizeBySpriteSheetIdMap.begin(); iter != incomingSizeBySpriteSheetIdMap.end(); ++iter)
+    {
+        incomingBytes += (Uint64)iter->second.first * iter->second.second * 4;
+    }
+
+    // Everything else can stay loaded, unless that would put us over our budget.
+    map<string, Uint64> residentSizeBySpriteSheetIdMap;
+
+    SDL_SemWait(pImageByIdSemaphore);
+    for (map<string, SpriteSheetImageSlot *>::iterator iter = imageSlotByIdMap.begin(); iter != imageSlotByIdMap.end(); ++iter)
+    {
+        Image *pImage = iter->second->GetImage();
+
+        if (pImage != NULL)
+        {
+            residentSizeBySpriteSheetIdMap[iter->first] = (Uint64)pImage->width * pImage->height * 4;
+        }
+    }
+    SDL_SemPost(pImageByIdSemaphore);
+
+    vector<string> spriteSheetIdsToEvict;
+    residencyManager.Evict(residentSizeBySpriteSheetIdMap, incomingBytes, (Uint64)gTextureMemoryBudgetMegabytes * 1024 * 1024, &spriteSheetIdsToEvict);
+
+    for (unsigned int i = 0; i < spriteSheetIdsToEvict.size(); i++)
+    {
+        ResourceLoader::GetInstance()->AddImageIdToDeleteList(spriteSheetIdsToEvict[i]);
+    }
+
+    // Deletions run before loads, so we'll have made room before we need it.
+    for (unsigned int i = 0; i < spriteSheetIdsToLoad.size(); i++)
+    {
+        ResourceLoader::GetInstance()->AddImageIdToLoadList(
+            spriteSheetIdsToLoad[i],
+            firstFrameSpriteSheetIdSet.count(spriteSheetIdsToLoad[i]) > 0 ? LoadResourceStepPriorityFirstFrame : LoadResourceStepPriorityNormal);
+    }
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_RESOURCE_LOADER
+    TextureResidencyManager::Statistics statistics = residencyManager.GetStatistics();
+
+    cout << "Sprite sheet residency: "
+         << statistics.Hits << " hits, "
+         << statistics.Misses << " misses, "
+         << statistics.Evictions << " evictions so far, "
+         << statistics.ResidentBytes / (1024 * 1024) << " MB of " << gTextureMemoryBudgetMegabytes << " MB budget in use" << endl;
+    #endif
+#endif
+}
+
+void SpriteManager::PrefetchTexturesForLocation(string locationId)
+{
+    if (GetLoadedImageBytes() >= (Uint64)gTextureMemoryBudgetMegabytes * 1024 * 1024)
+    {
+        return;
+    }
+
+    // Prefetched sprite sheets aren't pinned, so until we actually go to the location that needs them,
+    // they're the first to be unloaded when we're over our budget.
+    for (map<string, Sprite *>::iterator iter = spriteByIdMap.begin(); iter != spriteByIdMap.end(); ++iter)
+    {
+        Sprite *pSprite = iter->second;
 
-        if (loadSprite)
+        if (pSprite == NULL || !pSprite->IsNeededAtLocation(locationId))
         {
-            ResourceLoader::GetInstance()->AddImageIdToLoadList(pSprite->GetSpriteSheetImageId());
+            continue;
         }
-        else if (deleteSprite)
+
+        string spriteSheetId = pSprite->GetSpriteSheetImageId();
+
+        if (!IsImageLoaded(spriteSheetId))
         {
-            ResourceLoader::GetInstance()->AddImageIdToDeleteList(pSprite->GetSpriteSheetImageId());
+            ResourceLoader::GetInstance()->AddImageIdToBackgroundLoadList(spriteSheetId);
         }
     }
 }
 
 void SpriteManager::UnloadResources()
 {
+    residencyManager.Reset();
+
+    SDL_SemWait(pImageByIdSemaphore);
+    for (map<string, SpriteSheetImageSlot *>::iterator iter = imageSlotByIdMap.begin(); iter != imageSlotByIdMap.end(); ++iter)
+    {
+        if (iter->second->GetImage() != NULL)
+        {
+            ResourceLoader::GetInstance()->AddImageIdToDeleteList(iter->first);
+        }
+    }
+    SDL_SemPost(pImageByIdSemaphore);
+}
+
+bool SpriteManager::IsImageLoaded(string id)
+{
+    return GetImageFromId(id) != NULL;
+}
+
+Uint64 SpriteManager::GetLoadedImageBytes()
+{
+    Uint64 loadedImageBytes = 0;
+
     SDL_SemWait(pImageByIdSemaphore);
-    for (map<string, Image *>::iterator iter = smartSpriteByIdMap.begin(); iter != smartSpriteByIdMap.end(); ++iter)
+    for (map<string, SpriteSheetImageSlot *>::iterator iter = imageSlotByIdMap.begin(); iter != imageSlotByIdMap.end(); ++iter)
     {
-        ResourceLoader::GetInstance()->AddImageIdToDeleteList(iter->first);
+        Image *pImage = iter->second->GetImage();
+
+        if (pImage != NULL)
+        {
+            loadedImageBytes += (Uint64)pImage->width * pImage->height * 4;
+        }
     }
     SDL_SemPost(pImageByIdSemaphore);
+
+    return loadedImageBytes;
 }
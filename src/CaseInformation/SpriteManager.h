@@ -34,6 +34,7 @@
 #include "../Image.h"
 #include "../Sprite.h"
 #include "../XmlReader.h"
+#include "TextureResidencyManager.h"
 #include <map>
 
 class SpriteManager
@@ -44,18 +45,36 @@ public:
 
     Sprite * GetSpriteFromId(string id);
     Image * GetImageFromId(string id);
+    SpriteSheetImageSlot * GetImageSlotFromId(string id);
     void AddSprite(string id, string spriteSheetId, RectangleWH spriteClipRect);
     void AddImage(string id, Image *pImage);
+    string GetImageFilePathFromId(string id);
     void LoadImageFromFilePath(string id);
+    void PrefetchImageFromFilePath(string id);
     void DeleteImage(string id);
+
+    // Images that have been replaced or unloaded might still be drawn with during the current frame,
+    // so they're only deleted once it's finished, which must be on the main thread.
+    static void ReclaimRetiredImages();
     void LoadFromXml(XmlReader *pReader);
-    void FinishUpdateLoadedTextures(string newLocationId);
+    void FinishUpdateLoadedTextures(string newLocationId, const vector<string> &firstFrameSpriteIdList = vector<string>());
+    void PrefetchTexturesForLocation(string locationId);
     void UnloadResources();
 
+    TextureResidencyManager::Statistics GetResidencyStatistics() { return residencyManager.GetStatistics(); }
+
 private:
+    bool IsImageLoaded(string id);
+    Uint64 GetLoadedImageBytes();
+    static void RetireImage(Image *pImage);
+
+    static vector<Image *> retiredImageList;
+    static SDL_SpinLock retiredImageListLock;
+
     map<string, Sprite *> spriteByIdMap;
-    map<string, Image *> smartSpriteByIdMap;
+    map<string, SpriteSheetImageSlot *> imageSlotByIdMap;
     map<string, string> smartSpriteFilePathByIdMap;
+    TextureResidencyManager residencyManager;
 
     ManagerSource managerSource;
     SDL_sem *pImageByIdSemaphore;
@@ -0,0 +1,112 @@
+/**
+ * Keeps track of which sprite sheets should stay loaded between locations.
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "TextureResidencyManager.h"
+
+#include <algorithm>
+
+TextureResidencyManager::TextureResidencyManager()
+{
+    updateCount = 0;
+}
+
+void TextureResidencyManager::BeginUpdate()
+{
+    // Whatever the last location pinned is free to be unloaded now, unless the new location pins it again.
+    updateCount++;
+    pinnedSpriteSheetIdSet.clear();
+}
+
+bool TextureResidencyManager::IsPinned(const string &spriteSheetId)
+{
+    return pinnedSpriteSheetIdSet.find(spriteSheetId) != pinnedSpriteSheetIdSet.end();
+}
+
+void TextureResidencyManager::Pin(const string &spriteSheetId, bool isResident)
+{
+    if (IsPinned(spriteSheetId))
+    {
+        return;
+    }
+
+    pinnedSpriteSheetIdSet.insert(spriteSheetId);
+    lastUsedUpdateBySpriteSheetIdMap[spriteSheetId] = updateCount;
+
+    if (isResident)
+    {
+        statistics.Hits++;
+    }
+    else
+    {
+        statistics.Misses++;
+    }
+}
+
+void TextureResidencyManager::Evict(const map<string, Uint64> &residentSizeBySpriteSheetIdMap, Uint64 incomingBytes, Uint64 budget, vector<string> *pSpriteSheetIdsToEvict)
+{
+    Uint64 residentBytes = incomingBytes;
+
+    // We'll sort the sprite sheets we're allowed to unload by when they were last used,
+    // with those that have never been pinned at all coming first.
+    vector<pair<unsigned int, string> > evictionCandidateList;
+
+    for (map<string, Uint64>::const_iterator iter = residentSizeBySpriteSheetIdMap.begin(); iter != residentSizeBySpriteSheetIdMap.end(); ++iter)
+    {
+        residentBytes += iter->second;
+
+        if (!IsPinned(iter->first))
+        {
+            map<string, unsigned int>::iterator lastUsedIter = lastUsedUpdateBySpriteSheetIdMap.find(iter->first);
+            unsigned int lastUsedUpdate = lastUsedIter != lastUsedUpdateBySpriteSheetIdMap.end() ? lastUsedIter->second : 0;
+
+            evictionCandidateList.push_back(pair<unsigned int, string>(lastUsedUpdate, iter->first));
+        }
+    }
+
+    sort(evictionCandidateList.begin(), evictionCandidateList.end());
+
+    for (unsigned int i = 0; i < evictionCandidateList.size() && residentBytes > budget; i++)
+    {
+        string spriteSheetId = evictionCandidateList[i].second;
+
+        residentBytes -= residentSizeBySpriteSheetIdMap.find(spriteSheetId)->second;
+        lastUsedUpdateBySpriteSheetIdMap.erase(spriteSheetId);
+        pSpriteSheetIdsToEvict->push_back(spriteSheetId);
+        statistics.Evictions++;
+    }
+
+    statistics.ResidentBytes = residentBytes;
+}
+
+void TextureResidencyManager::Reset()
+{
+    pinnedSpriteSheetIdSet.clear();
+    lastUsedUpdateBySpriteSheetIdMap.clear();
+    statistics.ResidentBytes = 0;
+}
@@ -0,0 +1,86 @@
+/**
+ * Basic header/include file for TextureResidencyManager.cpp.
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TEXTURERESIDENCYMANAGER_H
+#define TEXTURERESIDENCYMANAGER_H
+
+#include <SDL2/SDL.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Decides which sprite sheets stay loaded when the player moves from one location to another.
+// Sprite sheets the new location needs are pinned, and stay loaded for as long as we're there.
+// Everything else stays loaded as well, so that going back to a location we just left doesn't mean
+// loading all of its sprite sheets again, until the loaded sprite sheets take up more memory than
+// our budget allows, at which point the least recently used ones are unloaded to make room.
+class TextureResidencyManager
+{
+public:
+    class Statistics
+    {
+    public:
+        Statistics()
+        {
+            Hits = 0;
+            Misses = 0;
+            Evictions = 0;
+            ResidentBytes = 0;
+        }
+
+        unsigned int Hits;
+        unsigned int Misses;
+        unsigned int Evictions;
+        Uint64 ResidentBytes;
+    };
+
+    TextureResidencyManager();
+
+    void BeginUpdate();
+    bool IsPinned(const string &spriteSheetId);
+    void Pin(const string &spriteSheetId, bool isResident);
+    // Picks sprite sheets to unload so that the resident ones, along with the given number of bytes
+    // of sprite sheets that are about to be loaded, fit in our budget.
+    void Evict(const map<string, Uint64> &residentSizeBySpriteSheetIdMap, Uint64 incomingBytes, Uint64 budget, vector<string> *pSpriteSheetIdsToEvict);
+    void Reset();
+
+    Statistics GetStatistics() { return statistics; }
+
+private:
+    unsigned int updateCount;
+    map<string, unsigned int> lastUsedUpdateBySpriteSheetIdMap;
+    set<string> pinnedSpriteSheetIdSet;
+
+    Statistics statistics;
+};
+
+#endif
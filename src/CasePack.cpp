@@ -0,0 +1,191 @@
+/**
+ * Reading and writing the headers and entries of case packs.
+ *
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "CasePack.h"
+
+#include <string.h>
+
+namespace
+{
+    mz_uint16 ReadUInt16(const unsigned char *pBytes)
+    {
+        return (mz_uint16)(pBytes[0] | (pBytes[1] << 8));
+    }
+
+    mz_uint32 ReadUInt32(const unsigned char *pBytes)
+    {
+        return (mz_uint32)pBytes[0] | ((mz_uint32)pBytes[1] << 8) | ((mz_uint32)pBytes[2] << 16) | ((mz_uint32)pBytes[3] << 24);
+    }
+
+    mz_uint64 ReadUInt64(const unsigned char *pBytes)
+    {
+        return (mz_uint64)ReadUInt32(pBytes) | ((mz_uint64)ReadUInt32(pBytes + 4) << 32);
+    }
+
+    void WriteUInt16(unsigned char *pBytes, mz_uint16 value)
+    {
+        pBytes[0] = (unsigned char)(value & 0xFF);
+        pBytes[1] = (unsigned char)((value >> 8) & 0xFF);
+    }
+
+    void WriteUInt32(unsigned char *pBytes, mz_uint32 value)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            pBytes[i] = (unsigned char)((value >> (i * 8)) & 0xFF);
+        }
+    }
+
+    void WriteUInt64(unsigned char *pBytes, mz_uint64 value)
+    {
+        WriteUInt32(pBytes, (mz_uint32)(value & 0xFFFFFFFF));
+        WriteUInt32(pBytes + 4, (mz_uint32)(value >> 32));
+    }
+}
+
+bool CasePackHeader::ReadFrom(const unsigned char *pBytes)
+{
+    if (!IsCasePack(pBytes, CasePackHeaderSize) || ReadUInt32(pBytes + 8) != CasePackVersion)
+    {
+        return false;
+    }
+
+    entryCount = ReadUInt32(pBytes + 12);
+    groupCount = ReadUInt32(pBytes + 16);
+    entryTableOffset = ReadUInt64(pBytes + 24);
+    nameTableOffset = ReadUInt64(pBytes + 32);
+    nameTableSize = ReadUInt64(pBytes + 40);
+    return true;
+}
+
+void CasePackHeader::WriteTo(unsigned char *pBytes) const
+{
+    memset(pBytes, 0, CasePackHeaderSize);
+    memcpy(pBytes, CasePackMagic, CasePackMagicLength);
+
+    WriteUInt32(pBytes + 8, CasePackVersion);
+    WriteUInt32(pBytes + 12, entryCount);
+    WriteUInt32(pBytes + 16, groupCount);
+    WriteUInt64(pBytes + 24, entryTableOffset);
+    WriteUInt64(pBytes + 32, nameTableOffset);
+    WriteUInt64(pBytes + 40, nameTableSize);
+}
+
+void CasePackEntry::ReadFrom(const unsigned char *pBytes)
+{
+    filePathHash = ReadUInt32(pBytes);
+    groupIndex = ReadUInt32(pBytes + 4);
+    nameOffset = ReadUInt32(pBytes + 8);
+    nameLength = ReadUInt16(pBytes + 12);
+    codec = ReadUInt16(pBytes + 14);
+    dataOffset = ReadUInt64(pBytes + 16);
+    storedSize = ReadUInt64(pBytes + 24);
+    size = ReadUInt64(pBytes + 32);
+    crc32 = ReadUInt32(pBytes + 40);
+}
+
+void CasePackEntry::WriteTo(unsigned char *pBytes) const
+{
+    memset(pBytes, 0, CasePackEntrySize);
+
+    WriteUInt32(pBytes, filePathHash);
+    WriteUInt32(pBytes + 4, groupIndex);
+    WriteUInt32(pBytes + 8, nameOffset);
+    WriteUInt16(pBytes + 12, nameLength);
+    WriteUInt16(pBytes + 14, codec);
+    WriteUInt64(pBytes + 16, dataOffset);
+    WriteUInt64(pBytes + 24, storedSize);
+    WriteUInt64(pBytes + 32, size);
+    WriteUInt32(pBytes + 40, crc32);
+}
+
+bool IsCasePack(const unsigned char *pBytes, size_t byteCount)
+{
+    return byteCount >= CasePackMagicLength && memcmp(pBytes, CasePackMagic, CasePackMagicLength) == 0;
+}
+
+// Archive lookups ignore case, as miniz's do, and treat either kind of slash the same.
+char NormalizeArchiveFilePathCharacter(char c)
+{
+    if (c >= 'A' && c <= 'Z')
+    {
+        return c - 'A' + 'a';
+    }
+    else if (c == '\\')
+    {
+        return '/';
+    }
+    else
+    {
+        return c;
+    }
+}
+
+// FNV-1a over the normalized file path, so that we never need to build the normalized string to look one up.
+mz_uint32 HashArchiveFilePath(const char *pFilePath)
+{
+    mz_uint32 hash = 2166136261u;
+
+    for (const char *pC = pFilePath; *pC != '\0'; pC++)
+    {
+        hash ^= (unsigned char)NormalizeArchiveFilePathCharacter(*pC);
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+bool DecodeCasePackEntry(const CasePackEntry &entry, const void *pStoredData, void *pOutput)
+{
+    switch (entry.codec)
+    {
+    case CasePackCodecStore:
+        if (entry.storedSize != entry.size)
+        {
+            return false;
+        }
+
+        memcpy(pOutput, pStoredData, (size_t)entry.size);
+        break;
+
+    case CasePackCodecDeflate:
+        if (tinfl_decompress_mem_to_mem(pOutput, (size_t)entry.size, pStoredData, (size_t)entry.storedSize, 0) != (size_t)entry.size)
+        {
+            return false;
+        }
+
+        break;
+
+    default:
+        return false;
+    }
+
+    return mz_crc32(MZ_CRC32_INIT, static_cast<const unsigned char *>(pOutput), (size_t)entry.size) == entry.crc32;
+}
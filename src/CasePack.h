@@ -0,0 +1,116 @@
+/**
+ * Basic header/include file for CasePack.cpp.
+ *
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CASEPACK_H
+#define CASEPACK_H
+
+#include "miniz.h"
+
+// Case packs are an alternative to zip archives for case files, written by CasePacker.
+// Everything is laid out so that it can be read straight out of a memory-mapped file:
+//
+//     Header            CasePackHeaderSize bytes.
+//     Payloads          Each file's data, starting on a CasePackAlignment boundary.
+//                       Files in the same group are stored next to each other.
+//     Entry table       CasePackEntrySize bytes per file, sorted by path hash and then by path.
+//     Name table        Every file's normalized path, one after another with no terminators.
+//
+// All integers are little-endian.
+const char CasePackMagic[] = "MLIPACK";
+const unsigned int CasePackMagicLength = 8;
+const mz_uint32 CasePackVersion = 1;
+const unsigned int CasePackHeaderSize = 64;
+const unsigned int CasePackEntrySize = 48;
+const mz_uint64 CasePackAlignment = 4096;
+
+enum CasePackCodec
+{
+    CasePackCodecStore = 0,
+    CasePackCodecDeflate = 1,
+};
+
+class CasePackHeader
+{
+public:
+    CasePackHeader()
+    {
+        entryCount = 0;
+        groupCount = 0;
+        entryTableOffset = 0;
+        nameTableOffset = 0;
+        nameTableSize = 0;
+    }
+
+    bool ReadFrom(const unsigned char *pBytes);
+    void WriteTo(unsigned char *pBytes) const;
+
+    mz_uint32 entryCount;
+    mz_uint32 groupCount;
+    mz_uint64 entryTableOffset;
+    mz_uint64 nameTableOffset;
+    mz_uint64 nameTableSize;
+};
+
+class CasePackEntry
+{
+public:
+    CasePackEntry()
+    {
+        filePathHash = 0;
+        groupIndex = 0;
+        nameOffset = 0;
+        nameLength = 0;
+        codec = CasePackCodecStore;
+        dataOffset = 0;
+        storedSize = 0;
+        size = 0;
+        crc32 = 0;
+    }
+
+    void ReadFrom(const unsigned char *pBytes);
+    void WriteTo(unsigned char *pBytes) const;
+
+    mz_uint32 filePathHash;
+    mz_uint32 groupIndex;
+    mz_uint32 nameOffset;
+    mz_uint16 nameLength;
+    mz_uint16 codec;
+    mz_uint64 dataOffset;
+    mz_uint64 storedSize;
+    mz_uint64 size;
+    mz_uint32 crc32;
+};
+
+bool IsCasePack(const unsigned char *pBytes, size_t byteCount);
+char NormalizeArchiveFilePathCharacter(char c);
+mz_uint32 HashArchiveFilePath(const char *pFilePath);
+bool DecodeCasePackEntry(const CasePackEntry &entry, const void *pStoredData, void *pOutput);
+
+#endif
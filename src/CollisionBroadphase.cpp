@@ -0,0 +1,225 @@
+/**
+ * Implementation of a uniform grid broadphase for collision tests.
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "CollisionBroadphase.h"
+#include <algorithm>
+#include <math.h>
+
+CollisionBroadphase::CollisionBroadphase(RectangleWH bounds)
+{
+    originX = bounds.GetX();
+    originY = bounds.GetY();
+    gridWidth = max(1, (int)ceil(bounds.GetWidth() / CollisionBroadphaseCellSize));
+    gridHeight = max(1, (int)ceil(bounds.GetHeight() / CollisionBroadphaseCellSize));
+
+    cellEntryIndexLists.resize(gridWidth * gridHeight);
+
+    lock = 0;
+
+    SDL_AtomicSet(&probeCount, 0);
+    SDL_AtomicSet(&candidateCount, 0);
+    SDL_AtomicSet(&narrowphaseTestCount, 0);
+}
+
+int CollisionBroadphase::AddEntry(RectangleWH boundingBox)
+{
+    Entry entry;
+    SetEntryBounds(&entry, boundingBox);
+
+    SDL_AtomicLock(&lock);
+
+    entryList.push_back(entry);
+    int entryIndex = (int)entryList.size() - 1;
+    InsertIntoCells(entryIndex);
+
+    SDL_AtomicUnlock(&lock);
+
+    return entryIndex;
+}
+
+void CollisionBroadphase::UpdateEntry(int entryIndex, RectangleWH boundingBox)
+{
+    Entry newEntry;
+    SetEntryBounds(&newEntry, boundingBox);
+
+    SDL_AtomicLock(&lock);
+
+    Entry *pEntry = &entryList[entryIndex];
+
+    // Things usually move by a few pixels at a time,
+    // so most updates won't need to touch the cells at all.
+    if (newEntry.MinCellX == pEntry->MinCellX &&
+        newEntry.MinCellY == pEntry->MinCellY &&
+        newEntry.MaxCellX == pEntry->MaxCellX &&
+        newEntry.MaxCellY == pEntry->MaxCellY)
+    {
+        *pEntry = newEntry;
+    }
+    else
+    {
+        RemoveFromCells(entryIndex);
+        *pEntry = newEntry;
+        InsertIntoCells(entryIndex);
+    }
+
+    SDL_AtomicUnlock(&lock);
+}
+
+int CollisionBroadphase::Query(RectangleWH boundingBox, int *pCandidateIndices, int maxCandidateCount)
+{
+    double left = boundingBox.GetX();
+    double top = boundingBox.GetY();
+    double right = boundingBox.GetX() + boundingBox.GetWidth();
+    double bottom = boundingBox.GetY() + boundingBox.GetHeight();
+
+    int minCellX, minCellY, maxCellX, maxCellY;
+    GetCellRange(left, top, right, bottom, &minCellX, &minCellY, &maxCellX, &maxCellY);
+
+    int count = 0;
+
+    SDL_AtomicLock(&lock);
+
+    for (int cellY = minCellY; cellY <= maxCellY && count >= 0; cellY++)
+    {
+        for (int cellX = minCellX; cellX <= maxCellX && count >= 0; cellX++)
+        {
+            vector<int> *pCellEntryIndices = &cellEntryIndexLists[cellY * gridWidth + cellX];
+
+            for (unsigned int i = 0; i < pCellEntryIndices->size(); i++)
+            {
+                int entryIndex = (*pCellEntryIndices)[i];
+                const Entry &entry = entryList[entryIndex];
+
+                // An entry spanning several cells shows up in each of them,
+                // so we only report it from the first cell that it shares with the query.
+                if (cellX != max(entry.MinCellX, minCellX) || cellY != max(entry.MinCellY, minCellY))
+                {
+                    continue;
+                }
+
+                if (entry.Right < left || entry.Left > right || entry.Bottom < top || entry.Top > bottom)
+                {
+                    continue;
+                }
+
+                if (count == maxCandidateCount)
+                {
+                    count = -1;
+                    break;
+                }
+
+                pCandidateIndices[count++] = entryIndex;
+            }
+        }
+    }
+
+    SDL_AtomicUnlock(&lock);
+
+    SDL_AtomicAdd(&probeCount, 1);
+
+    if (count > 0)
+    {
+        sort(pCandidateIndices, pCandidateIndices + count);
+        SDL_AtomicAdd(&candidateCount, count);
+    }
+
+    return count;
+}
+
+void CollisionBroadphase::AddNarrowphaseTests(int narrowphaseTestCount)
+{
+    if (narrowphaseTestCount > 0)
+    {
+        SDL_AtomicAdd(&this->narrowphaseTestCount, narrowphaseTestCount);
+    }
+}
+
+CollisionBroadphase::Statistics CollisionBroadphase::GetStatistics()
+{
+    Statistics statistics;
+
+    statistics.Probes = (unsigned int)SDL_AtomicGet(&probeCount);
+    statistics.Candidates = (unsigned int)SDL_AtomicGet(&candidateCount);
+    statistics.NarrowphaseTests = (unsigned int)SDL_AtomicGet(&narrowphaseTestCount);
+
+    return statistics;
+}
+
+void CollisionBroadphase::ResetStatistics()
+{
+    SDL_AtomicSet(&probeCount, 0);
+    SDL_AtomicSet(&candidateCount, 0);
+    SDL_AtomicSet(&narrowphaseTestCount, 0);
+}
+
+void CollisionBroadphase::SetEntryBounds(Entry *pEntry, RectangleWH boundingBox)
+{
+    pEntry->Left = boundingBox.GetX();
+    pEntry->Top = boundingBox.GetY();
+    pEntry->Right = boundingBox.GetX() + boundingBox.GetWidth();
+    pEntry->Bottom = boundingBox.GetY() + boundingBox.GetHeight();
+
+    GetCellRange(pEntry->Left, pEntry->Top, pEntry->Right, pEntry->Bottom, &pEntry->MinCellX, &pEntry->MinCellY, &pEntry->MaxCellX, &pEntry->MaxCellY);
+}
+
+void CollisionBroadphase::GetCellRange(double left, double top, double right, double bottom, int *pMinCellX, int *pMinCellY, int *pMaxCellX, int *pMaxCellY) const
+{
+    // Anything outside of the grid gets clamped into the cells along its edges.
+    *pMinCellX = min(max((int)floor((left - originX) / CollisionBroadphaseCellSize), 0), gridWidth - 1);
+    *pMinCellY = min(max((int)floor((top - originY) / CollisionBroadphaseCellSize), 0), gridHeight - 1);
+    *pMaxCellX = min(max((int)floor((right - originX) / CollisionBroadphaseCellSize), 0), gridWidth - 1);
+    *pMaxCellY = min(max((int)floor((bottom - originY) / CollisionBroadphaseCellSize), 0), gridHeight - 1);
+}
+
+void CollisionBroadphase::InsertIntoCells(int entryIndex)
+{
+    const Entry &entry = entryList[entryIndex];
+
+    for (int cellY = entry.MinCellY; cellY <= entry.MaxCellY; cellY++)
+    {
+        for (int cellX = entry.MinCellX; cellX <= entry.MaxCellX; cellX++)
+        {
+            cellEntryIndexLists[cellY * gridWidth + cellX].push_back(entryIndex);
+        }
+    }
+}
+
+void CollisionBroadphase::RemoveFromCells(int entryIndex)
+{
+    const Entry &entry = entryList[entryIndex];
+
+    for (int cellY = entry.MinCellY; cellY <= entry.MaxCellY; cellY++)
+    {
+        for (int cellX = entry.MinCellX; cellX <= entry.MaxCellX; cellX++)
+        {
+            vector<int> *pCellEntryIndices = &cellEntryIndexLists[cellY * gridWidth + cellX];
+            pCellEntryIndices->erase(remove(pCellEntryIndices->begin(), pCellEntryIndices->end(), entryIndex), pCellEntryIndices->end());
+        }
+    }
+}
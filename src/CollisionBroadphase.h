@@ -0,0 +1,113 @@
+/**
+ * Basic header/include file for CollisionBroadphase.cpp.
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef COLLISIONBROADPHASE_H
+#define COLLISIONBROADPHASE_H
+
+#include "Rectangle.h"
+#include <SDL2/SDL.h>
+#include <vector>
+
+using namespace std;
+
+const double CollisionBroadphaseCellSize = 128;
+
+// A uniform grid of axis-aligned bounding boxes that lets us skip the narrowphase
+// for any object that can't possibly be touching the thing we're testing.
+// Entries are identified by the order in which they were added.
+// Queries may come from any thread, but entries should only be added or updated from one.
+class CollisionBroadphase
+{
+public:
+    class Statistics
+    {
+    public:
+        Statistics()
+        {
+            Probes = 0;
+            Candidates = 0;
+            NarrowphaseTests = 0;
+        }
+
+        unsigned int Probes;
+        unsigned int Candidates;
+        unsigned int NarrowphaseTests;
+    };
+
+    CollisionBroadphase(RectangleWH bounds);
+
+    int AddEntry(RectangleWH boundingBox);
+    void UpdateEntry(int entryIndex, RectangleWH boundingBox);
+    int GetEntryCount() const { return (int)this->entryList.size(); }
+
+    // Fills in the indices of every entry whose bounding box overlaps the given one, in ascending order,
+    // and returns how many there were.  If there were more than will fit, returns -1 instead,
+    // in which case the caller should just test everything.
+    int Query(RectangleWH boundingBox, int *pCandidateIndices, int maxCandidateCount);
+
+    void AddNarrowphaseTests(int narrowphaseTestCount);
+    Statistics GetStatistics();
+    void ResetStatistics();
+
+private:
+    class Entry
+    {
+    public:
+        double Left;
+        double Top;
+        double Right;
+        double Bottom;
+
+        int MinCellX;
+        int MinCellY;
+        int MaxCellX;
+        int MaxCellY;
+    };
+
+    void SetEntryBounds(Entry *pEntry, RectangleWH boundingBox);
+    void GetCellRange(double left, double top, double right, double bottom, int *pMinCellX, int *pMinCellY, int *pMaxCellX, int *pMaxCellY) const;
+    void InsertIntoCells(int entryIndex);
+    void RemoveFromCells(int entryIndex);
+
+    double originX;
+    double originY;
+    int gridWidth;
+    int gridHeight;
+
+    vector<Entry> entryList;
+    vector<vector<int> > cellEntryIndexLists;
+
+    SDL_SpinLock lock;
+
+    SDL_atomic_t probeCount;
+    SDL_atomic_t candidateCount;
+    SDL_atomic_t narrowphaseTestCount;
+};
+
+#endif
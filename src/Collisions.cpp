@@ -29,8 +29,97 @@
 
 #include "Collisions.h"
 #include <math.h>
+#include <algorithm>
 #include <limits>
 
+// SSE2 lets us test two offsets at once in double precision, which is what the rest of the collision code uses.
+// It's always available on 64-bit x86, but we'll fall back to the scalar version anywhere else.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MLI_COLLISIONS_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // Gets the intervals of both objects along the given separating axis.
+    // The first axes are the normals of the first object, followed by those of the second.
+    void GetSeparatingAxisIntervals(CollidableObject *pCollisionObject1, CollidableObject *pCollisionObject2, int axisIndex, Vector2 *pAxis, double *pMinDistance1, double *pMaxDistance1, double *pMinDistance2, double *pMaxDistance2)
+    {
+        int normalCount1 = pCollisionObject1->GetNormalCount();
+
+        if (axisIndex < normalCount1)
+        {
+            *pAxis = pCollisionObject1->GetNormal(axisIndex);
+            pCollisionObject1->GetNormalInterval(axisIndex, pMinDistance1, pMaxDistance1);
+            pCollisionObject2->CalculateInterval(pAxis->GetX(), pAxis->GetY(), pMinDistance2, pMaxDistance2);
+        }
+        else
+        {
+            *pAxis = pCollisionObject2->GetNormal(axisIndex - normalCount1);
+            pCollisionObject1->CalculateInterval(pAxis->GetX(), pAxis->GetY(), pMinDistance1, pMaxDistance1);
+            pCollisionObject2->GetNormalInterval(axisIndex - normalCount1, pMinDistance2, pMaxDistance2);
+        }
+    }
+
+    // Equivalent to testing for a collision against a square collidable object,
+    // but since the square is axis-aligned, we can project it onto any axis directly.
+    bool SquareCollisionExists(CollidableObject *pCollisionObject, Vector2 collisionObjectOffset, Vector2 squareCenter, double squareHalfSize)
+    {
+        Vector2 separation = pCollisionObject->GetPosition() + collisionObjectOffset - squareCenter;
+        int normalCount = pCollisionObject->GetNormalCount();
+
+        for (int i = 0; i < normalCount + 2; i++)
+        {
+            Vector2 axis = i < normalCount ? pCollisionObject->GetNormal(i) : (i == normalCount ? Vector2(1, 0) : Vector2(0, 1));
+            double minDistance;
+            double maxDistance;
+            double squareExtent = squareHalfSize * (fabs(axis.GetX()) + fabs(axis.GetY()));
+            double overlapDistance;
+
+            if (i < normalCount)
+            {
+                pCollisionObject->GetNormalInterval(i, &minDistance, &maxDistance);
+            }
+            else
+            {
+                pCollisionObject->CalculateInterval(axis.GetX(), axis.GetY(), &minDistance, &maxDistance);
+            }
+
+            if (!IsIntervalIntersection(minDistance, maxDistance, -squareExtent, squareExtent, separation * axis, &overlapDistance) ||
+                overlapDistance >= 0)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Restricts the given time interval to the times at which the given linear constraint holds,
+    // and returns whether any time remains.
+    bool ClipTimeInterval(double timeCoefficient, double constant, double *pEnterTime, double *pExitTime)
+    {
+        // timeCoefficient * t <= constant
+        if (fabs(timeCoefficient) < 0.000001)
+        {
+            if (constant < 0)
+            {
+                return false;
+            }
+        }
+        else if (timeCoefficient > 0)
+        {
+            *pExitTime = min(*pExitTime, constant / timeCoefficient);
+        }
+        else
+        {
+            *pEnterTime = max(*pEnterTime, constant / timeCoefficient);
+        }
+
+        return *pEnterTime <= *pExitTime;
+    }
+}
+
 HitBox::HitBox(XmlReader *pReader)
 {
     pReader->StartElement("HitBox");
@@ -53,6 +142,8 @@ HitBox::HitBox(XmlReader *pReader)
     }
 
     pReader->EndElement();
+
+    UpdateCollisionBoundingBox();
 }
 
 HitBox::~HitBox()
@@ -65,29 +156,26 @@ HitBox::~HitBox()
 
 bool HitBox::ContainsPoint(Vector2 offset, Vector2 point) const
 {
-    bool isCollision = false;
-    Vector2 overlapCompensation = Vector2(0, 0);
-    CollidableObject *pCollidableObjectForPoint = CollidableObject::CreateRectangle(Vector2(0, 0), Vector2(1, 1));
-
+    // The point is treated as a 1x1 square with the point at its top-left corner.
+    // We only need to know whether there's a collision, so we can stop at the first one.
     for (unsigned int i = 0; i < collidableObjectList.size(); i++)
     {
-        CollidableObject *pCollidableObject = collidableObjectList[i];
-        CollisionParameter tempParam;
-
-        if (CollisionExists(pCollidableObject, offset + overlapCompensation, pCollidableObjectForPoint, point, &tempParam)
-            && fabs(tempParam.OverlapDistance) > 0.0001)
+        if (SquareCollisionExists(collidableObjectList[i], offset, point + Vector2(0.5, 0.5), 0.5))
         {
-            overlapCompensation += tempParam.OverlapAxis * tempParam.OverlapDistance;
-            isCollision = true;
+            return true;
         }
     }
 
-    delete pCollidableObjectForPoint;
-    return isCollision;
+    return false;
 }
 
 bool HitBox::IsCollision(Vector2 offset, HitBox *pHitBox, Vector2 hitBoxOffset, CollisionParameter *pParam) const
 {
+    if (pParam == NULL)
+    {
+        return IsCollision(offset, pHitBox, hitBoxOffset);
+    }
+
     bool isCollision = false;
     Vector2 overlapCompensation = Vector2(0, 0);
 
@@ -100,19 +188,19 @@ bool HitBox::IsCollision(Vector2 offset, HitBox *pHitBox, Vector2 hitBoxOffset,
             for (unsigned int j = 0; j < pHitBox->collidableObjectList.size(); j++)
             {
                 CollidableObject *pCollidableObject2 = pHitBox->collidableObjectList[j];
-                CollisionParameter tempParam;
+                unsigned int overlapEntryCount = pParam->OverlapEntryList.size();
 
-                if (CollisionExists(pCollidableObject1, offset + overlapCompensation, pCollidableObject2, hitBoxOffset, &tempParam)
-                    && fabs(tempParam.OverlapDistance) > 0.0001)
+                // The overlap entries are only kept if this turns out to be a collision.
+                if (CollisionExists(pCollidableObject1, offset + overlapCompensation, pCollidableObject2, hitBoxOffset, pParam)
+                    && fabs(pParam->OverlapDistance) > 0.0001)
                 {
-                    for (unsigned int k = 0; k < tempParam.OverlapEntryList.size(); k++)
-                    {
-                        pParam->OverlapEntryList.push_back(tempParam.OverlapEntryList[k]);
-                    }
-
-                    overlapCompensation += tempParam.OverlapAxis * tempParam.OverlapDistance;
+                    overlapCompensation += pParam->OverlapAxis * pParam->OverlapDistance;
                     isCollision = true;
                 }
+                else
+                {
+                    pParam->OverlapEntryList.erase(pParam->OverlapEntryList.begin() + overlapEntryCount, pParam->OverlapEntryList.end());
+                }
             }
         }
     }
@@ -122,6 +210,118 @@ bool HitBox::IsCollision(Vector2 offset, HitBox *pHitBox, Vector2 hitBoxOffset,
     return isCollision;
 }
 
+bool HitBox::IsCollision(Vector2 offset, HitBox *pHitBox, Vector2 hitBoxOffset) const
+{
+    if (pHitBox == NULL)
+    {
+        return false;
+    }
+
+    // The overlap compensation in the version above only comes into play
+    // after a collision has been found, so we can stop at the first one.
+    for (unsigned int i = 0; i < collidableObjectList.size(); i++)
+    {
+        for (unsigned int j = 0; j < pHitBox->collidableObjectList.size(); j++)
+        {
+            if (CollisionExists(collidableObjectList[i], offset, pHitBox->collidableObjectList[j], hitBoxOffset))
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+unsigned int HitBox::IsCollisionBatch(const Vector2 *pOffsets, int offsetCount, unsigned int offsetMask, HitBox *pHitBox, Vector2 hitBoxOffset) const
+{
+    unsigned int collisionMask = 0;
+    double offsetXs[MaxCollisionBatchSize];
+    double offsetYs[MaxCollisionBatchSize];
+
+    if (pHitBox == NULL || offsetCount <= 0)
+    {
+        return 0;
+    }
+
+    if (offsetCount < MaxCollisionBatchSize)
+    {
+        offsetMask &= (1u << offsetCount) - 1;
+    }
+    else
+    {
+        offsetCount = MaxCollisionBatchSize;
+    }
+
+    for (int i = 0; i < offsetCount; i++)
+    {
+        offsetXs[i] = pOffsets[i].GetX();
+        offsetYs[i] = pOffsets[i].GetY();
+    }
+
+    // As with the single-offset version, we only need to know whether each offset collides with anything,
+    // so each pair of collidable objects only needs to test the offsets that haven't collided yet.
+    for (unsigned int i = 0; i < collidableObjectList.size(); i++)
+    {
+        for (unsigned int j = 0; j < pHitBox->collidableObjectList.size(); j++)
+        {
+            unsigned int remainingMask = offsetMask & ~collisionMask;
+
+            if (remainingMask == 0)
+            {
+                return collisionMask;
+            }
+
+            collisionMask |= CollisionExistsBatch(collidableObjectList[i], offsetXs, offsetYs, offsetCount, remainingMask, pHitBox->collidableObjectList[j], hitBoxOffset);
+        }
+    }
+
+    return collisionMask;
+}
+
+bool HitBox::IsSweptCollision(Vector2 startOffset, Vector2 endOffset, HitBox *pHitBox, Vector2 hitBoxOffset) const
+{
+    if (pHitBox == NULL)
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < collidableObjectList.size(); i++)
+    {
+        CollidableObject *pCollidableObject1 = collidableObjectList[i];
+        RectangleWH boundingBox1 = pCollidableObject1->GetBoundingBox();
+        Vector2 position1 = pCollidableObject1->GetPosition();
+
+        // Everything that the object touches on its way is inside the box covering it at both ends.
+        double left1 = position1.GetX() + boundingBox1.GetX() + min(startOffset.GetX(), endOffset.GetX());
+        double top1 = position1.GetY() + boundingBox1.GetY() + min(startOffset.GetY(), endOffset.GetY());
+        double right1 = position1.GetX() + boundingBox1.GetX() + boundingBox1.GetWidth() + max(startOffset.GetX(), endOffset.GetX());
+        double bottom1 = position1.GetY() + boundingBox1.GetY() + boundingBox1.GetHeight() + max(startOffset.GetY(), endOffset.GetY());
+
+        for (unsigned int j = 0; j < pHitBox->collidableObjectList.size(); j++)
+        {
+            CollidableObject *pCollidableObject2 = pHitBox->collidableObjectList[j];
+            RectangleWH boundingBox2 = pCollidableObject2->GetBoundingBox();
+            Vector2 position2 = pCollidableObject2->GetPosition() + hitBoxOffset;
+
+            if (position2.GetX() + boundingBox2.GetX() > right1 + 1 ||
+                position2.GetX() + boundingBox2.GetX() + boundingBox2.GetWidth() < left1 - 1 ||
+                position2.GetY() + boundingBox2.GetY() > bottom1 + 1 ||
+                position2.GetY() + boundingBox2.GetY() + boundingBox2.GetHeight() < top1 - 1)
+            {
+                continue;
+            }
+
+            if (SweptCollisionExists(pCollidableObject1, startOffset, endOffset, pCollidableObject2, hitBoxOffset))
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
 RectangleWH HitBox::GetBoundingBox() const
 {
     double left = numeric_limits<double>::infinity();
@@ -162,6 +362,15 @@ RectangleWH HitBox::GetBoundingBox() const
     return RectangleWH(left, top, right - left, bottom - top);
 }
 
+RectangleWH HitBox::GetCollisionBoundingBox(Vector2 offset) const
+{
+    return RectangleWH(
+        collisionBoundingBox.GetX() + offset.GetX(),
+        collisionBoundingBox.GetY() + offset.GetY(),
+        collisionBoundingBox.GetWidth(),
+        collisionBoundingBox.GetHeight());
+}
+
 void HitBox::Draw(Vector2 topLeftCornerPosition) const
 {
     for (unsigned int i = 0; i < collidableObjectList.size(); i++)
@@ -180,10 +389,45 @@ HitBox * HitBox::Clone()
     }
 
     pCloneHitBox->areaBoundsRectangle = areaBoundsRectangle;
+    pCloneHitBox->collisionBoundingBox = collisionBoundingBox;
 
     return pCloneHitBox;
 }
 
+void HitBox::UpdateCollisionBoundingBox()
+{
+    double left = numeric_limits<double>::infinity();
+    double top = numeric_limits<double>::infinity();
+    double right = -numeric_limits<double>::infinity();
+    double bottom = -numeric_limits<double>::infinity();
+
+    for (unsigned int i = 0; i < collidableObjectList.size(); i++)
+    {
+        CollidableObject *pCollidableObject = collidableObjectList[i];
+        vector<Vector2> *pVertices = pCollidableObject->GetVertices();
+
+        for (unsigned int j = 0; j < pVertices->size(); j++)
+        {
+            Vector2 vertex = pCollidableObject->GetPosition() + (*pVertices)[j];
+
+            left = min(left, vertex.GetX());
+            top = min(top, vertex.GetY());
+            right = max(right, vertex.GetX());
+            bottom = max(bottom, vertex.GetY());
+        }
+    }
+
+    // An empty hitbox can't collide with anything, so we'll just give it an empty bounding box.
+    if (left > right || top > bottom)
+    {
+        collisionBoundingBox = RectangleWH(0, 0, 0, 0);
+    }
+    else
+    {
+        collisionBoundingBox = RectangleWH(left, top, right - left, bottom - top);
+    }
+}
+
 CollidableObject::CollidableObject(XmlReader *pReader)
 {
     pReader->StartElement("CollidableObject");
@@ -213,6 +457,8 @@ CollidableObject::CollidableObject(XmlReader *pReader)
     pReader->EndElement();
 
     pReader->EndElement();
+
+    UpdateCachedGeometry();
 }
 
 CollidableObject * CollidableObject::CreateRectangle(Vector2 position, Vector2 size)
@@ -229,6 +475,8 @@ CollidableObject * CollidableObject::CreateRectangle(Vector2 position, Vector2 s
     pRectangle->GetNormals()->push_back(Vector2(1, 0));
     pRectangle->GetNormals()->push_back(Vector2(0, 1));
 
+    pRectangle->UpdateCachedGeometry();
+
     return pRectangle;
 }
 
@@ -253,45 +501,90 @@ CollidableObject * CollidableObject::Clone()
 
     pCloneCollidableObject->position = position;
 
+    pCloneCollidableObject->UpdateCachedGeometry();
+
     return pCloneCollidableObject;
 }
 
-void CalculateInterval(vector<Vector2> *pVertices, Vector2 axis, double *pMinDistance, double *pMaxDistance)
+void CollidableObject::CalculateInterval(double axisX, double axisY, double *pMinDistance, double *pMaxDistance) const
 {
-    double minDistance = axis * (*pVertices)[0];
+    int vertexCount = (int)vertexXList.size();
+
+    if (vertexCount == 0)
+    {
+        *pMinDistance = 0;
+        *pMaxDistance = 0;
+        return;
+    }
+
+    const double *pVertexXs = &vertexXList[0];
+    const double *pVertexYs = &vertexYList[0];
+
+    double minDistance = axisX * pVertexXs[0] + axisY * pVertexYs[0];
     double maxDistance = minDistance;
 
-    for (unsigned int i = 1; i < pVertices->size(); i++)
+    for (int i = 1; i < vertexCount; i++)
     {
-        double distance = axis * (*pVertices)[i];
+        double distance = axisX * pVertexXs[i] + axisY * pVertexYs[i];
 
-        if (distance < minDistance)
-        {
-            minDistance = distance;
-        }
-        else if (distance > maxDistance)
-        {
-            maxDistance = distance;
-        }
+        minDistance = min(minDistance, distance);
+        maxDistance = max(maxDistance, distance);
     }
 
     *pMinDistance = minDistance;
     *pMaxDistance = maxDistance;
 }
 
-bool IsIntervalIntersection(vector<Vector2> *pPolygon1Vertices, vector<Vector2> *pPolygon2Vertices, Vector2 offset, Vector2 axis, CollisionParameter *pParam)
+void CollidableObject::UpdateCachedGeometry()
 {
-    double minDistance1;
-    double maxDistance1;
-    double minDistance2;
-    double maxDistance2;
+    vertexXList.clear();
+    vertexYList.clear();
+    normalXList.clear();
+    normalYList.clear();
+    normalIntervalMinList.clear();
+    normalIntervalMaxList.clear();
+
+    for (unsigned int i = 0; i < vertices.size(); i++)
+    {
+        vertexXList.push_back(vertices[i].GetX());
+        vertexYList.push_back(vertices[i].GetY());
+    }
+
+    for (unsigned int i = 0; i < normals.size(); i++)
+    {
+        normalXList.push_back(normals[i].GetX());
+        normalYList.push_back(normals[i].GetY());
+    }
+
+    if (vertices.empty())
+    {
+        boundingBox = RectangleWH(0, 0, 0, 0);
+        return;
+    }
 
-    CalculateInterval(pPolygon1Vertices, axis, &minDistance1, &maxDistance1);
-    CalculateInterval(pPolygon2Vertices, axis, &minDistance2, &maxDistance2);
+    double left = *min_element(vertexXList.begin(), vertexXList.end());
+    double top = *min_element(vertexYList.begin(), vertexYList.end());
+    double right = *max_element(vertexXList.begin(), vertexXList.end());
+    double bottom = *max_element(vertexYList.begin(), vertexYList.end());
 
-    double h = offset * axis;
-    minDistance1 += h;
-    maxDistance1 += h;
+    boundingBox = RectangleWH(left, top, right - left, bottom - top);
+
+    for (unsigned int i = 0; i < normals.size(); i++)
+    {
+        double minDistance;
+        double maxDistance;
+
+        CalculateInterval(normalXList[i], normalYList[i], &minDistance, &maxDistance);
+
+        normalIntervalMinList.push_back(minDistance);
+        normalIntervalMaxList.push_back(maxDistance);
+    }
+}
+
+bool IsIntervalIntersection(double minDistance1, double maxDistance1, double minDistance2, double maxDistance2, double offsetDistance, double *pOverlapDistance)
+{
+    minDistance1 += offsetDistance;
+    maxDistance1 += offsetDistance;
 
     double distance1 = minDistance1 - maxDistance2;
     double distance2 = minDistance2 - maxDistance1;
@@ -306,7 +599,7 @@ bool IsIntervalIntersection(vector<Vector2> *pPolygon1Vertices, vector<Vector2>
         distance2 = 0;
     }
 
-    pParam->OverlapDistance = max(distance1, distance2);
+    *pOverlapDistance = max(distance1, distance2);
     return distance1 <= 0 && distance2 <= 0;
 }
 
@@ -315,41 +608,35 @@ bool CollisionExists(CollidableObject *pCollisionObject1, Vector2 collisionObjec
     pParam->OverlapAxis = Vector2(0, 0);
     pParam->OverlapDistance = -numeric_limits<double>::infinity();
 
-    int axesCount = 0;
-    Vector2 axes[32];
-
-    for (unsigned int i = 0; i < pCollisionObject1->GetNormals()->size(); i++)
-    {
-        axes[axesCount++] = (*pCollisionObject1->GetNormals())[i];
-    }
-
-    for (unsigned int i = 0; i < pCollisionObject2->GetNormals()->size(); i++)
-    {
-        axes[axesCount++] = (*pCollisionObject2->GetNormals())[i];
-    }
-
+    int axesCount = pCollisionObject1->GetNormalCount() + pCollisionObject2->GetNormalCount();
     Vector2 collisionObjectsSeparation = pCollisionObject1->GetPosition() + collisionObject1Offset - (pCollisionObject2->GetPosition() + collisionObject2Offset);
 
     for (int i = 0; i < axesCount; i++)
     {
-        CollisionParameter tempParam;
+        Vector2 axis;
+        double minDistance1;
+        double maxDistance1;
+        double minDistance2;
+        double maxDistance2;
+        double overlapDistance;
 
-        if (!IsIntervalIntersection(pCollisionObject1->GetVertices(), pCollisionObject2->GetVertices(), collisionObjectsSeparation, axes[i], &tempParam))
+        GetSeparatingAxisIntervals(pCollisionObject1, pCollisionObject2, i, &axis, &minDistance1, &maxDistance1, &minDistance2, &maxDistance2);
+
+        if (!IsIntervalIntersection(minDistance1, maxDistance1, minDistance2, maxDistance2, collisionObjectsSeparation * axis, &overlapDistance))
         {
             return false;
         }
 
-        if (tempParam.OverlapDistance < 0)
+        if (overlapDistance < 0)
         {
-            double overlapDistance = tempParam.OverlapDistance;
-            Vector2 overlapAxis = axes[i];
+            Vector2 overlapAxis = axis;
 
             if ((overlapAxis * overlapDistance) * collisionObjectsSeparation < 0)
             {
                 overlapAxis *= -1;
             }
 
-            if (pParam->OverlapDistance < 0 && tempParam.OverlapDistance > pParam->OverlapDistance)
+            if (pParam->OverlapDistance < 0 && overlapDistance > pParam->OverlapDistance)
             {
                 pParam->OverlapDistance = overlapDistance;
                 pParam->OverlapAxis = overlapAxis;
@@ -359,18 +646,155 @@ bool CollisionExists(CollidableObject *pCollisionObject1, Vector2 collisionObjec
         }
         else
         {
-            double overlapDistance = tempParam.OverlapDistance;
-            Vector2 overlapAxis = axes[i];
-
             if (overlapDistance > pParam->OverlapDistance)
             {
                 pParam->OverlapDistance = overlapDistance;
-                pParam->OverlapAxis = overlapAxis;
+                pParam->OverlapAxis = axis;
             }
 
-            pParam->AddOverlapEntry(overlapDistance, overlapAxis, pCollisionObject1, pCollisionObject2);
+            pParam->AddOverlapEntry(overlapDistance, axis, pCollisionObject1, pCollisionObject2);
         }
     }
 
     return true;
 }
+
+bool CollisionExists(CollidableObject *pCollisionObject1, Vector2 collisionObject1Offset, CollidableObject *pCollisionObject2, Vector2 collisionObject2Offset)
+{
+    int axesCount = pCollisionObject1->GetNormalCount() + pCollisionObject2->GetNormalCount();
+    Vector2 collisionObjectsSeparation = pCollisionObject1->GetPosition() + collisionObject1Offset - (pCollisionObject2->GetPosition() + collisionObject2Offset);
+
+    // The version above reports an overlap of zero if the objects are just touching along any axis,
+    // which IsCollision() doesn't count as a collision, so every axis needs a real overlap.
+    for (int i = 0; i < axesCount; i++)
+    {
+        Vector2 axis;
+        double minDistance1;
+        double maxDistance1;
+        double minDistance2;
+        double maxDistance2;
+        double overlapDistance;
+
+        GetSeparatingAxisIntervals(pCollisionObject1, pCollisionObject2, i, &axis, &minDistance1, &maxDistance1, &minDistance2, &maxDistance2);
+
+        if (!IsIntervalIntersection(minDistance1, maxDistance1, minDistance2, maxDistance2, collisionObjectsSeparation * axis, &overlapDistance) ||
+            overlapDistance >= 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool SweptCollisionExists(CollidableObject *pCollisionObject1, Vector2 collisionObject1StartOffset, Vector2 collisionObject1EndOffset, CollidableObject *pCollisionObject2, Vector2 collisionObject2Offset)
+{
+    int axesCount = pCollisionObject1->GetNormalCount() + pCollisionObject2->GetNormalCount();
+    Vector2 collisionObjectsSeparation = pCollisionObject1->GetPosition() + collisionObject1StartOffset - (pCollisionObject2->GetPosition() + collisionObject2Offset);
+    Vector2 displacement = collisionObject1EndOffset - collisionObject1StartOffset;
+    double enterTime = 0;
+    double exitTime = 1;
+
+    // With the first object at a time t between 0 and 1 along its path, the overlap along each axis changes linearly in t,
+    // so the times at which the objects overlap along any one axis form a single interval.
+    // The objects collide if there's some time that's in all of those intervals.
+    for (int i = 0; i < axesCount; i++)
+    {
+        Vector2 axis;
+        double minDistance1;
+        double maxDistance1;
+        double minDistance2;
+        double maxDistance2;
+
+        GetSeparatingAxisIntervals(pCollisionObject1, pCollisionObject2, i, &axis, &minDistance1, &maxDistance1, &minDistance2, &maxDistance2);
+
+        double separationDistance = collisionObjectsSeparation * axis;
+        double displacementDistance = displacement * axis;
+
+        // As with the boolean-only version of CollisionExists(), we need an overlap of at least 0.01 in both directions:
+        //     (minDistance1 + separationDistance + t * displacementDistance) - maxDistance2 <= -0.01
+        //     minDistance2 - (maxDistance1 + separationDistance + t * displacementDistance) <= -0.01
+        if (!ClipTimeInterval(displacementDistance, maxDistance2 - minDistance1 - separationDistance - 0.01, &enterTime, &exitTime) ||
+            !ClipTimeInterval(-displacementDistance, maxDistance1 + separationDistance - minDistance2 - 0.01, &enterTime, &exitTime))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+unsigned int CollisionExistsBatch(CollidableObject *pCollisionObject1, const double *pCollisionObject1OffsetXs, const double *pCollisionObject1OffsetYs, int offsetCount, unsigned int offsetMask, CollidableObject *pCollisionObject2, Vector2 collisionObject2Offset)
+{
+    int axesCount = pCollisionObject1->GetNormalCount() + pCollisionObject2->GetNormalCount();
+    Vector2 collisionObject2Position = pCollisionObject2->GetPosition() + collisionObject2Offset;
+    double separationXs[MaxCollisionBatchSize];
+    double separationYs[MaxCollisionBatchSize];
+
+    for (int i = 0; i < offsetCount; i++)
+    {
+        separationXs[i] = (pCollisionObject1->GetPosition().GetX() + pCollisionObject1OffsetXs[i]) - collisionObject2Position.GetX();
+        separationYs[i] = (pCollisionObject1->GetPosition().GetY() + pCollisionObject1OffsetYs[i]) - collisionObject2Position.GetY();
+    }
+
+    // The intervals along each axis don't depend on the offset at all - only the separation does -
+    // so we can get them once and then check every offset against them.
+    // An offset remains a collision only as long as it has a real overlap along every axis,
+    // which after accounting for the tolerance in IsIntervalIntersection means an overlap of at least 0.01.
+    for (int axisIndex = 0; axisIndex < axesCount && offsetMask != 0; axisIndex++)
+    {
+        Vector2 axis;
+        double minDistance1;
+        double maxDistance1;
+        double minDistance2;
+        double maxDistance2;
+
+        GetSeparatingAxisIntervals(pCollisionObject1, pCollisionObject2, axisIndex, &axis, &minDistance1, &maxDistance1, &minDistance2, &maxDistance2);
+
+        int i = 0;
+
+#ifdef MLI_COLLISIONS_USE_SSE2
+        __m128d axisX = _mm_set1_pd(axis.GetX());
+        __m128d axisY = _mm_set1_pd(axis.GetY());
+        __m128d minDistance1Vector = _mm_set1_pd(minDistance1);
+        __m128d maxDistance1Vector = _mm_set1_pd(maxDistance1);
+        __m128d minDistance2Vector = _mm_set1_pd(minDistance2);
+        __m128d maxDistance2Vector = _mm_set1_pd(maxDistance2);
+        __m128d maxOverlapDistance = _mm_set1_pd(-0.01);
+
+        for (; i + 1 < offsetCount; i += 2)
+        {
+            if (((offsetMask >> i) & 0x3) == 0)
+            {
+                continue;
+            }
+
+            __m128d separationDistance = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(&separationXs[i]), axisX), _mm_mul_pd(_mm_loadu_pd(&separationYs[i]), axisY));
+            __m128d distance1 = _mm_sub_pd(_mm_add_pd(minDistance1Vector, separationDistance), maxDistance2Vector);
+            __m128d distance2 = _mm_sub_pd(minDistance2Vector, _mm_add_pd(maxDistance1Vector, separationDistance));
+            __m128d isOverlapping = _mm_and_pd(_mm_cmple_pd(distance1, maxOverlapDistance), _mm_cmple_pd(distance2, maxOverlapDistance));
+
+            offsetMask &= ~((~(unsigned int)_mm_movemask_pd(isOverlapping) & 0x3) << i);
+        }
+#endif
+
+        for (; i < offsetCount; i++)
+        {
+            if ((offsetMask & (1u << i)) == 0)
+            {
+                continue;
+            }
+
+            double separationDistance = separationXs[i] * axis.GetX() + separationYs[i] * axis.GetY();
+            double distance1 = (minDistance1 + separationDistance) - maxDistance2;
+            double distance2 = minDistance2 - (maxDistance1 + separationDistance);
+
+            if (distance1 > -0.01 || distance2 > -0.01)
+            {
+                offsetMask &= ~(1u << i);
+            }
+        }
+    }
+
+    return offsetMask;
+}
@@ -38,6 +38,10 @@
 class CollidableObject;
 class CollisionParameter;
 
+// The number of offsets that can be tested at once by IsCollisionBatch(),
+// which is limited by the number of bits in the returned mask.
+const int MaxCollisionBatchSize = 32;
+
 class HitBox
 {
 public:
@@ -46,14 +50,38 @@ public:
     ~HitBox();
 
     bool ContainsPoint(Vector2 offset, Vector2 point) const;
+
+    // If the caller only needs to know whether there's a collision,
+    // it can pass a NULL parameter to skip all of the overlap bookkeeping.
     bool IsCollision(Vector2 offset, HitBox *pHitBox, Vector2 hitBoxOffset, CollisionParameter *pParam) const;
+    bool IsCollision(Vector2 offset, HitBox *pHitBox, Vector2 hitBoxOffset) const;
+
+    // Tests this hitbox at each of the given offsets for which the corresponding bit in the mask is set,
+    // and returns a mask with the bits set for each of those that collide.
+    // Equivalent to, but much faster than, calling IsCollision() for each offset.
+    unsigned int IsCollisionBatch(const Vector2 *pOffsets, int offsetCount, unsigned int offsetMask, HitBox *pHitBox, Vector2 hitBoxOffset) const;
+
+    // Determines whether IsCollision() would report a collision at any point
+    // as this hitbox moves in a straight line from the start offset to the end offset.
+    bool IsSweptCollision(Vector2 startOffset, Vector2 endOffset, HitBox *pHitBox, Vector2 hitBoxOffset) const;
+
     RectangleWH GetBoundingBox() const;
+
+    // Unlike GetBoundingBox(), this accounts for the positions of the collidable objects,
+    // so it bounds everything that IsCollision() could possibly report a collision with.
+    RectangleWH GetCollisionBoundingBox(Vector2 offset) const;
+
     void Draw(Vector2 topLeftCornerPosition) const;
     HitBox * Clone();
 
+    vector<CollidableObject *> * GetCollidableObjects() { return &this->collidableObjectList; }
+
 private:
+    void UpdateCollisionBoundingBox();
+
     vector<CollidableObject *> collidableObjectList;
     RectangleWH areaBoundsRectangle;
+    RectangleWH collisionBoundingBox;
 };
 
 class CollidableObject
@@ -69,6 +97,23 @@ public:
     Vector2 GetPosition() const { return this->position; }
     void SetPosition(Vector2 position) { this->position = position; }
 
+    // The bounding box of the vertices, relative to the object's position.
+    RectangleWH GetBoundingBox() const { return this->boundingBox; }
+
+    int GetNormalCount() const { return (int)this->normalXList.size(); }
+    Vector2 GetNormal(int normalIndex) const { return Vector2(this->normalXList[normalIndex], this->normalYList[normalIndex]); }
+
+    // Projects the vertices onto the given axis, relative to the object's position.
+    void CalculateInterval(double axisX, double axisY, double *pMinDistance, double *pMaxDistance) const;
+
+    // The same as above, but for one of the object's own normals,
+    // whose intervals never change and so are computed once up front.
+    void GetNormalInterval(int normalIndex, double *pMinDistance, double *pMaxDistance) const
+    {
+        *pMinDistance = this->normalIntervalMinList[normalIndex];
+        *pMaxDistance = this->normalIntervalMaxList[normalIndex];
+    }
+
     void Draw(Vector2 topLeftCornerPosition) const;
     CollidableObject * Clone();
 
@@ -77,9 +122,24 @@ private:
     {
     }
 
+    // Must be called whenever the vertices or normals change.
+    void UpdateCachedGeometry();
+
     vector<Vector2> vertices;
     vector<Vector2> normals;
     Vector2 position;
+
+    // The vertices and normals again, stored as separate coordinate lists
+    // so that projecting them is a tight loop over contiguous memory.
+    vector<double> vertexXList;
+    vector<double> vertexYList;
+    vector<double> normalXList;
+    vector<double> normalYList;
+
+    vector<double> normalIntervalMinList;
+    vector<double> normalIntervalMaxList;
+
+    RectangleWH boundingBox;
 };
 
 class OverlapEntry
@@ -125,14 +185,24 @@ public:
     }
 };
 
-void CalculateInterval(vector<Vector2> *pVertices, Vector2 axis, double *pMinDistance, double *pMaxDistance);
-
-// Determines whether there's an intersection between the vertices along the given axis,
+// Determines whether there's an intersection between the given intervals, the first of which is offset by the given distance,
 // and returns how far they're overlapping if so.
-bool IsIntervalIntersection(vector<Vector2> *pPolygon1Vertices, vector<Vector2> *pPolygon2Vertices, Vector2 offset, Vector2 axis, CollisionParameter *pParam);
+bool IsIntervalIntersection(double minDistance1, double maxDistance1, double minDistance2, double maxDistance2, double offsetDistance, double *pOverlapDistance);
 
 // Determines whether there's an intersection between the given objects,
 // and returns the distance they're overlapping and along which axis if so.
 bool CollisionExists(CollidableObject *pCollisionObject1, Vector2 collisionObject1Offset, CollidableObject *pCollisionObject2, Vector2 collisionObject2Offset, CollisionParameter *pParam);
 
+// Determines whether the given objects are overlapping by more than a negligible amount,
+// which is the only kind of collision that HitBox::IsCollision() reports.
+bool CollisionExists(CollidableObject *pCollisionObject1, Vector2 collisionObject1Offset, CollidableObject *pCollisionObject2, Vector2 collisionObject2Offset);
+
+// Determines whether the given objects collide at any point as the first moves in a straight line
+// from its start offset to its end offset, using the same criteria as the boolean-only version of CollisionExists().
+bool SweptCollisionExists(CollidableObject *pCollisionObject1, Vector2 collisionObject1StartOffset, Vector2 collisionObject1EndOffset, CollidableObject *pCollisionObject2, Vector2 collisionObject2Offset);
+
+// The same as the boolean-only version of CollisionExists(), but for many offsets of the first object at once,
+// given as separate coordinate lists.  Only tests the offsets whose bits are set in the mask, and returns the mask of those that collide.
+unsigned int CollisionExistsBatch(CollidableObject *pCollisionObject1, const double *pCollisionObject1OffsetXs, const double *pCollisionObject1OffsetYs, int offsetCount, unsigned int offsetMask, CollidableObject *pCollisionObject2, Vector2 collisionObject2Offset);
+
 #endif
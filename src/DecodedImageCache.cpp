@@ -0,0 +1,442 @@
+/**
+ * Keeps decoded images on disk so they don't need to be decoded again.
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "DecodedImageCache.h"
+
+#include <fstream>
+#include <vector>
+#include <stdio.h>
+
+namespace
+{
+    // "MLDI", followed by the version of the file format.
+    const Uint32 DecodedImageFileMagic = 0x49444C4D;
+    const Uint32 DecodedImageFileVersion = 1;
+
+    const char DecodedImageCacheIndexFileName[] = "Index.txt";
+
+    // Files removed since the index was last saved are listed with this in front of their names.
+    const char DecodedImageCacheIndexRemovedPrefix = '-';
+
+    // Each file begins with these, followed by the key and then the pixels.
+    enum DecodedImageFileHeaderField
+    {
+        DecodedImageFileHeaderFieldMagic,
+        DecodedImageFileHeaderFieldVersion,
+        DecodedImageFileHeaderFieldWidth,
+        DecodedImageFileHeaderFieldHeight,
+        DecodedImageFileHeaderFieldPitch,
+        DecodedImageFileHeaderFieldPixelFormat,
+        DecodedImageFileHeaderFieldKeyLength,
+        DecodedImageFileHeaderFieldCount,
+    };
+
+    Uint32 HashString(const string &s, Uint32 hash)
+    {
+        // FNV-1a.
+        for (unsigned int i = 0; i < s.length(); i++)
+        {
+            hash ^= (unsigned char)s[i];
+            hash *= 16777619;
+        }
+
+        return hash;
+    }
+}
+
+DecodedImageCache::DecodedImageCache()
+{
+    maxSize = 0;
+    isInitialized = false;
+    totalSize = 0;
+    isIndexDirty = false;
+    pLock = SDL_CreateSemaphore(1);
+}
+
+DecodedImageCache::~DecodedImageCache()
+{
+    SaveIndex();
+
+    SDL_DestroySemaphore(pLock);
+    pLock = NULL;
+}
+
+void DecodedImageCache::Init(const string &cacheFolderPath, Uint64 maxSize)
+{
+    if (cacheFolderPath.length() == 0)
+    {
+        return;
+    }
+
+    this->cacheFolderPath = cacheFolderPath;
+    this->maxSize = maxSize;
+
+    // The index lists every file in the cache, from least to most recently used,
+    // followed by the files that were added or removed since it was last saved in full.
+    ifstream indexStream((cacheFolderPath + DecodedImageCacheIndexFileName).c_str());
+    string fileName;
+    Uint64 size = 0;
+    unsigned int lineCount = 0;
+
+    while (indexStream >> fileName)
+    {
+        lineCount++;
+
+        if (fileName[0] == DecodedImageCacheIndexRemovedPrefix)
+        {
+            EraseEntry(fileName.substr(1));
+            continue;
+        }
+
+        if (!(indexStream >> size))
+        {
+            break;
+        }
+
+        // A file that's listed again was written again, which makes it the most recently used.
+        EraseEntry(fileName);
+        AddEntry(fileName, size);
+    }
+
+    indexStream.close();
+
+    // If anything was removed or written again since the index was last saved in full,
+    // we'll leave it out of the index the next time we save it.
+    isIndexDirty = lineCount != entryList.size();
+
+    // The size limit may have gone down since the cache was last used.
+    vector<string> fileNamesToRemove;
+    EvictLeastRecentlyUsed(&fileNamesToRemove);
+    RemoveFiles(fileNamesToRemove);
+
+    isInitialized = true;
+}
+
+void DecodedImageCache::SaveIndex()
+{
+    if (!isInitialized)
+    {
+        return;
+    }
+
+    SDL_SemWait(pLock);
+
+    if (isIndexDirty)
+    {
+        ofstream indexStream((cacheFolderPath + DecodedImageCacheIndexFileName).c_str());
+
+        for (EntryList::iterator iter = entryList.begin(); iter != entryList.end(); ++iter)
+        {
+            indexStream << iter->fileName << " " << iter->size << "\n";
+        }
+
+        isIndexDirty = false;
+    }
+
+    SDL_SemPost(pLock);
+}
+
+SDL_Surface * DecodedImageCache::TryLoadSurface(const string &key)
+{
+    if (!isInitialized)
+    {
+        return NULL;
+    }
+
+    string fileName = GetFileNameForKey(key);
+
+    SDL_SemWait(pLock);
+    map<string, EntryList::iterator>::iterator iter = entryByFileNameMap.find(fileName);
+
+    if (iter == entryByFileNameMap.end())
+    {
+        SDL_SemPost(pLock);
+        return NULL;
+    }
+
+    // This is now the most recently used image.
+    entryList.splice(entryList.end(), entryList, iter->second);
+    isIndexDirty = true;
+    SDL_SemPost(pLock);
+
+    FILE *pFile = fopen((cacheFolderPath + fileName).c_str(), "rb");
+
+    if (pFile == NULL)
+    {
+        RemoveEntry(fileName);
+        return NULL;
+    }
+
+    SDL_Surface *pSurface = NULL;
+    Uint32 header[DecodedImageFileHeaderFieldCount];
+
+    if (fread(header, sizeof(header), 1, pFile) == 1 &&
+        header[DecodedImageFileHeaderFieldMagic] == DecodedImageFileMagic &&
+        header[DecodedImageFileHeaderFieldVersion] == DecodedImageFileVersion &&
+        header[DecodedImageFileHeaderFieldKeyLength] == key.length())
+    {
+        string fileKey(key.length(), '\0');
+        int bitsPerPixel = 0;
+        Uint32 redMask = 0;
+        Uint32 greenMask = 0;
+        Uint32 blueMask = 0;
+        Uint32 alphaMask = 0;
+
+        // Hashes can collide, so we'll make sure this really is the image we're looking for.
+        if ((key.length() == 0 || fread(&fileKey[0], key.length(), 1, pFile) == 1) &&
+            fileKey == key &&
+            SDL_PixelFormatEnumToMasks(header[DecodedImageFileHeaderFieldPixelFormat], &bitsPerPixel, &redMask, &greenMask, &blueMask, &alphaMask))
+        {
+            pSurface =
+                SDL_CreateRGBSurface(
+                    0,
+                    (int)header[DecodedImageFileHeaderFieldWidth],
+                    (int)header[DecodedImageFileHeaderFieldHeight],
+                    bitsPerPixel,
+                    redMask,
+                    greenMask,
+                    blueMask,
+                    alphaMask);
+        }
+    }
+
+    // The pixels were written straight out of a surface of the same size and format,
+    // so they can be read straight into this one.
+    if (pSurface != NULL &&
+        ((Uint32)pSurface->pitch != header[DecodedImageFileHeaderFieldPitch] ||
+         fread(pSurface->pixels, pSurface->pitch, pSurface->h, pFile) != (size_t)pSurface->h))
+    {
+        SDL_FreeSurface(pSurface);
+        pSurface = NULL;
+    }
+
+    fclose(pFile);
+
+    if (pSurface == NULL)
+    {
+        RemoveEntry(fileName);
+    }
+
+    return pSurface;
+}
+
+void DecodedImageCache::SaveSurface(const string &key, SDL_Surface *pSurface)
+{
+    Uint32 colorKey = 0;
+
+    // A color key or a palette can't be recreated from the pixels alone, so we'll leave those images alone.
+    if (!isInitialized ||
+        pSurface == NULL ||
+        pSurface->format->palette != NULL ||
+        SDL_GetColorKey(pSurface, &colorKey) == 0)
+    {
+        return;
+    }
+
+    Uint64 size = (Uint64)pSurface->pitch * pSurface->h;
+
+    if (size > maxSize)
+    {
+        return;
+    }
+
+    string fileName = GetFileNameForKey(key);
+
+    SDL_SemWait(pLock);
+
+    // If this image is already cached, or another thread is caching it right now, there's nothing to do.
+    if (entryByFileNameMap.find(fileName) != entryByFileNameMap.end() ||
+        fileNamesBeingWrittenSet.find(fileName) != fileNamesBeingWrittenSet.end())
+    {
+        SDL_SemPost(pLock);
+        return;
+    }
+
+    fileNamesBeingWrittenSet.insert(fileName);
+    SDL_SemPost(pLock);
+
+    bool success = WriteSurfaceFile(cacheFolderPath + fileName, key, pSurface);
+
+    if (!success)
+    {
+        remove((cacheFolderPath + fileName).c_str());
+    }
+
+    SDL_SemWait(pLock);
+    fileNamesBeingWrittenSet.erase(fileName);
+
+    // We only add the image to the index once it's completely written,
+    // so nobody will ever try to read a half-written file.  We'll note it in the index file right away
+    // as well, so that if we don't get to save the index, the file won't be left out of it.
+    if (success)
+    {
+        AddEntry(fileName, size);
+        AppendAddedFileToIndexFile(fileName, size);
+    }
+
+    vector<string> fileNamesToRemove;
+    EvictLeastRecentlyUsed(&fileNamesToRemove);
+    SDL_SemPost(pLock);
+
+    RemoveFiles(fileNamesToRemove);
+}
+
+string DecodedImageCache::GetFileNameForKey(const string &key)
+{
+    char fileName[32];
+
+    // Two different 32-bit hashes make accidental collisions vanishingly rare,
+    // and we check the key stored in the file in any event.
+    sprintf(fileName, "%08X%08X.bin", HashString(key, 2166136261U), HashString(key, 84696351U));
+    return string(fileName);
+}
+
+bool DecodedImageCache::WriteSurfaceFile(const string &filePath, const string &key, SDL_Surface *pSurface)
+{
+    FILE *pFile = fopen(filePath.c_str(), "wb");
+
+    if (pFile == NULL)
+    {
+        return false;
+    }
+
+    Uint32 header[DecodedImageFileHeaderFieldCount];
+
+    header[DecodedImageFileHeaderFieldMagic] = DecodedImageFileMagic;
+    header[DecodedImageFileHeaderFieldVersion] = DecodedImageFileVersion;
+    header[DecodedImageFileHeaderFieldWidth] = (Uint32)pSurface->w;
+    header[DecodedImageFileHeaderFieldHeight] = (Uint32)pSurface->h;
+    header[DecodedImageFileHeaderFieldPitch] = (Uint32)pSurface->pitch;
+    header[DecodedImageFileHeaderFieldPixelFormat] = pSurface->format->format;
+    header[DecodedImageFileHeaderFieldKeyLength] = (Uint32)key.length();
+
+    bool success =
+        fwrite(header, sizeof(header), 1, pFile) == 1 &&
+        fwrite(key.c_str(), 1, key.length(), pFile) == key.length();
+
+    if (success)
+    {
+        bool mustLock = SDL_MUSTLOCK(pSurface);
+
+        if (mustLock)
+        {
+            SDL_LockSurface(pSurface);
+        }
+
+        success = fwrite(pSurface->pixels, pSurface->pitch, pSurface->h, pFile) == (size_t)pSurface->h;
+
+        if (mustLock)
+        {
+            SDL_UnlockSurface(pSurface);
+        }
+    }
+
+    return fclose(pFile) == 0 && success;
+}
+
+void DecodedImageCache::RemoveEntry(const string &fileName)
+{
+    SDL_SemWait(pLock);
+
+    if (entryByFileNameMap.find(fileName) != entryByFileNameMap.end())
+    {
+        EraseEntry(fileName);
+        AppendRemovedFileToIndexFile(fileName);
+    }
+
+    SDL_SemPost(pLock);
+
+    remove((cacheFolderPath + fileName).c_str());
+}
+
+// Expects the lock to be held by the caller.
+void DecodedImageCache::EraseEntry(const string &fileName)
+{
+    map<string, EntryList::iterator>::iterator iter = entryByFileNameMap.find(fileName);
+
+    if (iter != entryByFileNameMap.end())
+    {
+        totalSize -= iter->second->size;
+        entryList.erase(iter->second);
+        entryByFileNameMap.erase(iter);
+        isIndexDirty = true;
+    }
+}
+
+// Expects the lock to be held by the caller.
+void DecodedImageCache::AppendAddedFileToIndexFile(const string &fileName, Uint64 size)
+{
+    ofstream indexStream((cacheFolderPath + DecodedImageCacheIndexFileName).c_str(), ios::app);
+    indexStream << fileName << " " << size << "\n";
+}
+
+// Expects the lock to be held by the caller.
+void DecodedImageCache::AppendRemovedFileToIndexFile(const string &fileName)
+{
+    ofstream indexStream((cacheFolderPath + DecodedImageCacheIndexFileName).c_str(), ios::app);
+    indexStream << DecodedImageCacheIndexRemovedPrefix << fileName << "\n";
+}
+
+// Expects the lock to be held by the caller.
+void DecodedImageCache::AddEntry(const string &fileName, Uint64 size)
+{
+    Entry entry;
+
+    entry.fileName = fileName;
+    entry.size = size;
+
+    entryByFileNameMap[fileName] = entryList.insert(entryList.end(), entry);
+    totalSize += size;
+    isIndexDirty = true;
+}
+
+// Expects the lock to be held by the caller.
+void DecodedImageCache::EvictLeastRecentlyUsed(vector<string> *pFileNamesToRemove)
+{
+    // We'll always keep the most recently used image, even if it's bigger than the limit on its own.
+    while (totalSize > maxSize && entryList.size() > 1)
+    {
+        Entry &oldestEntry = entryList.front();
+
+        pFileNamesToRemove->push_back(oldestEntry.fileName);
+        AppendRemovedFileToIndexFile(oldestEntry.fileName);
+        totalSize -= oldestEntry.size;
+        entryByFileNameMap.erase(oldestEntry.fileName);
+        entryList.pop_front();
+        isIndexDirty = true;
+    }
+}
+
+void DecodedImageCache::RemoveFiles(const vector<string> &fileNameList)
+{
+    for (unsigned int i = 0; i < fileNameList.size(); i++)
+    {
+        remove((cacheFolderPath + fileNameList[i]).c_str());
+    }
+}
@@ -0,0 +1,100 @@
+/**
+ * Basic header/include file for DecodedImageCache.cpp.
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef DECODEDIMAGECACHE_H
+#define DECODEDIMAGECACHE_H
+
+#include <SDL2/SDL.h>
+
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// The most disk space we'll let the decoded image cache take up.
+const Uint64 MaxDecodedImageCacheSize = 1024 * 1024 * 1024;
+
+// Keeps decoded images on disk, so that the next time we need one we can read its pixels
+// straight into a surface instead of extracting and decoding the original image all over again.
+// Each image is stored in its own file, named after a hash of its key, holding the raw surface pixels.
+// Keys should change whenever the contents of the original image do.
+// Once the cache grows past its size limit, the least recently used images are deleted to make room.
+// Images are noted in the index on disk as they're added and removed, so that the index stays complete
+// even if we never get the chance to save it, though how recently each one was used may be out of date.
+// Images can be loaded and saved on any number of threads at once.
+class DecodedImageCache
+{
+public:
+    DecodedImageCache();
+    ~DecodedImageCache();
+
+    void Init(const string &cacheFolderPath, Uint64 maxSize);
+    void SaveIndex();
+
+    SDL_Surface * TryLoadSurface(const string &key);
+    void SaveSurface(const string &key, SDL_Surface *pSurface);
+
+private:
+    class Entry
+    {
+    public:
+        string fileName;
+        Uint64 size;
+    };
+
+    typedef list<Entry> EntryList;
+
+    static string GetFileNameForKey(const string &key);
+    bool WriteSurfaceFile(const string &filePath, const string &key, SDL_Surface *pSurface);
+    void RemoveEntry(const string &fileName);
+    void EraseEntry(const string &fileName);
+    void AddEntry(const string &fileName, Uint64 size);
+    void AppendAddedFileToIndexFile(const string &fileName, Uint64 size);
+    void AppendRemovedFileToIndexFile(const string &fileName);
+    void EvictLeastRecentlyUsed(vector<string> *pFileNamesToRemove);
+    void RemoveFiles(const vector<string> &fileNameList);
+
+    string cacheFolderPath;
+    Uint64 maxSize;
+    bool isInitialized;
+
+    // Ordered from least to most recently used.
+    EntryList entryList;
+    map<string, EntryList::iterator> entryByFileNameMap;
+    set<string> fileNamesBeingWrittenSet;
+    Uint64 totalSize;
+    bool isIndexDirty;
+
+    SDL_sem *pLock;
+};
+
+#endif
@@ -124,6 +124,7 @@ string casesPath;
 string userAppDataPath;
 string dialogSeenListsPath;
 string savesPath;
+string decodedImageCachePath;
 
 string executionPath;
 
@@ -174,6 +175,15 @@ void LoadFilePathsAndCaseUuids(string executableFilePath)
             if (ftyp == INVALID_FILE_ATTRIBUTES) CreateDirectory(szPath, NULL);
             savesPath = TStringToString(tstring(szPath));
         }
+
+        if (SUCCEEDED(SHGetFolderPath(NULL, CSIDL_APPDATA, NULL, 0, szPath)))
+        {
+            PathAppend(szPath, TEXT("\\My Little Investigations\\"));
+            PathAppend(szPath, TEXT("DecodedImageCache\\"));
+            DWORD ftyp = GetFileAttributes(szPath);
+            if (ftyp == INVALID_FILE_ATTRIBUTES) CreateDirectory(szPath, NULL);
+            decodedImageCachePath = TStringToString(tstring(szPath));
+        }
 #elif defined(__OSX)
         pathSeparator = "/";
         otherPathSeparator = "\\";
@@ -186,6 +196,8 @@ void LoadFilePathsAndCaseUuids(string executableFilePath)
         userAppDataPath = string(pUserApplicationSupportPath);
         dialogSeenListsPath = string(pDialogSeenListsPath);
         savesPath = string(pSavesPath);
+        decodedImageCachePath = userAppDataPath + "/DecodedImageCache/";
+        mkdir(decodedImageCachePath.c_str(), 0700);
 #else
         pathSeparator = "/";
         otherPathSeparator = "\\";
@@ -206,6 +218,8 @@ void LoadFilePathsAndCaseUuids(string executableFilePath)
         ensure_dir(dialogSeenListsPath);
         savesPath = userAppDataPath+"/Saves";
         ensure_dir(savesPath);
+        decodedImageCachePath = userAppDataPath+"/DecodedImageCache/";
+        ensure_dir(decodedImageCachePath);
 #endif
 
     executableFilePath = ConvertSeparatorsInPath(executableFilePath);
@@ -543,6 +557,9 @@ void SaveConfigurations()
     configWriter.WriteDoubleElement("BackgroundMusicVolume", gBackgroundMusicVolume);
     configWriter.WriteDoubleElement("SoundEffectsVolume", gSoundEffectsVolume);
     configWriter.WriteDoubleElement("VoiceVolume", gVoiceVolume);
+    configWriter.WriteIntElement("TextureMemoryBudgetMegabytes", gTextureMemoryBudgetMegabytes);
+    configWriter.WriteIntElement("VideoDecodeThreadBudget", gVideoDecodeThreadBudget);
+    configWriter.WriteIntElement("MaxCachedVideoMegabytes", gMaxCachedVideoMegabytes);
     configWriter.EndElement();
 }
 
@@ -561,6 +578,9 @@ void LoadConfigurations()
             double backgroundMusicVolume = gBackgroundMusicVolume;
             double soundEffectsVolume = gSoundEffectsVolume;
             double voiceVolume = gVoiceVolume;
+            int textureMemoryBudgetMegabytes = gTextureMemoryBudgetMegabytes;
+            int videoDecodeThreadBudget = gVideoDecodeThreadBudget;
+            int maxCachedVideoMegabytes = gMaxCachedVideoMegabytes;
 
             XmlReader configReader(GetConfigFilePath().c_str());
 
@@ -605,6 +625,44 @@ void LoadConfigurations()
                     voiceVolume = configReader.ReadDoubleElement("VoiceVolume");
                 }
 
+                if (configReader.ElementExists("TextureMemoryBudgetMegabytes"))
+                {
+                    textureMemoryBudgetMegabytes = configReader.ReadIntElement("TextureMemoryBudgetMegabytes");
+
+                    if (textureMemoryBudgetMegabytes <= 0)
+                    {
+                        textureMemoryBudgetMegabytes = gTextureMemoryBudgetMegabytesDefault;
+                    }
+                    else if (textureMemoryBudgetMegabytes < MinTextureMemoryBudgetMegabytes)
+                    {
+                        textureMemoryBudgetMegabytes = MinTextureMemoryBudgetMegabytes;
+                    }
+                }
+
+                if (configReader.ElementExists("VideoDecodeThreadBudget"))
+                {
+                    videoDecodeThreadBudget = configReader.ReadIntElement("VideoDecodeThreadBudget");
+
+                    if (videoDecodeThreadBudget < 0)
+                    {
+                        videoDecodeThreadBudget = gVideoDecodeThreadBudgetDefault;
+                    }
+                }
+
+                if (configReader.ElementExists("MaxCachedVideoMegabytes"))
+                {
+                    maxCachedVideoMegabytes = configReader.ReadIntElement("MaxCachedVideoMegabytes");
+
+                    if (maxCachedVideoMegabytes < 0)
+                    {
+                        maxCachedVideoMegabytes = gMaxCachedVideoMegabytesDefault;
+                    }
+                    else if (maxCachedVideoMegabytes > MaxCachedVideoMegabytesLimit)
+                    {
+                        maxCachedVideoMegabytes = MaxCachedVideoMegabytesLimit;
+                    }
+                }
+
                 configReader.EndElement();
             }
 
@@ -617,6 +675,9 @@ void LoadConfigurations()
             gBackgroundMusicVolume = backgroundMusicVolume;
             gSoundEffectsVolume = soundEffectsVolume;
             gVoiceVolume = voiceVolume;
+            gTextureMemoryBudgetMegabytes = textureMemoryBudgetMegabytes;
+            gVideoDecodeThreadBudget = videoDecodeThreadBudget;
+            gMaxCachedVideoMegabytes = maxCachedVideoMegabytes;
         }
         catch (ticpp::Exception e)
         {
@@ -878,6 +939,11 @@ void LoadDialogsSeenListForCase(string caseUuid)
     }
 }
 
+string GetDecodedImageCacheFolderPath()
+{
+    return decodedImageCachePath;
+}
+
 bool CheckForExistingInstance()
 {
     bool existingInstanceExists = false;
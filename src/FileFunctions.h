@@ -88,6 +88,8 @@ bool DialogsSeenListFileExistsForCase(string caseUuid);
 void SaveDialogsSeenListForCase(string caseUuid);
 void LoadDialogsSeenListForCase(string caseUuid);
 
+string GetDecodedImageCacheFolderPath();
+
 bool CheckForExistingInstance();
 #endif
 
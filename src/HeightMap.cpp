@@ -32,6 +32,7 @@
 #include "Polygon.h"
 #include "Rectangle.h"
 #include <math.h>
+#include <algorithm>
 
 HeightMap * HeightMap::LoadFromXml(XmlReader *pReader)
 {
@@ -42,9 +43,125 @@ HeightMap * HeightMap::LoadFromXml(XmlReader *pReader)
         pHeightMap = new ParabolicHeightMap(pReader);
     }
 
+    if (pHeightMap != NULL)
+    {
+        pHeightMap->Bake();
+    }
+
     return pHeightMap;
 }
 
+bool HeightMap::IsPointInBoundingPolygon(Vector2 point)
+{
+    double column = (point.GetX() - bakedBounds.GetX()) / HeightMapBakeCellSize;
+    double row = (point.GetY() - bakedBounds.GetY()) / HeightMapBakeCellSize;
+
+    if (bakedCellContainmentList.empty() || column < 0 || column > bakedColumnCount || row < 0 || row > bakedRowCount)
+    {
+        return boundingPolygon.Contains(point);
+    }
+
+    // Cells that an edge passes through are the only ones where the answer can vary,
+    // so we only need to go to the polygon itself for those.
+    int cellColumn = min((int)column, bakedColumnCount - 1);
+    int cellRow = min((int)row, bakedRowCount - 1);
+
+    switch (bakedCellContainmentList[cellRow * bakedColumnCount + cellColumn])
+    {
+    case BakedCellContainmentInside:
+        return true;
+
+    case BakedCellContainmentOutside:
+        return false;
+
+    default:
+        return boundingPolygon.Contains(point);
+    }
+}
+
+int HeightMap::GetHeightAtPoint(Vector2 point)
+{
+    double column = (point.GetX() - bakedBounds.GetX()) / HeightMapBakeCellSize;
+    double row = (point.GetY() - bakedBounds.GetY()) / HeightMapBakeCellSize;
+
+    if (bakedHeightList.empty() || column < 0 || column > bakedColumnCount || row < 0 || row > bakedRowCount)
+    {
+        return (int)floor(0.5 + CalculateHeightAtPoint(point));
+    }
+
+    int cellColumn = min((int)column, bakedColumnCount - 1);
+    int cellRow = min((int)row, bakedRowCount - 1);
+    double columnFraction = column - cellColumn;
+    double rowFraction = row - cellRow;
+    int stride = bakedColumnCount + 1;
+    int topLeftIndex = cellRow * stride + cellColumn;
+
+    double topHeight = bakedHeightList[topLeftIndex] * (1 - columnFraction) + bakedHeightList[topLeftIndex + 1] * columnFraction;
+    double bottomHeight = bakedHeightList[topLeftIndex + stride] * (1 - columnFraction) + bakedHeightList[topLeftIndex + stride + 1] * columnFraction;
+
+    return (int)floor(0.5 + topHeight * (1 - rowFraction) + bottomHeight * rowFraction);
+}
+
+void HeightMap::Bake()
+{
+    ClearBake();
+
+    RectangleWH boundingBox = boundingPolygon.GetBoundingBox();
+
+    bakedColumnCount = max((int)ceil(boundingBox.GetWidth() / HeightMapBakeCellSize), 1);
+    bakedRowCount = max((int)ceil(boundingBox.GetHeight() / HeightMapBakeCellSize), 1);
+    bakedBounds = RectangleWH(boundingBox.GetX(), boundingBox.GetY(), bakedColumnCount * HeightMapBakeCellSize, bakedRowCount * HeightMapBakeCellSize);
+
+    vector<float> heightList;
+    vector<unsigned char> cellContainmentList;
+
+    heightList.reserve((bakedColumnCount + 1) * (bakedRowCount + 1));
+
+    for (int row = 0; row <= bakedRowCount; row++)
+    {
+        for (int column = 0; column <= bakedColumnCount; column++)
+        {
+            Vector2 point(bakedBounds.GetX() + column * HeightMapBakeCellSize, bakedBounds.GetY() + row * HeightMapBakeCellSize);
+            heightList.push_back((float)CalculateHeightAtPoint(point));
+        }
+    }
+
+    cellContainmentList.reserve(bakedColumnCount * bakedRowCount);
+
+    for (int row = 0; row < bakedRowCount; row++)
+    {
+        for (int column = 0; column < bakedColumnCount; column++)
+        {
+            RectangleWH cellRect(bakedBounds.GetX() + column * HeightMapBakeCellSize, bakedBounds.GetY() + row * HeightMapBakeCellSize, HeightMapBakeCellSize, HeightMapBakeCellSize);
+
+            if (boundingPolygon.EdgesIntersect(cellRect))
+            {
+                cellContainmentList.push_back(BakedCellContainmentEdge);
+            }
+            else if (boundingPolygon.Contains(Vector2(cellRect.GetX() + cellRect.GetWidth() / 2, cellRect.GetY() + cellRect.GetHeight() / 2)))
+            {
+                cellContainmentList.push_back(BakedCellContainmentInside);
+            }
+            else
+            {
+                cellContainmentList.push_back(BakedCellContainmentOutside);
+            }
+        }
+    }
+
+    bakedHeightList.swap(heightList);
+    bakedCellContainmentList.swap(cellContainmentList);
+}
+
+void HeightMap::ClearBake()
+{
+    bakedColumnCount = 0;
+    bakedRowCount = 0;
+
+    bakedHeightList.clear();
+    bakedCellContainmentList.clear();
+}
+
 Vector2 HeightMap::GetBasePointOffsetFromHeightenedPoint(Vector2 point)
 {
     // Since the function assigning heightened points to base points can sometimes
@@ -119,7 +236,7 @@ ParabolicHeightMap::ParabolicHeightMap(XmlReader *pReader)
     pReader->EndElement();
 }
 
-int ParabolicHeightMap::GetHeightAtPoint(Vector2 point)
+double ParabolicHeightMap::CalculateHeightAtPoint(Vector2 point)
 {
     Line characterDirectionLine(point, directionVector);
 
@@ -140,14 +257,14 @@ int ParabolicHeightMap::GetHeightAtPoint(Vector2 point)
         double normalizedDistance = distanceToHeightLine1 / (distanceToHeightLine1 + distanceToHeightLine2);
         double weight = (1 - normalizedDistance) * (1 - normalizedDistance);
 
-        return (int)floor(0.5 + heightLine1.GetHeightAtLine() * weight + heightLine2.GetHeightAtLine() * (1 - weight));
+        return heightLine1.GetHeightAtLine() * weight + heightLine2.GetHeightAtLine() * (1 - weight);
     }
     else
     {
         double normalizedDistance = distanceToHeightLine3 / (distanceToHeightLine3 + distanceToHeightLine2);
         double weight = (1 - normalizedDistance) * (1 - normalizedDistance);
 
-        return (int)floor(0.5 + heightLine3.GetHeightAtLine() * weight + heightLine2.GetHeightAtLine() * (1 - weight));
+        return heightLine3.GetHeightAtLine() * weight + heightLine2.GetHeightAtLine() * (1 - weight);
     }
 }
 
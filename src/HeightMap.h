@@ -32,26 +32,70 @@
 
 #include "Line.h"
 #include "Polygon.h"
+#include <vector>
+
+using namespace std;
+
+// The spacing, in pixels, of the points at which we bake height map values.
+const int HeightMapBakeCellSize = 2;
 
 class HeightMap
 {
 public:
+    HeightMap()
+    {
+        bakedColumnCount = 0;
+        bakedRowCount = 0;
+    }
+
     virtual ~HeightMap() {}
 
-    bool IsPointInBoundingPolygon(Vector2 point) { return this->boundingPolygon.Contains(point); }
-    void SetDirectionVector(Vector2 directionVector) { this->directionVector = directionVector.Normalize(); }
-    void SetBoundingPolygon(GeometricPolygon boundingPolygon) { this->boundingPolygon = boundingPolygon; }
+    bool IsPointInBoundingPolygon(Vector2 point);
+
+    // If the height map has been baked, these rebuild the baked tables to match.
+    void SetDirectionVector(Vector2 directionVector) { this->directionVector = directionVector.Normalize(); RebakeIfBaked(); }
+    void SetBoundingPolygon(GeometricPolygon boundingPolygon) { this->boundingPolygon = boundingPolygon; RebakeIfBaked(); }
 
-    virtual int GetHeightAtPoint(Vector2 point) = 0;
+    int GetHeightAtPoint(Vector2 point);
     Vector2 GetBasePointOffsetFromHeightenedPoint(Vector2 point);
     static HeightMap * LoadFromXml(XmlReader *pReader);
 
+    void Bake();
+    void ClearBake();
+    bool IsBaked() { return bakedColumnCount > 0; }
+
 protected:
+    virtual double CalculateHeightAtPoint(Vector2 point) = 0;
     virtual int GetHighestHeight() = 0;
     void LoadFromXmlCore(XmlReader *pReader);
 
     Vector2 directionVector;
     GeometricPolygon boundingPolygon;
+
+private:
+    void RebakeIfBaked()
+    {
+        if (IsBaked())
+        {
+            Bake();
+        }
+    }
+
+    enum BakedCellContainment
+    {
+        BakedCellContainmentOutside,
+        BakedCellContainmentInside,
+        BakedCellContainmentEdge,
+    };
+
+    // Heights are baked at the corners of a grid of cells covering the bounding polygon,
+    // and are interpolated between them.
+    RectangleWH bakedBounds;
+    int bakedColumnCount;
+    int bakedRowCount;
+
+    vector<float> bakedHeightList;
+    vector<unsigned char> bakedCellContainmentList;
 };
 
 class ParabolicHeightMap : public HeightMap
@@ -59,9 +103,8 @@ class ParabolicHeightMap : public HeightMap
 public:
     ParabolicHeightMap(XmlReader *pReader);
 
-    virtual int GetHeightAtPoint(Vector2 point);
-
 protected:
+    virtual double CalculateHeightAtPoint(Vector2 point);
     virtual int GetHighestHeight();
 
     class HeightLine : public Line
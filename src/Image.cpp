@@ -46,11 +46,24 @@ vector<Image *> Image::deletedSpriteList;
 SDL_sem *Image::pSpriteListSemaphore = SDL_CreateSemaphore(1);
 bool Image::isReloadingSprites = false;
 
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_DRAW_CALLS
+    unsigned int Image::drawCallCount = 0;
+    unsigned int Image::textureSwitchCount = 0;
+    SDL_Texture *Image::pLastDrawnTexture = NULL;
+    #endif
+#endif
+
 Image::Image(void)
 {
     valid = false;
     pSurface = NULL;
     pTexture = NULL;
+    pAtlasPage = NULL;
+    atlasRect.x = 0;
+    atlasRect.y = 0;
+    atlasRect.w = 0;
+    atlasRect.h = 0;
     width = 0;
     height = 0;
     pSource = NULL;
@@ -176,8 +189,18 @@ void Image::LoadTextures()
         pTexture = NULL;
     }
 
-    pTexture = SDL_CreateTextureFromSurface(gpRenderer, pSurface);
-    SDL_SetTextureBlendMode(pTexture, SDL_BLENDMODE_BLEND);
+    if (pAtlasPage != NULL)
+    {
+        TextureAtlas::Remove(pAtlasPage, atlasRect);
+        pAtlasPage = NULL;
+    }
+
+    if (!TextureAtlas::TryAdd(pSurface, &pAtlasPage, &atlasRect))
+    {
+        pAtlasPage = NULL;
+        pTexture = SDL_CreateTextureFromSurface(gpRenderer, pSurface);
+        SDL_SetTextureBlendMode(pTexture, SDL_BLENDMODE_BLEND);
+    }
 
     SDL_FreeSurface(pSurface);
     pSurface = NULL;
@@ -204,6 +227,12 @@ void Image::UnloadTextures()
         SDL_DestroyTexture(pTexture);
         pTexture = NULL;
     }
+
+    if (pAtlasPage != NULL)
+    {
+        TextureAtlas::Remove(pAtlasPage, atlasRect);
+        pAtlasPage = NULL;
+    }
 }
 
 void Image::ReloadFromSource()
@@ -255,7 +284,38 @@ void Image::Draw(
         return;
     }
 
-    Image::Draw(pTexture, position, clipRect, flipHorizontally, flipVertically, scale, color);
+    if (pAtlasPage != NULL)
+    {
+        // A texture of our own would have had anything outside of the image clipped off for us,
+        // but in the atlas page, anything outside of the image belongs to other images.
+        double left = max(clipRect.GetX(), 0.0);
+        double top = max(clipRect.GetY(), 0.0);
+        double right = min(clipRect.GetX() + clipRect.GetWidth(), (double)atlasRect.w);
+        double bottom = min(clipRect.GetY() + clipRect.GetHeight(), (double)atlasRect.h);
+
+        if (right <= left || bottom <= top)
+        {
+            return;
+        }
+
+        // Whatever we clipped off the near side of the image moves it along on screen to match,
+        // where the near side is the far side if we're flipping it.
+        double clippedLeft = left - clipRect.GetX();
+        double clippedTop = top - clipRect.GetY();
+        double clippedRight = clipRect.GetX() + clipRect.GetWidth() - right;
+        double clippedBottom = clipRect.GetY() + clipRect.GetHeight() - bottom;
+
+        position.SetX(position.GetX() + (flipHorizontally ? clippedRight : clippedLeft) * scale);
+        position.SetY(position.GetY() + (flipVertically ? clippedBottom : clippedTop) * scale);
+
+        clipRect = RectangleWH(left + atlasRect.x, top + atlasRect.y, right - left, bottom - top);
+
+        Image::Draw(pAtlasPage->GetTexture(), position, clipRect, flipHorizontally, flipVertically, scale, color);
+    }
+    else
+    {
+        Image::Draw(pTexture, position, clipRect, flipHorizontally, flipVertically, scale, color);
+    }
 }
 
 void Image::Draw(
@@ -388,11 +448,34 @@ void Image::Draw(
         flags = (SDL_RendererFlip)(flags | SDL_FLIP_VERTICAL);
     }
 
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_DRAW_CALLS
+    drawCallCount++;
+
+    if (pTexture != pLastDrawnTexture)
+    {
+        textureSwitchCount++;
+        pLastDrawnTexture = pTexture;
+    }
+    #endif
+#endif
+
     SDL_SetTextureColorMod(pTexture, color.GetIntR(), color.GetIntG(), color.GetIntB());
     SDL_SetTextureAlphaMod(pTexture, color.GetIntA());
     SDL_RenderCopyEx(gpRenderer, pTexture, &srcRect, &dstRect, 0, NULL, flags);
 }
 
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_DRAW_CALLS
+void Image::ResetDrawStatistics()
+{
+    drawCallCount = 0;
+    textureSwitchCount = 0;
+    pLastDrawnTexture = NULL;
+}
+    #endif
+#endif
+
 void Image::ResourceLoaderSource::DoReload()
 {
 #ifdef GAME_EXECUTABLE
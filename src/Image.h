@@ -42,6 +42,7 @@
 
 #include "Color.h"
 #include "Rectangle.h"
+#include "TextureAtlas.h"
 #include "Vector2.h"
 #include "Video.h"
 
@@ -91,6 +92,14 @@ public:
         double scale,
         Color color);
 
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_DRAW_CALLS
+    static unsigned int GetDrawCallCount() { return drawCallCount; }
+    static unsigned int GetTextureSwitchCount() { return textureSwitchCount; }
+    static void ResetDrawStatistics();
+    #endif
+#endif
+
     Uint16 width;
     Uint16 height;
 
@@ -101,10 +110,23 @@ private:
     static SDL_sem *pSpriteListSemaphore;
     static bool isReloadingSprites;
 
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_DRAW_CALLS
+    static unsigned int drawCallCount;
+    static unsigned int textureSwitchCount;
+    static SDL_Texture *pLastDrawnTexture;
+    #endif
+#endif
+
     bool valid;
     SDL_Surface *pSurface;
     SDL_Texture *pTexture;
 
+    // Small images are packed into a texture atlas instead of getting a texture of their own,
+    // in which case this is the atlas page they're in and where they are in it.
+    TextureAtlasPage *pAtlasPage;
+    SDL_Rect atlasRect;
+
     class Source
     {
     public:
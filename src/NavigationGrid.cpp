@@ -0,0 +1,472 @@
+/**
+ * Caches static collision information for pathfinding in a location.
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "NavigationGrid.h"
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+// Cells are only classified as entirely free or entirely blocked
+// if that remains true when shrunk or grown by this much.
+// This is deliberately larger than the tolerance used by IsIntervalIntersection.
+const double CellClassificationTolerance = 0.05;
+
+namespace
+{
+    double Cross(Vector2 origin, Vector2 a, Vector2 b)
+    {
+        return (a.GetX() - origin.GetX()) * (b.GetY() - origin.GetY()) - (a.GetY() - origin.GetY()) * (b.GetX() - origin.GetX());
+    }
+
+    bool CompareByXThenY(const Vector2 &a, const Vector2 &b)
+    {
+        return a.GetX() < b.GetX() || (a.GetX() == b.GetX() && a.GetY() < b.GetY());
+    }
+
+    // Computes the convex hull of the given points using Andrew's monotone chain algorithm.
+    vector<Vector2> GetConvexHull(vector<Vector2> points)
+    {
+        sort(points.begin(), points.end(), CompareByXThenY);
+
+        vector<Vector2> hull(2 * points.size());
+        int hullCount = 0;
+
+        for (unsigned int i = 0; i < points.size(); i++)
+        {
+            while (hullCount >= 2 && Cross(hull[hullCount - 2], hull[hullCount - 1], points[i]) <= 0)
+            {
+                hullCount--;
+            }
+
+            hull[hullCount++] = points[i];
+        }
+
+        for (int i = (int)points.size() - 2, lowerHullCount = hullCount + 1; i >= 0; i--)
+        {
+            while (hullCount >= lowerHullCount && Cross(hull[hullCount - 2], hull[hullCount - 1], points[i]) <= 0)
+            {
+                hullCount--;
+            }
+
+            hull[hullCount++] = points[i];
+        }
+
+        hull.resize(hullCount > 1 ? hullCount - 1 : hullCount);
+        return hull;
+    }
+
+    // Gets the horizontal extent of the given convex polygon along the horizontal line at y.
+    bool GetPolygonSpanAtY(const vector<Vector2> &polygon, double y, double *pMinX, double *pMaxX)
+    {
+        double minX = numeric_limits<double>::infinity();
+        double maxX = -numeric_limits<double>::infinity();
+
+        for (unsigned int i = 0; i < polygon.size(); i++)
+        {
+            Vector2 start = polygon[i];
+            Vector2 end = polygon[(i + 1) % polygon.size()];
+
+            if ((start.GetY() <= y && end.GetY() >= y) || (start.GetY() >= y && end.GetY() <= y))
+            {
+                if (start.GetY() == end.GetY())
+                {
+                    minX = min(minX, min(start.GetX(), end.GetX()));
+                    maxX = max(maxX, max(start.GetX(), end.GetX()));
+                }
+                else
+                {
+                    double x = start.GetX() + (end.GetX() - start.GetX()) * (y - start.GetY()) / (end.GetY() - start.GetY());
+                    minX = min(minX, x);
+                    maxX = max(maxX, x);
+                }
+            }
+        }
+
+        *pMinX = minX;
+        *pMaxX = maxX;
+        return minX <= maxX;
+    }
+
+    // Gets the horizontal extent of the part of the given convex polygon
+    // that lies between the horizontal lines at top and bottom.
+    bool GetPolygonExtentInStrip(const vector<Vector2> &polygon, double top, double bottom, double *pMinX, double *pMaxX)
+    {
+        double minX = numeric_limits<double>::infinity();
+        double maxX = -numeric_limits<double>::infinity();
+        double spanMinX = 0;
+        double spanMaxX = 0;
+
+        for (unsigned int i = 0; i < polygon.size(); i++)
+        {
+            if (polygon[i].GetY() >= top && polygon[i].GetY() <= bottom)
+            {
+                minX = min(minX, polygon[i].GetX());
+                maxX = max(maxX, polygon[i].GetX());
+            }
+        }
+
+        if (GetPolygonSpanAtY(polygon, top, &spanMinX, &spanMaxX))
+        {
+            minX = min(minX, spanMinX);
+            maxX = max(maxX, spanMaxX);
+        }
+
+        if (GetPolygonSpanAtY(polygon, bottom, &spanMinX, &spanMaxX))
+        {
+            minX = min(minX, spanMinX);
+            maxX = max(maxX, spanMaxX);
+        }
+
+        *pMinX = minX;
+        *pMaxX = maxX;
+        return minX <= maxX;
+    }
+
+    vector<vector<Vector2> > GetWorldSpacePolygons(HitBox *pHitBox, Vector2 hitBoxOffset)
+    {
+        vector<vector<Vector2> > polygons;
+
+        if (pHitBox == NULL)
+        {
+            return polygons;
+        }
+
+        vector<CollidableObject *> *pCollidableObjects = pHitBox->GetCollidableObjects();
+
+        for (unsigned int i = 0; i < pCollidableObjects->size(); i++)
+        {
+            CollidableObject *pCollidableObject = (*pCollidableObjects)[i];
+            vector<Vector2> *pVertices = pCollidableObject->GetVertices();
+            vector<Vector2> polygon;
+
+            for (unsigned int j = 0; j < pVertices->size(); j++)
+            {
+                polygon.push_back(hitBoxOffset + pCollidableObject->GetPosition() + (*pVertices)[j]);
+            }
+
+            polygons.push_back(polygon);
+        }
+
+        return polygons;
+    }
+}
+
+NavigationGrid::NavigationGrid(HitBox *pFootprintHitBox, RectangleWH bounds)
+{
+    footprintPolygons = GetWorldSpacePolygons(pFootprintHitBox, Vector2(0, 0));
+
+    double footprintLeft = 0;
+    double footprintTop = 0;
+    double footprintRight = 0;
+    double footprintBottom = 0;
+
+    for (unsigned int i = 0; i < footprintPolygons.size(); i++)
+    {
+        for (unsigned int j = 0; j < footprintPolygons[i].size(); j++)
+        {
+            footprintLeft = min(footprintLeft, footprintPolygons[i][j].GetX());
+            footprintTop = min(footprintTop, footprintPolygons[i][j].GetY());
+            footprintRight = max(footprintRight, footprintPolygons[i][j].GetX());
+            footprintBottom = max(footprintBottom, footprintPolygons[i][j].GetY());
+        }
+    }
+
+    // The grid is in terms of the footprint's position, so we'll cover every position
+    // at which the footprint would overlap the given bounds.
+    originX = floor(bounds.GetX() - footprintRight);
+    originY = floor(bounds.GetY() - footprintBottom);
+    gridWidth = (int)ceil((bounds.GetX() + bounds.GetWidth() - footprintLeft - originX) / NavigationGridCellSize) + 1;
+    gridHeight = (int)ceil((bounds.GetY() + bounds.GetHeight() - footprintTop - originY) / NavigationGridCellSize) + 1;
+
+    blockedBits.resize((gridWidth * gridHeight + 31) / 32, 0);
+    touchedBits.resize((gridWidth * gridHeight + 31) / 32, 0);
+}
+
+int NavigationGrid::AddLayer(HitBox *pHitBox, Vector2 hitBoxOffset, bool isEnabled)
+{
+    Layer layer;
+    layer.isEnabled = isEnabled;
+
+    vector<vector<Vector2> > layerPolygons = GetWorldSpacePolygons(pHitBox, hitBoxOffset);
+    vector<vector<Vector2> > minkowskiPolygons;
+
+    double left = numeric_limits<double>::infinity();
+    double top = numeric_limits<double>::infinity();
+    double right = -numeric_limits<double>::infinity();
+    double bottom = -numeric_limits<double>::infinity();
+
+    // The footprint collides with a convex polygon exactly when its position lies
+    // within the Minkowski difference of that polygon and the footprint's own polygons,
+    // which is just the convex hull of the differences of their vertices.
+    for (unsigned int i = 0; i < layerPolygons.size(); i++)
+    {
+        for (unsigned int j = 0; j < footprintPolygons.size(); j++)
+        {
+            vector<Vector2> differences;
+
+            for (unsigned int k = 0; k < layerPolygons[i].size(); k++)
+            {
+                for (unsigned int l = 0; l < footprintPolygons[j].size(); l++)
+                {
+                    Vector2 difference = layerPolygons[i][k] - footprintPolygons[j][l];
+
+                    left = min(left, difference.GetX());
+                    top = min(top, difference.GetY());
+                    right = max(right, difference.GetX());
+                    bottom = max(bottom, difference.GetY());
+
+                    differences.push_back(difference);
+                }
+            }
+
+            if (differences.size() >= 3)
+            {
+                minkowskiPolygons.push_back(GetConvexHull(differences));
+            }
+        }
+    }
+
+    if (!minkowskiPolygons.empty())
+    {
+        int cellLeft = max(0, (int)floor((left - CellClassificationTolerance - originX) / NavigationGridCellSize));
+        int cellTop = max(0, (int)floor((top - CellClassificationTolerance - originY) / NavigationGridCellSize));
+        int cellRight = min(gridWidth - 1, (int)floor((right + CellClassificationTolerance - originX) / NavigationGridCellSize));
+        int cellBottom = min(gridHeight - 1, (int)floor((bottom + CellClassificationTolerance - originY) / NavigationGridCellSize));
+
+        if (cellRight >= cellLeft && cellBottom >= cellTop)
+        {
+            layer.cellLeft = cellLeft;
+            layer.cellTop = cellTop;
+            layer.cellWidth = cellRight - cellLeft + 1;
+            layer.cellHeight = cellBottom - cellTop + 1;
+            layer.blockedBits.resize((layer.cellWidth * layer.cellHeight + 31) / 32, 0);
+            layer.touchedBits.resize((layer.cellWidth * layer.cellHeight + 31) / 32, 0);
+
+            for (unsigned int i = 0; i < minkowskiPolygons.size(); i++)
+            {
+                RasterizePolygon(&layer, minkowskiPolygons[i]);
+            }
+        }
+    }
+
+    layerList.push_back(layer);
+
+    if (layer.isEnabled)
+    {
+        ComposeCells(layer.cellLeft, layer.cellTop, layer.cellWidth, layer.cellHeight);
+    }
+
+    return (int)layerList.size() - 1;
+}
+
+void NavigationGrid::SetLayerEnabled(int layerIndex, bool isEnabled)
+{
+    Layer *pLayer = &layerList[layerIndex];
+
+    if (pLayer->isEnabled != isEnabled)
+    {
+        pLayer->isEnabled = isEnabled;
+        ComposeCells(pLayer->cellLeft, pLayer->cellTop, pLayer->cellWidth, pLayer->cellHeight);
+    }
+}
+
+NavigationGridCellState NavigationGrid::GetCellState(Vector2 position, int excludedLayerIndex) const
+{
+    int cellX = 0;
+    int cellY = 0;
+
+    if (!GetCellCoordinates(position, &cellX, &cellY))
+    {
+        return NavigationGridCellStateUnknown;
+    }
+
+    if (excludedLayerIndex < 0 || !layerList[excludedLayerIndex].ContainsCell(cellX, cellY))
+    {
+        int bitIndex = cellY * gridWidth + cellX;
+
+        if (GetBit(blockedBits, bitIndex))
+        {
+            return NavigationGridCellStateBlocked;
+        }
+        else if (GetBit(touchedBits, bitIndex))
+        {
+            return NavigationGridCellStateUnknown;
+        }
+        else
+        {
+            return NavigationGridCellStateFree;
+        }
+    }
+
+    // The excluded layer covers this cell, so we can't use the composed bits -
+    // instead we'll check each of the other layers individually.
+    NavigationGridCellState cellState = NavigationGridCellStateFree;
+
+    for (unsigned int i = 0; i < layerList.size(); i++)
+    {
+        const Layer &layer = layerList[i];
+
+        if ((int)i == excludedLayerIndex || !layer.isEnabled || !layer.ContainsCell(cellX, cellY))
+        {
+            continue;
+        }
+
+        int bitIndex = layer.GetBitIndex(cellX, cellY);
+
+        if (GetBit(layer.blockedBits, bitIndex))
+        {
+            return NavigationGridCellStateBlocked;
+        }
+        else if (GetBit(layer.touchedBits, bitIndex))
+        {
+            cellState = NavigationGridCellStateUnknown;
+        }
+    }
+
+    return cellState;
+}
+
+void NavigationGrid::RasterizePolygon(Layer *pLayer, const vector<Vector2> &polygon)
+{
+    double polygonTop = numeric_limits<double>::infinity();
+    double polygonBottom = -numeric_limits<double>::infinity();
+
+    for (unsigned int i = 0; i < polygon.size(); i++)
+    {
+        polygonTop = min(polygonTop, polygon[i].GetY());
+        polygonBottom = max(polygonBottom, polygon[i].GetY());
+    }
+
+    for (int cellY = pLayer->cellTop; cellY < pLayer->cellTop + pLayer->cellHeight; cellY++)
+    {
+        double rowTop = originY + cellY * NavigationGridCellSize;
+        double rowBottom = rowTop + NavigationGridCellSize;
+        double touchedMinX = 0;
+        double touchedMaxX = 0;
+
+        if (!GetPolygonExtentInStrip(polygon, rowTop - CellClassificationTolerance, rowBottom + CellClassificationTolerance, &touchedMinX, &touchedMaxX))
+        {
+            continue;
+        }
+
+        int touchedCellLeft = max(pLayer->cellLeft, (int)floor((touchedMinX - CellClassificationTolerance - originX) / NavigationGridCellSize));
+        int touchedCellRight = min(pLayer->cellLeft + pLayer->cellWidth - 1, (int)floor((touchedMaxX + CellClassificationTolerance - originX) / NavigationGridCellSize));
+
+        for (int cellX = touchedCellLeft; cellX <= touchedCellRight; cellX++)
+        {
+            SetBit(pLayer->touchedBits, pLayer->GetBitIndex(cellX, cellY));
+        }
+
+        // A cell is entirely blocked only if the polygon covers the whole row strip
+        // across the cell's width.  Since the polygon is convex, it's enough to check
+        // the spans at the top and bottom of the strip.
+        double topMinX = 0;
+        double topMaxX = 0;
+        double bottomMinX = 0;
+        double bottomMaxX = 0;
+
+        if (polygonTop > rowTop - CellClassificationTolerance ||
+            polygonBottom < rowBottom + CellClassificationTolerance ||
+            !GetPolygonSpanAtY(polygon, rowTop - CellClassificationTolerance, &topMinX, &topMaxX) ||
+            !GetPolygonSpanAtY(polygon, rowBottom + CellClassificationTolerance, &bottomMinX, &bottomMaxX))
+        {
+            continue;
+        }
+
+        double fullMinX = max(topMinX, bottomMinX) + CellClassificationTolerance;
+        double fullMaxX = min(topMaxX, bottomMaxX) - CellClassificationTolerance;
+
+        int blockedCellLeft = max(pLayer->cellLeft, (int)ceil((fullMinX - originX) / NavigationGridCellSize));
+        int blockedCellRight = min(pLayer->cellLeft + pLayer->cellWidth - 1, (int)floor((fullMaxX - originX) / NavigationGridCellSize) - 1);
+
+        for (int cellX = blockedCellLeft; cellX <= blockedCellRight; cellX++)
+        {
+            SetBit(pLayer->blockedBits, pLayer->GetBitIndex(cellX, cellY));
+        }
+    }
+}
+
+void NavigationGrid::ComposeCells(int cellLeft, int cellTop, int cellWidth, int cellHeight)
+{
+    for (int cellY = cellTop; cellY < cellTop + cellHeight; cellY++)
+    {
+        for (int cellX = cellLeft; cellX < cellLeft + cellWidth; cellX++)
+        {
+            int bitIndex = cellY * gridWidth + cellX;
+            bool isBlocked = false;
+            bool isTouched = false;
+
+            for (unsigned int i = 0; i < layerList.size() && !isBlocked; i++)
+            {
+                const Layer &layer = layerList[i];
+
+                if (layer.isEnabled && layer.ContainsCell(cellX, cellY))
+                {
+                    int layerBitIndex = layer.GetBitIndex(cellX, cellY);
+
+                    isBlocked = GetBit(layer.blockedBits, layerBitIndex);
+                    isTouched = isTouched || GetBit(layer.touchedBits, layerBitIndex);
+                }
+            }
+
+            if (isBlocked)
+            {
+                SetBit(blockedBits, bitIndex);
+            }
+            else
+            {
+                ClearBit(blockedBits, bitIndex);
+            }
+
+            if (isTouched)
+            {
+                SetBit(touchedBits, bitIndex);
+            }
+            else
+            {
+                ClearBit(touchedBits, bitIndex);
+            }
+        }
+    }
+}
+
+bool NavigationGrid::GetCellCoordinates(Vector2 position, int *pCellX, int *pCellY) const
+{
+    double cellX = floor((position.GetX() - originX) / NavigationGridCellSize);
+    double cellY = floor((position.GetY() - originY) / NavigationGridCellSize);
+
+    if (cellX < 0 || cellX >= gridWidth || cellY < 0 || cellY >= gridHeight)
+    {
+        return false;
+    }
+
+    *pCellX = (int)cellX;
+    *pCellY = (int)cellY;
+    return true;
+}
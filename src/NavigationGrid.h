@@ -0,0 +1,121 @@
+/**
+ * Basic header/include file for NavigationGrid.cpp.
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NAVIGATIONGRID_H
+#define NAVIGATIONGRID_H
+
+#include "Collisions.h"
+#include "Rectangle.h"
+#include "Vector2.h"
+#include <SDL2/SDL.h>
+#include <vector>
+
+using namespace std;
+
+const double NavigationGridCellSize = 2; // px
+
+enum NavigationGridCellState
+{
+    NavigationGridCellStateFree,
+    NavigationGridCellStateBlocked,
+    NavigationGridCellStateUnknown,
+};
+
+// Caches which positions a given hitbox (the "footprint") can occupy
+// relative to a set of static hitboxes, each of which is stored as a layer.
+// Every cell records whether the footprint collides with the layers at all positions within it,
+// at no positions within it, or at some positions within it - in the last case,
+// the caller will need to fall back to an actual collision test.
+class NavigationGrid
+{
+public:
+    NavigationGrid(HitBox *pFootprintHitBox, RectangleWH bounds);
+
+    int AddLayer(HitBox *pHitBox, Vector2 hitBoxOffset, bool isEnabled = true);
+    void SetLayerEnabled(int layerIndex, bool isEnabled);
+
+    // Returns the state of the cell containing the given footprint position,
+    // ignoring the layer with the given index, if any.
+    NavigationGridCellState GetCellState(Vector2 position, int excludedLayerIndex = -1) const;
+
+private:
+    class Layer
+    {
+    public:
+        Layer()
+        {
+            isEnabled = true;
+            cellLeft = 0;
+            cellTop = 0;
+            cellWidth = 0;
+            cellHeight = 0;
+        }
+
+        bool ContainsCell(int cellX, int cellY) const
+        {
+            return cellX >= cellLeft && cellX < cellLeft + cellWidth && cellY >= cellTop && cellY < cellTop + cellHeight;
+        }
+
+        int GetBitIndex(int cellX, int cellY) const
+        {
+            return (cellY - cellTop) * cellWidth + (cellX - cellLeft);
+        }
+
+        bool isEnabled;
+        int cellLeft;
+        int cellTop;
+        int cellWidth;
+        int cellHeight;
+        vector<Uint32> blockedBits;
+        vector<Uint32> touchedBits;
+    };
+
+    static bool GetBit(const vector<Uint32> &bits, int bitIndex) { return (bits[bitIndex >> 5] & (1u << (bitIndex & 31))) != 0; }
+    static void SetBit(vector<Uint32> &bits, int bitIndex) { bits[bitIndex >> 5] |= (1u << (bitIndex & 31)); }
+    static void ClearBit(vector<Uint32> &bits, int bitIndex) { bits[bitIndex >> 5] &= ~(1u << (bitIndex & 31)); }
+
+    void RasterizePolygon(Layer *pLayer, const vector<Vector2> &polygon);
+    void ComposeCells(int cellLeft, int cellTop, int cellWidth, int cellHeight);
+    bool GetCellCoordinates(Vector2 position, int *pCellX, int *pCellY) const;
+
+    vector<vector<Vector2> > footprintPolygons;
+
+    double originX;
+    double originY;
+    int gridWidth;
+    int gridHeight;
+
+    vector<Layer> layerList;
+
+    // The union of every enabled layer, covering the whole grid.
+    vector<Uint32> blockedBits;
+    vector<Uint32> touchedBits;
+};
+
+#endif
@@ -0,0 +1,426 @@
+/**
+ * Implements A* pathfinding over a tile grid for characters in a location.
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Pathfinder.h"
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+// How many tiles we expand between checks of the cancellation flag.
+// Checking on every tile would be needlessly chatty with the other thread.
+const unsigned int CancellationCheckInterval = 32;
+
+Pathfinder::Pathfinder()
+{
+    tileSize = 0;
+
+    gridOriginX = 0;
+    gridOriginY = 0;
+    gridWidth = 0;
+    gridHeight = 0;
+    goalTileIndex = -1;
+
+    currentGeneration = 0;
+}
+
+queue<Vector2> Pathfinder::FindPath(PathfindingCollisionTester *pTester, FieldCharacter *pCharacter, RectangleWH bounds, Vector2 start, Vector2 goal, double tileSize, SDL_atomic_t *pCancellationFlag)
+{
+    Uint64 startTime = SDL_GetPerformanceCounter();
+    queue<Vector2> path;
+
+    lastStatistics.Reset();
+
+    this->start = start;
+    this->goal = goal;
+    this->tileSize = tileSize;
+
+    // Bumping the generation invalidates every tile's state from the previous search.
+    // In the unlikely event that we've wrapped around, we'll need to clear things out for real.
+    currentGeneration++;
+
+    if (currentGeneration == 0)
+    {
+        fill(tileGenerations.begin(), tileGenerations.end(), 0);
+        currentGeneration = 1;
+    }
+
+    PrepareGrid(bounds, start, goal, tileSize);
+    openHeap.clear();
+
+    int startTileIndex = GetTileIndex(0, 0);
+
+    // If the goal is in the same tile as our start position, we're already there.
+    if (startTileIndex == goalTileIndex)
+    {
+        lastStatistics.ElapsedMilliseconds = (double)(SDL_GetPerformanceCounter() - startTime) * 1000.0 / SDL_GetPerformanceFrequency();
+        return path;
+    }
+
+    ResetTileIfStale(startTileIndex);
+    gScores[startTileIndex] = 0.0;
+    fScores[startTileIndex] = (goal - start).Length();
+    tileStates[startTileIndex] |= TileStatePassabilityKnown;
+    HeapPush(startTileIndex);
+
+    double closestTileDistance = numeric_limits<double>::infinity();
+    int closestTileIndex = -1;
+
+    while (!openHeap.empty())
+    {
+        if (pCancellationFlag != NULL &&
+            lastStatistics.NodesExpanded % CancellationCheckInterval == 0 &&
+            SDL_AtomicGet(pCancellationFlag) != 0)
+        {
+            lastStatistics.WasCancelled = true;
+            lastStatistics.ElapsedMilliseconds = (double)(SDL_GetPerformanceCounter() - startTime) * 1000.0 / SDL_GetPerformanceFrequency();
+            return path;
+        }
+
+        int currentTileIndex = HeapPop();
+        Vector2 currentPosition = GetTilePosition(currentTileIndex);
+
+        tileStates[currentTileIndex] = (tileStates[currentTileIndex] & ~TileStateOpen) | TileStateClosed;
+        lastStatistics.NodesExpanded++;
+
+        if (currentTileIndex == goalTileIndex)
+        {
+            closestTileIndex = currentTileIndex;
+            break;
+        }
+        else if ((goal - currentPosition).Length() < closestTileDistance)
+        {
+            closestTileDistance = (goal - currentPosition).Length();
+            closestTileIndex = currentTileIndex;
+        }
+
+        int currentTileX = currentTileIndex % gridWidth;
+        int currentTileY = currentTileIndex / gridWidth;
+
+        TestNeighborPassability(pTester, pCharacter, currentTileIndex);
+
+        for (int deltaY = -1; deltaY <= 1; deltaY++)
+        {
+            for (int deltaX = -1; deltaX <= 1; deltaX++)
+            {
+                int neighborTileX = currentTileX + deltaX;
+                int neighborTileY = currentTileY + deltaY;
+
+                if ((deltaX == 0 && deltaY == 0) ||
+                    neighborTileX < 0 || neighborTileX >= gridWidth ||
+                    neighborTileY < 0 || neighborTileY >= gridHeight)
+                {
+                    continue;
+                }
+
+                int neighborTileIndex = neighborTileY * gridWidth + neighborTileX;
+                ResetTileIfStale(neighborTileIndex);
+
+                if ((tileStates[neighborTileIndex] & TileStateClosed) != 0 ||
+                    !IsTilePassable(pTester, pCharacter, neighborTileIndex))
+                {
+                    continue;
+                }
+
+                double tentativeGScore = gScores[currentTileIndex] + (GetTilePosition(neighborTileIndex) - currentPosition).Length();
+
+                if ((tileStates[neighborTileIndex] & TileStateOpen) == 0)
+                {
+                    cameFromTileIndices[neighborTileIndex] = currentTileIndex;
+                    gScores[neighborTileIndex] = tentativeGScore;
+                    fScores[neighborTileIndex] = tentativeGScore + (goal - GetTilePosition(neighborTileIndex)).Length();
+                    HeapPush(neighborTileIndex);
+                    lastStatistics.NodesOpened++;
+                }
+                else if (tentativeGScore < gScores[neighborTileIndex])
+                {
+                    double hScore = fScores[neighborTileIndex] - gScores[neighborTileIndex];
+
+                    cameFromTileIndices[neighborTileIndex] = currentTileIndex;
+                    gScores[neighborTileIndex] = tentativeGScore;
+                    fScores[neighborTileIndex] = tentativeGScore + hScore;
+                    HeapDecreaseKey(neighborTileIndex);
+                }
+            }
+        }
+    }
+
+    // Walk back from the tile closest to the goal to build the path.
+    // As with the start position, we don't include the closest tile itself -
+    // the goal always takes its place at the end of the path.
+    if (closestTileIndex >= 0 && cameFromTileIndices[closestTileIndex] >= 0)
+    {
+        vector<Vector2> reversedPath;
+
+        for (int tileIndex = cameFromTileIndices[closestTileIndex]; tileIndex != startTileIndex; tileIndex = cameFromTileIndices[tileIndex])
+        {
+            reversedPath.push_back(GetTilePosition(tileIndex));
+        }
+
+        for (int i = (int)reversedPath.size() - 1; i >= 0; i--)
+        {
+            path.push(reversedPath[i]);
+        }
+
+        path.push(goal);
+    }
+
+    lastStatistics.ElapsedMilliseconds = (double)(SDL_GetPerformanceCounter() - startTime) * 1000.0 / SDL_GetPerformanceFrequency();
+    return path;
+}
+
+void Pathfinder::PrepareGrid(RectangleWH bounds, Vector2 start, Vector2 goal, double tileSize)
+{
+    // The grid is aligned such that the start position is at the center of tile (0, 0).
+    // We cover the location bounds plus a one-tile margin, and also make sure that
+    // the goal's tile is included even if it's outside the bounds.
+    int goalTileX = (int)floor((goal.GetX() - start.GetX()) / tileSize + 0.5);
+    int goalTileY = (int)floor((goal.GetY() - start.GetY()) / tileSize + 0.5);
+
+    int minTileX = min(min(0, goalTileX), (int)floor((bounds.GetX() - start.GetX()) / tileSize) - 1);
+    int minTileY = min(min(0, goalTileY), (int)floor((bounds.GetY() - start.GetY()) / tileSize) - 1);
+    int maxTileX = max(max(0, goalTileX), (int)ceil((bounds.GetX() + bounds.GetWidth() - start.GetX()) / tileSize) + 1);
+    int maxTileY = max(max(0, goalTileY), (int)ceil((bounds.GetY() + bounds.GetHeight() - start.GetY()) / tileSize) + 1);
+
+    gridOriginX = minTileX;
+    gridOriginY = minTileY;
+    gridWidth = maxTileX - minTileX + 1;
+    gridHeight = maxTileY - minTileY + 1;
+
+    unsigned int tileCount = (unsigned int)(gridWidth * gridHeight);
+
+    // We only ever grow these - every tile's generation is stale at this point,
+    // so there's no need to clear out what a previous search left behind.
+    EnsureSize(&tileGenerations, tileCount);
+    EnsureSize(&tileStates, tileCount);
+    EnsureSize(&gScores, tileCount);
+    EnsureSize(&fScores, tileCount);
+    EnsureSize(&cameFromTileIndices, tileCount);
+    EnsureSize(&heapPositions, tileCount);
+
+    if (openHeap.capacity() < tileCount)
+    {
+        openHeap.reserve(tileCount);
+        lastStatistics.Allocations++;
+    }
+
+    goalTileIndex = GetTileIndex(goalTileX, goalTileY);
+}
+
+int Pathfinder::GetTileIndex(int tileX, int tileY) const
+{
+    return (tileY - gridOriginY) * gridWidth + (tileX - gridOriginX);
+}
+
+Vector2 Pathfinder::GetTilePosition(int tileIndex) const
+{
+    // The goal stands in for the tile that contains it.
+    if (tileIndex == goalTileIndex)
+    {
+        return goal;
+    }
+
+    int tileX = tileIndex % gridWidth + gridOriginX;
+    int tileY = tileIndex / gridWidth + gridOriginY;
+
+    return Vector2(start.GetX() + tileX * tileSize, start.GetY() + tileY * tileSize);
+}
+
+bool Pathfinder::IsTilePassable(PathfindingCollisionTester *pTester, FieldCharacter *pCharacter, int tileIndex)
+{
+    // Nothing in the location moves while we're searching,
+    // so we only need to test each tile for collisions once.
+    if ((tileStates[tileIndex] & TileStatePassabilityKnown) == 0)
+    {
+        lastStatistics.CollisionTests++;
+
+        if (pTester->TestCollisionForPathfinding(pCharacter, GetTilePosition(tileIndex)))
+        {
+            tileStates[tileIndex] |= TileStateBlocked;
+        }
+
+        tileStates[tileIndex] |= TileStatePassabilityKnown;
+    }
+
+    return (tileStates[tileIndex] & TileStateBlocked) == 0;
+}
+
+void Pathfinder::TestNeighborPassability(PathfindingCollisionTester *pTester, FieldCharacter *pCharacter, int tileIndex)
+{
+    // Testing all of the neighbors that we haven't seen yet in one go
+    // lets the tester share its work between them.
+    int neighborTileIndices[8];
+    Vector2 neighborPositions[8];
+    int neighborCount = 0;
+    int tileX = tileIndex % gridWidth;
+    int tileY = tileIndex / gridWidth;
+
+    for (int deltaY = -1; deltaY <= 1; deltaY++)
+    {
+        for (int deltaX = -1; deltaX <= 1; deltaX++)
+        {
+            int neighborTileX = tileX + deltaX;
+            int neighborTileY = tileY + deltaY;
+
+            if ((deltaX == 0 && deltaY == 0) ||
+                neighborTileX < 0 || neighborTileX >= gridWidth ||
+                neighborTileY < 0 || neighborTileY >= gridHeight)
+            {
+                continue;
+            }
+
+            int neighborTileIndex = neighborTileY * gridWidth + neighborTileX;
+            ResetTileIfStale(neighborTileIndex);
+
+            if ((tileStates[neighborTileIndex] & (TileStateClosed | TileStatePassabilityKnown)) == 0)
+            {
+                neighborTileIndices[neighborCount] = neighborTileIndex;
+                neighborPositions[neighborCount] = GetTilePosition(neighborTileIndex);
+                neighborCount++;
+            }
+        }
+    }
+
+    if (neighborCount == 0)
+    {
+        return;
+    }
+
+    unsigned int collisionMask = 0;
+    pTester->TestCollisionBatchForPathfinding(pCharacter, neighborPositions, neighborCount, &collisionMask);
+    lastStatistics.CollisionTests += neighborCount;
+
+    for (int i = 0; i < neighborCount; i++)
+    {
+        if ((collisionMask & (1u << i)) != 0)
+        {
+            tileStates[neighborTileIndices[i]] |= TileStateBlocked;
+        }
+
+        tileStates[neighborTileIndices[i]] |= TileStatePassabilityKnown;
+    }
+}
+
+void Pathfinder::ResetTileIfStale(int tileIndex)
+{
+    if (tileGenerations[tileIndex] != currentGeneration)
+    {
+        tileGenerations[tileIndex] = currentGeneration;
+        tileStates[tileIndex] = TileStateUnvisited;
+        gScores[tileIndex] = numeric_limits<double>::infinity();
+        fScores[tileIndex] = numeric_limits<double>::infinity();
+        cameFromTileIndices[tileIndex] = -1;
+        heapPositions[tileIndex] = -1;
+    }
+}
+
+void Pathfinder::HeapPush(int tileIndex)
+{
+    tileStates[tileIndex] |= TileStateOpen;
+    heapPositions[tileIndex] = (int)openHeap.size();
+    openHeap.push_back(tileIndex);
+    HeapSiftUp(heapPositions[tileIndex]);
+}
+
+int Pathfinder::HeapPop()
+{
+    int tileIndex = openHeap[0];
+
+    HeapSwap(0, (int)openHeap.size() - 1);
+    openHeap.pop_back();
+    heapPositions[tileIndex] = -1;
+
+    if (!openHeap.empty())
+    {
+        HeapSiftDown(0);
+    }
+
+    return tileIndex;
+}
+
+void Pathfinder::HeapDecreaseKey(int tileIndex)
+{
+    HeapSiftUp(heapPositions[tileIndex]);
+}
+
+void Pathfinder::HeapSiftUp(int heapPosition)
+{
+    while (heapPosition > 0)
+    {
+        int parentHeapPosition = (heapPosition - 1) / 2;
+
+        if (fScores[openHeap[parentHeapPosition]] <= fScores[openHeap[heapPosition]])
+        {
+            break;
+        }
+
+        HeapSwap(heapPosition, parentHeapPosition);
+        heapPosition = parentHeapPosition;
+    }
+}
+
+void Pathfinder::HeapSiftDown(int heapPosition)
+{
+    int heapSize = (int)openHeap.size();
+
+    while (true)
+    {
+        int leftChildHeapPosition = heapPosition * 2 + 1;
+        int rightChildHeapPosition = leftChildHeapPosition + 1;
+        int smallestHeapPosition = heapPosition;
+
+        if (leftChildHeapPosition < heapSize && fScores[openHeap[leftChildHeapPosition]] < fScores[openHeap[smallestHeapPosition]])
+        {
+            smallestHeapPosition = leftChildHeapPosition;
+        }
+
+        if (rightChildHeapPosition < heapSize && fScores[openHeap[rightChildHeapPosition]] < fScores[openHeap[smallestHeapPosition]])
+        {
+            smallestHeapPosition = rightChildHeapPosition;
+        }
+
+        if (smallestHeapPosition == heapPosition)
+        {
+            break;
+        }
+
+        HeapSwap(heapPosition, smallestHeapPosition);
+        heapPosition = smallestHeapPosition;
+    }
+}
+
+void Pathfinder::HeapSwap(int heapPosition1, int heapPosition2)
+{
+    int tileIndex1 = openHeap[heapPosition1];
+    int tileIndex2 = openHeap[heapPosition2];
+
+    openHeap[heapPosition1] = tileIndex2;
+    openHeap[heapPosition2] = tileIndex1;
+    heapPositions[tileIndex2] = heapPosition1;
+    heapPositions[tileIndex1] = heapPosition2;
+}
@@ -0,0 +1,175 @@
+/**
+ * Basic header/include file for Pathfinder.cpp.
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PATHFINDER_H
+#define PATHFINDER_H
+
+#include "Rectangle.h"
+#include "Vector2.h"
+#include <SDL2/SDL.h>
+#include <queue>
+#include <vector>
+
+using namespace std;
+
+class FieldCharacter;
+
+class PathfindingCollisionTester
+{
+public:
+    virtual ~PathfindingCollisionTester() {}
+
+    virtual bool TestCollisionForPathfinding(FieldCharacter *pCharacter, Vector2 position) = 0;
+
+    // Tests up to 32 positions at once, setting the bit in the mask for each position that collides.
+    // Testers that can answer several positions faster than one at a time should override this.
+    virtual void TestCollisionBatchForPathfinding(FieldCharacter *pCharacter, const Vector2 *pPositions, int positionCount, unsigned int *pCollisionMask)
+    {
+        *pCollisionMask = 0;
+
+        for (int i = 0; i < positionCount; i++)
+        {
+            if (TestCollisionForPathfinding(pCharacter, pPositions[i]))
+            {
+                *pCollisionMask |= 1u << i;
+            }
+        }
+    }
+};
+
+// The per-tile arrays a pathfinder searches with grow to fit the largest grid it has searched,
+// and are kept from one search to the next, so searches only stop allocating once the same
+// pathfinder is reused for them.  Hold on to one rather than creating one for every search.
+class Pathfinder
+{
+public:
+    class Statistics
+    {
+    public:
+        Statistics()
+        {
+            Reset();
+        }
+
+        void Reset()
+        {
+            NodesExpanded = 0;
+            NodesOpened = 0;
+            CollisionTests = 0;
+            Allocations = 0;
+            ElapsedMilliseconds = 0;
+            WasCancelled = false;
+        }
+
+        unsigned int NodesExpanded;
+        unsigned int NodesOpened;
+        unsigned int CollisionTests;
+        unsigned int Allocations;
+        double ElapsedMilliseconds;
+        bool WasCancelled;
+    };
+
+    Pathfinder();
+
+    // Implements the A* search algorithm over a grid of tiles of the given size
+    // centered on the start position.  The returned queue doesn't contain the start position,
+    // and always ends in the goal position, even if the goal turned out to be unreachable -
+    // in that case the path leads through the tile closest to the goal.
+    // If a cancellation flag is provided, the search is abandoned as soon as it becomes non-zero,
+    // in which case an empty path is returned and the statistics are marked as cancelled.
+    queue<Vector2> FindPath(PathfindingCollisionTester *pTester, FieldCharacter *pCharacter, RectangleWH bounds, Vector2 start, Vector2 goal, double tileSize, SDL_atomic_t *pCancellationFlag = NULL);
+
+    const Statistics & GetLastStatistics() const { return this->lastStatistics; }
+
+private:
+    enum TileState
+    {
+        TileStateUnvisited = 0x0,
+        TileStatePassabilityKnown = 0x1,
+        TileStateBlocked = 0x2,
+        TileStateOpen = 0x4,
+        TileStateClosed = 0x8
+    };
+
+    void PrepareGrid(RectangleWH bounds, Vector2 start, Vector2 goal, double tileSize);
+    int GetTileIndex(int tileX, int tileY) const;
+    Vector2 GetTilePosition(int tileIndex) const;
+    bool IsTilePassable(PathfindingCollisionTester *pTester, FieldCharacter *pCharacter, int tileIndex);
+    void TestNeighborPassability(PathfindingCollisionTester *pTester, FieldCharacter *pCharacter, int tileIndex);
+    void ResetTileIfStale(int tileIndex);
+
+    void HeapPush(int tileIndex);
+    int HeapPop();
+    void HeapDecreaseKey(int tileIndex);
+    void HeapSiftUp(int heapPosition);
+    void HeapSiftDown(int heapPosition);
+    void HeapSwap(int heapPosition1, int heapPosition2);
+
+    template <class T>
+    void EnsureSize(vector<T> *pVector, unsigned int size)
+    {
+        if (pVector->size() < size)
+        {
+            if (pVector->capacity() < size)
+            {
+                lastStatistics.Allocations++;
+            }
+
+            pVector->resize(size);
+        }
+    }
+
+    Vector2 start;
+    Vector2 goal;
+    double tileSize;
+
+    int gridOriginX;
+    int gridOriginY;
+    int gridWidth;
+    int gridHeight;
+    int goalTileIndex;
+
+    // Per-tile state is stored in flat arrays indexed by tile,
+    // and lazily reset by comparing against the current search generation
+    // so that we don't need to clear the whole grid before every search.
+    unsigned int currentGeneration;
+    vector<unsigned int> tileGenerations;
+    vector<unsigned char> tileStates;
+    vector<double> gScores;
+    vector<double> fScores;
+    vector<int> cameFromTileIndices;
+    vector<int> heapPositions;
+
+    // The open set, stored as a binary min-heap of tile indices ordered by f-score.
+    vector<int> openHeap;
+
+    Statistics lastStatistics;
+};
+
+#endif
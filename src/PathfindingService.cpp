@@ -0,0 +1,315 @@
+/**
+ * Implementation of a long-lived pathfinding thread with a cancellable request queue.
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "PathfindingService.h"
+
+// Requests are coalesced per character, so this only needs to be large enough
+// to hold one request for every character that can be pathing at once.
+const unsigned int MaxPendingPathfindingRequests = 4;
+
+PathfindingService::PathfindingService(PathfindingRequestHandler *pHandler)
+{
+    this->pHandler = pHandler;
+
+    pThread = NULL;
+    SDL_AtomicSet(&isQuitting, 0);
+
+    pRequestListSemaphore = SDL_CreateSemaphore(1);
+    pRequestsAvailableSemaphore = SDL_CreateSemaphore(0);
+    pCurrentRequestCharacter = NULL;
+    SDL_AtomicSet(&isCurrentRequestCancelled, 0);
+
+    SDL_AtomicSet(&resultReadIndex, 0);
+    SDL_AtomicSet(&resultWriteIndex, 0);
+
+    lastRequestId = 0;
+}
+
+PathfindingService::~PathfindingService()
+{
+    if (pThread != NULL)
+    {
+        SDL_AtomicSet(&isQuitting, 1);
+        SDL_AtomicSet(&isCurrentRequestCancelled, 1);
+        SDL_SemPost(pRequestsAvailableSemaphore);
+        SDL_WaitThread(pThread, NULL);
+        pThread = NULL;
+    }
+
+    SDL_DestroySemaphore(pRequestListSemaphore);
+    pRequestListSemaphore = NULL;
+    SDL_DestroySemaphore(pRequestsAvailableSemaphore);
+    pRequestsAvailableSemaphore = NULL;
+}
+
+void PathfindingService::QueueRequest(FieldCharacter *pCharacter, Vector2 startPosition, Vector2 endPosition, FieldCharacterState characterStateIfMoving)
+{
+    EnsureThreadStarted();
+
+    Request request(pCharacter, startPosition, endPosition, characterStateIfMoving, ++lastRequestId);
+    bool requestReplaced = false;
+
+    latestRequestIdByCharacterMap[pCharacter] = request.requestId;
+
+    SDL_SemWait(pRequestListSemaphore);
+
+    for (unsigned int i = 0; i < pendingRequestList.size(); i++)
+    {
+        if (pendingRequestList[i].pCharacter == pCharacter)
+        {
+            pendingRequestList[i] = request;
+            requestReplaced = true;
+            break;
+        }
+    }
+
+    if (!requestReplaced)
+    {
+        if (pendingRequestList.size() >= MaxPendingPathfindingRequests)
+        {
+            // We're full, so the oldest request gives way.  We're swapping one request for another,
+            // so the number of available requests stays the same.
+            Request droppedRequest = pendingRequestList.front();
+            pendingRequestList.pop_front();
+
+            if (latestRequestIdByCharacterMap[droppedRequest.pCharacter] == droppedRequest.requestId)
+            {
+                latestRequestIdByCharacterMap.erase(droppedRequest.pCharacter);
+            }
+
+            pendingRequestList.push_back(request);
+        }
+        else
+        {
+            pendingRequestList.push_back(request);
+            SDL_SemPost(pRequestsAvailableSemaphore);
+        }
+    }
+
+    // Any search already under way for this character is now stale.
+    CancelCurrentRequestIfMatching(pCharacter);
+
+    SDL_SemPost(pRequestListSemaphore);
+}
+
+void PathfindingService::CancelRequests(FieldCharacter *pCharacter, bool waitForCurrentRequest)
+{
+    latestRequestIdByCharacterMap.erase(pCharacter);
+
+    SDL_SemWait(pRequestListSemaphore);
+
+    for (deque<Request>::iterator iter = pendingRequestList.begin(); iter != pendingRequestList.end();)
+    {
+        if (iter->pCharacter == pCharacter)
+        {
+            iter = pendingRequestList.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+
+    CancelCurrentRequestIfMatching(pCharacter);
+
+    SDL_SemPost(pRequestListSemaphore);
+
+    if (waitForCurrentRequest)
+    {
+        WaitForCurrentRequest(pCharacter);
+    }
+}
+
+void PathfindingService::CancelAllRequests(bool waitForCurrentRequest)
+{
+    latestRequestIdByCharacterMap.clear();
+
+    SDL_SemWait(pRequestListSemaphore);
+
+    pendingRequestList.clear();
+
+    if (pCurrentRequestCharacter != NULL)
+    {
+        SDL_AtomicSet(&isCurrentRequestCancelled, 1);
+    }
+
+    SDL_SemPost(pRequestListSemaphore);
+
+    if (waitForCurrentRequest)
+    {
+        WaitForCurrentRequest(NULL);
+    }
+}
+
+bool PathfindingService::HasPendingRequest(FieldCharacter *pCharacter)
+{
+    return latestRequestIdByCharacterMap.count(pCharacter) > 0;
+}
+
+bool PathfindingService::TryGetResult(Result *pResult)
+{
+    while (true)
+    {
+        int readIndex = SDL_AtomicGet(&resultReadIndex);
+
+        if (readIndex == SDL_AtomicGet(&resultWriteIndex))
+        {
+            return false;
+        }
+
+        Result *pSlot = &resultRing[(unsigned int)readIndex % PathfindingResultRingSize];
+        map<FieldCharacter *, int>::iterator iter = latestRequestIdByCharacterMap.find(pSlot->request.pCharacter);
+        bool isLatestRequest = iter != latestRequestIdByCharacterMap.end() && iter->second == pSlot->request.requestId;
+
+        if (isLatestRequest)
+        {
+            *pResult = *pSlot;
+            latestRequestIdByCharacterMap.erase(iter);
+        }
+
+        pSlot->path = queue<Vector2>();
+        SDL_AtomicSet(&resultReadIndex, readIndex + 1);
+
+        if (isLatestRequest)
+        {
+            return true;
+        }
+    }
+}
+
+int PathfindingService::RunStatic(void *pData)
+{
+    PathfindingService *pThis = reinterpret_cast<PathfindingService *>(pData);
+    pThis->Run();
+    return 0;
+}
+
+void PathfindingService::Run()
+{
+    while (true)
+    {
+        SDL_SemWait(pRequestsAvailableSemaphore);
+
+        if (SDL_AtomicGet(&isQuitting) != 0)
+        {
+            break;
+        }
+
+        SDL_SemWait(pRequestListSemaphore);
+
+        // Cancelled requests leave the available count ahead of the list,
+        // so there may turn out to be nothing to do.
+        if (pendingRequestList.empty())
+        {
+            SDL_SemPost(pRequestListSemaphore);
+            continue;
+        }
+
+        Result result;
+        result.request = pendingRequestList.front();
+        pendingRequestList.pop_front();
+
+        pCurrentRequestCharacter = result.request.pCharacter;
+        SDL_AtomicSet(&isCurrentRequestCancelled, 0);
+
+        SDL_SemPost(pRequestListSemaphore);
+
+        result.path = pHandler->FindPathForRequest(result.request.pCharacter, result.request.startPosition, result.request.endPosition, &pathfinder, &isCurrentRequestCancelled);
+
+        if (SDL_AtomicGet(&isCurrentRequestCancelled) == 0)
+        {
+            PublishResult(result);
+        }
+
+        SDL_SemWait(pRequestListSemaphore);
+        pCurrentRequestCharacter = NULL;
+        SDL_SemPost(pRequestListSemaphore);
+    }
+}
+
+void PathfindingService::EnsureThreadStarted()
+{
+    if (pThread == NULL)
+    {
+        pThread = SDL_CreateThread(PathfindingService::RunStatic, "PathfindingThread", this);
+    }
+}
+
+void PathfindingService::CancelCurrentRequestIfMatching(FieldCharacter *pCharacter)
+{
+    // Expects the request list semaphore to be held.
+    if (pCurrentRequestCharacter != NULL && pCurrentRequestCharacter == pCharacter)
+    {
+        SDL_AtomicSet(&isCurrentRequestCancelled, 1);
+    }
+}
+
+void PathfindingService::WaitForCurrentRequest(FieldCharacter *pCharacter)
+{
+    // Searches check for cancellation frequently, so this never waits for long.
+    // A NULL character means that we'll wait for whatever request is in progress.
+    while (true)
+    {
+        SDL_SemWait(pRequestListSemaphore);
+        bool isBusy = pCurrentRequestCharacter != NULL && (pCharacter == NULL || pCurrentRequestCharacter == pCharacter);
+        SDL_SemPost(pRequestListSemaphore);
+
+        if (!isBusy)
+        {
+            break;
+        }
+
+        SDL_Delay(1);
+    }
+}
+
+bool PathfindingService::PublishResult(const Result &result)
+{
+    int writeIndex = SDL_AtomicGet(&resultWriteIndex);
+
+    // If the main thread has fallen behind, wait for it to make room,
+    // unless the result we're holding is no longer wanted anyway.
+    while (writeIndex - SDL_AtomicGet(&resultReadIndex) >= PathfindingResultRingSize)
+    {
+        if (SDL_AtomicGet(&isQuitting) != 0 || SDL_AtomicGet(&isCurrentRequestCancelled) != 0)
+        {
+            return false;
+        }
+
+        SDL_Delay(1);
+    }
+
+    resultRing[(unsigned int)writeIndex % PathfindingResultRingSize] = result;
+
+    // Setting the write index is a full memory barrier,
+    // so the main thread will never see the index before the result itself.
+    SDL_AtomicSet(&resultWriteIndex, writeIndex + 1);
+
+    return true;
+}
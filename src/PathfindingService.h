@@ -0,0 +1,145 @@
+/**
+ * Basic header/include file for PathfindingService.cpp.
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PATHFINDINGSERVICE_H
+#define PATHFINDINGSERVICE_H
+
+#include "enums.h"
+#include "Pathfinder.h"
+#include "Vector2.h"
+#include <SDL2/SDL.h>
+#include <deque>
+#include <map>
+#include <queue>
+
+using namespace std;
+
+class FieldCharacter;
+
+const int PathfindingResultRingSize = 8;
+
+class PathfindingRequestHandler
+{
+public:
+    virtual ~PathfindingRequestHandler() {}
+
+    // Called on the pathfinding thread.  Implementations should pass the cancellation flag
+    // along to the pathfinder and return an empty path if the search was cancelled.
+    virtual queue<Vector2> FindPathForRequest(FieldCharacter *pCharacter, Vector2 startPosition, Vector2 endPosition, Pathfinder *pPathfinder, SDL_atomic_t *pCancellationFlag) = 0;
+};
+
+// Runs pathfinding requests on a single long-lived thread.
+// Requests are queued from the main thread, with at most one pending request per character -
+// a newer request for a character replaces its pending one and cancels its in-progress search.
+// Completed paths are handed back through a single-producer, single-consumer ring buffer
+// that the main thread polls without taking any locks.
+class PathfindingService
+{
+public:
+    class Request
+    {
+    public:
+        Request()
+        {
+            pCharacter = NULL;
+            characterStateIfMoving = FieldCharacterStateNone;
+            requestId = 0;
+        }
+
+        Request(FieldCharacter *pCharacter, Vector2 startPosition, Vector2 endPosition, FieldCharacterState characterStateIfMoving, int requestId)
+            : pCharacter(pCharacter)
+            , startPosition(startPosition)
+            , endPosition(endPosition)
+            , characterStateIfMoving(characterStateIfMoving)
+            , requestId(requestId)
+        {
+        }
+
+        FieldCharacter *pCharacter;
+        Vector2 startPosition;
+        Vector2 endPosition;
+        FieldCharacterState characterStateIfMoving;
+        int requestId;
+    };
+
+    class Result
+    {
+    public:
+        Request request;
+        queue<Vector2> path;
+    };
+
+    PathfindingService(PathfindingRequestHandler *pHandler);
+    ~PathfindingService();
+
+    void QueueRequest(FieldCharacter *pCharacter, Vector2 startPosition, Vector2 endPosition, FieldCharacterState characterStateIfMoving);
+    void CancelRequests(FieldCharacter *pCharacter, bool waitForCurrentRequest = false);
+    void CancelAllRequests(bool waitForCurrentRequest = false);
+
+    // Whether a request for this character is still waiting on its result.
+    bool HasPendingRequest(FieldCharacter *pCharacter);
+
+    // Returns the next completed result that is still the latest request for its character.
+    // Results for superseded or cancelled requests are silently discarded.
+    bool TryGetResult(Result *pResult);
+
+private:
+    static int RunStatic(void *pData);
+    void Run();
+
+    void EnsureThreadStarted();
+    void CancelCurrentRequestIfMatching(FieldCharacter *pCharacter);
+    void WaitForCurrentRequest(FieldCharacter *pCharacter);
+    bool PublishResult(const Result &result);
+
+    PathfindingRequestHandler *pHandler;
+    Pathfinder pathfinder;
+
+    SDL_Thread *pThread;
+    SDL_atomic_t isQuitting;
+
+    // Guards the pending request list and the identity of the request currently being processed.
+    SDL_sem *pRequestListSemaphore;
+    SDL_sem *pRequestsAvailableSemaphore;
+    deque<Request> pendingRequestList;
+    FieldCharacter *pCurrentRequestCharacter;
+    SDL_atomic_t isCurrentRequestCancelled;
+
+    // Only the pathfinding thread writes results and advances the write index,
+    // and only the main thread reads them and advances the read index.
+    Result resultRing[PathfindingResultRingSize];
+    SDL_atomic_t resultReadIndex;
+    SDL_atomic_t resultWriteIndex;
+
+    // Only touched on the main thread.
+    int lastRequestId;
+    map<FieldCharacter *, int> latestRequestIdByCharacterMap;
+};
+
+#endif
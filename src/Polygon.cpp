@@ -29,6 +29,7 @@
 
 #include "Polygon.h"
 #include "Line.h"
+#include <algorithm>
 #include <limits>
 
 GeometricPolygon::GeometricPolygon(XmlReader *pReader)
@@ -130,3 +131,69 @@ const GeometricPolygon GeometricPolygon::operator-(const Vector2 &other) const
 
     return newPolygon;
 }
+
+bool GeometricPolygon::EdgesIntersect(RectangleWH rectangle)
+{
+    int lastIndex = points.size() - 1;
+
+    for (unsigned int index = 0; index < points.size(); index++)
+    {
+        // We'll clip each edge against the rectangle one side at a time,
+        // keeping track of which portion of the edge remains inside it.
+        // If anything's left at the end, then the edge passes through the rectangle.
+        Vector2 edgeStart = points[lastIndex];
+        Vector2 edgeDelta = points[index] - points[lastIndex];
+        double enterFraction = 0;
+        double exitFraction = 1;
+
+        double deltas[4] =
+        {
+            -edgeDelta.GetX(),
+            edgeDelta.GetX(),
+            -edgeDelta.GetY(),
+            edgeDelta.GetY(),
+        };
+
+        double distances[4] =
+        {
+            edgeStart.GetX() - rectangle.GetX(),
+            rectangle.GetX() + rectangle.GetWidth() - edgeStart.GetX(),
+            edgeStart.GetY() - rectangle.GetY(),
+            rectangle.GetY() + rectangle.GetHeight() - edgeStart.GetY(),
+        };
+
+        bool edgeIntersects = true;
+
+        for (int side = 0; side < 4 && edgeIntersects; side++)
+        {
+            if (deltas[side] == 0)
+            {
+                edgeIntersects = distances[side] >= 0;
+            }
+            else
+            {
+                double fraction = distances[side] / deltas[side];
+
+                if (deltas[side] < 0)
+                {
+                    enterFraction = max(enterFraction, fraction);
+                }
+                else
+                {
+                    exitFraction = min(exitFraction, fraction);
+                }
+
+                edgeIntersects = enterFraction <= exitFraction;
+            }
+        }
+
+        if (edgeIntersects)
+        {
+            return true;
+        }
+
+        lastIndex = index;
+    }
+
+    return false;
+}
@@ -42,6 +42,7 @@ public:
     GeometricPolygon(XmlReader *pReader);
 
     bool Contains(Vector2 point);
+    bool EdgesIntersect(RectangleWH rectangle);
     RectangleWH GetBoundingBox();
 
     const GeometricPolygon operator-(const Vector2 &other) const;
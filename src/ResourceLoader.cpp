@@ -28,14 +28,125 @@
  */
 
 #include "ResourceLoader.h"
+#include "FileFunctions.h"
 #include "mli_audio.h"
 #include "CaseInformation/Case.h"
 
+#include <algorithm>
+
+#ifdef __WINDOWS
+#include <windows.h>
+
+// windows.h defines LoadImage as a macro, which would otherwise rename our own LoadImage.
+#undef LoadImage
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_ARCHIVE_BENCHMARK
+    #include <iostream>
+    #endif
+#endif
+
 ResourceLoader * ResourceLoader::pInstance = NULL;
 
+namespace
+{
+    bool SeekFile(FILE *pFile, mz_uint64 offset, int origin)
+    {
+#ifdef __WINDOWS
+        return fseeko64(pFile, (off64_t)offset, origin) == 0;
+#else
+        return fseeko(pFile, (off_t)offset, origin) == 0;
+#endif
+    }
+
+    mz_uint64 GetFilePosition(FILE *pFile)
+    {
+#ifdef __WINDOWS
+        return (mz_uint64)ftello64(pFile);
+#else
+        return (mz_uint64)ftello(pFile);
+#endif
+    }
+
+    double GetMillisecondsSince(Uint64 startTime)
+    {
+        return (double)(SDL_GetPerformanceCounter() - startTime) * 1000.0 / SDL_GetPerformanceFrequency();
+    }
+
+    int GetMicrosecondsSince(Uint64 startTime)
+    {
+        return (int)(GetMillisecondsSince(startTime) * 1000.0);
+    }
+
+    bool FilePathMatchesNormalizedFilePath(const char *pFilePath, const string &normalizedFilePath)
+    {
+        const char *pNormalizedC = normalizedFilePath.c_str();
+        const char *pC = pFilePath;
+
+        for (; *pC != '\0' && *pNormalizedC != '\0'; pC++, pNormalizedC++)
+        {
+            if (NormalizeArchiveFilePathCharacter(*pC) != *pNormalizedC)
+            {
+                return false;
+            }
+        }
+
+        return *pC == *pNormalizedC;
+    }
+}
+
 void ResourceLoader::LoadImageStep::Execute()
 {
-    Case::GetInstance()->GetSpriteManager()->LoadImageFromFilePath(spriteId);
+    if (isBackground)
+    {
+        Case::GetInstance()->GetSpriteManager()->PrefetchImageFromFilePath(spriteId);
+    }
+    else
+    {
+        Case::GetInstance()->GetSpriteManager()->LoadImageFromFilePath(spriteId);
+    }
+}
+
+void ResourceLoader::LoadImageStep::Prefetch()
+{
+    if (isPrefetched)
+    {
+        return;
+    }
+
+    ResourceLoader::GetInstance()->PrefetchImage(GetFilePath());
+    isPrefetched = true;
+}
+
+bool ResourceLoader::LoadImageStep::IsReadyToExecute()
+{
+    return isPrefetched && !ResourceLoader::GetInstance()->IsPrefetchedImagePending(GetFilePath());
+}
+
+void ResourceLoader::LoadImageStep::CancelPrefetch()
+{
+    if (!isPrefetched)
+    {
+        return;
+    }
+
+    // A background load step may have asked for the same decode, in which case it's still wanted.
+    if (!ResourceLoader::GetInstance()->IsBackgroundPrefetch(GetFilePath()))
+    {
+        ResourceLoader::GetInstance()->CancelPrefetchedImage(GetFilePath());
+    }
+
+    isPrefetched = false;
+}
+
+string ResourceLoader::LoadImageStep::GetFilePath()
+{
+    return Case::GetInstance()->GetSpriteManager()->GetImageFilePathFromId(spriteId);
 }
 
 void ResourceLoader::DeleteImageStep::Execute()
@@ -48,11 +159,187 @@ void ResourceLoader::LoadVideoStep::Execute()
     pVideo->LoadFile();
 }
 
+void ResourceLoader::LoadVideoStep::Prefetch()
+{
+    if (isPrefetched)
+    {
+        return;
+    }
+
+    pVideo->Prefetch();
+    isPrefetched = true;
+}
+
+bool ResourceLoader::LoadVideoStep::IsReadyToExecute()
+{
+    return isPrefetched && !pVideo->IsPrefetchPending();
+}
+
+void ResourceLoader::LoadVideoStep::CancelPrefetch()
+{
+    if (!isPrefetched)
+    {
+        return;
+    }
+
+    if (!ResourceLoader::GetInstance()->IsBackgroundPrefetch(pVideo))
+    {
+        pVideo->CancelPrefetch();
+    }
+
+    isPrefetched = false;
+}
+
 void ResourceLoader::DeleteVideoStep::Execute()
 {
     pVideo->UnloadFile();
 }
 
+string ResourceLoader::GetImageResourceKey(const string &spriteId)
+{
+    return "Image/" + spriteId;
+}
+
+string ResourceLoader::GetVideoResourceKey(Video *pVideo)
+{
+    char videoAddress[32];
+    sprintf(videoAddress, "%p", (void *)pVideo);
+    return string("Video/") + videoAddress;
+}
+
+void ResourceLoader::LoadStepQueue::Add(LoadResourceStep *pStep)
+{
+    map<string, LoadResourceStep *>::iterator iter = stepByResourceKeyMap.find(pStep->GetResourceKey());
+
+    if (iter != stepByResourceKeyMap.end())
+    {
+        LoadResourceStep *pQueuedStep = iter->second;
+
+        // Loading something and then unloading it again, or the other way around, leaves it as it was,
+        // so neither step needs to run.  A step that's already queued only needs moving
+        // if it's now needed sooner than it was.
+        bool cancelsOut = pQueuedStep->GetIsUnload() != pStep->GetIsUnload();
+
+        if (cancelsOut || pStep->GetPriority() < pQueuedStep->GetPriority())
+        {
+            // If the step is only moving, the new one will want whatever this one prefetched.
+            if (cancelsOut)
+            {
+                pQueuedStep->CancelPrefetch();
+            }
+
+            pQueuedStep->Cancel();
+            stepByResourceKeyMap.erase(iter);
+            count--;
+        }
+
+        if (cancelsOut || !pQueuedStep->GetIsCancelled())
+        {
+            delete pStep;
+            return;
+        }
+    }
+
+    stepListByPriority[pStep->GetPriority()].push_back(pStep);
+    stepByResourceKeyMap[pStep->GetResourceKey()] = pStep;
+    count++;
+}
+
+void ResourceLoader::LoadStepQueue::AddAll(LoadStepQueue *pOther)
+{
+    for (int priority = 0; priority < LoadResourceStepPriorityCount; priority++)
+    {
+        deque<LoadResourceStep *> &otherStepList = pOther->stepListByPriority[priority];
+
+        for (unsigned int i = 0; i < otherStepList.size(); i++)
+        {
+            if (otherStepList[i]->GetIsCancelled())
+            {
+                delete otherStepList[i];
+            }
+            else
+            {
+                Add(otherStepList[i]);
+            }
+        }
+
+        otherStepList.clear();
+    }
+
+    pOther->stepByResourceKeyMap.clear();
+    pOther->count = 0;
+}
+
+ResourceLoader::LoadResourceStep * ResourceLoader::LoadStepQueue::Peek()
+{
+    for (int priority = 0; priority < LoadResourceStepPriorityCount; priority++)
+    {
+        deque<LoadResourceStep *> &stepList = stepListByPriority[priority];
+
+        while (!stepList.empty() && stepList.front()->GetIsCancelled())
+        {
+            delete stepList.front();
+            stepList.pop_front();
+        }
+
+        if (!stepList.empty())
+        {
+            return stepList.front();
+        }
+    }
+
+    return NULL;
+}
+
+ResourceLoader::LoadResourceStep * ResourceLoader::LoadStepQueue::Pop()
+{
+    LoadResourceStep *pStep = Peek();
+
+    if (pStep != NULL)
+    {
+        stepListByPriority[pStep->GetPriority()].pop_front();
+        stepByResourceKeyMap.erase(pStep->GetResourceKey());
+        count--;
+    }
+
+    return pStep;
+}
+
+void ResourceLoader::LoadStepQueue::GetSteps(unsigned int maxCount, vector<LoadResourceStep *> *pStepList)
+{
+    unsigned int stepCount = 0;
+
+    for (int priority = 0; priority < LoadResourceStepPriorityCount && stepCount < maxCount; priority++)
+    {
+        deque<LoadResourceStep *> &stepList = stepListByPriority[priority];
+
+        for (unsigned int i = 0; i < stepList.size() && stepCount < maxCount; i++)
+        {
+            if (!stepList[i]->GetIsCancelled())
+            {
+                pStepList->push_back(stepList[i]);
+                stepCount++;
+            }
+        }
+    }
+}
+
+void ResourceLoader::LoadStepQueue::Clear()
+{
+    for (int priority = 0; priority < LoadResourceStepPriorityCount; priority++)
+    {
+        for (unsigned int i = 0; i < stepListByPriority[priority].size(); i++)
+        {
+            delete stepListByPriority[priority][i];
+        }
+
+        stepListByPriority[priority].clear();
+    }
+
+    stepByResourceKeyMap.clear();
+    count = 0;
+}
+
 void ResourceLoader::Close()
 {
     delete pInstance;
@@ -69,25 +356,46 @@ bool ResourceLoader::Init(string commonResourcesFilePath)
     }
 
     this->pCommonResourcesSource = pCommonResourcesSource;
+    decodedImageCache.Init(GetDecodedImageCacheFolderPath(), MaxDecodedImageCacheSize);
+
+    // Until a case is mounted, the index covers just the common archive.
+    SwapCaseResourcesSource(NULL);
     return true;
 }
 
 bool ResourceLoader::LoadCase(string caseFilePath)
 {
-    bool retVal;
+    ArchiveSource *pNewCaseResourcesSource = NULL;
 
-    SDL_SemWait(pLoadingSemaphore);
-    delete pCaseResourcesSource;
-    retVal = ArchiveSource::CreateAndInit(caseFilePath, &pCaseResourcesSource);
-    SDL_SemPost(pLoadingSemaphore);
+    // Anything we decoded ahead of time may have come from the old case's files.
+    FlushPrefetchedImages();
+    FinishAudioPreloads();
+
+    // Switching cases is as good a time as any to record which cached images we've used,
+    // in case we don't get the chance to when we exit.
+    decodedImageCache.SaveIndex();
+
+    // We'll open the new archive before swapping it in, so nobody else has to wait on that.
+    bool retVal = ArchiveSource::CreateAndInit(caseFilePath, &pNewCaseResourcesSource);
+    SwapCaseResourcesSource(retVal ? pNewCaseResourcesSource : NULL);
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_ARCHIVE_BENCHMARK
+    if (retVal)
+    {
+        pNewCaseResourcesSource->BenchmarkExtraction();
+    }
+    #endif
+#endif
 
     return retVal;
 }
 
 bool ResourceLoader::LoadTemporaryCase(string caseFilePath)
 {
-    pCachedCaseResourcesSource = pCaseResourcesSource;
-    pCaseResourcesSource = NULL;
+    // Our reference to the current case's archive keeps it around
+    // until we switch back to it in UnloadTemporaryCase().
+    pCachedCaseResourcesSource = AcquireCaseResourcesSource();
 
     bool retVal = LoadCase(caseFilePath);
 
@@ -101,17 +409,17 @@ bool ResourceLoader::LoadTemporaryCase(string caseFilePath)
 
 void ResourceLoader::UnloadTemporaryCase()
 {
-    delete pCaseResourcesSource;
-    pCaseResourcesSource = pCachedCaseResourcesSource;
+    FlushPrefetchedImages();
+
+    SwapCaseResourcesSource(pCachedCaseResourcesSource);
     pCachedCaseResourcesSource = NULL;
 }
 
 void ResourceLoader::UnloadCase()
 {
-    SDL_SemWait(pLoadingSemaphore);
-    delete pCaseResourcesSource;
-    pCaseResourcesSource = NULL;
-    SDL_SemPost(pLoadingSemaphore);
+    FlushPrefetchedImages();
+    FinishAudioPreloads();
+    SwapCaseResourcesSource(NULL);
 }
 
 SDL_Surface * ResourceLoader::LoadRawSurface(string relativeFilePath)
@@ -119,64 +427,46 @@ SDL_Surface * ResourceLoader::LoadRawSurface(string relativeFilePath)
     void *pMemToFree = NULL;
     SDL_RWops * pRW = NULL;
 
-    SDL_SemWait(pLoadingSemaphore);
-    pRW = pCommonResourcesSource->LoadFile(relativeFilePath,&pMemToFree);
-    SDL_SemPost(pLoadingSemaphore);
+    pRW = LoadFile(relativeFilePath,&pMemToFree);
 
     if(pRW==NULL) return NULL;
     SDL_Surface * pSurface = IMG_Load_RW(pRW,1);
     return pSurface;
 }
 
-Image * ResourceLoader::LoadImage(string relativeFilePath)
+Image * ResourceLoader::LoadImage(string relativeFilePath, bool loadImmediately)
 {
-    SDL_RWops *pRW = NULL;
-    void *pMemToFree = NULL;
-
-    SDL_SemWait(pLoadingSemaphore);
-    pRW = pCommonResourcesSource->LoadFile(relativeFilePath, &pMemToFree);
+    SDL_Surface *pSurface = NULL;
+    bool fileExists = false;
 
-    if (pRW == NULL && pCaseResourcesSource != NULL)
+    if (!TakePrefetchedSurface(relativeFilePath, &pSurface, &fileExists))
     {
-        pRW = pCaseResourcesSource->LoadFile(relativeFilePath, &pMemToFree);
+        pSurface = LoadSurface(relativeFilePath, &fileExists);
     }
-    SDL_SemPost(pLoadingSemaphore);
 
-    if (pRW == NULL)
+    if (!fileExists)
     {
         return NULL;
     }
 
-    Image *pSprite = Image::Load(pRW);
+    Image *pSprite = Image::Load(pSurface, loadImmediately);
     pSprite->FlagResourceLoaderSource(relativeFilePath);
-    free(pMemToFree);
     return pSprite;
 }
 
 void ResourceLoader::ReloadImage(Image *pSprite, string originFilePath)
 {
-    SDL_RWops *pRW = NULL;
-    void *pMemToFree = NULL;
-
-    SDL_SemWait(pLoadingSemaphore);
-    pRW = pCommonResourcesSource->LoadFile(originFilePath, &pMemToFree);
-
-    if (pRW == NULL && pCaseResourcesSource != NULL)
-    {
-        pRW = pCaseResourcesSource->LoadFile(originFilePath, &pMemToFree);
-    }
-    SDL_SemPost(pLoadingSemaphore);
+    bool fileExists = false;
+    SDL_Surface *pSurface = LoadSurface(originFilePath, &fileExists);
 
-    if (pRW == NULL)
+    if (!fileExists)
     {
         pSprite->UnloadTextures();
     }
     else
     {
-        pSprite->Reload(pRW, false /* loadImmediately */);
+        pSprite->Reload(pSurface, false /* loadImmediately */);
     }
-
-    free(pMemToFree);
 }
 
 Document * ResourceLoader::LoadDocument(string relativeFilePath)
@@ -186,17 +476,26 @@ Document * ResourceLoader::LoadDocument(string relativeFilePath)
 
     if (pLoadingSemaphore != NULL)
     {
-        SDL_SemWait(pLoadingSemaphore);
-        if (pCaseResourcesSource != NULL)
+        // Documents describe the case, so they only ever come from the case's own archive.
+        AssetIndex *pAssetIndex = AcquireAssetIndex();
+
+        if (pAssetIndex != NULL)
         {
-            pRW = pCaseResourcesSource->LoadFile(relativeFilePath,&pMemToFree);
+            int entryIndex = -1;
+
+            if (pAssetIndex->TryResolveCaseFile(relativeFilePath, &entryIndex))
+            {
+                pRW = pAssetIndex->LoadFile(entryIndex, &pMemToFree);
+            }
+
+            pAssetIndex->Release();
         }
-        SDL_SemPost(pLoadingSemaphore);
     }
 
     if (pRW == NULL) return NULL;
     Document * pDocument = new Document();
     pDocument->LoadFile(pRW);
+    SDL_RWclose(pRW);
     free(pMemToFree);
     return pDocument;
 }
@@ -206,14 +505,7 @@ TTF_Font * ResourceLoader::LoadFont(string relativeFilePath, int ptSize)
     void *pMemToFree = NULL;
     SDL_RWops * pRW = NULL;
 
-    SDL_SemWait(pLoadingSemaphore);
-    pRW = pCommonResourcesSource->LoadFile(relativeFilePath, &pMemToFree);
-
-    if (pRW == NULL && pCaseResourcesSource != NULL)
-    {
-        pRW = pCaseResourcesSource->LoadFile(relativeFilePath, &pMemToFree);
-    }
-    SDL_SemPost(pLoadingSemaphore);
+    pRW = LoadFile(relativeFilePath, &pMemToFree);
     if (pRW == NULL) return NULL;
     TTF_Font *pFont = TTF_OpenFontRW(pRW, 1, ptSize);
     return pFont;
@@ -221,12 +513,14 @@ TTF_Font * ResourceLoader::LoadFont(string relativeFilePath, int ptSize)
 
 void ResourceLoader::LoadVideo(
     string relativeFilePath,
+    int codecThreadCount,
     RWOpsIOContext **ppRWOpsIOContext,
     AVFormatContext **ppFormatContext,
     int *pVideoStream,
     AVCodecContext **ppCodecContext,
     AVCodec **ppCodec,
-    void **ppMemToFree)
+    void **ppMemToFree,
+    AssetHandle *pAssetHandle)
 {
     *ppRWOpsIOContext = NULL;
     *ppFormatContext = NULL;
@@ -238,14 +532,9 @@ void ResourceLoader::LoadVideo(
     void *pMemToFree = NULL;
     SDL_RWops *pRW = NULL;
 
-    SDL_SemWait(pLoadingSemaphore);
-    pRW = pCommonResourcesSource->LoadFile(relativeFilePath, &pMemToFree);
-
-    if (pRW == NULL && pCaseResourcesSource != NULL)
-    {
-        pRW = pCaseResourcesSource->LoadFile(relativeFilePath, &pMemToFree);
-    }
-    SDL_SemPost(pLoadingSemaphore);
+    // Videos are read a little at a time as they play, so rather than extract the whole file,
+    // we'll read it out of the archive as we go.  pMemToFree is only set if the file can't be streamed.
+    pRW = LoadFileStream(relativeFilePath, &pMemToFree, pAssetHandle);
 
     if (pRW == NULL) return;
 
@@ -279,15 +568,31 @@ void ResourceLoader::LoadVideo(
 
     for (unsigned int i = 0; i < pFormatContext->nb_streams; i++)
     {
-        if (pFormatContext->streams[i]->codec->codec_type == AVMEDIA_TYPE_VIDEO)
+        if (pFormatContext->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
         {
             videoStream = i;
             break;
         }
     }
 
-    AVCodecContext *pCodecContext = pFormatContext->streams[videoStream]->codec;
-    AVCodec *pCodec = avcodec_find_decoder(pCodecContext->codec_id);
+    AVCodecParameters *pCodecParameters = pFormatContext->streams[videoStream]->codecpar;
+    AVCodec *pCodec = avcodec_find_decoder(pCodecParameters->codec_id);
+    AVCodecContext *pCodecContext = avcodec_alloc_context3(pCodec);
+
+    if (avcodec_parameters_to_context(pCodecContext, pCodecParameters) < 0)
+    {
+        throw Exception("Couldn't set up codec!");
+    }
+
+    // Frame threading lets several frames decode at once, at the cost of the decoder
+    // holding onto that many frames before handing any back.  Slice threading splits up
+    // each frame instead, for codecs that support it.
+    pCodecContext->thread_count = codecThreadCount;
+    pCodecContext->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+    // Videos hold onto decoded frames past the next call to the decoder,
+    // so we need the decoder to hand us references it won't reuse.
+    pCodecContext->refcounted_frames = 1;
 
     if (avcodec_open2(pCodecContext, pCodec, NULL) < 0)
     {
@@ -304,134 +609,133 @@ void ResourceLoader::LoadVideo(
 
 void ResourceLoader::PreloadMusic(string id, string relativeFilePath)
 {
-    SDL_RWops *pRWA = NULL;
-    SDL_RWops *pRWB = NULL;
-    void *pMemToFreeA = NULL;
-    void *pMemToFreeB = NULL;
-
-    SDL_SemWait(pLoadingSemaphore);
-    pRWA = pCommonResourcesSource->LoadFile(relativeFilePath + "A.ogg", &pMemToFreeA);
-
-    if (pRWA == NULL && pCaseResourcesSource != NULL)
-    {
-        pRWA = pCaseResourcesSource->LoadFile(relativeFilePath + "A.ogg", &pMemToFreeA);
-        pRWB = pCaseResourcesSource->LoadFile(relativeFilePath + "B.ogg", &pMemToFreeB);
-    }
-    else
-    {
-        pRWB = pCommonResourcesSource->LoadFile(relativeFilePath + "B.ogg", &pMemToFreeB);
-    }
-    SDL_SemPost(pLoadingSemaphore);
-
-    if (pRWA == NULL || pRWB == NULL)
-    {
-        return;
-    }
-
-    preloadMusic(id, pRWA, pRWB);
-
-    musicIdToMemToFreeMap[id + "_A"] = pMemToFreeA;
-    musicIdToMemToFreeMap[id + "_B"] = pMemToFreeB;
+    QueueAudioPreload(AudioTypeMusic, id, relativeFilePath);
 }
 
 void ResourceLoader::UnloadMusic(string id)
 {
+    FinishAudioPreload(AudioTypeMusic, id, false /* runIfQueued */);
     unloadMusic(id);
 
+    SDL_SemWait(pAudioPreloadSemaphore);
     free(musicIdToMemToFreeMap[id + "_A"]);
     free(musicIdToMemToFreeMap[id + "_B"]);
 
     musicIdToMemToFreeMap.erase(id + "_A");
     musicIdToMemToFreeMap.erase(id + "_B");
+    SDL_SemPost(pAudioPreloadSemaphore);
 }
 
 void ResourceLoader::PreloadSound(string id, string relativeFilePath)
 {
-    SDL_RWops *pRW = NULL;
-    void *pMemToFree = NULL;
-
-    SDL_SemWait(pLoadingSemaphore);
-    pRW = pCommonResourcesSource->LoadFile(relativeFilePath + ".ogg", &pMemToFree);
-
-    if (pRW == NULL && pCaseResourcesSource != NULL)
-    {
-        pRW = pCaseResourcesSource->LoadFile(relativeFilePath + ".ogg", &pMemToFree);
-    }
-    SDL_SemPost(pLoadingSemaphore);
-
-    if (pRW == NULL)
-    {
-        return;
-    }
-
-    preloadSound(id, pRW);
-    free(pMemToFree);
+    QueueAudioPreload(AudioTypeSound, id, relativeFilePath);
 }
 
 void ResourceLoader::UnloadSound(string id)
 {
+    FinishAudioPreload(AudioTypeSound, id, false /* runIfQueued */);
     unloadSound(id);
 }
 
 void ResourceLoader::PreloadDialog(string id, string relativeFilePath)
 {
-    SDL_RWops *pRW = NULL;
-    void *pMemToFree = NULL;
-
-    SDL_SemWait(pLoadingSemaphore);
-    pRW = pCommonResourcesSource->LoadFile(relativeFilePath + ".ogg", &pMemToFree);
-
-    if (pRW == NULL && pCaseResourcesSource != NULL)
-    {
-        pRW = pCaseResourcesSource->LoadFile(relativeFilePath + ".ogg", &pMemToFree);
-    }
-    SDL_SemPost(pLoadingSemaphore);
-
-    if (pRW == NULL)
-    {
-        return;
-    }
-
-    preloadDialog(id, pRW);
-    free(pMemToFree);
+    QueueAudioPreload(AudioTypeDialog, id, relativeFilePath);
 }
 
 void ResourceLoader::UnloadDialog(string id)
 {
+    FinishAudioPreload(AudioTypeDialog, id, false /* runIfQueued */);
     unloadDialog(id);
 }
 
-void * ResourceLoader::LoadFileToMemory(string relativeFilePath, unsigned int *pFileSize)
+void ResourceLoader::WaitForAudioPreload(AudioType type, const string &id)
 {
-    void *p = NULL;
-    unsigned int fileSize = 0;
-
-    SDL_SemWait(pLoadingSemaphore);
-    p = pCommonResourcesSource->LoadFileToMemory(relativeFilePath, &fileSize);
+    FinishAudioPreload(type, id, true /* runIfQueued */);
+}
 
-    if (p == NULL && pCaseResourcesSource != NULL)
+void ResourceLoader::FinishAudioPreloads()
+{
+    // Anything still queued belongs to the case we're about to switch away from,
+    // so we'll load it now, while its files are still the ones we'd find.
+    while (true)
     {
-        p = pCaseResourcesSource->LoadFileToMemory(relativeFilePath, &fileSize);
-    }
-    SDL_SemPost(pLoadingSemaphore);
+        SDL_SemWait(pAudioPreloadSemaphore);
 
-    *pFileSize = fileSize;
-    return p;
+        if (!audioPreloadQueue.empty())
+        {
+            AudioPreload *pAudioPreload = audioPreloadQueue.front();
+            audioPreloadQueue.pop_front();
+            pAudioPreload->state = AudioPreloadStateLoading;
+            SDL_SemPost(pAudioPreloadSemaphore);
+
+            RunAudioPreload(pAudioPreload);
+        }
+        else if (!audioPreloadByKeyMap.empty())
+        {
+            // Everything left is already being loaded by an audio preload thread.
+            AudioPreload *pAudioPreload = audioPreloadByKeyMap.begin()->second;
+            pAudioPreload->waiterCount++;
+            SDL_SemPost(pAudioPreloadSemaphore);
+
+            WaitForAudioPreloadToLoad(pAudioPreload);
+        }
+        else
+        {
+            SDL_SemPost(pAudioPreloadSemaphore);
+            break;
+        }
+    }
 }
 
-void ResourceLoader::HashFile(string relativeFilePath, byte hash[CryptoPP::SHA256::DIGESTSIZE])
+bool ResourceLoader::HasAudioPreloads()
+{
+    bool hasAudioPreloads = false;
+
+    SDL_SemWait(pAudioPreloadSemaphore);
+    hasAudioPreloads = !audioPreloadByKeyMap.empty();
+    SDL_SemPost(pAudioPreloadSemaphore);
+
+    return hasAudioPreloads;
+}
+
+void * ResourceLoader::LoadFileToMemory(string relativeFilePath, unsigned int *pFileSize)
 {
     void *p = NULL;
     unsigned int fileSize = 0;
+    AssetIndex *pAssetIndex = AcquireAssetIndex();
 
-    SDL_SemWait(pLoadingSemaphore);
-    p = pCommonResourcesSource->LoadFileToMemory(relativeFilePath, &fileSize);
+    if (pAssetIndex != NULL)
+    {
+        int entryIndex = -1;
+
+        if (pAssetIndex->TryResolve(relativeFilePath, &entryIndex))
+        {
+            p = pAssetIndex->LoadFileToMemory(entryIndex, &fileSize);
+        }
+
+        pAssetIndex->Release();
+    }
+
+    *pFileSize = fileSize;
+    return p;
+}
+
+void ResourceLoader::ResolveAsset(string relativeFilePath, AssetHandle *pAssetHandle)
+{
+    AssetIndex *pAssetIndex = AcquireAssetIndex();
 
-    if (p == NULL && pCaseResourcesSource != NULL)
+    if (pAssetIndex != NULL)
     {
-        p = pCaseResourcesSource->LoadFileToMemory(relativeFilePath, &fileSize);
+        int entryIndex = -1;
+        TryResolveAsset(pAssetIndex, relativeFilePath, pAssetHandle, &entryIndex);
+        pAssetIndex->Release();
     }
-    SDL_SemPost(pLoadingSemaphore);
+}
+
+void ResourceLoader::HashFile(string relativeFilePath, byte hash[CryptoPP::SHA256::DIGESTSIZE])
+{
+    unsigned int fileSize = 0;
+    void *p = LoadFileToMemory(relativeFilePath, &fileSize);
 
     if (p != NULL)
     {
@@ -451,6 +755,7 @@ void ResourceLoader::AddImage(Image *pImage)
 {
     SDL_SemWait(pQueueSemaphore);
     smartSpriteQueue.push_back(pImage);
+    SDL_AtomicSet(&imageTexturesToLoadCount, (int)smartSpriteQueue.size());
     SDL_SemPost(pQueueSemaphore);
 }
 
@@ -466,6 +771,8 @@ void ResourceLoader::RemoveImage(Image *pImage)
         }
     }
 
+    SDL_AtomicSet(&imageTexturesToLoadCount, (int)smartSpriteQueue.size());
+
     SDL_SemPost(pQueueSemaphore);
 }
 
@@ -477,116 +784,160 @@ void ResourceLoader::TryLoadOneImageTexture()
     {
         Image *pImage = smartSpriteQueue.front();
         smartSpriteQueue.pop_front();
+        SDL_AtomicSet(&imageTexturesToLoadCount, (int)smartSpriteQueue.size());
 
+        Uint64 startTime = SDL_GetPerformanceCounter();
         pImage->LoadTextures();
+
+        SDL_AtomicAdd(&uploadMicroseconds, GetMicrosecondsSince(startTime));
+        SDL_AtomicAdd(&texturesUploadedCount, 1);
     }
 
     SDL_SemPost(pQueueSemaphore);
 }
 
-bool ResourceLoader::HasImageTexturesToLoad()
+void ResourceLoader::TryLoadImageTextures(double timeBudgetMs)
 {
-    bool hasImageTexturesToLoad;
+    Uint64 startTime = SDL_GetPerformanceCounter();
 
-    SDL_SemWait(pQueueSemaphore);
-    hasImageTexturesToLoad = !smartSpriteQueue.empty();
-    SDL_SemPost(pQueueSemaphore);
+    // We'll always upload at least one texture, so we keep making progress
+    // even if a single upload takes longer than the whole budget.
+    do
+    {
+        TryLoadOneImageTexture();
+    }
+    while (HasImageTexturesToLoad() && GetMillisecondsSince(startTime) < timeBudgetMs);
+}
 
-    return hasImageTexturesToLoad;
+bool ResourceLoader::HasImageTexturesToLoad()
+{
+    // Sprites ask this every time they're drawn, by way of Case::IsLoading(), so it mustn't take a lock.
+    return SDL_AtomicGet(&imageTexturesToLoadCount) > 0;
 }
 
 void ResourceLoader::FlushImages()
 {
     SDL_SemWait(pQueueSemaphore);
     smartSpriteQueue.clear();
+    SDL_AtomicSet(&imageTexturesToLoadCount, 0);
     SDL_SemPost(pQueueSemaphore);
 }
 
-void ResourceLoader::AddImageIdToLoadList(string id)
+void ResourceLoader::PrefetchImage(string relativeFilePath)
 {
-    if (id.length() == 0)
+    if (relativeFilePath.length() == 0)
     {
         return;
     }
 
-    SDL_SemWait(pLoadQueueSemaphore);
-    bool alreadyExists = false;
+    EnsureImageDecodeThreadsStarted();
+
+    SDL_SemWait(pPrefetchSemaphore);
 
-    for (unsigned int i = 0; i < loadResourceStepList.size(); i++)
+    if (prefetchedImageByFilePathMap.count(relativeFilePath) == 0)
     {
-        LoadImageStep *pStep = dynamic_cast<LoadImageStep *>(loadResourceStepList[i]);
+        PrefetchedImage *pPrefetchedImage = new PrefetchedImage(relativeFilePath);
 
-        if (pStep != NULL && pStep->GetSpriteId() == id)
-        {
-            alreadyExists = true;
-            break;
-        }
+        prefetchedImageByFilePathMap[relativeFilePath] = pPrefetchedImage;
+        imageDecodeQueue.push_back(pPrefetchedImage);
+        SDL_SemPost(pImageDecodesAvailableSemaphore);
     }
 
-    if (!alreadyExists)
-    {
-        loadResourceStepList.push_back(new LoadImageStep(id));
-    }
-    SDL_SemPost(pLoadQueueSemaphore);
+    SDL_SemPost(pPrefetchSemaphore);
 }
 
-void ResourceLoader::AddImageIdToDeleteList(string id)
+bool ResourceLoader::IsPrefetchedImagePending(string relativeFilePath)
 {
-    if (id.length() == 0)
-    {
-        return;
-    }
+    bool isPending = false;
 
-    SDL_SemWait(pLoadQueueSemaphore);
-    bool alreadyExists = false;
+    SDL_SemWait(pPrefetchSemaphore);
+    map<string, PrefetchedImage *>::iterator iter = prefetchedImageByFilePathMap.find(relativeFilePath);
+    isPending = iter != prefetchedImageByFilePathMap.end() && iter->second->state != PrefetchedImageStateDecoded;
+    SDL_SemPost(pPrefetchSemaphore);
+
+    return isPending;
+}
 
-    for (unsigned int i = 0; i < loadResourceStepList.size(); i++)
+void ResourceLoader::CancelPrefetchedImage(string relativeFilePath)
+{
+    SDL_SemWait(pPrefetchSemaphore);
+
+    map<string, PrefetchedImage *>::iterator iter = prefetchedImageByFilePathMap.find(relativeFilePath);
+
+    if (iter != prefetchedImageByFilePathMap.end())
     {
-        DeleteImageStep *pStep = dynamic_cast<DeleteImageStep *>(loadResourceStepList[i]);
+        PrefetchedImage *pPrefetchedImage = iter->second;
+        prefetchedImageByFilePathMap.erase(iter);
 
-        if (pStep != NULL && pStep->GetSpriteId() == id)
+        if (pPrefetchedImage->state == PrefetchedImageStateQueued)
         {
-            alreadyExists = true;
-            break;
+            imageDecodeQueue.erase(find(imageDecodeQueue.begin(), imageDecodeQueue.end(), pPrefetchedImage));
+            delete pPrefetchedImage;
+        }
+        else if (pPrefetchedImage->state == PrefetchedImageStateDecoding)
+        {
+            pPrefetchedImage->isCancelled = true;
+        }
+        else
+        {
+            delete pPrefetchedImage;
         }
     }
 
-    if (!alreadyExists)
+    SDL_SemPost(pPrefetchSemaphore);
+}
+
+void ResourceLoader::FlushPrefetchedImages()
+{
+    SDL_SemWait(pPrefetchSemaphore);
+
+    for (map<string, PrefetchedImage *>::iterator iter = prefetchedImageByFilePathMap.begin(); iter != prefetchedImageByFilePathMap.end(); ++iter)
     {
-        loadResourceStepList.push_back(new DeleteImageStep(id));
+        PrefetchedImage *pPrefetchedImage = iter->second;
+
+        // Images that are being decoded belong to the decode thread until it's done with them,
+        // so we'll just let it know to throw the result away.
+        if (pPrefetchedImage->state == PrefetchedImageStateDecoding)
+        {
+            pPrefetchedImage->isCancelled = true;
+        }
+        else
+        {
+            delete pPrefetchedImage;
+        }
     }
-    SDL_SemPost(pLoadQueueSemaphore);
+
+    prefetchedImageByFilePathMap.clear();
+    imageDecodeQueue.clear();
+
+    SDL_SemPost(pPrefetchSemaphore);
 }
 
-void ResourceLoader::AddVideoToLoadList(Video *pVideo)
+void ResourceLoader::AddImageIdToLoadList(string id, LoadResourceStepPriority priority)
 {
-    if (pVideo == NULL)
+    if (id.length() == 0)
     {
         return;
     }
 
     SDL_SemWait(pLoadQueueSemaphore);
-    bool alreadyExists = false;
+    loadStepQueue.Add(new LoadImageStep(id, priority));
+    SDL_SemPost(pLoadQueueSemaphore);
+}
 
-    for (unsigned int i = 0; i < loadResourceStepList.size(); i++)
+void ResourceLoader::AddImageIdToDeleteList(string id)
+{
+    if (id.length() == 0)
     {
-        LoadVideoStep *pStep = dynamic_cast<LoadVideoStep *>(loadResourceStepList[i]);
-
-        if (pStep != NULL && pStep->GetVideo() == pVideo)
-        {
-            alreadyExists = true;
-            break;
-        }
+        return;
     }
 
-    if (!alreadyExists)
-    {
-        loadResourceStepList.push_back(new LoadVideoStep(pVideo));
-    }
+    SDL_SemWait(pLoadQueueSemaphore);
+    loadStepQueue.Add(new DeleteImageStep(id));
     SDL_SemPost(pLoadQueueSemaphore);
 }
 
-void ResourceLoader::AddVideoToDeleteList(Video *pVideo)
+void ResourceLoader::AddVideoToLoadList(Video *pVideo)
 {
     if (pVideo == NULL)
     {
@@ -594,130 +945,2211 @@ void ResourceLoader::AddVideoToDeleteList(Video *pVideo)
     }
 
     SDL_SemWait(pLoadQueueSemaphore);
-    bool alreadyExists = false;
+    loadStepQueue.Add(new LoadVideoStep(pVideo));
+    SDL_SemPost(pLoadQueueSemaphore);
+}
 
-    for (unsigned int i = 0; i < loadResourceStepList.size(); i++)
+void ResourceLoader::AddVideoToDeleteList(Video *pVideo)
+{
+    if (pVideo == NULL)
     {
-        DeleteVideoStep *pStep = dynamic_cast<DeleteVideoStep *>(loadResourceStepList[i]);
-
-        if (pStep != NULL && pStep->GetVideo() == pVideo)
-        {
-            alreadyExists = true;
-            break;
-        }
+        return;
     }
 
-    if (!alreadyExists)
-    {
-        loadResourceStepList.push_back(new DeleteVideoStep(pVideo));
-    }
+    SDL_SemWait(pLoadQueueSemaphore);
+    loadStepQueue.Add(new DeleteVideoStep(pVideo));
     SDL_SemPost(pLoadQueueSemaphore);
 }
 
 void ResourceLoader::SnapLoadStepQueue()
 {
+    // Steps that cancel out steps we've already prefetched will cancel their prefetches,
+    // which takes the background load queue's lock, so we'll add them once we've let go of ours.
+    LoadStepQueue snappedLoadStepQueue;
+
     SDL_SemWait(pLoadQueueSemaphore);
-    for (unsigned int i = 0; i < loadResourceStepList.size(); i++)
-    {
-        cachedLoadResourceStepList.push_back(loadResourceStepList[i]);
-    }
-    loadResourceStepList.clear();
+    snappedLoadStepQueue.AddAll(&loadStepQueue);
     SDL_SemPost(pLoadQueueSemaphore);
+
+    cachedLoadStepQueue.AddAll(&snappedLoadStepQueue);
 }
 
 bool ResourceLoader::HasLoadStep()
 {
-    return !cachedLoadResourceStepList.empty();
+    return !cachedLoadStepQueue.IsEmpty();
 }
 
 void ResourceLoader::TryRunOneLoadStep()
 {
     if (HasLoadStep())
     {
-        LoadResourceStep *pStep = cachedLoadResourceStepList.front();
+        PrefetchUpcomingLoadSteps();
+
+        Uint64 startTime = SDL_GetPerformanceCounter();
+        LoadResourceStep *pStep = cachedLoadStepQueue.Pop();
         pStep->Execute();
-        cachedLoadResourceStepList.pop_front();
         delete pStep;
+
+        SDL_AtomicAdd(&loadStepMicroseconds, GetMicrosecondsSince(startTime));
+        SDL_AtomicAdd(&loadStepsRunCount, 1);
     }
 }
 
-ResourceLoader::ResourceLoader()
+void ResourceLoader::TryRunLoadSteps(double timeBudgetMs)
 {
-    pCommonResourcesSource = NULL;
-    pCaseResourcesSource = NULL;
-    pCachedCaseResourcesSource = NULL;
+    Uint64 startTime = SDL_GetPerformanceCounter();
 
-    pLoadingSemaphore = SDL_CreateSemaphore(1);
-    pQueueSemaphore = SDL_CreateSemaphore(1);
-    pLoadQueueSemaphore = SDL_CreateSemaphore(1);
+    do
+    {
+        TryRunOneLoadStep();
+    }
+    while (HasLoadStep() && GetMillisecondsSince(startTime) < timeBudgetMs);
 }
 
-ResourceLoader::~ResourceLoader()
+void ResourceLoader::ClearBackgroundLoadSteps()
 {
-    delete pCommonResourcesSource;
-    pCommonResourcesSource = NULL;
-    delete pCaseResourcesSource;
-    pCaseResourcesSource = NULL;
-
-    SDL_DestroySemaphore(pLoadingSemaphore);
-    pLoadingSemaphore = NULL;
-    SDL_DestroySemaphore(pQueueSemaphore);
-    pQueueSemaphore = NULL;
-    SDL_DestroySemaphore(pLoadQueueSemaphore);
-    pLoadQueueSemaphore = NULL;
+    SDL_SemWait(pBackgroundLoadQueueSemaphore);
+    backgroundLoadStepQueue.Clear();
+    SDL_SemPost(pBackgroundLoadQueueSemaphore);
 
-    smartSpriteQueue.clear();
-    deleteTextureQueue.clear();
+    CancelUnneededBackgroundPrefetches();
 }
 
-ResourceLoader::ArchiveSource::~ArchiveSource()
+void ResourceLoader::AddImageIdToBackgroundLoadList(string id)
 {
-    mz_zip_reader_end(&zip_archive);
+    if (id.length() == 0)
+    {
+        return;
+    }
+
+    SDL_SemWait(pBackgroundLoadQueueSemaphore);
+    backgroundLoadStepQueue.Add(new LoadImageStep(id, LoadResourceStepPriorityNormal, true /* isBackground */));
+    SDL_SemPost(pBackgroundLoadQueueSemaphore);
 }
 
-bool ResourceLoader::ArchiveSource::CreateAndInit(string archiveFilePath, ArchiveSource **ppSource)
+void ResourceLoader::AddVideoToBackgroundLoadList(Video *pVideo)
 {
-    ArchiveSource *pSource = new ArchiveSource();
-
-    if (!pSource->Init(archiveFilePath))
+    if (pVideo == NULL)
     {
-        delete pSource;
-        return false;
+        return;
     }
 
-    *ppSource = pSource;
-    return true;
+    SDL_SemWait(pBackgroundLoadQueueSemaphore);
+    backgroundLoadStepQueue.Add(new LoadVideoStep(pVideo));
+    SDL_SemPost(pBackgroundLoadQueueSemaphore);
 }
 
-SDL_RWops * ResourceLoader::ArchiveSource::LoadFile(string relativeFilePath, void **ppMemToFree)
+void ResourceLoader::CancelUnneededBackgroundPrefetches()
 {
-    size_t uncomp_size = 0;
-    void *p = mz_zip_reader_extract_file_to_heap(&zip_archive, relativeFilePath.c_str(), &uncomp_size, 0);
+    // Images that the background load steps have started decoding, and videos that they've started opening,
+    // are still wanted if a background load step or a regular load step is still going to load them.
+    set<string> stillPrefetchedFilePathSet;
+    set<string> neededFilePathSet;
+    set<Video *> stillPrefetchedVideoSet;
+    set<Video *> neededVideoSet;
+    vector<LoadResourceStep *> stepList;
+
+    SDL_SemWait(pBackgroundLoadQueueSemaphore);
+    backgroundLoadStepQueue.GetSteps(backgroundLoadStepQueue.GetCount(), &stepList);
+
+    for (unsigned int i = 0; i < stepList.size(); i++)
+    {
+        LoadImageStep *pStep = dynamic_cast<LoadImageStep *>(stepList[i]);
+        LoadVideoStep *pVideoStep = dynamic_cast<LoadVideoStep *>(stepList[i]);
 
-    if (p == NULL)
+        if (pStep != NULL && pStep->GetIsPrefetched())
+        {
+            stillPrefetchedFilePathSet.insert(pStep->GetFilePath());
+        }
+        else if (pVideoStep != NULL && pVideoStep->GetIsPrefetched())
+        {
+            stillPrefetchedVideoSet.insert(pVideoStep->GetVideo());
+        }
+    }
+
+    stepList.clear();
+
+    SDL_SemWait(pLoadQueueSemaphore);
+    loadStepQueue.GetSteps(loadStepQueue.GetCount(), &stepList);
+    SDL_SemPost(pLoadQueueSemaphore);
+
+    cachedLoadStepQueue.GetSteps(cachedLoadStepQueue.GetCount(), &stepList);
+
+    for (unsigned int i = 0; i < stepList.size(); i++)
     {
-        return NULL;
+        LoadImageStep *pStep = dynamic_cast<LoadImageStep *>(stepList[i]);
+        LoadVideoStep *pVideoStep = dynamic_cast<LoadVideoStep *>(stepList[i]);
+
+        if (pStep != NULL)
+        {
+            neededFilePathSet.insert(pStep->GetFilePath());
+        }
+        else if (pVideoStep != NULL)
+        {
+            neededVideoSet.insert(pVideoStep->GetVideo());
+        }
     }
 
-    *ppMemToFree = p;
-    return SDL_RWFromMem(p, (unsigned int)uncomp_size);
+    for (set<string>::iterator iter = backgroundPrefetchedFilePathSet.begin(); iter != backgroundPrefetchedFilePathSet.end(); ++iter)
+    {
+        if (stillPrefetchedFilePathSet.count(*iter) == 0 && neededFilePathSet.count(*iter) == 0)
+        {
+            CancelPrefetchedImage(*iter);
+        }
+    }
+
+    for (set<Video *>::iterator iter = backgroundPrefetchedVideoSet.begin(); iter != backgroundPrefetchedVideoSet.end(); ++iter)
+    {
+        if (stillPrefetchedVideoSet.count(*iter) == 0 && neededVideoSet.count(*iter) == 0)
+        {
+            (*iter)->CancelPrefetch();
+        }
+    }
+
+    backgroundPrefetchedFilePathSet = stillPrefetchedFilePathSet;
+    backgroundPrefetchedVideoSet = stillPrefetchedVideoSet;
+    SDL_SemPost(pBackgroundLoadQueueSemaphore);
 }
 
-void * ResourceLoader::ArchiveSource::LoadFileToMemory(string relativeFilePath, unsigned int *pSize)
+bool ResourceLoader::IsBackgroundPrefetch(const string &relativeFilePath)
 {
-    size_t uncomp_size = 0;
-    void *p = mz_zip_reader_extract_file_to_heap(&zip_archive, relativeFilePath.c_str(), &uncomp_size, 0);
+    bool isBackgroundPrefetch = false;
 
-    if (p == NULL)
+    SDL_SemWait(pBackgroundLoadQueueSemaphore);
+    isBackgroundPrefetch = backgroundPrefetchedFilePathSet.count(relativeFilePath) > 0;
+    SDL_SemPost(pBackgroundLoadQueueSemaphore);
+
+    return isBackgroundPrefetch;
+}
+
+bool ResourceLoader::IsBackgroundPrefetch(Video *pVideo)
+{
+    bool isBackgroundPrefetch = false;
+
+    SDL_SemWait(pBackgroundLoadQueueSemaphore);
+    isBackgroundPrefetch = backgroundPrefetchedVideoSet.count(pVideo) > 0;
+    SDL_SemPost(pBackgroundLoadQueueSemaphore);
+
+    return isBackgroundPrefetch;
+}
+
+bool ResourceLoader::HasBackgroundLoadStep()
+{
+    bool hasBackgroundLoadStep = false;
+
+    SDL_SemWait(pBackgroundLoadQueueSemaphore);
+    hasBackgroundLoadStep = !backgroundLoadStepQueue.IsEmpty();
+    SDL_SemPost(pBackgroundLoadQueueSemaphore);
+
+    return hasBackgroundLoadStep;
+}
+
+void ResourceLoader::TryRunBackgroundLoadSteps(double timeBudgetMs)
+{
+    // Anything we need right now comes first.
+    if (HasImageTexturesToLoad() || HasLoadStep())
     {
-        return NULL;
+        return;
     }
 
-    *pSize = (unsigned int)uncomp_size;
-    return p;
+    Uint64 startTime = SDL_GetPerformanceCounter();
+
+    SDL_SemWait(pBackgroundLoadQueueSemaphore);
+
+    // We'll never wait on a decode here, so unlike regular load steps,
+    // we want the decode threads working on the step at the front as well.
+    vector<LoadResourceStep *> upcomingStepList;
+    backgroundLoadStepQueue.GetSteps(BackgroundImageDecodeAheadCount, &upcomingStepList);
+
+    for (unsigned int i = 0; i < upcomingStepList.size(); i++)
+    {
+        LoadResourceStep *pStep = upcomingStepList[i];
+        LoadImageStep *pImageStep = dynamic_cast<LoadImageStep *>(pStep);
+        LoadVideoStep *pVideoStep = dynamic_cast<LoadVideoStep *>(pStep);
+
+        pStep->Prefetch();
+
+        if (pImageStep != NULL)
+        {
+            backgroundPrefetchedFilePathSet.insert(pImageStep->GetFilePath());
+        }
+        else if (pVideoStep != NULL)
+        {
+            backgroundPrefetchedVideoSet.insert(pVideoStep->GetVideo());
+        }
+    }
+
+    while (!backgroundLoadStepQueue.IsEmpty() && GetMillisecondsSince(startTime) < timeBudgetMs)
+    {
+        if (!backgroundLoadStepQueue.Peek()->IsReadyToExecute())
+        {
+            break;
+        }
+
+        Uint64 stepStartTime = SDL_GetPerformanceCounter();
+        LoadResourceStep *pStep = backgroundLoadStepQueue.Pop();
+        LoadImageStep *pImageStep = dynamic_cast<LoadImageStep *>(pStep);
+        LoadVideoStep *pVideoStep = dynamic_cast<LoadVideoStep *>(pStep);
+
+        if (pImageStep != NULL)
+        {
+            backgroundPrefetchedFilePathSet.erase(pImageStep->GetFilePath());
+        }
+        else if (pVideoStep != NULL)
+        {
+            backgroundPrefetchedVideoSet.erase(pVideoStep->GetVideo());
+        }
+
+        pStep->Execute();
+        delete pStep;
+
+        SDL_AtomicAdd(&backgroundLoadStepMicroseconds, GetMicrosecondsSince(stepStartTime));
+        SDL_AtomicAdd(&backgroundLoadStepsRunCount, 1);
+    }
+
+    SDL_SemPost(pBackgroundLoadQueueSemaphore);
 }
 
-bool ResourceLoader::ArchiveSource::Init(string archiveFilePath)
+ResourceLoader::Statistics ResourceLoader::GetStatistics()
 {
-    return mz_zip_reader_init_file(&zip_archive, archiveFilePath.c_str(), 0) > 0;
+    Statistics statistics;
+
+    statistics.ImagesDecoded = (unsigned int)SDL_AtomicGet(&imagesDecodedCount);
+    statistics.ImagesDecodedAhead = (unsigned int)SDL_AtomicGet(&imagesDecodedAheadCount);
+    statistics.ImagesWaitedOn = (unsigned int)SDL_AtomicGet(&imagesWaitedOnCount);
+    statistics.ExtractMicroseconds = (unsigned int)SDL_AtomicGet(&extractMicroseconds);
+    statistics.DecodeMicroseconds = (unsigned int)SDL_AtomicGet(&decodeMicroseconds);
+    statistics.ImagesLoadedFromCache = (unsigned int)SDL_AtomicGet(&imagesLoadedFromCacheCount);
+    statistics.CacheReadMicroseconds = (unsigned int)SDL_AtomicGet(&cacheReadMicroseconds);
+    statistics.CacheWriteMicroseconds = (unsigned int)SDL_AtomicGet(&cacheWriteMicroseconds);
+    statistics.TexturesUploaded = (unsigned int)SDL_AtomicGet(&texturesUploadedCount);
+    statistics.UploadMicroseconds = (unsigned int)SDL_AtomicGet(&uploadMicroseconds);
+    statistics.LoadStepsRun = (unsigned int)SDL_AtomicGet(&loadStepsRunCount);
+    statistics.LoadStepMicroseconds = (unsigned int)SDL_AtomicGet(&loadStepMicroseconds);
+    statistics.BackgroundLoadStepsRun = (unsigned int)SDL_AtomicGet(&backgroundLoadStepsRunCount);
+    statistics.BackgroundLoadStepMicroseconds = (unsigned int)SDL_AtomicGet(&backgroundLoadStepMicroseconds);
+    statistics.AudioPreloadsRun = (unsigned int)SDL_AtomicGet(&audioPreloadsRunCount);
+    statistics.AudioPreloadsWaitedOn = (unsigned int)SDL_AtomicGet(&audioPreloadsWaitedOnCount);
+    statistics.AudioPreloadMicroseconds = (unsigned int)SDL_AtomicGet(&audioPreloadMicroseconds);
+
+    if (pCommonResourcesSource != NULL)
+    {
+        statistics.ArchiveKilobytesMapped += pCommonResourcesSource->GetKilobytesMapped();
+        statistics.ArchiveKilobytesExtracted += pCommonResourcesSource->GetKilobytesExtracted();
+        statistics.ArchiveKilobytesStreamed += pCommonResourcesSource->GetKilobytesStreamed();
+    }
+
+    ArchiveSource *pCaseSource = AcquireCaseResourcesSource();
+
+    if (pCaseSource != NULL)
+    {
+        statistics.ArchiveKilobytesMapped += pCaseSource->GetKilobytesMapped();
+        statistics.ArchiveKilobytesExtracted += pCaseSource->GetKilobytesExtracted();
+        statistics.ArchiveKilobytesStreamed += pCaseSource->GetKilobytesStreamed();
+        pCaseSource->Release();
+    }
+
+    SDL_SemWait(pPrefetchSemaphore);
+    statistics.QueuedImageDecodes = imageDecodeQueue.size();
+
+    for (map<string, PrefetchedImage *>::iterator iter = prefetchedImageByFilePathMap.begin(); iter != prefetchedImageByFilePathMap.end(); ++iter)
+    {
+        if (iter->second->state == PrefetchedImageStateDecoded)
+        {
+            statistics.DecodedImagesWaiting++;
+        }
+    }
+    SDL_SemPost(pPrefetchSemaphore);
+
+    SDL_SemWait(pQueueSemaphore);
+    statistics.TexturesToUpload = smartSpriteQueue.size();
+    SDL_SemPost(pQueueSemaphore);
+
+    statistics.LoadStepsToRun = cachedLoadStepQueue.GetCount();
+
+    SDL_SemWait(pBackgroundLoadQueueSemaphore);
+    statistics.BackgroundLoadStepsToRun = backgroundLoadStepQueue.GetCount();
+    SDL_SemPost(pBackgroundLoadQueueSemaphore);
+
+    SDL_SemWait(pAudioPreloadSemaphore);
+    statistics.QueuedAudioPreloads = audioPreloadQueue.size();
+    SDL_SemPost(pAudioPreloadSemaphore);
+
+    return statistics;
+}
+
+void ResourceLoader::ResetStatistics()
+{
+    SDL_AtomicSet(&imagesDecodedCount, 0);
+    SDL_AtomicSet(&imagesDecodedAheadCount, 0);
+    SDL_AtomicSet(&imagesWaitedOnCount, 0);
+    SDL_AtomicSet(&extractMicroseconds, 0);
+    SDL_AtomicSet(&decodeMicroseconds, 0);
+    SDL_AtomicSet(&imagesLoadedFromCacheCount, 0);
+    SDL_AtomicSet(&cacheReadMicroseconds, 0);
+    SDL_AtomicSet(&cacheWriteMicroseconds, 0);
+    SDL_AtomicSet(&texturesUploadedCount, 0);
+    SDL_AtomicSet(&uploadMicroseconds, 0);
+    SDL_AtomicSet(&loadStepsRunCount, 0);
+    SDL_AtomicSet(&loadStepMicroseconds, 0);
+    SDL_AtomicSet(&backgroundLoadStepsRunCount, 0);
+    SDL_AtomicSet(&backgroundLoadStepMicroseconds, 0);
+    SDL_AtomicSet(&audioPreloadsRunCount, 0);
+    SDL_AtomicSet(&audioPreloadsWaitedOnCount, 0);
+    SDL_AtomicSet(&audioPreloadMicroseconds, 0);
+
+    if (pCommonResourcesSource != NULL)
+    {
+        pCommonResourcesSource->ResetStatistics();
+    }
+
+    ArchiveSource *pCaseSource = AcquireCaseResourcesSource();
+
+    if (pCaseSource != NULL)
+    {
+        pCaseSource->ResetStatistics();
+        pCaseSource->Release();
+    }
+}
+
+ResourceLoader::ArchiveSource * ResourceLoader::AcquireCaseResourcesSource()
+{
+    SDL_SemWait(pLoadingSemaphore);
+    ArchiveSource *pSource = pCaseResourcesSource;
+
+    if (pSource != NULL)
+    {
+        pSource->AddReference();
+    }
+    SDL_SemPost(pLoadingSemaphore);
+
+    return pSource;
+}
+
+void ResourceLoader::SwapCaseResourcesSource(ArchiveSource *pNewCaseResourcesSource)
+{
+    // We'll build the new index before swapping it in, so nobody else has to wait on that.
+    AssetIndex *pNewAssetIndex =
+        new AssetIndex(
+            (unsigned int)SDL_AtomicAdd(&assetIndexGenerationCount, 1) + 1,
+            pCommonResourcesSource,
+            pNewCaseResourcesSource);
+
+    SDL_SemWait(pLoadingSemaphore);
+    ArchiveSource *pOldCaseResourcesSource = pCaseResourcesSource;
+    AssetIndex *pOldAssetIndex = pAssetIndex;
+    pCaseResourcesSource = pNewCaseResourcesSource;
+    pAssetIndex = pNewAssetIndex;
+    SDL_SemPost(pLoadingSemaphore);
+
+    // Anyone still reading from the old archive holds a reference to it,
+    // so it'll stay open until they're done.
+    if (pOldCaseResourcesSource != NULL)
+    {
+        pOldCaseResourcesSource->Release();
+    }
+
+    if (pOldAssetIndex != NULL)
+    {
+        pOldAssetIndex->Release();
+    }
+}
+
+ResourceLoader::AssetIndex * ResourceLoader::AcquireAssetIndex()
+{
+    SDL_SemWait(pLoadingSemaphore);
+    AssetIndex *pIndex = pAssetIndex;
+
+    if (pIndex != NULL)
+    {
+        pIndex->AddReference();
+    }
+    SDL_SemPost(pLoadingSemaphore);
+
+    return pIndex;
+}
+
+bool ResourceLoader::TryResolveAsset(AssetIndex *pAssetIndex, const string &relativeFilePath, AssetHandle *pAssetHandle, int *pEntryIndex)
+{
+    // A handle resolved against this same index already knows where the file is,
+    // or that it isn't there at all, so we don't need to look at the path.
+    if (pAssetHandle != NULL && pAssetHandle->assetIndexGeneration == pAssetIndex->GetGeneration())
+    {
+        *pEntryIndex = pAssetHandle->entryIndex;
+        return *pEntryIndex >= 0;
+    }
+
+    bool retVal = pAssetIndex->TryResolve(relativeFilePath, pEntryIndex);
+
+    if (pAssetHandle != NULL)
+    {
+        pAssetHandle->assetIndexGeneration = pAssetIndex->GetGeneration();
+        pAssetHandle->entryIndex = retVal ? *pEntryIndex : -1;
+    }
+
+    return retVal;
+}
+
+SDL_RWops * ResourceLoader::LoadFile(const string &relativeFilePath, void **ppMemToFree, AssetHandle *pAssetHandle)
+{
+    SDL_RWops *pRW = NULL;
+    AssetIndex *pAssetIndex = AcquireAssetIndex();
+
+    if (pAssetIndex != NULL)
+    {
+        int entryIndex = -1;
+
+        if (TryResolveAsset(pAssetIndex, relativeFilePath, pAssetHandle, &entryIndex))
+        {
+            pRW = pAssetIndex->LoadFile(entryIndex, ppMemToFree);
+        }
+
+        pAssetIndex->Release();
+    }
+
+    return pRW;
+}
+
+SDL_RWops * ResourceLoader::LoadFileStream(const string &relativeFilePath, void **ppMemToFree, AssetHandle *pAssetHandle)
+{
+    SDL_RWops *pRW = NULL;
+    AssetIndex *pAssetIndex = AcquireAssetIndex();
+
+    if (pAssetIndex != NULL)
+    {
+        int entryIndex = -1;
+
+        if (TryResolveAsset(pAssetIndex, relativeFilePath, pAssetHandle, &entryIndex))
+        {
+            pRW = pAssetIndex->LoadFileStream(entryIndex, ppMemToFree);
+        }
+
+        pAssetIndex->Release();
+    }
+
+    return pRW;
+}
+
+SDL_Surface * ResourceLoader::LoadSurface(string relativeFilePath, bool *pFileExists)
+{
+    SDL_RWops *pRW = NULL;
+    void *pMemToFree = NULL;
+    int entryIndex = -1;
+    AssetIndex *pAssetIndex = AcquireAssetIndex();
+
+    *pFileExists = pAssetIndex != NULL && pAssetIndex->TryResolve(relativeFilePath, &entryIndex);
+
+    if (!*pFileExists)
+    {
+        if (pAssetIndex != NULL)
+        {
+            pAssetIndex->Release();
+        }
+
+        return NULL;
+    }
+
+    // If we've decoded this exact file before, we can skip both extracting and decoding it.
+    string cacheKey = pAssetIndex->GetDecodedImageCacheKey(entryIndex);
+    Uint64 startTime = SDL_GetPerformanceCounter();
+    SDL_Surface *pSurface = decodedImageCache.TryLoadSurface(cacheKey);
+
+    if (pSurface != NULL)
+    {
+        SDL_AtomicAdd(&cacheReadMicroseconds, GetMicrosecondsSince(startTime));
+        SDL_AtomicAdd(&imagesLoadedFromCacheCount, 1);
+
+        pAssetIndex->Release();
+        return pSurface;
+    }
+
+    startTime = SDL_GetPerformanceCounter();
+    pRW = pAssetIndex->LoadFile(entryIndex, &pMemToFree);
+    pAssetIndex->Release();
+
+    SDL_AtomicAdd(&extractMicroseconds, GetMicrosecondsSince(startTime));
+
+    if (pRW == NULL)
+    {
+        return NULL;
+    }
+
+    startTime = SDL_GetPerformanceCounter();
+    pSurface = IMG_Load_RW(pRW, 1 /* freesrc */);
+    free(pMemToFree);
+
+    SDL_AtomicAdd(&decodeMicroseconds, GetMicrosecondsSince(startTime));
+    SDL_AtomicAdd(&imagesDecodedCount, 1);
+
+    startTime = SDL_GetPerformanceCounter();
+    decodedImageCache.SaveSurface(cacheKey, pSurface);
+    SDL_AtomicAdd(&cacheWriteMicroseconds, GetMicrosecondsSince(startTime));
+
+    return pSurface;
+}
+
+bool ResourceLoader::TakePrefetchedSurface(string relativeFilePath, SDL_Surface **ppSurface, bool *pFileExists)
+{
+    SDL_SemWait(pPrefetchSemaphore);
+
+    map<string, PrefetchedImage *>::iterator iter = prefetchedImageByFilePathMap.find(relativeFilePath);
+
+    if (iter == prefetchedImageByFilePathMap.end())
+    {
+        SDL_SemPost(pPrefetchSemaphore);
+        return false;
+    }
+
+    PrefetchedImage *pPrefetchedImage = iter->second;
+    prefetchedImageByFilePathMap.erase(iter);
+
+    if (pPrefetchedImage->state == PrefetchedImageStateQueued)
+    {
+        // No decode thread has gotten to this one yet, so we may as well decode it ourselves.
+        imageDecodeQueue.erase(find(imageDecodeQueue.begin(), imageDecodeQueue.end(), pPrefetchedImage));
+        SDL_SemPost(pPrefetchSemaphore);
+
+        delete pPrefetchedImage;
+        return false;
+    }
+    else if (pPrefetchedImage->state == PrefetchedImageStateDecoding)
+    {
+        SDL_SemPost(pPrefetchSemaphore);
+        SDL_AtomicAdd(&imagesWaitedOnCount, 1);
+        SDL_SemWait(pPrefetchedImage->pDecodedSemaphore);
+
+        // The decode thread signals us while holding the lock,
+        // so we'll wait for it to let go before we delete the image.
+        SDL_SemWait(pPrefetchSemaphore);
+    }
+
+    *ppSurface = pPrefetchedImage->pSurface;
+    *pFileExists = pPrefetchedImage->fileExists;
+    pPrefetchedImage->pSurface = NULL;
+
+    SDL_SemPost(pPrefetchSemaphore);
+
+    delete pPrefetchedImage;
+    SDL_AtomicAdd(&imagesDecodedAheadCount, 1);
+    return true;
+}
+
+void ResourceLoader::PrefetchUpcomingLoadSteps()
+{
+    // The step at the front is about to run on this thread, so we'll leave it be
+    // and have the decode threads work on the ones after it in the meantime.
+    vector<LoadResourceStep *> upcomingStepList;
+    cachedLoadStepQueue.GetSteps(ImageDecodeAheadCount + 1, &upcomingStepList);
+
+    for (unsigned int i = 1; i < upcomingStepList.size(); i++)
+    {
+        upcomingStepList[i]->Prefetch();
+    }
+}
+
+string ResourceLoader::GetAudioPreloadKey(AudioType type, const string &id)
+{
+    switch (type)
+    {
+    case AudioTypeMusic:
+        return "Music/" + id;
+    case AudioTypeSound:
+        return "Sound/" + id;
+    default:
+        return "Dialog/" + id;
+    }
+}
+
+void ResourceLoader::QueueAudioPreload(AudioType type, string id, string relativeFilePath)
+{
+    // If audio isn't enabled, then there isn't much point in loading audio files.
+    if (!isAudioEnabled())
+    {
+        return;
+    }
+
+    EnsureAudioPreloadThreadsStarted();
+
+    SDL_SemWait(pAudioPreloadSemaphore);
+
+    string key = GetAudioPreloadKey(type, id);
+
+    if (audioPreloadByKeyMap.count(key) == 0)
+    {
+        AudioPreload *pAudioPreload = new AudioPreload(type, id, relativeFilePath);
+
+        audioPreloadByKeyMap[key] = pAudioPreload;
+        audioPreloadQueue.push_back(pAudioPreload);
+        SDL_SemPost(pAudioPreloadsAvailableSemaphore);
+    }
+
+    SDL_SemPost(pAudioPreloadSemaphore);
+}
+
+void ResourceLoader::FinishAudioPreload(AudioType type, const string &id, bool runIfQueued)
+{
+    SDL_SemWait(pAudioPreloadSemaphore);
+
+    map<string, AudioPreload *>::iterator iter = audioPreloadByKeyMap.find(GetAudioPreloadKey(type, id));
+
+    if (iter == audioPreloadByKeyMap.end())
+    {
+        SDL_SemPost(pAudioPreloadSemaphore);
+        return;
+    }
+
+    AudioPreload *pAudioPreload = iter->second;
+
+    if (pAudioPreload->state == AudioPreloadStateQueued)
+    {
+        audioPreloadQueue.erase(find(audioPreloadQueue.begin(), audioPreloadQueue.end(), pAudioPreload));
+
+        if (runIfQueued)
+        {
+            // No sense waiting for an audio preload thread to get around to it.
+            pAudioPreload->state = AudioPreloadStateLoading;
+            SDL_SemPost(pAudioPreloadSemaphore);
+
+            SDL_AtomicAdd(&audioPreloadsWaitedOnCount, 1);
+            RunAudioPreload(pAudioPreload);
+        }
+        else
+        {
+            audioPreloadByKeyMap.erase(iter);
+            SDL_SemPost(pAudioPreloadSemaphore);
+
+            delete pAudioPreload;
+        }
+    }
+    else
+    {
+        pAudioPreload->waiterCount++;
+        SDL_SemPost(pAudioPreloadSemaphore);
+
+        SDL_AtomicAdd(&audioPreloadsWaitedOnCount, 1);
+        WaitForAudioPreloadToLoad(pAudioPreload);
+    }
+}
+
+void ResourceLoader::WaitForAudioPreloadToLoad(AudioPreload *pAudioPreload)
+{
+    // Callers have counted themselves as waiting on this preload while holding the lock,
+    // so it can't have been deleted out from under us.
+    SDL_SemWait(pAudioPreload->pLoadedSemaphore);
+
+    SDL_SemWait(pAudioPreloadSemaphore);
+    pAudioPreload->waiterCount--;
+    bool shouldDelete = pAudioPreload->waiterCount == 0;
+    SDL_SemPost(pAudioPreloadSemaphore);
+
+    if (shouldDelete)
+    {
+        delete pAudioPreload;
+    }
+}
+
+void ResourceLoader::RunAudioPreload(AudioPreload *pAudioPreload)
+{
+    Uint64 startTime = SDL_GetPerformanceCounter();
+
+    switch (pAudioPreload->type)
+    {
+    case AudioTypeMusic:
+        LoadMusic(pAudioPreload->id, pAudioPreload->relativeFilePath);
+        break;
+    case AudioTypeSound:
+        LoadSound(pAudioPreload->id, pAudioPreload->relativeFilePath);
+        break;
+    case AudioTypeDialog:
+        LoadDialog(pAudioPreload->id, pAudioPreload->relativeFilePath);
+        break;
+    }
+
+    SDL_AtomicAdd(&audioPreloadsRunCount, 1);
+    SDL_AtomicAdd(&audioPreloadMicroseconds, GetMicrosecondsSince(startTime));
+
+    SDL_SemWait(pAudioPreloadSemaphore);
+
+    audioPreloadByKeyMap.erase(GetAudioPreloadKey(pAudioPreload->type, pAudioPreload->id));
+    int waiterCount = pAudioPreload->waiterCount;
+
+    for (int i = 0; i < waiterCount; i++)
+    {
+        SDL_SemPost(pAudioPreload->pLoadedSemaphore);
+    }
+
+    SDL_SemPost(pAudioPreloadSemaphore);
+
+    if (waiterCount == 0)
+    {
+        delete pAudioPreload;
+    }
+}
+
+void ResourceLoader::LoadMusic(string id, string relativeFilePath)
+{
+    SDL_RWops *pRWA = NULL;
+    SDL_RWops *pRWB = NULL;
+    void *pMemToFreeA = NULL;
+    void *pMemToFreeB = NULL;
+
+    pRWA = LoadFile(relativeFilePath + "A.ogg", &pMemToFreeA);
+    pRWB = LoadFile(relativeFilePath + "B.ogg", &pMemToFreeB);
+
+    if (pRWA == NULL || pRWB == NULL)
+    {
+        if (pRWA != NULL)
+        {
+            SDL_RWclose(pRWA);
+        }
+
+        if (pRWB != NULL)
+        {
+            SDL_RWclose(pRWB);
+        }
+
+        free(pMemToFreeA);
+        free(pMemToFreeB);
+        return;
+    }
+
+    preloadMusic(id, pRWA, pRWB);
+
+    SDL_SemWait(pAudioPreloadSemaphore);
+    musicIdToMemToFreeMap[id + "_A"] = pMemToFreeA;
+    musicIdToMemToFreeMap[id + "_B"] = pMemToFreeB;
+    SDL_SemPost(pAudioPreloadSemaphore);
+}
+
+void ResourceLoader::LoadSound(string id, string relativeFilePath)
+{
+    SDL_RWops *pRW = NULL;
+    void *pMemToFree = NULL;
+
+    pRW = LoadFile(relativeFilePath + ".ogg", &pMemToFree);
+
+    if (pRW == NULL)
+    {
+        return;
+    }
+
+    preloadSound(id, pRW);
+    free(pMemToFree);
+}
+
+void ResourceLoader::LoadDialog(string id, string relativeFilePath)
+{
+    SDL_RWops *pRW = NULL;
+    void *pMemToFree = NULL;
+
+    pRW = LoadFile(relativeFilePath + ".ogg", &pMemToFree);
+
+    if (pRW == NULL)
+    {
+        return;
+    }
+
+    preloadDialog(id, pRW);
+    free(pMemToFree);
+}
+
+void ResourceLoader::WaitForAudioPreloadStatic(AudioType type, const string &id)
+{
+    GetInstance()->WaitForAudioPreload(type, id);
+}
+
+void ResourceLoader::EnsureAudioPreloadThreadsStarted()
+{
+    if (!audioPreloadThreadList.empty())
+    {
+        return;
+    }
+
+    // Whatever plays audio will wait for it if it isn't loaded yet.
+    setAudioPreloadWaitCallback(ResourceLoader::WaitForAudioPreloadStatic);
+
+    int threadCount = min(max(SDL_GetCPUCount() - 1, 1), MaxAudioPreloadThreadCount);
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        audioPreloadThreadList.push_back(SDL_CreateThread(ResourceLoader::RunAudioPreloadThreadStatic, "AudioPreloadThread", this));
+    }
+}
+
+int ResourceLoader::RunAudioPreloadThreadStatic(void *pData)
+{
+    ResourceLoader *pThis = reinterpret_cast<ResourceLoader *>(pData);
+    pThis->RunAudioPreloadThread();
+    return 0;
+}
+
+void ResourceLoader::RunAudioPreloadThread()
+{
+    while (true)
+    {
+        SDL_SemWait(pAudioPreloadsAvailableSemaphore);
+
+        if (SDL_AtomicGet(&isQuitting) != 0)
+        {
+            break;
+        }
+
+        SDL_SemWait(pAudioPreloadSemaphore);
+
+        // Preloads taken out of the queue by someone else still count towards the semaphore,
+        // so there may not actually be anything for us to do.
+        if (audioPreloadQueue.empty())
+        {
+            SDL_SemPost(pAudioPreloadSemaphore);
+            continue;
+        }
+
+        AudioPreload *pAudioPreload = audioPreloadQueue.front();
+        audioPreloadQueue.pop_front();
+        pAudioPreload->state = AudioPreloadStateLoading;
+
+        SDL_SemPost(pAudioPreloadSemaphore);
+
+        RunAudioPreload(pAudioPreload);
+    }
+}
+
+void ResourceLoader::EnsureImageDecodeThreadsStarted()
+{
+    if (!imageDecodeThreadList.empty())
+    {
+        return;
+    }
+
+    // We'll leave one core for the main thread.
+    int threadCount = min(max(SDL_GetCPUCount() - 1, 1), MaxImageDecodeThreadCount);
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        imageDecodeThreadList.push_back(SDL_CreateThread(ResourceLoader::RunImageDecodeThreadStatic, "ImageDecodeThread", this));
+    }
+}
+
+int ResourceLoader::RunImageDecodeThreadStatic(void *pData)
+{
+    ResourceLoader *pThis = reinterpret_cast<ResourceLoader *>(pData);
+    pThis->RunImageDecodeThread();
+    return 0;
+}
+
+void ResourceLoader::RunImageDecodeThread()
+{
+    while (true)
+    {
+        SDL_SemWait(pImageDecodesAvailableSemaphore);
+
+        if (SDL_AtomicGet(&isQuitting) != 0)
+        {
+            break;
+        }
+
+        SDL_SemWait(pPrefetchSemaphore);
+
+        // Images taken out of the queue by someone else still count towards the semaphore,
+        // so there may not actually be anything for us to do.
+        if (imageDecodeQueue.empty())
+        {
+            SDL_SemPost(pPrefetchSemaphore);
+            continue;
+        }
+
+        PrefetchedImage *pPrefetchedImage = imageDecodeQueue.front();
+        imageDecodeQueue.pop_front();
+        pPrefetchedImage->state = PrefetchedImageStateDecoding;
+        string relativeFilePath = pPrefetchedImage->relativeFilePath;
+
+        SDL_SemPost(pPrefetchSemaphore);
+
+        bool fileExists = false;
+        SDL_Surface *pSurface = LoadSurface(relativeFilePath, &fileExists);
+
+        SDL_SemWait(pPrefetchSemaphore);
+
+        if (pPrefetchedImage->isCancelled)
+        {
+            if (pSurface != NULL)
+            {
+                SDL_FreeSurface(pSurface);
+            }
+
+            delete pPrefetchedImage;
+        }
+        else
+        {
+            pPrefetchedImage->pSurface = pSurface;
+            pPrefetchedImage->fileExists = fileExists;
+            pPrefetchedImage->state = PrefetchedImageStateDecoded;
+            SDL_SemPost(pPrefetchedImage->pDecodedSemaphore);
+        }
+
+        SDL_SemPost(pPrefetchSemaphore);
+    }
+}
+
+ResourceLoader::ResourceLoader()
+{
+    pCommonResourcesSource = NULL;
+    pCaseResourcesSource = NULL;
+    pCachedCaseResourcesSource = NULL;
+    pAssetIndex = NULL;
+    SDL_AtomicSet(&assetIndexGenerationCount, 0);
+
+    pLoadingSemaphore = SDL_CreateSemaphore(1);
+    pQueueSemaphore = SDL_CreateSemaphore(1);
+    SDL_AtomicSet(&imageTexturesToLoadCount, 0);
+    pLoadQueueSemaphore = SDL_CreateSemaphore(1);
+    pBackgroundLoadQueueSemaphore = SDL_CreateSemaphore(1);
+
+    SDL_AtomicSet(&isQuitting, 0);
+    pPrefetchSemaphore = SDL_CreateSemaphore(1);
+    pImageDecodesAvailableSemaphore = SDL_CreateSemaphore(0);
+    pAudioPreloadSemaphore = SDL_CreateSemaphore(1);
+    pAudioPreloadsAvailableSemaphore = SDL_CreateSemaphore(0);
+
+    ResetStatistics();
+}
+
+ResourceLoader::~ResourceLoader()
+{
+    SDL_AtomicSet(&isQuitting, 1);
+
+    for (unsigned int i = 0; i < imageDecodeThreadList.size(); i++)
+    {
+        SDL_SemPost(pImageDecodesAvailableSemaphore);
+    }
+
+    for (unsigned int i = 0; i < imageDecodeThreadList.size(); i++)
+    {
+        SDL_WaitThread(imageDecodeThreadList[i], NULL);
+    }
+
+    imageDecodeThreadList.clear();
+
+    // The case is gone by now, so we'll just drop the background load steps
+    // and leave their decodes to be flushed along with everything else.
+    backgroundLoadStepQueue.Clear();
+    FlushPrefetchedImages();
+
+    for (unsigned int i = 0; i < audioPreloadThreadList.size(); i++)
+    {
+        SDL_SemPost(pAudioPreloadsAvailableSemaphore);
+    }
+
+    for (unsigned int i = 0; i < audioPreloadThreadList.size(); i++)
+    {
+        SDL_WaitThread(audioPreloadThreadList[i], NULL);
+    }
+
+    audioPreloadThreadList.clear();
+    setAudioPreloadWaitCallback(NULL);
+
+    // Nothing's left to load these, and nothing will play them after this point.
+    for (unsigned int i = 0; i < audioPreloadQueue.size(); i++)
+    {
+        delete audioPreloadQueue[i];
+    }
+
+    audioPreloadQueue.clear();
+    audioPreloadByKeyMap.clear();
+
+    SDL_DestroySemaphore(pAudioPreloadSemaphore);
+    pAudioPreloadSemaphore = NULL;
+    SDL_DestroySemaphore(pAudioPreloadsAvailableSemaphore);
+    pAudioPreloadsAvailableSemaphore = NULL;
+
+    SDL_DestroySemaphore(pPrefetchSemaphore);
+    pPrefetchSemaphore = NULL;
+    SDL_DestroySemaphore(pImageDecodesAvailableSemaphore);
+    pImageDecodesAvailableSemaphore = NULL;
+
+    if (pAssetIndex != NULL)
+    {
+        pAssetIndex->Release();
+        pAssetIndex = NULL;
+    }
+
+    if (pCommonResourcesSource != NULL)
+    {
+        pCommonResourcesSource->Release();
+        pCommonResourcesSource = NULL;
+    }
+
+    if (pCaseResourcesSource != NULL)
+    {
+        pCaseResourcesSource->Release();
+        pCaseResourcesSource = NULL;
+    }
+
+    if (pCachedCaseResourcesSource != NULL)
+    {
+        pCachedCaseResourcesSource->Release();
+        pCachedCaseResourcesSource = NULL;
+    }
+
+    SDL_DestroySemaphore(pLoadingSemaphore);
+    pLoadingSemaphore = NULL;
+    SDL_DestroySemaphore(pQueueSemaphore);
+    pQueueSemaphore = NULL;
+    SDL_DestroySemaphore(pLoadQueueSemaphore);
+    pLoadQueueSemaphore = NULL;
+    SDL_DestroySemaphore(pBackgroundLoadQueueSemaphore);
+    pBackgroundLoadQueueSemaphore = NULL;
+
+    smartSpriteQueue.clear();
+    deleteTextureQueue.clear();
+}
+
+ResourceLoader::ArchiveSource::~ArchiveSource()
+{
+    mz_zip_reader_end(&zip_archive);
+    UnmapArchive();
+
+    for (unsigned int i = 0; i < fileHandleList.size(); i++)
+    {
+        fclose(fileHandleList[i]);
+    }
+
+    fileHandleList.clear();
+    freeFileHandleList.clear();
+}
+
+bool ResourceLoader::ArchiveSource::CreateAndInit(string archiveFilePath, ArchiveSource **ppSource)
+{
+    ArchiveSource *pSource = new ArchiveSource();
+
+    if (!pSource->Init(archiveFilePath))
+    {
+        delete pSource;
+        return false;
+    }
+
+    *ppSource = pSource;
+    return true;
+}
+
+SDL_RWops * ResourceLoader::ArchiveSource::LoadFile(const ArchiveEntry &entry, void **ppMemToFree)
+{
+    const unsigned char *pData = NULL;
+    size_t dataSize = 0;
+
+    // Files stored without compression can be read directly out of the mapped archive.
+    // The returned SDL_RWops owns everything it needs, so there's no memory for the caller to free.
+    if (TryGetStoredFileData(entry, &pData, &dataSize))
+    {
+        SDL_RWops *pRW = SDL_AllocRW();
+
+        if (pRW != NULL)
+        {
+            MappedFileView *pView = new MappedFileView();
+            pView->pSource = this;
+            pView->pData = pData;
+            pView->size = (Sint64)dataSize;
+            pView->position = 0;
+
+            AddReference();
+
+            pRW->size = &ArchiveSource::MappedFileViewSize;
+            pRW->seek = &ArchiveSource::MappedFileViewSeek;
+            pRW->read = &ArchiveSource::MappedFileViewRead;
+            pRW->write = &ArchiveSource::MappedFileViewWrite;
+            pRW->close = &ArchiveSource::MappedFileViewClose;
+            pRW->type = SDL_RWOPS_UNKNOWN;
+            pRW->hidden.unknown.data1 = pView;
+
+            SDL_AtomicAdd(&kilobytesMapped, (int)((dataSize + 512) / 1024));
+
+            *ppMemToFree = NULL;
+            return pRW;
+        }
+    }
+
+    size_t uncomp_size = 0;
+    void *p = ExtractFile(entry, &uncomp_size);
+
+    if (p == NULL)
+    {
+        return NULL;
+    }
+
+    SDL_AtomicAdd(&kilobytesExtracted, (int)((uncomp_size + 512) / 1024));
+
+    *ppMemToFree = p;
+    return SDL_RWFromMem(p, (unsigned int)uncomp_size);
+}
+
+SDL_RWops * ResourceLoader::ArchiveSource::LoadFileStream(const ArchiveEntry &entry, void **ppMemToFree)
+{
+    const unsigned char *pData = NULL;
+    size_t dataSize = 0;
+    mz_uint64 dataOffset = 0;
+    bool isCompressed = false;
+
+    // Files we can read in place from the mapped archive are already as cheap as they can be.
+    if (TryGetStoredFileData(entry, &pData, &dataSize) || !TryGetFileDataLocation(entry, &dataOffset, &isCompressed))
+    {
+        return LoadFile(entry, ppMemToFree);
+    }
+
+    SDL_RWops *pRW = SDL_AllocRW();
+
+    if (pRW == NULL)
+    {
+        return LoadFile(entry, ppMemToFree);
+    }
+
+    ArchiveFileStream *pStream = new ArchiveFileStream(this, dataOffset, entry.storedSize, entry.size, isCompressed);
+
+    AddReference();
+
+    pRW->size = &ArchiveSource::ArchiveFileStreamSize;
+    pRW->seek = &ArchiveSource::ArchiveFileStreamSeek;
+    pRW->read = &ArchiveSource::ArchiveFileStreamRead;
+    pRW->write = &ArchiveSource::ArchiveFileStreamWrite;
+    pRW->close = &ArchiveSource::ArchiveFileStreamClose;
+    pRW->type = SDL_RWOPS_UNKNOWN;
+    pRW->hidden.unknown.data1 = pStream;
+
+    SDL_AtomicAdd(&kilobytesStreamed, (int)((entry.size + 512) / 1024));
+
+    *ppMemToFree = NULL;
+    return pRW;
+}
+
+void * ResourceLoader::ArchiveSource::LoadFileToMemory(const ArchiveEntry &entry, unsigned int *pSize)
+{
+    size_t uncomp_size = 0;
+    void *p = ExtractFile(entry, &uncomp_size);
+
+    if (p == NULL)
+    {
+        return NULL;
+    }
+
+    SDL_AtomicAdd(&kilobytesExtracted, (int)((uncomp_size + 512) / 1024));
+
+    *pSize = (unsigned int)uncomp_size;
+    return p;
+}
+
+void ResourceLoader::ArchiveSource::AddReference()
+{
+    SDL_AtomicAdd(&referenceCount, 1);
+}
+
+void ResourceLoader::ArchiveSource::Release()
+{
+    // SDL_AtomicAdd() returns the value from before the decrement.
+    if (SDL_AtomicAdd(&referenceCount, -1) == 1)
+    {
+        delete this;
+    }
+}
+
+bool ResourceLoader::ArchiveSource::Init(string archiveFilePath)
+{
+    this->archiveFilePath = archiveFilePath;
+
+    FILE *pFile = AcquireFileHandle();
+
+    if (pFile == NULL)
+    {
+        return false;
+    }
+
+    mz_uint64 archiveSize = 0;
+
+    if (SeekFile(pFile, 0, SEEK_END))
+    {
+        archiveSize = GetFilePosition(pFile);
+    }
+
+    ReleaseFileHandle(pFile);
+
+    // If we can't map the archive, we'll read from it through file handles instead.
+    MapArchive(archiveSize);
+
+    unsigned char magic[CasePackMagicLength];
+
+    if (ReadArchiveBytes(0, magic, CasePackMagicLength) && IsCasePack(magic, CasePackMagicLength))
+    {
+        format = ArchiveFormatCasePack;
+        return InitCasePack(archiveSize);
+    }
+
+    format = ArchiveFormatZip;
+    return InitZip(archiveSize);
+}
+
+bool ResourceLoader::ArchiveSource::InitZip(mz_uint64 archiveSize)
+{
+    if (pMappedArchive != NULL)
+    {
+        if (mz_zip_reader_init_mem(&zip_archive, pMappedArchive, (size_t)mappedArchiveSize, 0))
+        {
+            BuildZipEntryList();
+            return true;
+        }
+
+        UnmapArchive();
+        zip_archive = mz_zip_archive();
+    }
+
+    // Rather than having miniz open the file itself, we give it our own read function,
+    // which reads from whatever position it's asked for without touching any shared state.
+    zip_archive.m_pRead = &ArchiveSource::Read;
+    zip_archive.m_pIO_opaque = this;
+
+    if (!mz_zip_reader_init(&zip_archive, archiveSize, 0))
+    {
+        return false;
+    }
+
+    BuildZipEntryList();
+    return true;
+}
+
+bool ResourceLoader::ArchiveSource::InitCasePack(mz_uint64 archiveSize)
+{
+    unsigned char headerBytes[CasePackHeaderSize];
+    CasePackHeader header;
+
+    if (!ReadArchiveBytes(0, headerBytes, CasePackHeaderSize) || !header.ReadFrom(headerBytes))
+    {
+        return false;
+    }
+
+    mz_uint64 entryTableSize = (mz_uint64)header.entryCount * CasePackEntrySize;
+
+    if (header.entryTableOffset + entryTableSize > archiveSize || header.nameTableOffset + header.nameTableSize > archiveSize)
+    {
+        return false;
+    }
+
+    vector<unsigned char> entryTableBytes((size_t)entryTableSize);
+    vector<char> nameTable((size_t)header.nameTableSize);
+
+    if ((entryTableSize > 0 && !ReadArchiveBytes(header.entryTableOffset, &entryTableBytes[0], (size_t)entryTableSize)) ||
+        (header.nameTableSize > 0 && !ReadArchiveBytes(header.nameTableOffset, &nameTable[0], (size_t)header.nameTableSize)))
+    {
+        return false;
+    }
+
+    entryList.reserve(header.entryCount);
+
+    for (mz_uint32 i = 0; i < header.entryCount; i++)
+    {
+        CasePackEntry packEntry;
+        packEntry.ReadFrom(&entryTableBytes[i * CasePackEntrySize]);
+
+        // We won't trust anything in the entry table that points outside the file.
+        if ((mz_uint64)packEntry.nameOffset + packEntry.nameLength > header.nameTableSize ||
+            packEntry.dataOffset + packEntry.storedSize > archiveSize)
+        {
+            entryList.clear();
+            return false;
+        }
+
+        ArchiveEntry entry;
+        entry.normalizedFilePath = string(nameTable.begin() + packEntry.nameOffset, nameTable.begin() + packEntry.nameOffset + packEntry.nameLength);
+        entry.filePathHash = HashArchiveFilePath(entry.normalizedFilePath.c_str());
+        entry.fileIndex = i;
+        entry.size = packEntry.size;
+        entry.method = packEntry.codec;
+        entry.dataOffset = packEntry.dataOffset;
+        entry.storedSize = packEntry.storedSize;
+        entry.crc32 = packEntry.crc32;
+
+        entryList.push_back(entry);
+    }
+
+    return true;
+}
+
+void ResourceLoader::ArchiveSource::BuildZipEntryList()
+{
+    mz_uint fileCount = mz_zip_reader_get_num_files(&zip_archive);
+    entryList.reserve(fileCount);
+
+    for (mz_uint i = 0; i < fileCount; i++)
+    {
+        mz_zip_archive_file_stat fileStat;
+
+        if (mz_zip_reader_is_file_a_directory(&zip_archive, i) || !mz_zip_reader_file_stat(&zip_archive, i, &fileStat))
+        {
+            continue;
+        }
+
+        ArchiveEntry entry;
+        entry.normalizedFilePath = fileStat.m_filename;
+
+        for (unsigned int j = 0; j < entry.normalizedFilePath.length(); j++)
+        {
+            entry.normalizedFilePath[j] = NormalizeArchiveFilePathCharacter(entry.normalizedFilePath[j]);
+        }
+
+        entry.filePathHash = HashArchiveFilePath(entry.normalizedFilePath.c_str());
+        entry.fileIndex = i;
+        entry.size = fileStat.m_uncomp_size;
+        entry.method = fileStat.m_method;
+        entry.dataOffset = 0;
+        entry.storedSize = fileStat.m_comp_size;
+        entry.crc32 = fileStat.m_crc32;
+
+        entryList.push_back(entry);
+    }
+}
+
+bool ResourceLoader::ArchiveSource::ReadArchiveBytes(mz_uint64 offset, void *pBuffer, size_t byteCount)
+{
+    if (pMappedArchive != NULL)
+    {
+        if (offset + byteCount > mappedArchiveSize)
+        {
+            return false;
+        }
+
+        memcpy(pBuffer, pMappedArchive + offset, byteCount);
+        return true;
+    }
+
+    return Read(this, offset, pBuffer, byteCount) == byteCount;
+}
+
+void * ResourceLoader::ArchiveSource::ExtractFile(const ArchiveEntry &entry, size_t *pSize)
+{
+    if (format == ArchiveFormatCasePack)
+    {
+        *pSize = (size_t)entry.size;
+        return ExtractCasePackFile(entry);
+    }
+
+    return mz_zip_reader_extract_to_heap(&zip_archive, entry.fileIndex, pSize, 0);
+}
+
+void * ResourceLoader::ArchiveSource::ExtractCasePackFile(const ArchiveEntry &entry)
+{
+    // malloc(0) is allowed to return NULL, which would look like a missing file.
+    void *pOutput = malloc(max((size_t)entry.size, (size_t)1));
+
+    if (pOutput == NULL)
+    {
+        return NULL;
+    }
+
+    CasePackEntry packEntry;
+    packEntry.codec = entry.method;
+    packEntry.storedSize = entry.storedSize;
+    packEntry.size = entry.size;
+    packEntry.crc32 = entry.crc32;
+
+    bool success = false;
+
+    if (pMappedArchive != NULL)
+    {
+        // InitCasePack() already made sure the data lies inside the archive.
+        success = DecodeCasePackEntry(packEntry, pMappedArchive + entry.dataOffset, pOutput);
+    }
+    else if (entry.method == CasePackCodecStore)
+    {
+        success =
+            entry.storedSize == entry.size &&
+            ReadArchiveBytes(entry.dataOffset, pOutput, (size_t)entry.size) &&
+            mz_crc32(MZ_CRC32_INIT, static_cast<const unsigned char *>(pOutput), (size_t)entry.size) == entry.crc32;
+    }
+    else
+    {
+        void *pStoredData = malloc(max((size_t)entry.storedSize, (size_t)1));
+
+        success =
+            pStoredData != NULL &&
+            ReadArchiveBytes(entry.dataOffset, pStoredData, (size_t)entry.storedSize) &&
+            DecodeCasePackEntry(packEntry, pStoredData, pOutput);
+
+        free(pStoredData);
+    }
+
+    if (!success)
+    {
+        free(pOutput);
+        return NULL;
+    }
+
+    return pOutput;
+}
+
+FILE * ResourceLoader::ArchiveSource::AcquireFileHandle()
+{
+    FILE *pFile = NULL;
+
+    SDL_AtomicLock(&fileHandleLock);
+    if (!freeFileHandleList.empty())
+    {
+        pFile = freeFileHandleList.back();
+        freeFileHandleList.pop_back();
+    }
+    SDL_AtomicUnlock(&fileHandleLock);
+
+    // If every handle we've opened so far is in use, we'll open another one,
+    // so there end up being as many handles as there are threads reading at once.
+    if (pFile == NULL)
+    {
+        pFile = fopen(archiveFilePath.c_str(), "rb");
+
+        if (pFile != NULL)
+        {
+            SDL_AtomicLock(&fileHandleLock);
+            fileHandleList.push_back(pFile);
+            SDL_AtomicUnlock(&fileHandleLock);
+        }
+    }
+
+    return pFile;
+}
+
+void ResourceLoader::ArchiveSource::ReleaseFileHandle(FILE *pFile)
+{
+    SDL_AtomicLock(&fileHandleLock);
+    freeFileHandleList.push_back(pFile);
+    SDL_AtomicUnlock(&fileHandleLock);
+}
+
+size_t ResourceLoader::ArchiveSource::Read(void *pOpaque, mz_uint64 fileOffset, void *pBuffer, size_t byteCount)
+{
+    ArchiveSource *pThis = reinterpret_cast<ArchiveSource *>(pOpaque);
+    FILE *pFile = pThis->AcquireFileHandle();
+    size_t bytesRead = 0;
+
+    if (pFile == NULL)
+    {
+        return 0;
+    }
+
+    // Reads from the same handle tend to follow on from each other, so we'll only seek when we have to.
+    if (GetFilePosition(pFile) == fileOffset || SeekFile(pFile, fileOffset, SEEK_SET))
+    {
+        bytesRead = fread(pBuffer, 1, byteCount, pFile);
+    }
+
+    pThis->ReleaseFileHandle(pFile);
+    return bytesRead;
+}
+
+void ResourceLoader::ArchiveSource::ResetStatistics()
+{
+    SDL_AtomicSet(&kilobytesMapped, 0);
+    SDL_AtomicSet(&kilobytesExtracted, 0);
+    SDL_AtomicSet(&kilobytesStreamed, 0);
+}
+
+bool ResourceLoader::ArchiveSource::MapArchive(mz_uint64 archiveSize)
+{
+    if (archiveSize == 0 || (sizeof(void *) < 8 && archiveSize > MaxMappedArchiveSizeIn32BitProcess))
+    {
+        return false;
+    }
+
+    void *pMapping = NULL;
+
+#ifdef __WINDOWS
+    HANDLE fileHandle = CreateFileA(archiveFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (fileHandle == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (mappingHandle != NULL)
+    {
+        pMapping = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+
+        // The view keeps the mapping alive on its own, so we can close both handles right away.
+        CloseHandle(mappingHandle);
+    }
+
+    CloseHandle(fileHandle);
+#else
+    int fileDescriptor = open(archiveFilePath.c_str(), O_RDONLY);
+
+    if (fileDescriptor < 0)
+    {
+        return false;
+    }
+
+    pMapping = mmap(NULL, (size_t)archiveSize, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+
+    // As on Windows, the mapping stays valid after the file is closed.
+    close(fileDescriptor);
+
+    if (pMapping == MAP_FAILED)
+    {
+        pMapping = NULL;
+    }
+#endif
+
+    if (pMapping == NULL)
+    {
+        return false;
+    }
+
+    pMappedArchive = static_cast<const unsigned char *>(pMapping);
+    mappedArchiveSize = archiveSize;
+    return true;
+}
+
+void ResourceLoader::ArchiveSource::UnmapArchive()
+{
+    if (pMappedArchive == NULL)
+    {
+        return;
+    }
+
+#ifdef __WINDOWS
+    UnmapViewOfFile(pMappedArchive);
+#else
+    munmap(const_cast<unsigned char *>(pMappedArchive), (size_t)mappedArchiveSize);
+#endif
+
+    pMappedArchive = NULL;
+    mappedArchiveSize = 0;
+}
+
+bool ResourceLoader::ArchiveSource::TryGetFileDataLocation(const ArchiveEntry &entry, mz_uint64 *pDataOffset, bool *pIsCompressed)
+{
+    // Case pack entries already know where their data is.
+    if (format == ArchiveFormatCasePack)
+    {
+        if (entry.method != CasePackCodecStore && entry.method != CasePackCodecDeflate)
+        {
+            return false;
+        }
+
+        *pDataOffset = entry.dataOffset;
+        *pIsCompressed = entry.method == CasePackCodecDeflate;
+        return true;
+    }
+
+    if (entry.method != 0 && entry.method != MZ_DEFLATED)
+    {
+        return false;
+    }
+
+    mz_zip_archive_file_stat fileStat;
+
+    if (!mz_zip_reader_file_stat(&zip_archive, entry.fileIndex, &fileStat))
+    {
+        return false;
+    }
+
+    // Anything encrypted needs extracting, and a file stored as-is should be the same size in the archive as out of it.
+    if (mz_zip_reader_is_file_encrypted(&zip_archive, entry.fileIndex) || (entry.method == 0 && fileStat.m_comp_size != fileStat.m_uncomp_size))
+    {
+        return false;
+    }
+
+    // The file's data follows its local header, which is 30 bytes followed by
+    // the file name and an extra field whose lengths are stored at offsets 26 and 28.
+    const mz_uint64 localHeaderSize = 30;
+    unsigned char localHeader[localHeaderSize];
+
+    if (!ReadArchiveBytes(fileStat.m_local_header_ofs, localHeader, (size_t)localHeaderSize))
+    {
+        return false;
+    }
+
+    if (localHeader[0] != 0x50 || localHeader[1] != 0x4b || localHeader[2] != 0x03 || localHeader[3] != 0x04)
+    {
+        return false;
+    }
+
+    mz_uint64 fileNameLength = localHeader[26] | (localHeader[27] << 8);
+    mz_uint64 extraFieldLength = localHeader[28] | (localHeader[29] << 8);
+
+    *pDataOffset = fileStat.m_local_header_ofs + localHeaderSize + fileNameLength + extraFieldLength;
+    *pIsCompressed = entry.method == MZ_DEFLATED;
+    return true;
+}
+
+bool ResourceLoader::ArchiveSource::TryGetStoredFileData(const ArchiveEntry &entry, const unsigned char **ppData, size_t *pSize)
+{
+    if (pMappedArchive == NULL)
+    {
+        return false;
+    }
+
+    mz_uint64 dataOffset = 0;
+    bool isCompressed = false;
+
+    // Only files stored as-is can be read in place - anything compressed needs extracting.
+    if (!TryGetFileDataLocation(entry, &dataOffset, &isCompressed) || isCompressed)
+    {
+        return false;
+    }
+
+    // InitCasePack() already made sure that case pack data lies inside the archive, but nothing's checked zip data yet.
+    if (dataOffset + entry.size > mappedArchiveSize)
+    {
+        return false;
+    }
+
+    *ppData = pMappedArchive + dataOffset;
+    *pSize = (size_t)entry.size;
+    return true;
+}
+
+Sint64 ResourceLoader::ArchiveSource::MappedFileViewSize(SDL_RWops *pRW)
+{
+    MappedFileView *pView = static_cast<MappedFileView *>(pRW->hidden.unknown.data1);
+    return pView->size;
+}
+
+Sint64 ResourceLoader::ArchiveSource::MappedFileViewSeek(SDL_RWops *pRW, Sint64 offset, int whence)
+{
+    MappedFileView *pView = static_cast<MappedFileView *>(pRW->hidden.unknown.data1);
+    Sint64 newPosition = 0;
+
+    switch (whence)
+    {
+    case RW_SEEK_SET:
+        newPosition = offset;
+        break;
+
+    case RW_SEEK_CUR:
+        newPosition = pView->position + offset;
+        break;
+
+    case RW_SEEK_END:
+        newPosition = pView->size + offset;
+        break;
+
+    default:
+        return -1;
+    }
+
+    pView->position = max((Sint64)0, min(pView->size, newPosition));
+    return pView->position;
+}
+
+size_t ResourceLoader::ArchiveSource::MappedFileViewRead(SDL_RWops *pRW, void *pBuffer, size_t size, size_t maxCount)
+{
+    MappedFileView *pView = static_cast<MappedFileView *>(pRW->hidden.unknown.data1);
+
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    size_t count = min(maxCount, (size_t)(pView->size - pView->position) / size);
+
+    memcpy(pBuffer, pView->pData + pView->position, count * size);
+    pView->position += (Sint64)(count * size);
+
+    return count;
+}
+
+size_t ResourceLoader::ArchiveSource::MappedFileViewWrite(SDL_RWops * /*pRW*/, const void * /*pBuffer*/, size_t /*size*/, size_t /*count*/)
+{
+    // The archive is read-only.
+    return 0;
+}
+
+int ResourceLoader::ArchiveSource::MappedFileViewClose(SDL_RWops *pRW)
+{
+    if (pRW != NULL)
+    {
+        MappedFileView *pView = static_cast<MappedFileView *>(pRW->hidden.unknown.data1);
+        pView->pSource->Release();
+        delete pView;
+
+        SDL_FreeRW(pRW);
+    }
+
+    return 0;
+}
+
+ResourceLoader::ArchiveSource::ArchiveFileStream::ArchiveFileStream(ArchiveSource *pSource, mz_uint64 dataOffset, mz_uint64 storedSize, mz_uint64 size, bool isCompressed)
+{
+    this->pSource = pSource;
+    this->size = (Sint64)size;
+    this->position = 0;
+    this->dataOffset = dataOffset;
+    this->storedSize = storedSize;
+    this->isCompressed = isCompressed;
+
+    pInputBuffer = isCompressed ? static_cast<unsigned char *>(malloc(ArchiveStreamInputBufferSize)) : NULL;
+    pWindow = isCompressed ? static_cast<unsigned char *>(malloc(TINFL_LZ_DICT_SIZE)) : NULL;
+
+    RestartInflating();
+}
+
+ResourceLoader::ArchiveSource::ArchiveFileStream::~ArchiveFileStream()
+{
+    free(pInputBuffer);
+    pInputBuffer = NULL;
+    free(pWindow);
+    pWindow = NULL;
+}
+
+size_t ResourceLoader::ArchiveSource::ArchiveFileStream::Read(unsigned char *pBuffer, size_t byteCount)
+{
+    byteCount = (size_t)min((Sint64)byteCount, size - position);
+
+    if (byteCount == 0)
+    {
+        return 0;
+    }
+
+    return isCompressed ? ReadCompressed(pBuffer, byteCount) : ReadStored(pBuffer, byteCount);
+}
+
+size_t ResourceLoader::ArchiveSource::ArchiveFileStream::ReadStored(unsigned char *pBuffer, size_t byteCount)
+{
+    if (!pSource->ReadArchiveBytes(dataOffset + position, pBuffer, byteCount))
+    {
+        return 0;
+    }
+
+    position += (Sint64)byteCount;
+    return byteCount;
+}
+
+size_t ResourceLoader::ArchiveSource::ArchiveFileStream::ReadCompressed(unsigned char *pBuffer, size_t byteCount)
+{
+    // Deflated data can only be inflated front to back, so going back to before
+    // the piece we've most recently inflated means starting over.
+    if (position < outputPosition)
+    {
+        RestartInflating();
+    }
+
+    size_t bytesRead = 0;
+
+    while (bytesRead < byteCount)
+    {
+        if (position < outputPosition + (Sint64)outputByteCount)
+        {
+            size_t offsetInOutput = (size_t)(position - outputPosition);
+            size_t count = min(byteCount - bytesRead, outputByteCount - offsetInOutput);
+
+            memcpy(pBuffer + bytesRead, pWindow + outputOffset + offsetInOutput, count);
+            bytesRead += count;
+            position += (Sint64)count;
+        }
+        else if (!InflateMore())
+        {
+            break;
+        }
+    }
+
+    return bytesRead;
+}
+
+void ResourceLoader::ArchiveSource::ArchiveFileStream::RestartInflating()
+{
+    tinfl_init(&decompressor);
+    inputBufferOffset = 0;
+    inputBufferByteCount = 0;
+    storedBytesRead = 0;
+
+    windowOffset = 0;
+    outputOffset = 0;
+    outputByteCount = 0;
+    outputPosition = 0;
+    isFinished = pInputBuffer == NULL || pWindow == NULL;
+}
+
+bool ResourceLoader::ArchiveSource::ArchiveFileStream::InflateMore()
+{
+    if (isFinished)
+    {
+        return false;
+    }
+
+    outputPosition += (Sint64)outputByteCount;
+    outputByteCount = 0;
+
+    while (true)
+    {
+        if (inputBufferOffset == inputBufferByteCount && storedBytesRead < storedSize)
+        {
+            inputBufferByteCount = (size_t)min((mz_uint64)ArchiveStreamInputBufferSize, storedSize - storedBytesRead);
+            inputBufferOffset = 0;
+
+            if (!pSource->ReadArchiveBytes(dataOffset + storedBytesRead, pInputBuffer, inputBufferByteCount))
+            {
+                isFinished = true;
+                return false;
+            }
+
+            storedBytesRead += inputBufferByteCount;
+        }
+
+        // The window is only as large as the deflate dictionary, so the decompressor
+        // wraps around to its start once it fills up.
+        size_t inputByteCount = inputBufferByteCount - inputBufferOffset;
+        size_t outputSpace = TINFL_LZ_DICT_SIZE - windowOffset;
+
+        tinfl_status status =
+            tinfl_decompress(
+                &decompressor,
+                pInputBuffer + inputBufferOffset,
+                &inputByteCount,
+                pWindow,
+                pWindow + windowOffset,
+                &outputSpace,
+                storedBytesRead < storedSize ? TINFL_FLAG_HAS_MORE_INPUT : 0);
+
+        inputBufferOffset += inputByteCount;
+        outputOffset = windowOffset;
+        outputByteCount = outputSpace;
+        windowOffset = (windowOffset + outputSpace) & (TINFL_LZ_DICT_SIZE - 1);
+
+        if (status <= TINFL_STATUS_DONE)
+        {
+            isFinished = true;
+        }
+
+        if (outputByteCount > 0)
+        {
+            return true;
+        }
+
+        if (isFinished)
+        {
+            return false;
+        }
+    }
+}
+
+Sint64 ResourceLoader::ArchiveSource::ArchiveFileStreamSize(SDL_RWops *pRW)
+{
+    ArchiveFileStream *pStream = static_cast<ArchiveFileStream *>(pRW->hidden.unknown.data1);
+    return pStream->size;
+}
+
+Sint64 ResourceLoader::ArchiveSource::ArchiveFileStreamSeek(SDL_RWops *pRW, Sint64 offset, int whence)
+{
+    ArchiveFileStream *pStream = static_cast<ArchiveFileStream *>(pRW->hidden.unknown.data1);
+    Sint64 newPosition = 0;
+
+    switch (whence)
+    {
+    case RW_SEEK_SET:
+        newPosition = offset;
+        break;
+
+    case RW_SEEK_CUR:
+        newPosition = pStream->position + offset;
+        break;
+
+    case RW_SEEK_END:
+        newPosition = pStream->size + offset;
+        break;
+
+    default:
+        return -1;
+    }
+
+    // We don't do any work until the next read, so seeking somewhere we never read from costs nothing.
+    pStream->position = max((Sint64)0, min(pStream->size, newPosition));
+    return pStream->position;
+}
+
+size_t ResourceLoader::ArchiveSource::ArchiveFileStreamRead(SDL_RWops *pRW, void *pBuffer, size_t size, size_t maxCount)
+{
+    ArchiveFileStream *pStream = static_cast<ArchiveFileStream *>(pRW->hidden.unknown.data1);
+
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    size_t count = min(maxCount, (size_t)(pStream->size - pStream->position) / size);
+    return pStream->Read(static_cast<unsigned char *>(pBuffer), count * size) / size;
+}
+
+size_t ResourceLoader::ArchiveSource::ArchiveFileStreamWrite(SDL_RWops * /*pRW*/, const void * /*pBuffer*/, size_t /*size*/, size_t /*count*/)
+{
+    // The archive is read-only.
+    return 0;
+}
+
+int ResourceLoader::ArchiveSource::ArchiveFileStreamClose(SDL_RWops *pRW)
+{
+    if (pRW != NULL)
+    {
+        ArchiveFileStream *pStream = static_cast<ArchiveFileStream *>(pRW->hidden.unknown.data1);
+        pStream->pSource->Release();
+        delete pStream;
+
+        SDL_FreeRW(pRW);
+    }
+
+    return 0;
+}
+
+ResourceLoader::AssetIndex::AssetIndex(unsigned int generation, ArchiveSource *pCommonSource, ArchiveSource *pCaseSource)
+{
+    this->generation = generation;
+    SDL_AtomicSet(&referenceCount, 1);
+
+    this->pCommonSource = pCommonSource;
+    this->pCaseSource = pCaseSource;
+
+    size_t entryCount = 0;
+
+    if (pCommonSource != NULL)
+    {
+        pCommonSource->AddReference();
+        entryCount += pCommonSource->GetEntryList().size();
+    }
+
+    if (pCaseSource != NULL)
+    {
+        pCaseSource->AddReference();
+        entryCount += pCaseSource->GetEntryList().size();
+        caseUuid = GetUuidFromFilePath(pCaseSource->GetArchiveFilePath());
+    }
+
+    // We'll keep at least twice as many buckets as entries, rounded up to a power of two,
+    // so that chains stay short and we can pick a bucket with a mask.
+    size_t bucketCount = 16;
+
+    while (bucketCount < entryCount * 2)
+    {
+        bucketCount *= 2;
+    }
+
+    bucketList.resize(bucketCount, -1);
+    entryList.reserve(entryCount);
+
+    // Common files go in first, so they win over any case file of the same name.
+    AddEntries(pCommonSource);
+    AddEntries(pCaseSource);
+}
+
+ResourceLoader::AssetIndex::~AssetIndex()
+{
+    if (pCommonSource != NULL)
+    {
+        pCommonSource->Release();
+    }
+
+    if (pCaseSource != NULL)
+    {
+        pCaseSource->Release();
+    }
+}
+
+void ResourceLoader::AssetIndex::AddReference()
+{
+    SDL_AtomicAdd(&referenceCount, 1);
+}
+
+void ResourceLoader::AssetIndex::Release()
+{
+    // SDL_AtomicAdd() returns the value from before the decrement.
+    if (SDL_AtomicAdd(&referenceCount, -1) == 1)
+    {
+        delete this;
+    }
+}
+
+bool ResourceLoader::AssetIndex::TryResolve(const string &relativeFilePath, int *pEntryIndex)
+{
+    const char *pFilePath = relativeFilePath.c_str();
+    *pEntryIndex = FindEntry(pFilePath, HashArchiveFilePath(pFilePath));
+    return *pEntryIndex >= 0;
+}
+
+bool ResourceLoader::AssetIndex::TryResolveCaseFile(const string &relativeFilePath, int *pEntryIndex)
+{
+    const char *pFilePath = relativeFilePath.c_str();
+    unsigned int filePathHash = HashArchiveFilePath(pFilePath);
+
+    *pEntryIndex = FindEntry(pFilePath, filePathHash);
+
+    if (*pEntryIndex >= 0 && entryList[*pEntryIndex].pSource != pCaseSource)
+    {
+        *pEntryIndex = -1;
+
+        for (unsigned int i = 0; i < shadowedCaseEntryIndexList.size(); i++)
+        {
+            const ArchiveSource::ArchiveEntry *pArchiveEntry = entryList[shadowedCaseEntryIndexList[i]].pArchiveEntry;
+
+            if (pArchiveEntry->filePathHash == filePathHash && FilePathMatchesNormalizedFilePath(pFilePath, pArchiveEntry->normalizedFilePath))
+            {
+                *pEntryIndex = shadowedCaseEntryIndexList[i];
+                break;
+            }
+        }
+    }
+
+    return *pEntryIndex >= 0;
+}
+
+SDL_RWops * ResourceLoader::AssetIndex::LoadFile(int entryIndex, void **ppMemToFree)
+{
+    Entry &entry = entryList[entryIndex];
+    return entry.pSource->LoadFile(*entry.pArchiveEntry, ppMemToFree);
+}
+
+SDL_RWops * ResourceLoader::AssetIndex::LoadFileStream(int entryIndex, void **ppMemToFree)
+{
+    Entry &entry = entryList[entryIndex];
+    return entry.pSource->LoadFileStream(*entry.pArchiveEntry, ppMemToFree);
+}
+
+void * ResourceLoader::AssetIndex::LoadFileToMemory(int entryIndex, unsigned int *pSize)
+{
+    Entry &entry = entryList[entryIndex];
+    return entry.pSource->LoadFileToMemory(*entry.pArchiveEntry, pSize);
+}
+
+string ResourceLoader::AssetIndex::GetDecodedImageCacheKey(int entryIndex)
+{
+    Entry &entry = entryList[entryIndex];
+    char crc32String[9];
+
+    // The CRC changes whenever the file does, so a new version of a case never picks up the old version's images.
+    sprintf(crc32String, "%08X", (unsigned int)entry.pArchiveEntry->crc32);
+
+    return
+        (entry.pSource == pCommonSource ? string("Common") : caseUuid) + "/" +
+        entry.pArchiveEntry->normalizedFilePath + "/" +
+        crc32String;
+}
+
+void ResourceLoader::AssetIndex::AddEntries(ArchiveSource *pSource)
+{
+    if (pSource == NULL)
+    {
+        return;
+    }
+
+    const vector<ArchiveSource::ArchiveEntry> &archiveEntryList = pSource->GetEntryList();
+
+    for (unsigned int i = 0; i < archiveEntryList.size(); i++)
+    {
+        const ArchiveSource::ArchiveEntry &archiveEntry = archiveEntryList[i];
+
+        Entry entry;
+        entry.pSource = pSource;
+        entry.pArchiveEntry = &archiveEntry;
+
+        if (FindEntry(archiveEntry.normalizedFilePath.c_str(), archiveEntry.filePathHash) >= 0)
+        {
+            if (pSource == pCaseSource)
+            {
+                entry.nextEntryIndex = -1;
+                shadowedCaseEntryIndexList.push_back((int)entryList.size());
+                entryList.push_back(entry);
+            }
+
+            continue;
+        }
+
+        size_t bucketIndex = archiveEntry.filePathHash & (bucketList.size() - 1);
+        entry.nextEntryIndex = bucketList[bucketIndex];
+
+        bucketList[bucketIndex] = (int)entryList.size();
+        entryList.push_back(entry);
+    }
+}
+
+int ResourceLoader::AssetIndex::FindEntry(const char *pFilePath, unsigned int filePathHash)
+{
+    int entryIndex = bucketList[filePathHash & (bucketList.size() - 1)];
+
+    while (entryIndex >= 0)
+    {
+        const ArchiveSource::ArchiveEntry *pArchiveEntry = entryList[entryIndex].pArchiveEntry;
+
+        if (pArchiveEntry->filePathHash == filePathHash && FilePathMatchesNormalizedFilePath(pFilePath, pArchiveEntry->normalizedFilePath))
+        {
+            return entryIndex;
+        }
+
+        entryIndex = entryList[entryIndex].nextEntryIndex;
+    }
+
+    return -1;
+}
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_ARCHIVE_BENCHMARK
+namespace
+{
+    class ExtractionBenchmarkParameters
+    {
+    public:
+        void *pSource;
+        SDL_atomic_t nextFileIndex;
+        SDL_atomic_t kilobytesExtracted;
+    };
+}
+
+void ResourceLoader::ArchiveSource::BenchmarkExtraction()
+{
+    const int threadCounts[] = { 1, 2, 4, 8 };
+
+    cout << "Extraction benchmark for \"" << archiveFilePath << "\" (" << entryList.size() << " files, " << (format == ArchiveFormatCasePack ? "case pack" : "zip") << "):" << endl;
+
+    for (unsigned int i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); i++)
+    {
+        ExtractionBenchmarkParameters parameters;
+        vector<SDL_Thread *> threadList;
+
+        parameters.pSource = this;
+        SDL_AtomicSet(&parameters.nextFileIndex, 0);
+        SDL_AtomicSet(&parameters.kilobytesExtracted, 0);
+
+        Uint64 startTime = SDL_GetPerformanceCounter();
+
+        for (int j = 0; j < threadCounts[i]; j++)
+        {
+            threadList.push_back(SDL_CreateThread(ArchiveSource::RunBenchmarkThread, "ExtractionBenchmarkThread", &parameters));
+        }
+
+        for (unsigned int j = 0; j < threadList.size(); j++)
+        {
+            SDL_WaitThread(threadList[j], NULL);
+        }
+
+        double elapsedMilliseconds = GetMillisecondsSince(startTime);
+        double megabytesExtracted = SDL_AtomicGet(&parameters.kilobytesExtracted) / 1024.0;
+
+        cout << "    " << threadCounts[i] << " thread(s): "
+             << megabytesExtracted << " MB in " << elapsedMilliseconds << " ms ("
+             << megabytesExtracted * 1000.0 / elapsedMilliseconds << " MB/s)" << endl;
+    }
+}
+
+int ResourceLoader::ArchiveSource::RunBenchmarkThread(void *pData)
+{
+    ExtractionBenchmarkParameters *pParameters = reinterpret_cast<ExtractionBenchmarkParameters *>(pData);
+    ArchiveSource *pSource = reinterpret_cast<ArchiveSource *>(pParameters->pSource);
+    int fileCount = (int)pSource->entryList.size();
+
+    for (int fileIndex = SDL_AtomicAdd(&pParameters->nextFileIndex, 1); fileIndex < fileCount; fileIndex = SDL_AtomicAdd(&pParameters->nextFileIndex, 1))
+    {
+        size_t uncomp_size = 0;
+        void *p = pSource->ExtractFile(pSource->entryList[fileIndex], &uncomp_size);
+
+        if (p != NULL)
+        {
+            SDL_AtomicAdd(&pParameters->kilobytesExtracted, (int)(uncomp_size / 1024));
+            free(p);
+        }
+    }
+
+    return 0;
 }
+    #endif
+#endif
@@ -39,12 +39,18 @@
 #include <SDL2/SDL_image.h>
 #endif
 
+#include "AssetHandle.h"
+#include "CasePack.h"
+#include "DecodedImageCache.h"
 #include "Image.h"
 #include "miniz.h"
+#include "mli_audio.h"
 
 #include <map>
+#include <set>
 #include <vector>
 #include <deque>
+#include <stdio.h>
 
 #include <cryptopp/sha.h>
 
@@ -55,8 +61,47 @@ extern "C"
 
 class ArchiveSource;
 
+enum LoadResourceStepPriority
+{
+    // Unloading takes next to no time, and makes room for whatever we're about to load, so it comes first.
+    LoadResourceStepPriorityUnload,
+    // Things that will be on screen as soon as we're done loading come next.
+    LoadResourceStepPriorityFirstFrame,
+    LoadResourceStepPriorityNormal,
+    LoadResourceStepPriorityCount,
+};
+
 const int IOContextBufferSize = 32768;
 
+// How much compressed data a streamed archive file reads from the archive at a time.
+// Along with the 32 KB deflate window, this is all the memory a streamed file needs, however large it is.
+const int ArchiveStreamInputBufferSize = 16384;
+
+// The most threads we'll use to decode images in the background.
+const int MaxImageDecodeThreadCount = 4;
+
+// How many upcoming image load steps we'll start decoding ahead of time.
+// Each decoded image is held in memory until its step runs, so this bounds the memory used.
+const int ImageDecodeAheadCount = 8;
+
+// The most threads we'll use to load music, sound effects and dialog in the background.
+// Audio is rarely needed the moment it's preloaded, so this is kept small to leave room for image decodes.
+const int MaxAudioPreloadThreadCount = 2;
+
+// How long we'll spend each frame uploading textures and running load steps.
+const double ResourceLoaderFrameTimeBudgetMs = 4.0;
+
+// How long we'll spend each frame running background load steps, which load
+// things we expect to need soon rather than things we need right now.
+const double BackgroundLoadFrameTimeBudgetMs = 1.0;
+
+// How many upcoming background image load steps we'll start decoding ahead of time.
+const int BackgroundImageDecodeAheadCount = 2;
+
+// The largest archive we'll map into memory in a 32-bit process.
+// Anything bigger is read through file handles instead, so we don't run out of address space.
+const mz_uint64 MaxMappedArchiveSizeIn32BitProcess = 512 * 1024 * 1024;
+
 class RWOpsIOContext
 {
 public:
@@ -80,6 +125,7 @@ public:
     {
         av_freep(&pIOContext);
         av_freep(&pBuffer);
+        SDL_RWclose(pRW);
     }
 
     static int Read(void *opaque, unsigned char *buf, int buf_size)
@@ -116,57 +162,315 @@ private:
 class ResourceLoader
 {
 private:
+    // Files can be extracted from an archive source on any number of threads at once.
+    // All threads share the archive's central directory, and each read borrows
+    // a file handle of its own, so no read ever moves another thread's file position.
+    // Archive sources are reference counted so that one can be swapped out
+    // while other threads are still reading from it.
+    // Where we can, we map the whole archive into memory, so that files stored
+    // without compression can be read straight out of the mapping without being copied.
+    // An archive can be either a zip archive or a case pack (see CasePack.h);
+    // which one it is is worked out from its first few bytes, so callers never need to know.
     class ArchiveSource
     {
     public:
+        enum ArchiveFormat
+        {
+            ArchiveFormatZip,
+            ArchiveFormatCasePack,
+        };
+
         ArchiveSource()
             : zip_archive(mz_zip_archive())
         {
+            format = ArchiveFormatZip;
+            fileHandleLock = 0;
+            SDL_AtomicSet(&referenceCount, 1);
+            pMappedArchive = NULL;
+            mappedArchiveSize = 0;
+            SDL_AtomicSet(&kilobytesMapped, 0);
+            SDL_AtomicSet(&kilobytesExtracted, 0);
+            SDL_AtomicSet(&kilobytesStreamed, 0);
         }
 
-        ~ArchiveSource();
+        // An entry in the archive's central directory or case pack entry table, read once when the archive is opened.
+        // For zip archives, method is the zip compression method, and the data offset isn't known up front.
+        // For case packs, method is the entry's CasePackCodec.
+        class ArchiveEntry
+        {
+        public:
+            string normalizedFilePath;
+            unsigned int filePathHash;
+            mz_uint fileIndex;
+            mz_uint64 size;
+            mz_uint16 method;
+            mz_uint64 dataOffset;
+            mz_uint64 storedSize;
+            mz_uint32 crc32;
+        };
 
         static bool CreateAndInit(string archiveFilePath, ArchiveSource **ppSource);
-        SDL_RWops * LoadFile(string relativeFilePath, void **ppMemToFree);
-        void * LoadFileToMemory(string relativeFilePath, unsigned int *pSize);
+        SDL_RWops * LoadFile(const ArchiveEntry &entry, void **ppMemToFree);
+        void * LoadFileToMemory(const ArchiveEntry &entry, unsigned int *pSize);
+
+        // Like LoadFile(), but reads the file out of the archive as it's read from, rather than extracting
+        // all of it up front, so that large files that are read a little at a time don't sit in memory in full.
+        // Files we can't stream are extracted as LoadFile() would.
+        SDL_RWops * LoadFileStream(const ArchiveEntry &entry, void **ppMemToFree);
+
+        const vector<ArchiveEntry> & GetEntryList() { return entryList; }
+        const string & GetArchiveFilePath() { return archiveFilePath; }
+
+        void AddReference();
+        void Release();
+
+        unsigned int GetKilobytesMapped() { return (unsigned int)SDL_AtomicGet(&kilobytesMapped); }
+        unsigned int GetKilobytesExtracted() { return (unsigned int)SDL_AtomicGet(&kilobytesExtracted); }
+        unsigned int GetKilobytesStreamed() { return (unsigned int)SDL_AtomicGet(&kilobytesStreamed); }
+        void ResetStatistics();
+
+    #ifdef MLI_DEBUG
+        #ifdef MLI_DEBUG_ARCHIVE_BENCHMARK
+        void BenchmarkExtraction();
+        static int RunBenchmarkThread(void *pData);
+        #endif
+    #endif
 
     private:
-        bool Init(string archiveFilePath);
+        ~ArchiveSource();
 
+        bool Init(string archiveFilePath);
+        bool InitZip(mz_uint64 archiveSize);
+        bool InitCasePack(mz_uint64 archiveSize);
+        void BuildZipEntryList();
+        bool ReadArchiveBytes(mz_uint64 offset, void *pBuffer, size_t byteCount);
+        void * ExtractFile(const ArchiveEntry &entry, size_t *pSize);
+        void * ExtractCasePackFile(const ArchiveEntry &entry);
+
+        FILE * AcquireFileHandle();
+        void ReleaseFileHandle(FILE *pFile);
+        static size_t Read(void *pOpaque, mz_uint64 fileOffset, void *pBuffer, size_t byteCount);
+
+        bool MapArchive(mz_uint64 archiveSize);
+        void UnmapArchive();
+        bool TryGetFileDataLocation(const ArchiveEntry &entry, mz_uint64 *pDataOffset, bool *pIsCompressed);
+        bool TryGetStoredFileData(const ArchiveEntry &entry, const unsigned char **ppData, size_t *pSize);
+
+        // A read-only view onto a stored file inside the mapped archive.
+        // The view holds a reference to its archive source, so the mapping
+        // stays valid until the SDL_RWops reading from it is closed.
+        class MappedFileView
+        {
+        public:
+            ArchiveSource *pSource;
+            const unsigned char *pData;
+            Sint64 size;
+            Sint64 position;
+        };
+
+        static Sint64 MappedFileViewSize(SDL_RWops *pRW);
+        static Sint64 MappedFileViewSeek(SDL_RWops *pRW, Sint64 offset, int whence);
+        static size_t MappedFileViewRead(SDL_RWops *pRW, void *pBuffer, size_t size, size_t maxCount);
+        static size_t MappedFileViewWrite(SDL_RWops *pRW, const void *pBuffer, size_t size, size_t count);
+        static int MappedFileViewClose(SDL_RWops *pRW);
+
+        // A file being read out of the archive a piece at a time.  Stored files are read straight from
+        // the archive at the position asked for.  Deflated files are inflated as they're read,
+        // into a buffer only as large as the deflate window; seeking forward inflates and throws away
+        // whatever's skipped over, and seeking backward starts inflating again from the beginning.
+        // Like a mapped file view, the stream holds a reference to its archive source.
+        class ArchiveFileStream
+        {
+        public:
+            ArchiveFileStream(ArchiveSource *pSource, mz_uint64 dataOffset, mz_uint64 storedSize, mz_uint64 size, bool isCompressed);
+            ~ArchiveFileStream();
+
+            size_t Read(unsigned char *pBuffer, size_t byteCount);
+
+            ArchiveSource *pSource;
+            Sint64 size;
+            Sint64 position;
+
+        private:
+            size_t ReadStored(unsigned char *pBuffer, size_t byteCount);
+            size_t ReadCompressed(unsigned char *pBuffer, size_t byteCount);
+            void RestartInflating();
+            bool InflateMore();
+
+            mz_uint64 dataOffset;
+            mz_uint64 storedSize;
+            bool isCompressed;
+
+            tinfl_decompressor decompressor;
+            unsigned char *pInputBuffer;
+            size_t inputBufferOffset;
+            size_t inputBufferByteCount;
+            mz_uint64 storedBytesRead;
+
+            // Inflated bytes are written into the window a piece at a time, wrapping around at its end.
+            // The piece we've just inflated starts at outputPosition in the file,
+            // and is the outputByteCount bytes starting at outputOffset in the window.
+            unsigned char *pWindow;
+            size_t windowOffset;
+            size_t outputOffset;
+            size_t outputByteCount;
+            Sint64 outputPosition;
+            bool isFinished;
+        };
+
+        static Sint64 ArchiveFileStreamSize(SDL_RWops *pRW);
+        static Sint64 ArchiveFileStreamSeek(SDL_RWops *pRW, Sint64 offset, int whence);
+        static size_t ArchiveFileStreamRead(SDL_RWops *pRW, void *pBuffer, size_t size, size_t maxCount);
+        static size_t ArchiveFileStreamWrite(SDL_RWops *pRW, const void *pBuffer, size_t size, size_t count);
+        static int ArchiveFileStreamClose(SDL_RWops *pRW);
+
+        ArchiveFormat format;
         mz_zip_archive zip_archive;
+        string archiveFilePath;
+        SDL_atomic_t referenceCount;
+        vector<ArchiveEntry> entryList;
+
+        vector<FILE *> fileHandleList;
+        vector<FILE *> freeFileHandleList;
+        SDL_SpinLock fileHandleLock;
+
+        const unsigned char *pMappedArchive;
+        mz_uint64 mappedArchiveSize;
+
+        SDL_atomic_t kilobytesMapped;
+        SDL_atomic_t kilobytesExtracted;
+        SDL_atomic_t kilobytesStreamed;
+    };
+
+    // A single hash table covering every file in the common archive and the mounted case archive,
+    // built whenever a case archive is mounted, so that finding a file never means searching each archive in turn.
+    // Files in the common archive take precedence over files of the same name in the case archive.
+    // Like archive sources, asset indexes are reference counted, and each holds a reference
+    // to the archives it covers, so a lookup stays valid while a different case is mounted.
+    class AssetIndex
+    {
+    public:
+        AssetIndex(unsigned int generation, ArchiveSource *pCommonSource, ArchiveSource *pCaseSource);
+
+        void AddReference();
+        void Release();
+
+        unsigned int GetGeneration() { return generation; }
+        bool TryResolve(const string &relativeFilePath, int *pEntryIndex);
+
+        // Like TryResolve(), but only finds files in the case's archive, even where a common file shadows them.
+        bool TryResolveCaseFile(const string &relativeFilePath, int *pEntryIndex);
+
+        SDL_RWops * LoadFile(int entryIndex, void **ppMemToFree);
+        SDL_RWops * LoadFileStream(int entryIndex, void **ppMemToFree);
+        void * LoadFileToMemory(int entryIndex, unsigned int *pSize);
+        string GetDecodedImageCacheKey(int entryIndex);
+
+    private:
+        ~AssetIndex();
+
+        void AddEntries(ArchiveSource *pSource);
+        int FindEntry(const char *pFilePath, unsigned int filePathHash);
+
+        class Entry
+        {
+        public:
+            ArchiveSource *pSource;
+            const ArchiveSource::ArchiveEntry *pArchiveEntry;
+            int nextEntryIndex;
+        };
+
+        unsigned int generation;
+        SDL_atomic_t referenceCount;
+
+        ArchiveSource *pCommonSource;
+        ArchiveSource *pCaseSource;
+        string caseUuid;
+
+        vector<Entry> entryList;
+        vector<int> bucketList;
+
+        // Case files with the same name as a common file aren't in any bucket,
+        // so they can only be found through TryResolveCaseFile().
+        vector<int> shadowedCaseEntryIndexList;
     };
 
     class LoadResourceStep
     {
     public:
+        LoadResourceStep(LoadResourceStepPriority priority)
+        {
+            this->priority = priority;
+            this->isCancelled = false;
+        }
+
         virtual ~LoadResourceStep() { }
         virtual void Execute() = 0;
+
+        // Starts any work for this step that can be done in the background ahead of time.
+        virtual void Prefetch() { }
+
+        // Whether this step can run without waiting on any work it started in Prefetch().
+        virtual bool IsReadyToExecute() { return true; }
+
+        // Lets go of any work this step started in Prefetch(), for when it won't be run after all.
+        virtual void CancelPrefetch() { }
+
+        // Identifies the resource this step loads or unloads.  The steps that load
+        // and unload a given resource share a key, so that they can cancel each other out.
+        virtual string GetResourceKey() = 0;
+
+        LoadResourceStepPriority GetPriority() { return this->priority; }
+        bool GetIsUnload() { return this->priority == LoadResourceStepPriorityUnload; }
+
+        bool GetIsCancelled() { return this->isCancelled; }
+        void Cancel() { this->isCancelled = true; }
+
+    private:
+        LoadResourceStepPriority priority;
+        bool isCancelled;
     };
 
+    // Background image load steps upload their texture right away, since a texture waiting
+    // to be uploaded would hold up the loading screen, and they leave sprite sheets
+    // that are already loaded alone.
     class LoadImageStep : public LoadResourceStep
     {
     public:
-        LoadImageStep(string spriteId)
+        LoadImageStep(string spriteId, LoadResourceStepPriority priority, bool isBackground = false)
+            : LoadResourceStep(priority)
         {
             this->spriteId = spriteId;
+            this->isBackground = isBackground;
+            this->isPrefetched = false;
         }
 
         void Execute();
+        void Prefetch();
+        bool IsReadyToExecute();
+        void CancelPrefetch();
+        string GetResourceKey() { return GetImageResourceKey(this->spriteId); }
         string GetSpriteId() { return this->spriteId; }
+        string GetFilePath();
+        bool GetIsPrefetched() { return this->isPrefetched; }
 
     private:
         string spriteId;
+        bool isBackground;
+        bool isPrefetched;
     };
 
     class DeleteImageStep : public LoadResourceStep
     {
     public:
         DeleteImageStep(string spriteId)
+            : LoadResourceStep(LoadResourceStepPriorityUnload)
         {
             this->spriteId = spriteId;
         }
 
         void Execute();
+        string GetResourceKey() { return GetImageResourceKey(this->spriteId); }
         string GetSpriteId() { return this->spriteId; }
 
     private:
@@ -177,33 +481,221 @@ private:
     {
     public:
         LoadVideoStep(Video *pVideo)
+            : LoadResourceStep(LoadResourceStepPriorityNormal)
         {
             this->pVideo = pVideo;
+            this->isPrefetched = false;
         }
 
         void Execute();
+        void Prefetch();
+        bool IsReadyToExecute();
+        void CancelPrefetch();
+        string GetResourceKey() { return GetVideoResourceKey(this->pVideo); }
         Video * GetVideo() { return this->pVideo; }
+        bool GetIsPrefetched() { return this->isPrefetched; }
 
     private:
         Video *pVideo;
+        bool isPrefetched;
     };
 
     class DeleteVideoStep : public LoadResourceStep
     {
     public:
         DeleteVideoStep(Video *pVideo)
+            : LoadResourceStep(LoadResourceStepPriorityUnload)
         {
             this->pVideo = pVideo;
         }
 
         void Execute();
+        string GetResourceKey() { return GetVideoResourceKey(this->pVideo); }
         Video * GetVideo() { return this->pVideo; }
 
     private:
         Video *pVideo;
     };
 
+    static string GetImageResourceKey(const string &spriteId);
+    static string GetVideoResourceKey(Video *pVideo);
+
+    // Load steps waiting to run, in order of priority, and in the order they were added within each priority.
+    // Steps are looked up by the resource they load or unload, so adding a step that's already queued
+    // does nothing, and adding a step that undoes one that's already queued cancels them both out.
+    // Cancelled steps are left where they are and thrown away once they reach the front,
+    // so that nothing ever needs to be removed from the middle of a queue.
+    class LoadStepQueue
+    {
+    public:
+        LoadStepQueue()
+        {
+            count = 0;
+        }
+
+        ~LoadStepQueue()
+        {
+            Clear();
+        }
+
+        void Add(LoadResourceStep *pStep);
+        void AddAll(LoadStepQueue *pOther);
+        LoadResourceStep * Peek();
+        LoadResourceStep * Pop();
+        void GetSteps(unsigned int maxCount, vector<LoadResourceStep *> *pStepList);
+        void Clear();
+
+        bool IsEmpty() { return count == 0; }
+        unsigned int GetCount() { return count; }
+
+    private:
+        deque<LoadResourceStep *> stepListByPriority[LoadResourceStepPriorityCount];
+        map<string, LoadResourceStep *> stepByResourceKeyMap;
+        unsigned int count;
+    };
+
+    enum PrefetchedImageState
+    {
+        PrefetchedImageStateQueued,
+        PrefetchedImageStateDecoding,
+        PrefetchedImageStateDecoded,
+    };
+
+    // An image that's being decoded in the background ahead of when it's needed.
+    // Once a decode thread has started on it, that thread owns it until it's done;
+    // whoever takes it out of the map after that point waits on its semaphore.
+    class PrefetchedImage
+    {
+    public:
+        PrefetchedImage(string relativeFilePath)
+        {
+            this->relativeFilePath = relativeFilePath;
+            this->state = PrefetchedImageStateQueued;
+            this->pSurface = NULL;
+            this->fileExists = false;
+            this->isCancelled = false;
+            this->pDecodedSemaphore = SDL_CreateSemaphore(0);
+        }
+
+        ~PrefetchedImage()
+        {
+            if (pSurface != NULL)
+            {
+                SDL_FreeSurface(pSurface);
+                pSurface = NULL;
+            }
+
+            SDL_DestroySemaphore(pDecodedSemaphore);
+            pDecodedSemaphore = NULL;
+        }
+
+        string relativeFilePath;
+        PrefetchedImageState state;
+        SDL_Surface *pSurface;
+        bool fileExists;
+        bool isCancelled;
+        SDL_sem *pDecodedSemaphore;
+    };
+
+    enum AudioPreloadState
+    {
+        AudioPreloadStateQueued,
+        AudioPreloadStateLoading,
+    };
+
+    // Music, a sound effect or dialog that's waiting to be loaded in the background.
+    // It's taken out of the map once it's loaded, at which point anyone waiting on it
+    // is woken up, and the last of them to wake deletes it.
+    class AudioPreload
+    {
+    public:
+        AudioPreload(AudioType type, string id, string relativeFilePath)
+        {
+            this->type = type;
+            this->id = id;
+            this->relativeFilePath = relativeFilePath;
+            this->state = AudioPreloadStateQueued;
+            this->waiterCount = 0;
+            this->pLoadedSemaphore = SDL_CreateSemaphore(0);
+        }
+
+        ~AudioPreload()
+        {
+            SDL_DestroySemaphore(pLoadedSemaphore);
+            pLoadedSemaphore = NULL;
+        }
+
+        AudioType type;
+        string id;
+        string relativeFilePath;
+        AudioPreloadState state;
+        int waiterCount;
+        SDL_sem *pLoadedSemaphore;
+    };
+
 public:
+    class Statistics
+    {
+    public:
+        Statistics()
+        {
+            ImagesDecoded = 0;
+            ImagesDecodedAhead = 0;
+            ImagesWaitedOn = 0;
+            ExtractMicroseconds = 0;
+            DecodeMicroseconds = 0;
+            ImagesLoadedFromCache = 0;
+            CacheReadMicroseconds = 0;
+            CacheWriteMicroseconds = 0;
+            TexturesUploaded = 0;
+            UploadMicroseconds = 0;
+            LoadStepsRun = 0;
+            LoadStepMicroseconds = 0;
+            BackgroundLoadStepsRun = 0;
+            BackgroundLoadStepMicroseconds = 0;
+            AudioPreloadsRun = 0;
+            AudioPreloadsWaitedOn = 0;
+            AudioPreloadMicroseconds = 0;
+            ArchiveKilobytesMapped = 0;
+            ArchiveKilobytesExtracted = 0;
+            ArchiveKilobytesStreamed = 0;
+            QueuedImageDecodes = 0;
+            DecodedImagesWaiting = 0;
+            TexturesToUpload = 0;
+            LoadStepsToRun = 0;
+            BackgroundLoadStepsToRun = 0;
+            QueuedAudioPreloads = 0;
+        }
+
+        unsigned int ImagesDecoded;
+        unsigned int ImagesDecodedAhead;
+        unsigned int ImagesWaitedOn;
+        unsigned int ExtractMicroseconds;
+        unsigned int DecodeMicroseconds;
+        unsigned int ImagesLoadedFromCache;
+        unsigned int CacheReadMicroseconds;
+        unsigned int CacheWriteMicroseconds;
+        unsigned int TexturesUploaded;
+        unsigned int UploadMicroseconds;
+        unsigned int LoadStepsRun;
+        unsigned int LoadStepMicroseconds;
+        unsigned int BackgroundLoadStepsRun;
+        unsigned int BackgroundLoadStepMicroseconds;
+        unsigned int AudioPreloadsRun;
+        unsigned int AudioPreloadsWaitedOn;
+        unsigned int AudioPreloadMicroseconds;
+        unsigned int ArchiveKilobytesMapped;
+        unsigned int ArchiveKilobytesExtracted;
+        unsigned int ArchiveKilobytesStreamed;
+
+        unsigned int QueuedImageDecodes;
+        unsigned int DecodedImagesWaiting;
+        unsigned int TexturesToUpload;
+        unsigned int LoadStepsToRun;
+        unsigned int BackgroundLoadStepsToRun;
+        unsigned int QueuedAudioPreloads;
+    };
+
     static void Close();
 
     static ResourceLoader * GetInstance()
@@ -222,37 +714,52 @@ public:
     void UnloadTemporaryCase();
     void UnloadCase();
     SDL_Surface * LoadRawSurface(string relativeFilePath);
-    Image * LoadImage(string relativeFilePath);
+    Image * LoadImage(string relativeFilePath, bool loadImmediately = false);
     void ReloadImage(Image *pSprite, string originFilePath);
     Document * LoadDocument(string relativeFilePath);
     TTF_Font * LoadFont(string relativeFilePath, int ptSize);
 
+    // The codec context is the caller's, and needs to be freed with avcodec_free_context().
     void LoadVideo(
         string relativeFilePath,
+        int codecThreadCount,
         RWOpsIOContext **ppRWOpsIOContext,
         AVFormatContext **ppFormatContext,
         int *pVideoStream,
         AVCodecContext **ppCodecContext,
         AVCodec **ppCodec,
-        void **ppMemToFree);
+        void **ppMemToFree,
+        AssetHandle *pAssetHandle = NULL);
 
+    // Audio is loaded on worker threads.  Playing audio that hasn't finished
+    // loading yet waits for it, and unloading it cancels it if it hasn't started.
     void PreloadMusic(string id, string relativeFilePath);
     void UnloadMusic(string id);
     void PreloadSound(string id, string relativeFilePath);
     void UnloadSound(string id);
     void PreloadDialog(string id, string relativeFilePath);
     void UnloadDialog(string id);
+    void WaitForAudioPreload(AudioType type, const string &id);
+    void FinishAudioPreloads();
+    bool HasAudioPreloads();
 
     void * LoadFileToMemory(string relativeFilePath, unsigned int *pFileSize);
+    void ResolveAsset(string relativeFilePath, AssetHandle *pAssetHandle);
     void HashFile(string relativeFilePath, byte hash[CryptoPP::SHA256::DIGESTSIZE]);
 
     void AddImage(Image *pImage);
     void RemoveImage(Image *pImage);
     void TryLoadOneImageTexture();
+    void TryLoadImageTextures(double timeBudgetMs);
     bool HasImageTexturesToLoad();
     void FlushImages();
 
-    void AddImageIdToLoadList(string id);
+    void PrefetchImage(string relativeFilePath);
+    bool IsPrefetchedImagePending(string relativeFilePath);
+    void CancelPrefetchedImage(string relativeFilePath);
+    void FlushPrefetchedImages();
+
+    void AddImageIdToLoadList(string id, LoadResourceStepPriority priority = LoadResourceStepPriorityNormal);
     void AddImageIdToDeleteList(string id);
     void AddVideoToLoadList(Video *pVideo);
     void AddVideoToDeleteList(Video *pVideo);
@@ -260,28 +767,117 @@ public:
     void SnapLoadStepQueue();
     bool HasLoadStep();
     void TryRunOneLoadStep();
+    void TryRunLoadSteps(double timeBudgetMs);
+
+    // Background load steps only run once every other load step has finished,
+    // and never count towards whether we're loading.  Replacing them cancels
+    // any of their image decodes and video prefetches that no other load step still wants.
+    void ClearBackgroundLoadSteps();
+    void AddImageIdToBackgroundLoadList(string id);
+    void AddVideoToBackgroundLoadList(Video *pVideo);
+    bool HasBackgroundLoadStep();
+    void TryRunBackgroundLoadSteps(double timeBudgetMs);
+
+    Statistics GetStatistics();
+    void ResetStatistics();
 
 private:
     ResourceLoader();
     ~ResourceLoader();
 
+    ArchiveSource * AcquireCaseResourcesSource();
+    void SwapCaseResourcesSource(ArchiveSource *pNewCaseResourcesSource);
+    AssetIndex * AcquireAssetIndex();
+    bool TryResolveAsset(AssetIndex *pAssetIndex, const string &relativeFilePath, AssetHandle *pAssetHandle, int *pEntryIndex);
+    SDL_RWops * LoadFile(const string &relativeFilePath, void **ppMemToFree, AssetHandle *pAssetHandle = NULL);
+    SDL_RWops * LoadFileStream(const string &relativeFilePath, void **ppMemToFree, AssetHandle *pAssetHandle = NULL);
+    SDL_Surface * LoadSurface(string relativeFilePath, bool *pFileExists);
+    bool TakePrefetchedSurface(string relativeFilePath, SDL_Surface **ppSurface, bool *pFileExists);
+    void PrefetchUpcomingLoadSteps();
+    void CancelUnneededBackgroundPrefetches();
+    bool IsBackgroundPrefetch(const string &relativeFilePath);
+    bool IsBackgroundPrefetch(Video *pVideo);
+
+    static string GetAudioPreloadKey(AudioType type, const string &id);
+    void QueueAudioPreload(AudioType type, string id, string relativeFilePath);
+    void FinishAudioPreload(AudioType type, const string &id, bool runIfQueued);
+    void WaitForAudioPreloadToLoad(AudioPreload *pAudioPreload);
+    void RunAudioPreload(AudioPreload *pAudioPreload);
+    void LoadMusic(string id, string relativeFilePath);
+    void LoadSound(string id, string relativeFilePath);
+    void LoadDialog(string id, string relativeFilePath);
+    static void WaitForAudioPreloadStatic(AudioType type, const string &id);
+
+    void EnsureAudioPreloadThreadsStarted();
+    static int RunAudioPreloadThreadStatic(void *pData);
+    void RunAudioPreloadThread();
+
+    void EnsureImageDecodeThreadsStarted();
+    static int RunImageDecodeThreadStatic(void *pData);
+    void RunImageDecodeThread();
+
     static ResourceLoader *pInstance;
 
     ArchiveSource *pCommonResourcesSource;
     ArchiveSource *pCaseResourcesSource;
     ArchiveSource *pCachedCaseResourcesSource;
+    AssetIndex *pAssetIndex;
+    SDL_atomic_t assetIndexGenerationCount;
 
+    // Only guards what pCaseResourcesSource and pAssetIndex point to; reading from the archives needs no lock.
     SDL_sem *pLoadingSemaphore;
 
+    DecodedImageCache decodedImageCache;
+
     map<string, void *> musicIdToMemToFreeMap;
 
+    map<string, AudioPreload *> audioPreloadByKeyMap;
+    deque<AudioPreload *> audioPreloadQueue;
+    vector<SDL_Thread *> audioPreloadThreadList;
+
+    // Also guards musicIdToMemToFreeMap, since the audio preload threads fill it in.
+    SDL_sem *pAudioPreloadSemaphore;
+    SDL_sem *pAudioPreloadsAvailableSemaphore;
+
     deque<Image *> smartSpriteQueue;
     deque<SDL_Texture *> deleteTextureQueue;
     SDL_sem *pQueueSemaphore;
+    SDL_atomic_t imageTexturesToLoadCount;
 
-    deque<LoadResourceStep *> loadResourceStepList;
-    deque<LoadResourceStep *> cachedLoadResourceStepList;
+    LoadStepQueue loadStepQueue;
+    LoadStepQueue cachedLoadStepQueue;
     SDL_sem *pLoadQueueSemaphore;
+
+    LoadStepQueue backgroundLoadStepQueue;
+    set<string> backgroundPrefetchedFilePathSet;
+    set<Video *> backgroundPrefetchedVideoSet;
+    SDL_sem *pBackgroundLoadQueueSemaphore;
+
+    vector<SDL_Thread *> imageDecodeThreadList;
+    SDL_atomic_t isQuitting;
+
+    map<string, PrefetchedImage *> prefetchedImageByFilePathMap;
+    deque<PrefetchedImage *> imageDecodeQueue;
+    SDL_sem *pPrefetchSemaphore;
+    SDL_sem *pImageDecodesAvailableSemaphore;
+
+    SDL_atomic_t imagesDecodedCount;
+    SDL_atomic_t imagesDecodedAheadCount;
+    SDL_atomic_t imagesWaitedOnCount;
+    SDL_atomic_t extractMicroseconds;
+    SDL_atomic_t decodeMicroseconds;
+    SDL_atomic_t imagesLoadedFromCacheCount;
+    SDL_atomic_t cacheReadMicroseconds;
+    SDL_atomic_t cacheWriteMicroseconds;
+    SDL_atomic_t texturesUploadedCount;
+    SDL_atomic_t uploadMicroseconds;
+    SDL_atomic_t loadStepsRunCount;
+    SDL_atomic_t loadStepMicroseconds;
+    SDL_atomic_t backgroundLoadStepsRunCount;
+    SDL_atomic_t backgroundLoadStepMicroseconds;
+    SDL_atomic_t audioPreloadsRunCount;
+    SDL_atomic_t audioPreloadsWaitedOnCount;
+    SDL_atomic_t audioPreloadMicroseconds;
 };
 
 #endif
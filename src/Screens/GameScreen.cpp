@@ -34,6 +34,12 @@
 #include "../CaseInformation/Case.h"
 #include "../CaseInformation/CommonCaseResources.h"
 
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_CASE_LOAD_BENCHMARK
+    #include <iostream>
+    #endif
+#endif
+
 const int LoadingDotsUpdateDelayMs = 500;
 
 GameScreen::GameScreen()
@@ -47,6 +53,13 @@ GameScreen::GameScreen()
     pConfrontationEntranceBackgroundVideo = NULL;
     pConfrontationEntranceVfxVideo = NULL;
 
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_CASE_LOAD_BENCHMARK
+    caseLoadStartTime = 0;
+    hasDrawnFirstInteractiveFrame = true;
+    #endif
+#endif
+
     EventProviders::GetCaseParsingEventProvider()->ClearListener(this);
     EventProviders::GetCaseParsingEventProvider()->RegisterListener(this);
 }
@@ -119,6 +132,13 @@ void GameScreen::Update(int delta)
     {
         SDL_CreateThread(GameScreen::LoadCaseStatic, "LoadCaseThread", new LoadCaseParameters(gCaseFilePath));
         gCaseFilePath = "";
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_CASE_LOAD_BENCHMARK
+        caseLoadStartTime = SDL_GetPerformanceCounter();
+        hasDrawnFirstInteractiveFrame = false;
+    #endif
+#endif
     }
 
     if (isFinishing)
@@ -248,6 +268,24 @@ void GameScreen::Draw()
     }
 
     Case::GetInstance()->Draw();
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_CASE_LOAD_BENCHMARK
+    if (!hasDrawnFirstInteractiveFrame)
+    {
+        // Whatever audio is still loading at this point didn't hold the player up.
+        ResourceLoader::Statistics statistics = ResourceLoader::GetInstance()->GetStatistics();
+
+        cout << "Case load: first interactive frame drawn "
+             << (double)(SDL_GetPerformanceCounter() - caseLoadStartTime) * 1000.0 / SDL_GetPerformanceFrequency() << " ms after the case began loading, with "
+             << statistics.QueuedAudioPreloads << " audio preloads still queued "
+             << "(" << statistics.AudioPreloadsRun << " audio files loaded in " << statistics.AudioPreloadMicroseconds / 1000.0 << " ms, "
+             << statistics.AudioPreloadsWaitedOn << " waited on)" << endl;
+
+        hasDrawnFirstInteractiveFrame = true;
+    }
+    #endif
+#endif
 }
 
 void GameScreen::OnCaseParsingComplete(string caseFileName)
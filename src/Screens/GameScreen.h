@@ -78,6 +78,13 @@ private:
     Video *pConfrontationEntranceVfxVideo;
 
     Video *pSpeedLinesVideo;
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_CASE_LOAD_BENCHMARK
+    Uint64 caseLoadStartTime;
+    bool hasDrawnFirstInteractiveFrame;
+    #endif
+#endif
 };
 
 #endif
@@ -35,8 +35,7 @@ const string CommonFilesId = "CommonFiles";
 
 Sprite::Sprite(XmlReader *pReader)
 {
-    pSpriteSheetImage = NULL;
-    pSpriteSheetSemaphore = SDL_CreateSemaphore(1);
+    pSpriteSheetImageSlot = NULL;
     managerSource = ManagerSourceCommonResources;
 
     pReader->StartElement("Sprite");
@@ -49,12 +48,6 @@ Sprite::Sprite(XmlReader *pReader)
     pReader->EndElement();
 }
 
-Sprite::~Sprite()
-{
-    SDL_DestroySemaphore(pSpriteSheetSemaphore);
-    pSpriteSheetSemaphore = NULL;
-}
-
 string Sprite::GetSpriteSheetImageId() const
 {
     return spriteSheetImageId;
@@ -87,14 +80,16 @@ void Sprite::Draw(Vector2 position, Color color)
 
 void Sprite::Draw(Vector2 position, Color color, double scale, bool flipHorizontally)
 {
-    if (GetSpriteSheetImage() == NULL)
+    Image *pSpriteSheetImage = GetSpriteSheetImage();
+
+    if (pSpriteSheetImage == NULL)
     {
         return;
     }
 
     Vector2 pixelSnappedPosition = Vector2((int)position.GetX(), (int)position.GetY());
 
-    GetSpriteSheetImage()->Draw(
+    pSpriteSheetImage->Draw(
         pixelSnappedPosition,
         spriteClipRect,
         flipHorizontally,
@@ -115,14 +110,16 @@ void Sprite::DrawClipped(Vector2 position, RectangleWH clipRect, bool flipHorizo
 
 void Sprite::DrawClipped(Vector2 position, RectangleWH clipRect, bool flipHorizontally, Color color)
 {
-    if (GetSpriteSheetImage() == NULL)
+    Image *pSpriteSheetImage = GetSpriteSheetImage();
+
+    if (pSpriteSheetImage == NULL)
     {
         return;
     }
 
     Vector2 pixelSnappedPosition = Vector2((int)position.GetX(), (int)position.GetY());
 
-    GetSpriteSheetImage()->Draw(
+    pSpriteSheetImage->Draw(
         pixelSnappedPosition,
         RectangleWH(
             spriteClipRect.GetX() + clipRect.GetX(),
@@ -135,50 +132,27 @@ void Sprite::DrawClipped(Vector2 position, RectangleWH clipRect, bool flipHorizo
         color);
 }
 
-void Sprite::UpdateReadiness(string newLocationId, bool *pLoadSprite, bool *pDeleteSprite)
+bool Sprite::IsNeededAtLocation(string locationId)
 {
     vector<string> parentLocationList = Case::GetInstance()->GetParentLocationListForSpriteSheetId(spriteSheetImageId);
-    bool isNeeded = false;
-
-    *pLoadSprite = false;
-    *pDeleteSprite = false;
 
     for (unsigned int i = 0; i < parentLocationList.size(); i++)
     {
-        if (parentLocationList[i] == newLocationId ||
+        if (parentLocationList[i] == locationId ||
             parentLocationList[i] == CommonFilesId ||
             parentLocationList[i] == Case::GetInstance()->GetPartnerManager()->GetCurrentPartnerId())
         {
-            isNeeded = true;
+            return true;
         }
     }
 
-    bool isReady = IsReady();
-
-    if (isNeeded && !isReady)
-    {
-        *pLoadSprite = true;
-    }
-    else if (!isNeeded && isReady)
-    {
-        *pDeleteSprite = true;
-
-        SDL_SemWait(pSpriteSheetSemaphore);
-        pSpriteSheetImage = NULL;
-        SDL_SemPost(pSpriteSheetSemaphore);
-    }
+    return false;
 }
 
 bool Sprite::IsReady()
 {
-    bool isReady;
-
-    SDL_SemWait(pSpriteSheetSemaphore);
-    Image *pImage = GetSpriteSheetImageNoCache();
-    isReady = pImage != NULL && pImage->IsReady();
-    SDL_SemPost(pSpriteSheetSemaphore);
-
-    return isReady;
+    Image *pImage = GetSpriteSheetImageSlot()->GetImage();
+    return pImage != NULL && pImage->IsReady();
 }
 
 Image * Sprite::GetSpriteSheetImage()
@@ -188,34 +162,33 @@ Image * Sprite::GetSpriteSheetImage()
         return NULL;
     }
 
-    Image *pSprite = NULL;
-
-    SDL_SemWait(pSpriteSheetSemaphore);
-    if (pSpriteSheetImage == NULL)
-    {
-        pSpriteSheetImage = GetSpriteSheetImageNoCache();
-    }
-
-    pSprite = pSpriteSheetImage;
-    SDL_SemPost(pSpriteSheetSemaphore);
-
-    return pSprite;
+    return GetSpriteSheetImageSlot()->GetImage();
 }
 
-Image * Sprite::GetSpriteSheetImageNoCache()
+SpriteSheetImageSlot * Sprite::GetSpriteSheetImageSlot()
 {
-    SpriteManager *pSpriteManager = NULL;
+    SpriteSheetImageSlot *pSlot = reinterpret_cast<SpriteSheetImageSlot *>(SDL_AtomicGetPtr(&pSpriteSheetImageSlot));
 
-    switch (managerSource)
+    // The sprite manager always hands back the same slot for a given sprite sheet,
+    // so it doesn't matter if more than one thread gets here at once.
+    if (pSlot == NULL)
     {
-        case ManagerSourceCaseFile:
-            pSpriteManager = Case::GetInstance()->GetSpriteManager();
-            break;
+        SpriteManager *pSpriteManager = NULL;
+
+        switch (managerSource)
+        {
+            case ManagerSourceCaseFile:
+                pSpriteManager = Case::GetInstance()->GetSpriteManager();
+                break;
+
+            case ManagerSourceCommonResources:
+                pSpriteManager = CommonCaseResources::GetInstance()->GetSpriteManager();
+                break;
+        }
 
-        case ManagerSourceCommonResources:
-            pSpriteManager = CommonCaseResources::GetInstance()->GetSpriteManager();
-            break;
+        pSlot = pSpriteManager->GetImageSlotFromId(spriteSheetImageId);
+        SDL_AtomicSetPtr(&pSpriteSheetImageSlot, pSlot);
     }
 
-    return pSpriteManager->GetImageFromId(spriteSheetImageId);
+    return pSlot;
 }
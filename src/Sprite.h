@@ -38,13 +38,33 @@
 #include "XmlReader.h"
 #include <vector>
 
+// Holds a sprite sheet's image, which may be swapped out or cleared as the sprite sheet is loaded and unloaded.
+// Slots live as long as the sprite manager that owns them, so sprites can hold onto their slot
+// and read the image from it on every draw without taking a lock.  An image that's been swapped out
+// isn't deleted until the frame has finished drawing, so anything read from a slot stays valid until then.
+class SpriteSheetImageSlot
+{
+public:
+    SpriteSheetImageSlot()
+    {
+        pImage = NULL;
+    }
+
+    Image * GetImage() { return reinterpret_cast<Image *>(SDL_AtomicGetPtr(&pImage)); }
+
+    // Returns the image that was in the slot before.
+    Image * SetImage(Image *pNewImage) { return reinterpret_cast<Image *>(SDL_AtomicSetPtr(&pImage, pNewImage)); }
+
+private:
+    void *pImage;
+};
+
 class Sprite
 {
 public:
     Sprite()
     {
-        pSpriteSheetImage = NULL;
-        pSpriteSheetSemaphore = NULL;
+        pSpriteSheetImageSlot = NULL;
         managerSource = ManagerSourceCommonResources;
     }
 
@@ -52,13 +72,11 @@ public:
     {
         this->spriteSheetImageId = spriteSheetImageId;
         this->spriteClipRect = spriteClipRect;
-        pSpriteSheetImage = NULL;
-        pSpriteSheetSemaphore = SDL_CreateSemaphore(1);
+        pSpriteSheetImageSlot = NULL;
         managerSource = ManagerSourceCommonResources;
     }
 
     Sprite(XmlReader *pReader);
-    ~Sprite();
 
     void SetManagerSource(ManagerSource managerSource) { this->managerSource = managerSource; }
 
@@ -73,20 +91,18 @@ public:
     void DrawClipped(Vector2 position, RectangleWH clipRect, bool flipHorizontally);
     void DrawClipped(Vector2 position, RectangleWH clipRect, bool flipHorizontally, Color color);
 
-    void UpdateReadiness(string newLocationId, bool *pLoadSprite, bool *pDeleteSprite);
+    bool IsNeededAtLocation(string locationId);
     bool IsReady();
 
 //private:
     Image * GetSpriteSheetImage();
-    Image * GetSpriteSheetImageNoCache();
+    SpriteSheetImageSlot * GetSpriteSheetImageSlot();
 
     string spriteSheetImageId;
-    Image *pSpriteSheetImage;
+    void *pSpriteSheetImageSlot;
     RectangleWH spriteClipRect;
 
     ManagerSource managerSource;
-
-    SDL_sem *pSpriteSheetSemaphore;
 };
 
 #endif
@@ -0,0 +1,434 @@
+/**
+ * Packs small images together into a few large textures.
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "TextureAtlas.h"
+#include "globals.h"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+vector<TextureAtlasPage *> TextureAtlas::pageList;
+SDL_sem *TextureAtlas::pPageListSemaphore = SDL_CreateSemaphore(1);
+
+TextureAtlasPage::TextureAtlasPage(SDL_Texture *pTexture, int width, int height)
+{
+    this->pTexture = pTexture;
+    this->width = width;
+    this->height = height;
+    this->imageCount = 0;
+
+    skyline.push_back(SkylineSegment(0, 0, width));
+}
+
+TextureAtlasPage::~TextureAtlasPage()
+{
+    SDL_DestroyTexture(pTexture);
+    pTexture = NULL;
+}
+
+bool TextureAtlasPage::TryAdd(SDL_Surface *pSurface, SDL_Rect *pRect)
+{
+    int paddedWidth = pSurface->w + 2 * TextureAtlasImagePadding;
+    int paddedHeight = pSurface->h + 2 * TextureAtlasImagePadding;
+    int x = 0;
+    int y = 0;
+    unsigned int segmentIndex = 0;
+    unsigned int freeRectIndex = 0;
+    bool usesFreeRect = TryFindFreeRect(paddedWidth, paddedHeight, &freeRectIndex);
+
+    if (usesFreeRect)
+    {
+        x = freeRectList[freeRectIndex].x;
+        y = freeRectList[freeRectIndex].y;
+    }
+    else if (!TryFindPosition(paddedWidth, paddedHeight, &x, &y, &segmentIndex))
+    {
+        return false;
+    }
+
+    // We'll need the pixels in the same format as the texture before we can copy them in.
+    SDL_Surface *pConvertedSurface = pSurface;
+
+    if (pSurface->format->format != SDL_PIXELFORMAT_ARGB8888)
+    {
+        pConvertedSurface = SDL_ConvertSurfaceFormat(pSurface, SDL_PIXELFORMAT_ARGB8888, 0);
+
+        if (pConvertedSurface == NULL)
+        {
+            return false;
+        }
+    }
+
+    // Each row of the image gets its first and last pixels repeated on either side of it,
+    // and the first and last rows are then repeated above and below it.
+    Uint32 *pPaddedPixels = (Uint32 *)malloc(paddedWidth * paddedHeight * sizeof(Uint32));
+
+    if (SDL_MUSTLOCK(pConvertedSurface))
+    {
+        SDL_LockSurface(pConvertedSurface);
+    }
+
+    for (int row = 0; row < paddedHeight; row++)
+    {
+        int sourceRow = row - TextureAtlasImagePadding;
+
+        if (sourceRow < 0)
+        {
+            sourceRow = 0;
+        }
+        else if (sourceRow >= pSurface->h)
+        {
+            sourceRow = pSurface->h - 1;
+        }
+
+        const Uint32 *pSourceRow = (const Uint32 *)((const Uint8 *)pConvertedSurface->pixels + sourceRow * pConvertedSurface->pitch);
+        Uint32 *pPaddedRow = pPaddedPixels + row * paddedWidth;
+
+        for (int column = 0; column < TextureAtlasImagePadding; column++)
+        {
+            pPaddedRow[column] = pSourceRow[0];
+            pPaddedRow[paddedWidth - 1 - column] = pSourceRow[pSurface->w - 1];
+        }
+
+        memcpy(pPaddedRow + TextureAtlasImagePadding, pSourceRow, pSurface->w * sizeof(Uint32));
+    }
+
+    if (SDL_MUSTLOCK(pConvertedSurface))
+    {
+        SDL_UnlockSurface(pConvertedSurface);
+    }
+
+    if (pConvertedSurface != pSurface)
+    {
+        SDL_FreeSurface(pConvertedSurface);
+    }
+
+    SDL_Rect rect = { x, y, paddedWidth, paddedHeight };
+    bool success = SDL_UpdateTexture(pTexture, &rect, pPaddedPixels, paddedWidth * sizeof(Uint32)) == 0;
+    free(pPaddedPixels);
+
+    if (!success)
+    {
+        return false;
+    }
+
+    if (usesFreeRect)
+    {
+        TakeFreeRect(freeRectIndex, paddedWidth, paddedHeight);
+    }
+    else
+    {
+        AddSkylineSegment(segmentIndex, x, y, paddedWidth, paddedHeight);
+    }
+
+    imageCount++;
+
+    pRect->x = x + TextureAtlasImagePadding;
+    pRect->y = y + TextureAtlasImagePadding;
+    pRect->w = pSurface->w;
+    pRect->h = pSurface->h;
+    return true;
+}
+
+void TextureAtlasPage::Remove(const SDL_Rect &rect)
+{
+    SDL_Rect paddedRect =
+        {
+            rect.x - TextureAtlasImagePadding,
+            rect.y - TextureAtlasImagePadding,
+            rect.w + 2 * TextureAtlasImagePadding,
+            rect.h + 2 * TextureAtlasImagePadding
+        };
+
+    AddFreeRect(paddedRect);
+    imageCount--;
+}
+
+bool TextureAtlasPage::TryFindPosition(int width, int height, int *pX, int *pY, unsigned int *pSegmentIndex)
+{
+    int bestY = height;
+    int bestX = width;
+    bool found = false;
+
+    // We'll put the image wherever its top would be highest up (i.e., lowest y),
+    // which keeps the skyline as flat as possible and wastes the least space beneath it.
+    for (unsigned int i = 0; i < skyline.size(); i++)
+    {
+        int x = skyline[i].x;
+
+        if (x + width > this->width)
+        {
+            break;
+        }
+
+        // The image rests on the highest of the segments it spans.
+        int y = 0;
+        int widthLeft = width;
+
+        for (unsigned int j = i; widthLeft > 0; j++)
+        {
+            if (skyline[j].y > y)
+            {
+                y = skyline[j].y;
+            }
+
+            widthLeft -= skyline[j].width;
+        }
+
+        if (y + height <= this->height && (!found || y < bestY))
+        {
+            bestX = x;
+            bestY = y;
+            *pSegmentIndex = i;
+            found = true;
+        }
+    }
+
+    *pX = bestX;
+    *pY = bestY;
+    return found;
+}
+
+void TextureAtlasPage::AddSkylineSegment(unsigned int segmentIndex, int x, int y, int width, int height)
+{
+    skyline.insert(skyline.begin() + segmentIndex, SkylineSegment(x, y + height, width));
+
+    // The segments the new one covers are now hidden beneath it, either in whole or in part.
+    unsigned int i = segmentIndex + 1;
+
+    while (i < skyline.size())
+    {
+        int overlap = x + width - skyline[i].x;
+
+        if (overlap <= 0)
+        {
+            break;
+        }
+
+        if (overlap < skyline[i].width)
+        {
+            skyline[i].x += overlap;
+            skyline[i].width -= overlap;
+            break;
+        }
+
+        skyline.erase(skyline.begin() + i);
+    }
+
+    // Neighboring segments at the same height are really just one segment.
+    for (i = 0; i + 1 < skyline.size();)
+    {
+        if (skyline[i].y == skyline[i + 1].y)
+        {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+bool TextureAtlasPage::TryFindFreeRect(int width, int height, unsigned int *pFreeRectIndex)
+{
+    int bestArea = 0;
+    bool found = false;
+
+    // We'll use the smallest free rect the image fits into, which leaves the bigger ones for bigger images.
+    for (unsigned int i = 0; i < freeRectList.size(); i++)
+    {
+        const SDL_Rect &freeRect = freeRectList[i];
+        int area = freeRect.w * freeRect.h;
+
+        if (freeRect.w >= width && freeRect.h >= height && (!found || area < bestArea))
+        {
+            bestArea = area;
+            *pFreeRectIndex = i;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+void TextureAtlasPage::TakeFreeRect(unsigned int freeRectIndex, int width, int height)
+{
+    SDL_Rect freeRect = freeRectList[freeRectIndex];
+    freeRectList.erase(freeRectList.begin() + freeRectIndex);
+
+    // The image goes in the top-left corner, and what's left over to its right and below it
+    // is split into two free rects, cutting along whichever side leaves the bigger of the two as big as possible.
+    int widthLeft = freeRect.w - width;
+    int heightLeft = freeRect.h - height;
+    SDL_Rect rightRect = { freeRect.x + width, freeRect.y, widthLeft, height };
+    SDL_Rect bottomRect = { freeRect.x, freeRect.y + height, freeRect.w, heightLeft };
+
+    if (widthLeft > heightLeft)
+    {
+        rightRect.h = freeRect.h;
+        bottomRect.w = width;
+    }
+
+    if (rightRect.w > 0 && rightRect.h > 0)
+    {
+        freeRectList.push_back(rightRect);
+    }
+
+    if (bottomRect.w > 0 && bottomRect.h > 0)
+    {
+        freeRectList.push_back(bottomRect);
+    }
+}
+
+void TextureAtlasPage::AddFreeRect(SDL_Rect freeRect)
+{
+    // Free rects that line up with each other along a whole side are merged back together,
+    // so that a region whose images have all gone away can take images as big as it is again.
+    bool merged = true;
+
+    while (merged)
+    {
+        merged = false;
+
+        for (unsigned int i = 0; i < freeRectList.size(); i++)
+        {
+            const SDL_Rect &otherRect = freeRectList[i];
+
+            if (otherRect.y == freeRect.y && otherRect.h == freeRect.h &&
+                (otherRect.x + otherRect.w == freeRect.x || freeRect.x + freeRect.w == otherRect.x))
+            {
+                freeRect.x = min(freeRect.x, otherRect.x);
+                freeRect.w += otherRect.w;
+                merged = true;
+            }
+            else if (otherRect.x == freeRect.x && otherRect.w == freeRect.w &&
+                (otherRect.y + otherRect.h == freeRect.y || freeRect.y + freeRect.h == otherRect.y))
+            {
+                freeRect.y = min(freeRect.y, otherRect.y);
+                freeRect.h += otherRect.h;
+                merged = true;
+            }
+
+            if (merged)
+            {
+                freeRectList.erase(freeRectList.begin() + i);
+                break;
+            }
+        }
+    }
+
+    freeRectList.push_back(freeRect);
+}
+
+bool TextureAtlas::TryAdd(SDL_Surface *pSurface, TextureAtlasPage **ppPage, SDL_Rect *pRect)
+{
+    if (pSurface->w > MaxTextureAtlasImageSize || pSurface->h > MaxTextureAtlasImageSize)
+    {
+        return false;
+    }
+
+    bool success = false;
+
+    SDL_SemWait(pPageListSemaphore);
+
+    for (unsigned int i = 0; i < pageList.size() && !success; i++)
+    {
+        if (pageList[i]->TryAdd(pSurface, pRect))
+        {
+            *ppPage = pageList[i];
+            success = true;
+        }
+    }
+
+    if (!success && pageList.size() < (unsigned int)MaxTextureAtlasPageCount)
+    {
+        SDL_RendererInfo rendererInfo;
+
+        // Some renderers can't create textures as big as our pages, in which case we won't use the atlas at all.
+        if (SDL_GetRendererInfo(gpRenderer, &rendererInfo) == 0 &&
+            (rendererInfo.max_texture_width == 0 || rendererInfo.max_texture_width >= TextureAtlasPageSize) &&
+            (rendererInfo.max_texture_height == 0 || rendererInfo.max_texture_height >= TextureAtlasPageSize))
+        {
+            SDL_Texture *pTexture =
+                SDL_CreateTexture(
+                    gpRenderer,
+                    SDL_PIXELFORMAT_ARGB8888,
+                    SDL_TEXTUREACCESS_STATIC,
+                    TextureAtlasPageSize,
+                    TextureAtlasPageSize);
+
+            if (pTexture != NULL)
+            {
+                SDL_SetTextureBlendMode(pTexture, SDL_BLENDMODE_BLEND);
+
+                TextureAtlasPage *pPage = new TextureAtlasPage(pTexture, TextureAtlasPageSize, TextureAtlasPageSize);
+
+                if (pPage->TryAdd(pSurface, pRect))
+                {
+                    pageList.push_back(pPage);
+                    *ppPage = pPage;
+                    success = true;
+                }
+                else
+                {
+                    delete pPage;
+                }
+            }
+        }
+    }
+
+    SDL_SemPost(pPageListSemaphore);
+
+    return success;
+}
+
+void TextureAtlas::Remove(TextureAtlasPage *pPage, const SDL_Rect &rect)
+{
+    SDL_SemWait(pPageListSemaphore);
+
+    pPage->Remove(rect);
+
+    if (pPage->GetImageCount() == 0)
+    {
+        for (unsigned int i = 0; i < pageList.size(); i++)
+        {
+            if (pageList[i] == pPage)
+            {
+                pageList.erase(pageList.begin() + i);
+                break;
+            }
+        }
+
+        delete pPage;
+    }
+
+    SDL_SemPost(pPageListSemaphore);
+}
@@ -0,0 +1,116 @@
+/**
+ * Basic header/include file for TextureAtlas.cpp.
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TEXTUREATLAS_H
+#define TEXTUREATLAS_H
+
+#include <SDL2/SDL.h>
+#include <vector>
+
+using namespace std;
+
+// The width and height of each atlas texture.
+const int TextureAtlasPageSize = 1024;
+
+// The most atlas textures we'll create at once.  Images that don't fit into these
+// just get textures of their own, so this bounds the video memory the atlas can use.
+const int MaxTextureAtlasPageCount = 8;
+
+// Images bigger than this in either dimension get textures of their own,
+// since packing them would fill up the atlas without saving many texture switches.
+const int MaxTextureAtlasImageSize = 256;
+
+// Images in the atlas have their outermost pixels repeated this many times around them,
+// so that filtering at their edges when they're scaled never picks up their neighbors.
+const int TextureAtlasImagePadding = 1;
+
+// A single atlas texture.  Images are packed into it using a skyline packer,
+// which keeps track of the height of the tallest image placed at each point along the texture's width.
+// The space an image used is handed back as a free rectangle when the image is removed,
+// and new images go into the free rectangles first, so that a page that stays around
+// because of a few long-lived images still has room for new ones.  The whole page is destroyed
+// once the last image in it is gone.
+class TextureAtlasPage
+{
+public:
+    TextureAtlasPage(SDL_Texture *pTexture, int width, int height);
+    ~TextureAtlasPage();
+
+    SDL_Texture * GetTexture() { return pTexture; }
+    int GetImageCount() { return imageCount; }
+
+    bool TryAdd(SDL_Surface *pSurface, SDL_Rect *pRect);
+    void Remove(const SDL_Rect &rect);
+
+private:
+    class SkylineSegment
+    {
+    public:
+        SkylineSegment(int x, int y, int width)
+        {
+            this->x = x;
+            this->y = y;
+            this->width = width;
+        }
+
+        int x;
+        int y;
+        int width;
+    };
+
+    bool TryFindPosition(int width, int height, int *pX, int *pY, unsigned int *pSegmentIndex);
+    void AddSkylineSegment(unsigned int segmentIndex, int x, int y, int width, int height);
+    bool TryFindFreeRect(int width, int height, unsigned int *pFreeRectIndex);
+    void TakeFreeRect(unsigned int freeRectIndex, int width, int height);
+    void AddFreeRect(SDL_Rect freeRect);
+
+    SDL_Texture *pTexture;
+    int width;
+    int height;
+    int imageCount;
+
+    vector<SkylineSegment> skyline;
+    vector<SDL_Rect> freeRectList;
+};
+
+// Packs small images together into a handful of large textures, so that drawing
+// a screen full of them doesn't mean switching textures for every one.
+class TextureAtlas
+{
+public:
+    // The rect that comes back is where the image is in the page, not counting its padding.
+    static bool TryAdd(SDL_Surface *pSurface, TextureAtlasPage **ppPage, SDL_Rect *pRect);
+    static void Remove(TextureAtlasPage *pPage, const SDL_Rect &rect);
+
+private:
+    static vector<TextureAtlasPage *> pageList;
+    static SDL_sem *pPageListSemaphore;
+};
+
+#endif
@@ -28,18 +28,108 @@
  */
 
 #include "Video.h"
+#include "VideoDecoder.h"
 #include "globals.h"
 #include "ResourceLoader.h"
 #include "CaseInformation/Case.h"
+#include <algorithm>
 #include <math.h>
 
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_BENCHMARK
+    #include <iostream>
+    #endif
+    #ifdef MLI_DEBUG_VIDEO_DECODE_BENCHMARK
+    #include <iostream>
+    #endif
+#endif
+
 const string CommonFilesId = "CommonFiles";
 
+// Looping videos at most this long are decoded once up front, if their frames fit in gMaxCachedVideoMegabytes.
+const unsigned int MaxCachedVideoFrameCount = 64;
+
+// Decoding on the main thread is only useful to measure what the decode thread saves us.
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_SYNCHRONOUS_DECODE
+const bool UseVideoDecodeThread = false;
+    #else
+const bool UseVideoDecodeThread = true;
+    #endif
+#else
+const bool UseVideoDecodeThread = true;
+#endif
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_BENCHMARK
+namespace
+{
+    int GetMicrosecondsSince(Uint64 startTime)
+    {
+        return (int)((SDL_GetPerformanceCounter() - startTime) * 1000000 / SDL_GetPerformanceFrequency());
+    }
+
+    void PrintTimeDistribution(const char *pLabel, vector<int> microsecondsList)
+    {
+        if (microsecondsList.empty())
+        {
+            return;
+        }
+
+        sort(microsecondsList.begin(), microsecondsList.end());
+
+        cout << "    " << pLabel << ": " << microsecondsList.size() << " frames, "
+             << microsecondsList.front() / 1000.0 << " ms min, "
+             << microsecondsList[microsecondsList.size() / 2] / 1000.0 << " ms median, "
+             << microsecondsList[microsecondsList.size() * 95 / 100] / 1000.0 << " ms 95th percentile, "
+             << microsecondsList.back() / 1000.0 << " ms max" << endl;
+    }
+}
+    #endif
+#endif
+
 bool IsYUVFormat(AVPixelFormat pixelFormat)
 {
     return pixelFormat == AV_PIX_FMT_YUVJ420P || pixelFormat == AV_PIX_FMT_YUV420P || pixelFormat == AV_PIX_FMT_YUV444P;
 }
 
+// Once we've run out of packets, the decoder can still be holding onto frames -
+// with frame threading, as many as it has threads - so we'll keep handing it empty packets
+// to get those out of it, until it has nothing left to give us.
+bool DecodeNextVideoFrame(AVFormatContext *pFormatContext, int videoStream, AVCodecContext *pCodecContext, AVFrame *pFrame)
+{
+    int frameFinished = 0;
+    AVPacket packet;
+
+    while (!frameFinished)
+    {
+        av_frame_unref(pFrame);
+
+        if (av_read_frame(pFormatContext, &packet) == 0)
+        {
+            if (packet.stream_index == videoStream)
+            {
+                avcodec_decode_video2(pCodecContext, pFrame, &frameFinished, &packet);
+            }
+
+            av_free_packet(&packet);
+        }
+        else
+        {
+            av_init_packet(&packet);
+            packet.data = NULL;
+            packet.size = 0;
+
+            if (avcodec_decode_video2(pCodecContext, pFrame, &frameFinished, &packet) < 0 || !frameFinished)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
 Video::Video(bool shouldLoop)
 {
     pCurFrame = NULL;
@@ -52,11 +142,29 @@ Video::Video(bool shouldLoop)
     videoStream = -1;
     pCodecContext = NULL;
     pCodec = NULL;
+    codecThreadCount = 0;
     pFrame = NULL;
     pMemToFree = NULL;
     pImageConvertContext = NULL;
-    pCachedTexturePixels = NULL;
+    usesYUVTextures = false;
+    uploadsDecodedFrames = false;
+    pDisplayedFrame = NULL;
     pTexture = NULL;
+    usesCachedFrames = false;
+    isPrefetchRequested = false;
+    isPrefetched = false;
+
+    nextFrameIndexToDecode = 0;
+    shouldSeekToStart = false;
+    decodeGeneration = 0;
+    pDecodingFrame = NULL;
+    decodingFrameNeedsSeek = false;
+    decodingFrameGeneration = 0;
+    isDecodingFrame = false;
+    isQueuedForPrefetch = false;
+    isRunningPrefetch = false;
+    isWaitingForDecoder = false;
+    pFrameDecodedSemaphore = SDL_CreateSemaphore(0);
 
     this->texturesRecreatedCount = gTexturesRecreatedCount;
 }
@@ -72,16 +180,35 @@ Video::Video(XmlReader *pReader)
     videoStream = -1;
     pCodecContext = NULL;
     pCodec = NULL;
+    codecThreadCount = 0;
     pFrame = NULL;
     pMemToFree = NULL;
     pImageConvertContext = NULL;
-    pCachedTexturePixels = NULL;
+    usesYUVTextures = false;
+    uploadsDecodedFrames = false;
+    pDisplayedFrame = NULL;
     pTexture = NULL;
+    usesCachedFrames = false;
+    isPrefetchRequested = false;
+    isPrefetched = false;
+
+    nextFrameIndexToDecode = 0;
+    shouldSeekToStart = false;
+    decodeGeneration = 0;
+    pDecodingFrame = NULL;
+    decodingFrameNeedsSeek = false;
+    decodingFrameGeneration = 0;
+    isDecodingFrame = false;
+    isQueuedForPrefetch = false;
+    isRunningPrefetch = false;
+    isWaitingForDecoder = false;
+    pFrameDecodedSemaphore = SDL_CreateSemaphore(0);
 
     pReader->StartElement("Video");
     id = pReader->ReadTextElement("Id");
     shouldLoop = pReader->ReadBooleanElement("ShouldLoop");
     videoRelativeFilePath = pReader->ReadTextElement("VideoRelativeFilePath");
+    ResourceLoader::GetInstance()->ResolveAsset(videoRelativeFilePath, &videoAssetHandle);
     width = pReader->ReadIntElement("Width");
     height = pReader->ReadIntElement("Height");
 
@@ -99,6 +226,9 @@ Video::~Video()
 {
     UnloadFile();
 
+    SDL_DestroySemaphore(pFrameDecodedSemaphore);
+    pFrameDecodedSemaphore = NULL;
+
     for (unsigned int i = 0; i < frameList.size(); i++)
     {
         delete frameList[i];
@@ -110,6 +240,7 @@ Video::~Video()
 void Video::SetVideoAttributes(string videoRelativeFilePath, unsigned int frameCount, int msFrameDuration, unsigned int width, unsigned int height)
 {
     this->videoRelativeFilePath = videoRelativeFilePath;
+    ResourceLoader::GetInstance()->ResolveAsset(videoRelativeFilePath, &videoAssetHandle);
     this->width = width;
     this->height = height;
 
@@ -148,6 +279,13 @@ void Video::Update(int delta)
     {
         MoveToNextFrame();
     }
+
+    if (isReady && !IsFinished())
+    {
+        // If the decode thread hasn't gotten to this frame yet, we'll keep showing the last one
+        // rather than hold up the game.
+        ShowFrame(curFrameIndex, !UseVideoDecodeThread /* waitUntilDecoded */);
+    }
 }
 
 void Video::Draw(Vector2 position)
@@ -182,18 +320,22 @@ void Video::Draw(Vector2 position, bool flipHorizontally, Color color, Rectangle
 
 void Video::Reset()
 {
-    bool shouldRewriteFrame = curFrameIndex > 0 || texturesRecreatedCount != gTexturesRecreatedCount;
-
     curFrameIndex = 0;
     pCurFrame = frameList[0];
 
-    if (pFormatContext != NULL)
+    if (isReady)
     {
-        av_seek_frame(pFormatContext, videoStream, 0, AVSEEK_FLAG_ANY);
+        RecreateTextureIfNeeded();
 
-        if (shouldRewriteFrame)
+        if (usesCachedFrames)
+        {
+            ShowFrame(0, true /* waitUntilDecoded */);
+        }
+        else if (pDisplayedFrame->frameIndex != 0)
         {
-            WriteNextFrame();
+            // We're starting over, so whatever we've decoded ahead is no longer what comes next.
+            RestartDecoding();
+            ShowFrame(0, true /* waitUntilDecoded */);
         }
     }
 
@@ -215,50 +357,47 @@ void Video::Finish()
             break;
         }
     }
+
+    if (isReady && !IsFinished())
+    {
+        ShowFrame(curFrameIndex, true /* waitUntilDecoded */);
+    }
 }
 
 void Video::LoadFile()
 {
     if (!isReady)
     {
-        ResourceLoader::GetInstance()->LoadVideo(
-            videoRelativeFilePath,
-            &pRWOpsIOContext,
-            &pFormatContext,
-            &videoStream,
-            &pCodecContext,
-            &pCodec,
-            &pMemToFree);
-
-        pFrame = av_frame_alloc();
+        // If the video decoder hasn't gotten around to opening the video yet, we'll just do it ourselves.
+        StopPrefetching();
+        PrefetchFile();
+        isPrefetched = false;
 
-        pImageConvertContext =
-            sws_getContext(
-                width,
-                height,
-                pCodecContext->pix_fmt == AV_PIX_FMT_BGRA ? AV_PIX_FMT_ARGB : pCodecContext->pix_fmt,
-                width,
-                height,
-                IsYUVFormat(pCodecContext->pix_fmt) ? AV_PIX_FMT_YUV420P : AV_PIX_FMT_ARGB,
-                SWS_BICUBIC,
-                NULL,
-                NULL,
-                NULL);
+        texturesRecreatedCount = gTexturesRecreatedCount;
 
-        pTexture =
-            SDL_CreateTexture(
-                gpRenderer,
-                IsYUVFormat(pCodecContext->pix_fmt) ? SDL_PIXELFORMAT_YV12 : SDL_PIXELFORMAT_ARGB8888,
-                SDL_TEXTUREACCESS_STREAMING,
-                width,
-                height);
-        SDL_SetTextureBlendMode(pTexture, SDL_BLENDMODE_BLEND);
+        if (usesCachedFrames)
+        {
+            // The rest of the frames are uploaded as they come up, so that we're never
+            // creating more than one texture for this video in a single frame.
+            cachedFrameTextureList.resize(cachedDecodedFrameList.size(), NULL);
+            pTexture = GetCachedFrameTexture(0);
+            isReady = true;
+        }
+        else
+        {
+            pTexture = CreateFrameTexture(SDL_TEXTUREACCESS_STREAMING);
+            UploadDisplayedFrame();
 
-        pCachedTexturePixels = new unsigned char[width * height * 4];
+            nextFrameIndexToDecode = 1;
+            shouldSeekToStart = false;
 
-        WriteNextFrame();
+            isReady = true;
 
-        isReady = true;
+            if (UseVideoDecodeThread)
+            {
+                VideoDecoder::GetInstance()->AddVideo(this);
+            }
+        }
     }
 }
 
@@ -268,22 +407,171 @@ void Video::UnloadFile()
     {
         isReady = false;
 
-        delete pCachedTexturePixels;
-        pCachedTexturePixels = NULL;
-        SDL_DestroyTexture(pTexture);
-        pTexture = NULL;
-        sws_freeContext(pImageConvertContext);
-        pImageConvertContext = NULL;
-        av_freep(&pFrame);
-        avcodec_close(pCodecContext);
-        pCodecContext = NULL;
+        if (!usesCachedFrames && UseVideoDecodeThread)
+        {
+            VideoDecoder::GetInstance()->RemoveVideo(this);
+        }
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_BENCHMARK
+        cout << "Video \"" << videoRelativeFilePath << "\" (" << (usesCachedFrames ? "cached frames" : UseVideoDecodeThread ? "decode thread" : "main thread decode") << "):" << endl;
+        PrintTimeDistribution("Decode time", decodeMicrosecondsList);
+        PrintTimeDistribution("Main thread time", showFrameMicrosecondsList);
+        PrintTimeDistribution("Conversion time", convertMicrosecondsList);
+        PrintTimeDistribution("Upload time", uploadMicrosecondsList);
+
+        cout << "    " << (uploadsDecodedFrames ? "Direct YUV upload" : "Converted upload") << ": "
+             << (convertMicrosecondsList.empty() ? 0 : convertedByteCount / convertMicrosecondsList.size()) << " bytes converted per frame, "
+             << (uploadMicrosecondsList.empty() ? 0 : uploadedByteCount / uploadMicrosecondsList.size()) << " bytes uploaded per frame" << endl;
+
+        decodeMicrosecondsList.clear();
+        showFrameMicrosecondsList.clear();
+        convertMicrosecondsList.clear();
+        uploadMicrosecondsList.clear();
+    #endif
+#endif
+
+        if (usesCachedFrames)
+        {
+            // The texture we're showing is one of the cached ones.
+            DestroyCachedFrames();
+            pTexture = NULL;
+            usesCachedFrames = false;
+        }
+        else
+        {
+            for (unsigned int i = 0; i < decodedFrameQueue.size(); i++)
+            {
+                delete decodedFrameQueue[i];
+            }
+
+            decodedFrameQueue.clear();
+
+            for (unsigned int i = 0; i < freeDecodedFrameList.size(); i++)
+            {
+                delete freeDecodedFrameList[i];
+            }
+
+            freeDecodedFrameList.clear();
+
+            SDL_DestroyTexture(pTexture);
+            pTexture = NULL;
+            CloseDecoder();
+        }
+    }
+    else
+    {
+        // We might have opened the video ahead of time and then never gotten around to loading it.
+        CancelPrefetch();
+    }
+}
+
+void Video::Prefetch()
+{
+    if (isReady || isPrefetchRequested || !UseVideoDecodeThread)
+    {
+        return;
+    }
+
+    isPrefetchRequested = true;
+    VideoDecoder::GetInstance()->AddPrefetchVideo(this);
+}
+
+bool Video::IsPrefetchPending()
+{
+    if (!isPrefetchRequested)
+    {
+        return false;
+    }
+
+    VideoDecoder *pDecoder = VideoDecoder::GetInstance();
+    bool isPrefetchPending = false;
+
+    pDecoder->Lock();
+    isPrefetchPending = isQueuedForPrefetch || isRunningPrefetch;
+    pDecoder->Unlock();
+
+    return isPrefetchPending;
+}
+
+void Video::CancelPrefetch()
+{
+    if (isReady)
+    {
+        return;
+    }
+
+    StopPrefetching();
+    ReleasePrefetchedFile();
+}
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_DECODE_BENCHMARK
+void Video::RunDecodeBenchmark(const string &videoRelativeFilePath)
+{
+    // We'll go up in powers of two, finishing with one thread per core.
+    vector<int> threadCountList;
+    int maxThreadCount = SDL_GetCPUCount();
+
+    for (int threadCount = 1; threadCount < maxThreadCount; threadCount *= 2)
+    {
+        threadCountList.push_back(threadCount);
+    }
+
+    threadCountList.push_back(maxThreadCount);
+
+    cout << "Decode benchmark for \"" << videoRelativeFilePath << "\":" << endl;
+
+    for (unsigned int i = 0; i < threadCountList.size(); i++)
+    {
+        int threadCount = threadCountList[i];
+        RWOpsIOContext *pRWOpsIOContext = NULL;
+        AVFormatContext *pFormatContext = NULL;
+        int videoStream = -1;
+        AVCodecContext *pCodecContext = NULL;
+        AVCodec *pCodec = NULL;
+        void *pMemToFree = NULL;
+
+        ResourceLoader::GetInstance()->LoadVideo(
+            videoRelativeFilePath,
+            threadCount,
+            &pRWOpsIOContext,
+            &pFormatContext,
+            &videoStream,
+            &pCodecContext,
+            &pCodec,
+            &pMemToFree);
+
+        if (pCodecContext == NULL)
+        {
+            cout << "    Couldn't load the video." << endl;
+            return;
+        }
+
+        AVFrame *pFrame = av_frame_alloc();
+        unsigned int frameCount = 0;
+        Uint64 startTime = SDL_GetPerformanceCounter();
+
+        while (DecodeNextVideoFrame(pFormatContext, videoStream, pCodecContext, pFrame))
+        {
+            frameCount++;
+        }
+
+        double elapsedMs = (double)(SDL_GetPerformanceCounter() - startTime) * 1000.0 / SDL_GetPerformanceFrequency();
+
+        cout << "    " << threadCount << (threadCount == 1 ? " thread: " : " threads: ")
+             << frameCount << " frames in " << elapsedMs << " ms ("
+             << (elapsedMs > 0 ? frameCount * 1000.0 / elapsedMs : 0) << " frames per second)" << endl;
+
+        av_frame_free(&pFrame);
+        avcodec_free_context(&pCodecContext);
         avformat_close_input(&pFormatContext);
         delete pRWOpsIOContext;
-        pRWOpsIOContext = NULL;
         free(pMemToFree);
-        pMemToFree = NULL;
     }
 }
+    #endif
+#endif
 
 bool Video::IsReady()
 {
@@ -430,125 +718,648 @@ void Video::MoveToNextFrame()
     if (IsFinished() && shouldLoop)
     {
         curFrameIndex = 0;
-        av_seek_frame(pFormatContext, videoStream, 0, AVSEEK_FLAG_ANY);
     }
 
     if (!IsFinished())
     {
         pCurFrame = frameList[curFrameIndex];
         pCurFrame->Begin(overflowDuration);
-
-        WriteNextFrame();
     }
 }
 
-void Video::WriteNextFrame()
+void Video::ShowFrame(unsigned int frameIndex, bool waitUntilDecoded)
 {
-    int frameFinished = 0;
-    AVPacket packet;
+    RecreateTextureIfNeeded();
 
-    if (texturesRecreatedCount != gTexturesRecreatedCount)
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_BENCHMARK
+    Uint64 startTime = SDL_GetPerformanceCounter();
+    #endif
+#endif
+
+    if (usesCachedFrames)
     {
-        texturesRecreatedCount = gTexturesRecreatedCount;
+        // Every frame is already in a texture, so all we need to do is draw a different one.
+        SDL_Texture *pFrameTexture = GetCachedFrameTexture(frameIndex);
 
-        SDL_DestroyTexture(pTexture);
-        pTexture =
-            SDL_CreateTexture(
-                gpRenderer,
-                IsYUVFormat(pCodecContext->pix_fmt) ? SDL_PIXELFORMAT_YV12 : SDL_PIXELFORMAT_ARGB8888,
-                SDL_TEXTUREACCESS_STREAMING,
-                width,
-                height);
-        SDL_SetTextureBlendMode(pTexture, SDL_BLENDMODE_BLEND);
+        if (pFrameTexture != pTexture)
+        {
+            pTexture = pFrameTexture;
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_BENCHMARK
+            showFrameMicrosecondsList.push_back(GetMicrosecondsSince(startTime));
+    #endif
+#endif
+        }
 
-        unsigned char *pPixels = NULL;
-        int pitch = 0;
+        return;
+    }
 
-        SDL_LockTexture(pTexture, NULL, reinterpret_cast<void **>(&pPixels), &pitch);
-        memcpy(pPixels, pCachedTexturePixels, pitch * height);
-        SDL_UnlockTexture(pTexture);
+    if (pDisplayedFrame->frameIndex == frameIndex)
+    {
+        return;
     }
 
-    while (!frameFinished)
+    VideoDecoder *pDecoder = VideoDecoder::GetInstance();
+    DecodedFrame *pFrameToShow = NULL;
+
+    pDecoder->Lock();
+
+    while (true)
     {
-        if (av_read_frame(pFormatContext, &packet) != 0)
+        // Anything before the frame we want has been skipped over.
+        while (!decodedFrameQueue.empty() && decodedFrameQueue.front()->frameIndex != frameIndex)
+        {
+            freeDecodedFrameList.push_back(decodedFrameQueue.front());
+            decodedFrameQueue.pop_front();
+        }
+
+        if (!decodedFrameQueue.empty())
+        {
+            pFrameToShow = decodedFrameQueue.front();
+            decodedFrameQueue.pop_front();
+            break;
+        }
+
+        if (!waitUntilDecoded || !(isDecodingFrame || CanDecodeFrame()))
         {
             break;
         }
 
-        if (packet.stream_index == videoStream && avcodec_decode_video2(pCodecContext, pFrame, &frameFinished, &packet) >= 0)
+        if (UseVideoDecodeThread)
+        {
+            isWaitingForDecoder = true;
+            pDecoder->Unlock();
+
+            pDecoder->WakeUp();
+            SDL_SemWait(pFrameDecodedSemaphore);
+
+            pDecoder->Lock();
+        }
+        else
+        {
+            StartDecodingFrame();
+            pDecoder->Unlock();
+
+            DecodeFrame();
+
+            pDecoder->Lock();
+            FinishDecodingFrame();
+        }
+    }
+
+    bool shouldUpload = false;
+
+    if (pFrameToShow != NULL)
+    {
+        if (pFrameToShow->hasPixels)
+        {
+            freeDecodedFrameList.push_back(pDisplayedFrame);
+            pDisplayedFrame = pFrameToShow;
+            shouldUpload = true;
+        }
+        else
+        {
+            pDisplayedFrame->frameIndex = frameIndex;
+            freeDecodedFrameList.push_back(pFrameToShow);
+        }
+    }
+
+    pDecoder->Unlock();
+
+    if (shouldUpload)
+    {
+        UploadDisplayedFrame();
+    }
+
+    if (pFrameToShow != NULL && UseVideoDecodeThread)
+    {
+        // We've made room for another frame.
+        pDecoder->WakeUp();
+    }
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_BENCHMARK
+    if (pFrameToShow != NULL)
+    {
+        showFrameMicrosecondsList.push_back(GetMicrosecondsSince(startTime));
+    }
+    #endif
+#endif
+}
+
+void Video::RestartDecoding()
+{
+    VideoDecoder *pDecoder = VideoDecoder::GetInstance();
+
+    pDecoder->Lock();
+
+    // Any frame that's being decoded right now will be thrown away when it's done.
+    decodeGeneration++;
+    shouldSeekToStart = true;
+
+    while (!decodedFrameQueue.empty())
+    {
+        freeDecodedFrameList.push_back(decodedFrameQueue.front());
+        decodedFrameQueue.pop_front();
+    }
+
+    pDecoder->Unlock();
+
+    if (UseVideoDecodeThread)
+    {
+        pDecoder->WakeUp();
+    }
+}
+
+void Video::RecreateTextureIfNeeded()
+{
+    if (texturesRecreatedCount == gTexturesRecreatedCount)
+    {
+        return;
+    }
+
+    texturesRecreatedCount = gTexturesRecreatedCount;
+
+    if (usesCachedFrames)
+    {
+        // The textures were all we kept of the frames we've shown, so we'll need to decode the frames all over again.
+        // This only happens when the renderer is reset, which holds up the game anyway.
+        DestroyCachedFrames();
+        PrefetchFile();
+        isPrefetched = false;
+
+        cachedFrameTextureList.resize(cachedDecodedFrameList.size(), NULL);
+        pTexture = GetCachedFrameTexture(curFrameIndex);
+    }
+    else
+    {
+        SDL_DestroyTexture(pTexture);
+        pTexture = CreateFrameTexture(SDL_TEXTUREACCESS_STREAMING);
+
+        UploadDisplayedFrame();
+    }
+}
+
+void Video::UploadDisplayedFrame()
+{
+    UploadFrame(pDisplayedFrame, pTexture);
+}
+
+void Video::UploadFrame(DecodedFrame *pDecodedFrame, SDL_Texture *pTargetTexture)
+{
+    if (!pDecodedFrame->hasPixels)
+    {
+        return;
+    }
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_BENCHMARK
+    Uint64 startTime = SDL_GetPerformanceCounter();
+    #endif
+#endif
+
+    if (uploadsDecodedFrames)
+    {
+        AVFrame *pAVFrame = pDecodedFrame->pAVFrame;
+
+        SDL_UpdateYUVTexture(
+            pTargetTexture,
+            NULL,
+            pAVFrame->data[0],
+            pAVFrame->linesize[0],
+            pAVFrame->data[1],
+            pAVFrame->linesize[1],
+            pAVFrame->data[2],
+            pAVFrame->linesize[2]);
+    }
+    else
+    {
+        SDL_UpdateTexture(pTargetTexture, NULL, pDecodedFrame->pPixels, GetTexturePitch());
+    }
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_BENCHMARK
+    uploadMicrosecondsList.push_back(GetMicrosecondsSince(startTime));
+    uploadedByteCount += GetTextureFrameSize();
+    #endif
+#endif
+}
+
+SDL_Texture * Video::CreateFrameTexture(int access)
+{
+    SDL_Texture *pFrameTexture =
+        SDL_CreateTexture(
+            gpRenderer,
+            GetTexturePixelFormat(),
+            access,
+            width,
+            height);
+    SDL_SetTextureBlendMode(pFrameTexture, SDL_BLENDMODE_BLEND);
+
+    return pFrameTexture;
+}
+
+void Video::OpenDecoder()
+{
+    codecThreadCount = VideoDecoder::GetInstance()->ReserveCodecThreads();
+
+    ResourceLoader::GetInstance()->LoadVideo(
+        videoRelativeFilePath,
+        codecThreadCount,
+        &pRWOpsIOContext,
+        &pFormatContext,
+        &videoStream,
+        &pCodecContext,
+        &pCodec,
+        &pMemToFree,
+        &videoAssetHandle);
+
+    pFrame = av_frame_alloc();
+
+    usesYUVTextures = IsYUVFormat(pCodecContext->pix_fmt);
+    uploadsDecodedFrames =
+        pCodecContext->pix_fmt == AV_PIX_FMT_YUV420P &&
+        (unsigned int)pCodecContext->width == width &&
+        (unsigned int)pCodecContext->height == height;
+
+    if (!uploadsDecodedFrames)
+    {
+        pImageConvertContext =
+            sws_getContext(
+                width,
+                height,
+                pCodecContext->pix_fmt == AV_PIX_FMT_BGRA ? AV_PIX_FMT_ARGB : pCodecContext->pix_fmt,
+                width,
+                height,
+                IsYUVFormat(pCodecContext->pix_fmt) ? AV_PIX_FMT_YUV420P : AV_PIX_FMT_ARGB,
+                SWS_BICUBIC,
+                NULL,
+                NULL,
+                NULL);
+    }
+
+    pDisplayedFrame = new DecodedFrame(GetDecodedFrameSize());
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_BENCHMARK
+    convertedByteCount = 0;
+    uploadedByteCount = 0;
+    #endif
+#endif
+}
+
+bool Video::RunPrefetchStep()
+{
+    if (isPrefetched)
+    {
+        return true;
+    }
+
+    if (pCodecContext == NULL)
+    {
+        OpenDecoder();
+        usesCachedFrames = ShouldCacheFrames();
+
+        if (!usesCachedFrames)
         {
-            if (frameFinished)
+            for (unsigned int i = 0; i < VideoDecodeAheadFrameCount; i++)
             {
-                AVPicture picture;
-                unsigned char *pPixels = NULL;
-                int pitch = 0;
-
-                SDL_LockTexture(pTexture, NULL, reinterpret_cast<void **>(&pPixels), &pitch);
-
-                if (IsYUVFormat(pCodecContext->pix_fmt))
-                {
-                    picture.data[0] = pFrame->data[0];
-                    picture.data[1] = pFrame->data[1];
-                    picture.data[2] = pFrame->data[2];
-                    picture.linesize[0] = pFrame->linesize[0];
-                    picture.linesize[1] = pFrame->linesize[1];
-                    picture.linesize[2] = pFrame->linesize[2];
-                }
-                else
-                {
-                    picture.data[0] = pPixels;
-                    picture.linesize[0] = pitch;
-                }
-
-                sws_scale(pImageConvertContext, pFrame->data, pFrame->linesize, 0, pFrame->height, picture.data, picture.linesize);
-
-                if (IsYUVFormat(pCodecContext->pix_fmt))
-                {
-                    if (pitch == picture.linesize[0])
-                    {
-                        int size = pitch * pFrame->height;
-
-                        memcpy(pPixels, picture.data[0], size);
-                        memcpy(pPixels + size, picture.data[2], size / 4);
-                        memcpy(pPixels + size * 5 / 4, picture.data[1], size / 4);
-                    }
-                    else
-                    {
-                        unsigned char *y1, *y2, *y3, *i1, *i2, *i3;
-                        y1 = pPixels;
-                        y3 = pPixels + pitch * pFrame->height;
-                        y2 = pPixels + pitch * pFrame->height * 5 / 4;
-
-                        i1 = picture.data[0];
-                        i2 = picture.data[1];
-                        i3 = picture.data[2];
-
-                        for (int i = 0; i < pFrame->height / 2; i++)
-                        {
-                            memcpy(y1, i1, pitch);
-                            i1 += picture.linesize[0];
-                            y1 += pitch;
-                            memcpy(y1, i1, pitch);
-
-                            memcpy(y2, i2, pitch / 2);
-                            memcpy(y3, i3, pitch / 2);
-
-                            y1 += pitch;
-                            y2 += pitch / 2;
-                            y3 += pitch / 2;
-                            i1 += picture.linesize[0];
-                            i2 += picture.linesize[1];
-                            i3 += picture.linesize[2];
-                        }
-                    }
-                }
-
-                memcpy(pCachedTexturePixels, pPixels, pitch * height);
-                SDL_UnlockTexture(pTexture);
+                freeDecodedFrameList.push_back(new DecodedFrame(GetDecodedFrameSize()));
             }
+
+            // We'll decode the first frame right away, so we have something to show as soon as we're loaded.
+            // The video decoder doesn't decode frames for this video until it's loaded, so there's no need to lock anything.
+            pDisplayedFrame->frameIndex = 0;
+            pDisplayedFrame->hasPixels = DecodeFrameInto(pDisplayedFrame);
+            isPrefetched = true;
         }
 
-        av_free_packet(&packet);
+        return isPrefetched;
+    }
+
+    // Cached videos decode one frame per step, so that the videos that are playing
+    // never wait on more than one frame of ours to get their next frame decoded.
+    if (!DecodeNextFrameToCache())
+    {
+        // Everything we need is in the decoded frames now, so there's no reason to hold onto the decoder.
+        CloseDecoder();
+        isPrefetched = true;
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_BENCHMARK
+        cout << "Cached " << cachedDecodedFrameList.size() << " frames of video \"" << videoRelativeFilePath << "\": "
+             << cachedDecodedFrameList.size() * GetTextureFrameSize() / 1024 << " KB of textures" << endl;
+    #endif
+#endif
+    }
+
+    return isPrefetched;
+}
+
+void Video::PrefetchFile()
+{
+    bool isFinished = false;
+
+    while (!isFinished)
+    {
+        isFinished = RunPrefetchStep();
+    }
+}
+
+void Video::StopPrefetching()
+{
+    // Once this returns, nobody but us is going to touch what the video decoder opened.
+    if (isPrefetchRequested)
+    {
+        VideoDecoder::GetInstance()->RemovePrefetchVideo(this);
+        isPrefetchRequested = false;
+    }
+}
+
+void Video::ReleasePrefetchedFile()
+{
+    for (unsigned int i = 0; i < freeDecodedFrameList.size(); i++)
+    {
+        delete freeDecodedFrameList[i];
+    }
+
+    freeDecodedFrameList.clear();
+
+    DestroyCachedFrames();
+    CloseDecoder();
+    usesCachedFrames = false;
+    isPrefetched = false;
+}
+
+void Video::CloseDecoder()
+{
+    delete pDisplayedFrame;
+    pDisplayedFrame = NULL;
+    sws_freeContext(pImageConvertContext);
+    pImageConvertContext = NULL;
+    av_freep(&pFrame);
+    avcodec_free_context(&pCodecContext);
+
+    if (codecThreadCount > 0)
+    {
+        VideoDecoder::GetInstance()->ReleaseCodecThreads(codecThreadCount);
+        codecThreadCount = 0;
+    }
+
+    avformat_close_input(&pFormatContext);
+    delete pRWOpsIOContext;
+    pRWOpsIOContext = NULL;
+    free(pMemToFree);
+    pMemToFree = NULL;
+}
+
+bool Video::ShouldCacheFrames()
+{
+    // Videos that don't loop only decode each frame once anyway, so there's nothing to save there.
+    return
+        shouldLoop &&
+        frameList.size() <= MaxCachedVideoFrameCount &&
+        (Uint64)GetTextureFrameSize() * frameList.size() <= (Uint64)gMaxCachedVideoMegabytes * 1024 * 1024;
+}
+
+bool Video::DecodeNextFrameToCache()
+{
+    if (cachedDecodedFrameList.size() >= frameList.size())
+    {
+        return false;
+    }
+
+    DecodedFrame *pDecodedFrame = new DecodedFrame(GetDecodedFrameSize());
+    pDecodedFrame->frameIndex = cachedDecodedFrameList.size();
+    pDecodedFrame->hasPixels = DecodeFrameInto(pDecodedFrame);
+
+    if (!pDecodedFrame->hasPixels)
+    {
+        delete pDecodedFrame;
+        return false;
+    }
+
+    cachedDecodedFrameList.push_back(pDecodedFrame);
+    return true;
+}
+
+void Video::DestroyCachedFrames()
+{
+    for (unsigned int i = 0; i < cachedFrameTextureList.size(); i++)
+    {
+        if (cachedFrameTextureList[i] != NULL)
+        {
+            SDL_DestroyTexture(cachedFrameTextureList[i]);
+        }
+    }
+
+    cachedFrameTextureList.clear();
+
+    for (unsigned int i = 0; i < cachedDecodedFrameList.size(); i++)
+    {
+        delete cachedDecodedFrameList[i];
+    }
+
+    cachedDecodedFrameList.clear();
+}
+
+SDL_Texture * Video::GetCachedFrameTexture(unsigned int frameIndex)
+{
+    if (cachedFrameTextureList.empty())
+    {
+        return NULL;
+    }
+
+    // If we ran out of video before we ran out of frames, we'll keep showing the last frame we got,
+    // same as if we were decoding as we go.
+    unsigned int cachedFrameIndex = min(frameIndex, (unsigned int)cachedFrameTextureList.size() - 1);
+
+    if (cachedFrameTextureList[cachedFrameIndex] == NULL)
+    {
+        // This is the first time we've shown this frame, so we'll upload it now and let go of its pixels.
+        cachedFrameTextureList[cachedFrameIndex] = CreateFrameTexture(SDL_TEXTUREACCESS_STATIC);
+        UploadFrame(cachedDecodedFrameList[cachedFrameIndex], cachedFrameTextureList[cachedFrameIndex]);
+
+        delete cachedDecodedFrameList[cachedFrameIndex];
+        cachedDecodedFrameList[cachedFrameIndex] = NULL;
+    }
+
+    return cachedFrameTextureList[cachedFrameIndex];
+}
+
+Uint32 Video::GetTexturePixelFormat()
+{
+    return usesYUVTextures ? SDL_PIXELFORMAT_YV12 : SDL_PIXELFORMAT_ARGB8888;
+}
+
+int Video::GetTexturePitch()
+{
+    return usesYUVTextures ? width : width * 4;
+}
+
+unsigned int Video::GetTextureFrameSize()
+{
+    // YV12 has a full-size Y plane, followed by quarter-size V and U planes.
+    return usesYUVTextures ? width * height * 3 / 2 : width * height * 4;
+}
+
+unsigned int Video::GetDecodedFrameSize()
+{
+    // If we can upload the decoder's frame as-is, we'll hold onto that instead.
+    return uploadsDecodedFrames ? 0 : GetTextureFrameSize();
+}
+
+bool Video::DecodeFrameInto(DecodedFrame *pDecodedFrame)
+{
+    // If we can upload the decoder's frame as-is, we'll decode straight into the decoded frame
+    // and keep the reference that the decoder hands us.  Otherwise we'll convert into its pixels.
+    if (uploadsDecodedFrames)
+    {
+        return DecodeNextVideoFrame(pFormatContext, videoStream, pCodecContext, pDecodedFrame->pAVFrame);
+    }
+
+    if (!DecodeNextVideoFrame(pFormatContext, videoStream, pCodecContext, pFrame))
+    {
+        return false;
+    }
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_BENCHMARK
+    Uint64 startTime = SDL_GetPerformanceCounter();
+    #endif
+#endif
+
+    AVPicture picture;
+
+    if (IsYUVFormat(pCodecContext->pix_fmt))
+    {
+        unsigned int ySize = width * height;
+
+        // We convert to YUV420P, whose planes go Y, U, V, but YV12 puts V before U.
+        picture.data[0] = pDecodedFrame->pPixels;
+        picture.data[1] = pDecodedFrame->pPixels + ySize * 5 / 4;
+        picture.data[2] = pDecodedFrame->pPixels + ySize;
+        picture.linesize[0] = width;
+        picture.linesize[1] = width / 2;
+        picture.linesize[2] = width / 2;
+    }
+    else
+    {
+        picture.data[0] = pDecodedFrame->pPixels;
+        picture.linesize[0] = width * 4;
+    }
+
+    sws_scale(pImageConvertContext, pFrame->data, pFrame->linesize, 0, pFrame->height, picture.data, picture.linesize);
+    av_frame_unref(pFrame);
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_BENCHMARK
+    convertMicrosecondsList.push_back(GetMicrosecondsSince(startTime));
+    convertedByteCount += GetDecodedFrameSize();
+    #endif
+#endif
+
+    return true;
+}
+
+bool Video::CanDecodeFrame()
+{
+    return
+        !isDecodingFrame &&
+        !freeDecodedFrameList.empty() &&
+        (shouldSeekToStart || shouldLoop || nextFrameIndexToDecode < frameList.size());
+}
+
+void Video::StartDecodingFrame()
+{
+    pDecodingFrame = freeDecodedFrameList.back();
+    freeDecodedFrameList.pop_back();
+
+    decodingFrameNeedsSeek = shouldSeekToStart;
+
+    if (shouldSeekToStart)
+    {
+        shouldSeekToStart = false;
+        nextFrameIndexToDecode = 0;
+    }
+    else if (nextFrameIndexToDecode >= frameList.size())
+    {
+        // We'll carry on past the end of a looping video into its start,
+        // so the seek back to the start happens well before we need the first frame.
+        nextFrameIndexToDecode = 0;
+        decodingFrameNeedsSeek = true;
+    }
+
+    pDecodingFrame->frameIndex = nextFrameIndexToDecode++;
+    decodingFrameGeneration = decodeGeneration;
+    isDecodingFrame = true;
+}
+
+void Video::DecodeFrame()
+{
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_BENCHMARK
+    Uint64 startTime = SDL_GetPerformanceCounter();
+    #endif
+#endif
+
+    if (decodingFrameNeedsSeek)
+    {
+        av_seek_frame(pFormatContext, videoStream, 0, AVSEEK_FLAG_ANY);
+        avcodec_flush_buffers(pCodecContext);
+    }
+
+    pDecodingFrame->hasPixels = DecodeFrameInto(pDecodingFrame);
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_BENCHMARK
+    decodingFrameMicroseconds = GetMicrosecondsSince(startTime);
+    #endif
+#endif
+}
+
+void Video::FinishDecodingFrame()
+{
+    if (decodingFrameGeneration == decodeGeneration)
+    {
+        decodedFrameQueue.push_back(pDecodingFrame);
+    }
+    else
+    {
+        freeDecodedFrameList.push_back(pDecodingFrame);
+    }
+
+    pDecodingFrame = NULL;
+    isDecodingFrame = false;
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_BENCHMARK
+    decodeMicrosecondsList.push_back(decodingFrameMicroseconds);
+    #endif
+#endif
+
+    if (isWaitingForDecoder)
+    {
+        isWaitingForDecoder = false;
+        SDL_SemPost(pFrameDecodedSemaphore);
+    }
+}
+
+void Video::StartPrefetch()
+{
+    isQueuedForPrefetch = false;
+    isRunningPrefetch = true;
+}
+
+void Video::FinishPrefetch()
+{
+    isRunningPrefetch = false;
+
+    if (isWaitingForDecoder)
+    {
+        isWaitingForDecoder = false;
+        SDL_SemPost(pFrameDecodedSemaphore);
     }
 }
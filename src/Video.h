@@ -31,6 +31,7 @@
 #define VIDEO_H
 
 #include "AnimationSound.h"
+#include "AssetHandle.h"
 #include "Color.h"
 #include "Rectangle.h"
 #include "Vector2.h"
@@ -48,8 +49,14 @@ extern "C"
 class Image;
 class RWOpsIOContext;
 
+// How many frames each video decodes ahead of the one on screen.
+// Every decoded frame is held in memory at the video's full size, so this bounds the memory used.
+const unsigned int VideoDecodeAheadFrameCount = 3;
+
 class Video
 {
+    friend class VideoDecoder;
+
 public:
     Video(bool shouldLoop);
     Video(XmlReader *pReader);
@@ -76,9 +83,23 @@ public:
     bool IsReady();
     bool IsFinished() const;
 
+    // Has the video decoder open the video and decode its first frame on its own thread - or every frame,
+    // if the video's frames are cached - so that LoadFile() only needs to create and upload the texture.
+    void Prefetch();
+    bool IsPrefetchPending();
+    void CancelPrefetch();
+
     void UpdateReadiness(string newLocationId, bool *pLoadFile, bool *pDeleteFile);
     bool IsAnimationReady();
 
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_DECODE_BENCHMARK
+    // Decodes every frame of the given video once for each of a range of codec thread counts,
+    // and prints how quickly each one got through it.
+    static void RunDecodeBenchmark(const string &videoRelativeFilePath);
+    #endif
+#endif
+
     class Frame
     {
         friend class Video;
@@ -111,11 +132,80 @@ public:
     AnimationSound * GetSoundToPlay();
 
 private:
+    // A frame that's been decoded and converted to the texture's pixel format.
+    class DecodedFrame
+    {
+    public:
+        DecodedFrame(unsigned int size)
+        {
+            pPixels = size > 0 ? new unsigned char[size] : NULL;
+            pAVFrame = av_frame_alloc();
+            frameIndex = 0;
+            hasPixels = false;
+        }
+
+        ~DecodedFrame()
+        {
+            delete [] pPixels;
+            pPixels = NULL;
+            av_frame_free(&pAVFrame);
+        }
+
+        // Frames that have to be converted end up in pPixels.  Frames that can be uploaded
+        // as they come out of the decoder are kept as a reference to the decoder's own frame instead.
+        unsigned char *pPixels;
+        AVFrame *pAVFrame;
+        unsigned int frameIndex;
+
+        // If we ran out of video before we ran out of frames, the frame has nothing in it,
+        // and we'll just keep showing whatever we were showing before.
+        bool hasPixels;
+    };
+
     void MoveToNextFrame();
-    void WriteNextFrame();
+    void ShowFrame(unsigned int frameIndex, bool waitUntilDecoded);
+    void RestartDecoding();
+    void RecreateTextureIfNeeded();
+    void UploadDisplayedFrame();
+    void UploadFrame(DecodedFrame *pDecodedFrame, SDL_Texture *pTargetTexture);
+    SDL_Texture * CreateFrameTexture(int access);
+    void OpenDecoder();
+    void CloseDecoder();
+    Uint32 GetTexturePixelFormat();
+    int GetTexturePitch();
+    unsigned int GetTextureFrameSize();
+    unsigned int GetDecodedFrameSize();
+    bool DecodeFrameInto(DecodedFrame *pDecodedFrame);
+
+    // Opens the video and decodes whatever LoadFile() needs, without touching any textures.
+    // The video decoder runs this a step at a time if the video was prefetched, and LoadFile()
+    // finishes whatever's left.  Returns true once there's nothing left to decode.
+    bool RunPrefetchStep();
+    void PrefetchFile();
+    void StopPrefetching();
+    void ReleasePrefetchedFile();
+
+    // Short looping videos are decoded once up front, a frame per prefetch step,
+    // after which we can let go of the decoder and the video file entirely.
+    // Each frame is only uploaded to its own texture the first time it's shown.
+    bool ShouldCacheFrames();
+    bool DecodeNextFrameToCache();
+    void DestroyCachedFrames();
+    SDL_Texture * GetCachedFrameTexture(unsigned int frameIndex);
+
+    // Called with the video decoder's lock held.
+    bool CanDecodeFrame();
+    void StartDecodingFrame();
+    void FinishDecodingFrame();
+    void StartPrefetch();
+    void FinishPrefetch();
+
+    // Called without the video decoder's lock held, between StartDecodingFrame() and FinishDecodingFrame().
+    void DecodeFrame();
 
     string id;
     string videoRelativeFilePath;
+    AssetHandle videoAssetHandle;
     unsigned int width;
     unsigned int height;
     bool isReady;
@@ -131,14 +221,72 @@ private:
     int videoStream;
     AVCodecContext *pCodecContext;
     AVCodec *pCodec;
+    int codecThreadCount;
     AVFrame *pFrame;
     void *pMemToFree;
     SwsContext *pImageConvertContext;
 
-    unsigned char *pCachedTexturePixels;
+    // True if the video's textures are YV12 rather than ARGB.  We keep this around after closing the decoder,
+    // since cached frames are uploaded after that.
+    bool usesYUVTextures;
+
+    // True if the decoder gives us YUV420P frames at the size we're drawing,
+    // in which case we skip conversion and upload the decoder's planes directly.
+    bool uploadsDecodedFrames;
+
+    // The frame that's in the texture, which we keep around in case the texture needs to be recreated.
+    // Only touched on the main thread once the video is loaded.
+    DecodedFrame *pDisplayedFrame;
+
+    // For videos whose frames are cached, this is just whichever of the cached textures we're showing.
     SDL_Texture *pTexture;
 
+    bool usesCachedFrames;
+    vector<SDL_Texture *> cachedFrameTextureList;
+
+    // Frames that haven't been uploaded to their texture yet.  Each one is let go of once it has been.
+    vector<DecodedFrame *> cachedDecodedFrameList;
+
     int texturesRecreatedCount;
+
+    // Only touched on the main thread.
+    bool isPrefetchRequested;
+
+    // Set once PrefetchFile() has run and LoadFile() hasn't taken what it opened yet.
+    // Belongs to whoever is prefetching the video, same as the format and codec contexts.
+    bool isPrefetched;
+
+    // Once the video has been handed to the video decoder, everything from here down is guarded by its lock,
+    // except for the format and codec contexts, which belong to whoever is decoding a frame.
+    deque<DecodedFrame *> decodedFrameQueue;
+    vector<DecodedFrame *> freeDecodedFrameList;
+    unsigned int nextFrameIndexToDecode;
+    bool shouldSeekToStart;
+    int decodeGeneration;
+
+    DecodedFrame *pDecodingFrame;
+    bool decodingFrameNeedsSeek;
+    int decodingFrameGeneration;
+    bool isDecodingFrame;
+
+    bool isQueuedForPrefetch;
+    bool isRunningPrefetch;
+
+    // Only one thread ever waits on a given video at a time.
+    bool isWaitingForDecoder;
+    SDL_sem *pFrameDecodedSemaphore;
+
+#ifdef MLI_DEBUG
+    #ifdef MLI_DEBUG_VIDEO_BENCHMARK
+    int decodingFrameMicroseconds;
+    vector<int> decodeMicrosecondsList;
+    vector<int> showFrameMicrosecondsList;
+    vector<int> convertMicrosecondsList;
+    vector<int> uploadMicrosecondsList;
+    Uint64 convertedByteCount;
+    Uint64 uploadedByteCount;
+    #endif
+#endif
 };
 
 #endif
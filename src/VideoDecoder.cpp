@@ -0,0 +1,318 @@
+/**
+ * Implementation of a long-lived thread that decodes video frames ahead of when they're shown.
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "VideoDecoder.h"
+#include "Video.h"
+#include "globals.h"
+#include <algorithm>
+
+// Past this many threads, frame threading mostly just adds latency for the sizes of video we play.
+const int MaxCodecThreadsPerVideo = 4;
+
+VideoDecoder * VideoDecoder::pInstance = NULL;
+
+void VideoDecoder::Close()
+{
+    delete pInstance;
+    pInstance = NULL;
+}
+
+VideoDecoder::VideoDecoder()
+{
+    pThread = NULL;
+    SDL_AtomicSet(&isQuitting, 0);
+
+    pVideoListSemaphore = SDL_CreateSemaphore(1);
+    pWorkAvailableSemaphore = SDL_CreateSemaphore(0);
+    nextVideoIndex = 0;
+
+    reservedCodecThreadCount = 0;
+}
+
+VideoDecoder::~VideoDecoder()
+{
+    if (pThread != NULL)
+    {
+        SDL_AtomicSet(&isQuitting, 1);
+        SDL_SemPost(pWorkAvailableSemaphore);
+        SDL_WaitThread(pThread, NULL);
+        pThread = NULL;
+    }
+
+    SDL_DestroySemaphore(pVideoListSemaphore);
+    pVideoListSemaphore = NULL;
+    SDL_DestroySemaphore(pWorkAvailableSemaphore);
+    pWorkAvailableSemaphore = NULL;
+}
+
+void VideoDecoder::AddVideo(Video *pVideo)
+{
+    EnsureThreadStarted();
+
+    Lock();
+
+    if (find(videoList.begin(), videoList.end(), pVideo) == videoList.end())
+    {
+        videoList.push_back(pVideo);
+    }
+
+    Unlock();
+
+    WakeUp();
+}
+
+void VideoDecoder::RemoveVideo(Video *pVideo)
+{
+    Lock();
+
+    vector<Video *>::iterator iter = find(videoList.begin(), videoList.end(), pVideo);
+
+    if (iter != videoList.end())
+    {
+        videoList.erase(iter);
+    }
+
+    // If the decode thread is in the middle of decoding a frame for this video,
+    // we need to let it finish before the video can go away.
+    while (pVideo->isDecodingFrame)
+    {
+        pVideo->isWaitingForDecoder = true;
+        Unlock();
+
+        SDL_SemWait(pVideo->pFrameDecodedSemaphore);
+
+        Lock();
+    }
+
+    Unlock();
+}
+
+void VideoDecoder::AddPrefetchVideo(Video *pVideo)
+{
+    EnsureThreadStarted();
+
+    Lock();
+
+    if (!pVideo->isQueuedForPrefetch)
+    {
+        pVideo->isQueuedForPrefetch = true;
+        prefetchVideoList.push_back(pVideo);
+    }
+
+    Unlock();
+
+    WakeUp();
+}
+
+void VideoDecoder::RemovePrefetchVideo(Video *pVideo)
+{
+    Lock();
+
+    // The decode thread puts a video back in line after each step it runs for it,
+    // so we need to let that happen before we take it out of line.
+    while (pVideo->isRunningPrefetch)
+    {
+        pVideo->isWaitingForDecoder = true;
+        Unlock();
+
+        SDL_SemWait(pVideo->pFrameDecodedSemaphore);
+
+        Lock();
+    }
+
+    deque<Video *>::iterator iter = find(prefetchVideoList.begin(), prefetchVideoList.end(), pVideo);
+
+    if (iter != prefetchVideoList.end())
+    {
+        prefetchVideoList.erase(iter);
+    }
+
+    pVideo->isQueuedForPrefetch = false;
+
+    Unlock();
+}
+
+void VideoDecoder::WakeUp()
+{
+    SDL_SemPost(pWorkAvailableSemaphore);
+}
+
+void VideoDecoder::Lock()
+{
+    SDL_SemWait(pVideoListSemaphore);
+}
+
+void VideoDecoder::Unlock()
+{
+    SDL_SemPost(pVideoListSemaphore);
+}
+
+int VideoDecoder::ReserveCodecThreads()
+{
+    int budget = gVideoDecodeThreadBudget > 0 ? gVideoDecodeThreadBudget : SDL_GetCPUCount();
+
+    Lock();
+
+    int threadCount = min(budget - reservedCodecThreadCount, MaxCodecThreadsPerVideo);
+
+    if (threadCount < 1)
+    {
+        threadCount = 1;
+    }
+
+    reservedCodecThreadCount += threadCount;
+
+    Unlock();
+
+    return threadCount;
+}
+
+void VideoDecoder::ReleaseCodecThreads(int threadCount)
+{
+    Lock();
+    reservedCodecThreadCount -= threadCount;
+    Unlock();
+}
+
+int VideoDecoder::RunStatic(void *pData)
+{
+    VideoDecoder *pThis = reinterpret_cast<VideoDecoder *>(pData);
+    pThis->Run();
+    return 0;
+}
+
+void VideoDecoder::Run()
+{
+    while (true)
+    {
+        SDL_SemWait(pWorkAvailableSemaphore);
+
+        if (SDL_AtomicGet(&isQuitting) != 0)
+        {
+            break;
+        }
+
+        // We'll keep going until every video has as many frames decoded as it can hold,
+        // and every video waiting to be prefetched has been opened.
+        // Wake-ups that arrive while we're doing this just cause an extra pass that finds nothing to do.
+        while (SDL_AtomicGet(&isQuitting) == 0)
+        {
+            Lock();
+
+            Video *pVideo = GetNextVideoToDecode();
+
+            if (pVideo != NULL)
+            {
+                pVideo->StartDecodingFrame();
+                Unlock();
+
+                pVideo->DecodeFrame();
+
+                Lock();
+                pVideo->FinishDecodingFrame();
+                Unlock();
+                continue;
+            }
+
+            pVideo = GetNextVideoToPrefetch();
+
+            if (pVideo == NULL)
+            {
+                Unlock();
+                break;
+            }
+
+            pVideo->StartPrefetch();
+            Unlock();
+
+            bool isPrefetchFinished = true;
+
+            // If the video can't be opened, we'll leave it for LoadFile() to try again,
+            // so that the error comes up on the main thread like it always has.
+            try
+            {
+                isPrefetchFinished = pVideo->RunPrefetchStep();
+            }
+            catch (Exception e)
+            {
+                pVideo->ReleasePrefetchedFile();
+            }
+
+            Lock();
+
+            // Videos that take more than one step go to the back of the line after each one,
+            // so that one long video doesn't hold up the rest.
+            if (!isPrefetchFinished)
+            {
+                pVideo->isQueuedForPrefetch = true;
+                prefetchVideoList.push_back(pVideo);
+            }
+
+            pVideo->FinishPrefetch();
+            Unlock();
+        }
+    }
+}
+
+void VideoDecoder::EnsureThreadStarted()
+{
+    if (pThread == NULL)
+    {
+        pThread = SDL_CreateThread(VideoDecoder::RunStatic, "VideoDecodeThread", this);
+    }
+}
+
+Video * VideoDecoder::GetNextVideoToDecode()
+{
+    // We'll go round-robin, so that one video with a slow codec doesn't starve the others.
+    for (unsigned int i = 0; i < videoList.size(); i++)
+    {
+        Video *pVideo = videoList[(nextVideoIndex + i) % videoList.size()];
+
+        if (pVideo->CanDecodeFrame())
+        {
+            nextVideoIndex = (nextVideoIndex + i + 1) % videoList.size();
+            return pVideo;
+        }
+    }
+
+    return NULL;
+}
+
+Video * VideoDecoder::GetNextVideoToPrefetch()
+{
+    if (prefetchVideoList.empty())
+    {
+        return NULL;
+    }
+
+    Video *pVideo = prefetchVideoList.front();
+    prefetchVideoList.pop_front();
+    return pVideo;
+}
@@ -0,0 +1,110 @@
+/**
+ * Basic header/include file for VideoDecoder.cpp.
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef VIDEODECODER_H
+#define VIDEODECODER_H
+
+#include <SDL2/SDL.h>
+#include <deque>
+#include <vector>
+
+using namespace std;
+
+class Video;
+
+// Decodes the upcoming frames of every loaded video on a single long-lived thread,
+// so that a slow keyframe or a seek back to the start of a loop never holds up a game frame.
+// Each video keeps a small queue of decoded frames; the decode thread tops up whichever
+// videos have room, one frame at a time, and the main thread just uploads the frames it's handed.
+class VideoDecoder
+{
+public:
+    static VideoDecoder * GetInstance()
+    {
+        if (pInstance == NULL)
+        {
+            pInstance = new VideoDecoder();
+        }
+
+        return pInstance;
+    }
+
+    static void Close();
+
+    void AddVideo(Video *pVideo);
+
+    // Once this returns, the decode thread won't touch the video again.
+    void RemoveVideo(Video *pVideo);
+
+    // Videos that are about to be loaded are opened on the decode thread too,
+    // whenever none of the videos that are playing need another frame.
+    void AddPrefetchVideo(Video *pVideo);
+
+    // Once this returns, the decode thread won't open the video or touch what it opened.
+    void RemovePrefetchVideo(Video *pVideo);
+
+    // Lets the decode thread know that a video has room for more frames.
+    void WakeUp();
+
+    // Guards the decoded frame queues of every video.
+    void Lock();
+    void Unlock();
+
+    // Hands out libavcodec threads to videos as they're loaded, out of a budget shared by every video,
+    // so that several videos playing at once don't end up with more threads than we have cores.
+    // A video always gets at least one thread, even if the budget's been used up.
+    int ReserveCodecThreads();
+    void ReleaseCodecThreads(int threadCount);
+
+private:
+    VideoDecoder();
+    ~VideoDecoder();
+
+    static int RunStatic(void *pData);
+    void Run();
+
+    void EnsureThreadStarted();
+    Video * GetNextVideoToDecode();
+    Video * GetNextVideoToPrefetch();
+
+    static VideoDecoder *pInstance;
+
+    SDL_Thread *pThread;
+    SDL_atomic_t isQuitting;
+
+    SDL_sem *pVideoListSemaphore;
+    SDL_sem *pWorkAvailableSemaphore;
+    vector<Video *> videoList;
+    unsigned int nextVideoIndex;
+    deque<Video *> prefetchVideoList;
+
+    int reservedCodecThreadCount;
+};
+
+#endif
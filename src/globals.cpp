@@ -80,6 +80,13 @@ vector<string> gCompletedCaseGuidList;
 map<string, bool> gCaseIsSignedByFilePathMap;
 vector<string> gDialogsSeenList;
 
+int gTextureMemoryBudgetMegabytes = 256;
+int gTextureMemoryBudgetMegabytesDefault = gTextureMemoryBudgetMegabytes;
+int gVideoDecodeThreadBudget = 0;
+int gVideoDecodeThreadBudgetDefault = gVideoDecodeThreadBudget;
+int gMaxCachedVideoMegabytes = 16;
+int gMaxCachedVideoMegabytesDefault = gMaxCachedVideoMegabytes;
+
 bool gToggleFullscreen = false;
 #else
 CURL *gpCurlHandle = NULL;
@@ -98,6 +98,22 @@ extern vector<string> gCompletedCaseGuidList;
 extern map<string, bool> gCaseIsSignedByFilePathMap;
 extern vector<string> gDialogsSeenList;
 
+// How much memory we'll let loaded case sprite sheets use before unloading the least recently used ones.
+// Anything less than the minimum would have us unloading a location's sprite sheets as fast as we load them.
+extern int gTextureMemoryBudgetMegabytes;
+extern int gTextureMemoryBudgetMegabytesDefault;
+const int MinTextureMemoryBudgetMegabytes = 64;
+
+// How many libavcodec threads all playing videos can use between them.  Zero means one per core.
+extern int gVideoDecodeThreadBudget;
+extern int gVideoDecodeThreadBudgetDefault;
+
+// How large a short looping video can be, once decoded, for us to keep all of its frames around as textures.
+// Zero turns this off.  The limit keeps a single cached video from taking up a sizeable part of video memory.
+extern int gMaxCachedVideoMegabytes;
+extern int gMaxCachedVideoMegabytesDefault;
+const int MaxCachedVideoMegabytesLimit = 128;
+
 extern bool gToggleFullscreen;
 #else
 extern CURL *gpCurlHandle;
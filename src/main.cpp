@@ -41,6 +41,8 @@
 #ifdef GAME_EXECUTABLE
 #include "ResourceLoader.h"
 #include "TextInputHelper.h"
+#include "Video.h"
+#include "VideoDecoder.h"
 #endif
 
 #ifdef LAUNCHER
@@ -213,6 +215,17 @@ int main(int argc, char * argv[])
         return 1;
     }
 
+#ifdef GAME_EXECUTABLE
+    #ifdef MLI_DEBUG
+        #ifdef MLI_DEBUG_VIDEO_DECODE_BENCHMARK
+    Video::RunDecodeBenchmark("video/TeamLogoAnimation.mov");
+    Video::RunDecodeBenchmark("video/OptionsBackground.mov");
+    Video::RunDecodeBenchmark("video/TitleScreenSpike.mov");
+    Video::RunDecodeBenchmark("video/TitleScreenTwilight.mov");
+        #endif
+    #endif
+#endif
+
     double now = -1.0f; // Used to temporarily store the current time, for timing-related calculations.
     double lastSecond = 0; // Updated once per second, used to keep track of how long a second actually is. (If now>=(lastSecond+1000), new second.) Used for FPS.
     Uint32 frame = 0; // Keeps track of the number of frames rendered during the current second. Used for FPS calculation later.
@@ -229,6 +242,14 @@ int main(int argc, char * argv[])
     int mouseY = -1;
     bool drawCursor = false;
     bool isReloadingSprites = false;
+
+    #ifdef MLI_DEBUG
+        #ifdef MLI_DEBUG_RESOURCE_LOADER
+            bool wasLoadingResources = false;
+            Uint32 loadingStartTicks = 0;
+            Uint32 lastQueueStatusTicks = 0;
+        #endif
+    #endif
 #endif
 
     while (!gIsQuitting)
@@ -325,16 +346,86 @@ int main(int argc, char * argv[])
         }
 
     #ifdef GAME_EXECUTABLE
-        // If we have any textures that we need to load or delete, let's do so now.
+        // If we have any textures that we need to load or delete, let's do so now,
+        // for as long as this frame's time budget allows.  Textures waiting to be uploaded
+        // come first; we only move on to the next load steps once those are done.
+        Uint64 loadStartTime = SDL_GetPerformanceCounter();
+
         if (ResourceLoader::GetInstance()->HasImageTexturesToLoad())
         {
-            ResourceLoader::GetInstance()->TryLoadOneImageTexture();
+            ResourceLoader::GetInstance()->TryLoadImageTextures(ResourceLoaderFrameTimeBudgetMs);
         }
-        else if (ResourceLoader::GetInstance()->HasLoadStep())
+
+        double loadTimeRemainingMs = ResourceLoaderFrameTimeBudgetMs - (double)(SDL_GetPerformanceCounter() - loadStartTime) * 1000.0 / SDL_GetPerformanceFrequency();
+
+        if (!ResourceLoader::GetInstance()->HasImageTexturesToLoad() && ResourceLoader::GetInstance()->HasLoadStep() && loadTimeRemainingMs > 0)
+        {
+            ResourceLoader::GetInstance()->TryRunLoadSteps(loadTimeRemainingMs);
+        }
+
+        // Once we've loaded everything we need right now, we'll spend a little time
+        // loading what we expect to need soon.
+        if (!ResourceLoader::GetInstance()->HasImageTexturesToLoad() && !ResourceLoader::GetInstance()->HasLoadStep() && ResourceLoader::GetInstance()->HasBackgroundLoadStep())
         {
-            ResourceLoader::GetInstance()->TryRunOneLoadStep();
+            ResourceLoader::GetInstance()->TryRunBackgroundLoadSteps(BackgroundLoadFrameTimeBudgetMs);
         }
 
+        #ifdef MLI_DEBUG
+            #ifdef MLI_DEBUG_RESOURCE_LOADER
+            {
+                bool isLoadingResources = ResourceLoader::GetInstance()->HasImageTexturesToLoad() || ResourceLoader::GetInstance()->HasLoadStep();
+
+                if (isLoadingResources && !wasLoadingResources)
+                {
+                    loadingStartTicks = SDL_GetTicks();
+                }
+
+                if (isLoadingResources)
+                {
+                    // Printing every frame would slow down the very loads we're watching, so we'll print once a second.
+                    if (!wasLoadingResources || SDL_GetTicks() - lastQueueStatusTicks >= 1000)
+                    {
+                        ResourceLoader::Statistics statistics = ResourceLoader::GetInstance()->GetStatistics();
+                        lastQueueStatusTicks = SDL_GetTicks();
+
+                        cout << "Resource loader queues: "
+                             << statistics.LoadStepsToRun << " load steps, "
+                             << statistics.QueuedImageDecodes << " image decodes, "
+                             << statistics.DecodedImagesWaiting << " decoded images waiting, "
+                             << statistics.TexturesToUpload << " texture uploads, "
+                             << statistics.BackgroundLoadStepsToRun << " background load steps, "
+                             << statistics.QueuedAudioPreloads << " audio preloads" << endl;
+                    }
+                }
+                else if (wasLoadingResources)
+                {
+                    ResourceLoader::Statistics statistics = ResourceLoader::GetInstance()->GetStatistics();
+
+                    // A load is warm if every image it needed came from the decoded image cache.
+                    cout << "Resource loader finished "
+                         << (statistics.ImagesDecoded == 0 ? "warm" : (statistics.ImagesLoadedFromCache == 0 ? "cold" : "partly warm"))
+                         << " in " << SDL_GetTicks() - loadingStartTicks << " ms: "
+                         << statistics.LoadStepsRun << " load steps in " << statistics.LoadStepMicroseconds / 1000.0 << " ms "
+                         << "(plus " << statistics.BackgroundLoadStepsRun << " background load steps in " << statistics.BackgroundLoadStepMicroseconds / 1000.0 << " ms), "
+                         << statistics.ImagesDecoded << " images extracted in " << statistics.ExtractMicroseconds / 1000.0 << " ms and decoded in " << statistics.DecodeMicroseconds / 1000.0 << " ms "
+                         << "(" << statistics.ImagesDecodedAhead << " ahead of time, " << statistics.ImagesWaitedOn << " waited on), "
+                         << statistics.ImagesLoadedFromCache << " images read from the decoded image cache in " << statistics.CacheReadMicroseconds / 1000.0 << " ms "
+                         << "(" << statistics.CacheWriteMicroseconds / 1000.0 << " ms spent writing to it), "
+                         << statistics.TexturesUploaded << " textures uploaded in " << statistics.UploadMicroseconds / 1000.0 << " ms, "
+                         << statistics.AudioPreloadsRun << " audio files loaded in " << statistics.AudioPreloadMicroseconds / 1000.0 << " ms "
+                         << "(" << statistics.AudioPreloadsWaitedOn << " waited on), "
+                         << statistics.ArchiveKilobytesMapped << " KB read in place from archives, "
+                         << statistics.ArchiveKilobytesExtracted << " KB extracted, "
+                         << statistics.ArchiveKilobytesStreamed << " KB streamed" << endl;
+
+                    ResourceLoader::GetInstance()->ResetStatistics();
+                }
+
+                wasLoadingResources = isLoadingResources;
+            }
+            #endif
+        #endif
+
         // Check if we're still in the process of reloading sprites after a change either to or from fullscreen.
         // If we are, then we'll just keep going until we're done.
         if (isReloadingSprites)
@@ -405,6 +496,13 @@ int main(int argc, char * argv[])
                     #ifndef MLI_DEBUG_NO_FPS
                         cout << "FPS: " << frame << endl;
                     #endif
+
+                    #ifdef MLI_DEBUG_DRAW_CALLS
+                        cout << "Draw calls per frame: " << (double)Image::GetDrawCallCount() / frame << ", "
+                             << "texture switches per frame: " << (double)Image::GetTextureSwitchCount() / frame << endl;
+
+                        Image::ResetDrawStatistics();
+                    #endif
                 #endif
 
                 frame = 0;
@@ -416,6 +514,11 @@ int main(int argc, char * argv[])
         // Swap the double buffer to display the new frame.
         SDL_RenderPresent(gpRenderer);
 
+    #ifdef GAME_EXECUTABLE
+        // Nothing can still be drawing with the sprite sheet images that were swapped out during this frame.
+        SpriteManager::ReclaimRetiredImages();
+    #endif
+
         // Increment the frame counter (for FPS).
         frame++;
 
@@ -446,6 +549,8 @@ int main(int argc, char * argv[])
 #ifdef GAME_EXECUTABLE
     // The game's done now, so finish it up.
     CommonCaseResources::Close();
+    SpriteManager::ReclaimRetiredImages();
+    VideoDecoder::Close();
 #endif
 
     Game::Finish();
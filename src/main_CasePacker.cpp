@@ -0,0 +1,574 @@
+/**
+ * Command-line utility for converting .mlicase zip archives into case packs.
+ *
+ *
+ * @author GabuEx, dawnmew
+ * @since 1.0
+ *
+ * Licensed under the MIT License.
+ *
+ * Copyright (c) 2014 Equestrian Dreamers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "CasePack.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+using namespace std;
+
+namespace
+{
+    // Files in these formats are already compressed, so deflating them again
+    // costs load time for next to no space.
+    const char *StoredFileExtensions[] = { "png", "jpg", "jpeg", "ogg", "mp3", "ogv", "webm", "mp4", "mov", "avi", "mkv" };
+
+    // Deflated files have to come out at least this much smaller than the original to be worth decoding at load.
+    const double MinimumDeflateSavings = 0.1;
+
+    class PackedFile
+    {
+    public:
+        PackedFile()
+        {
+            pStoredData = NULL;
+            groupIndex = 0;
+            groupOrder = 0;
+        }
+
+        string normalizedFilePath;
+        string groupName;
+        void *pStoredData;
+        CasePackEntry entry;
+        mz_uint32 groupIndex;
+        size_t groupOrder;
+    };
+
+    bool ComparePackedFilesByGroup(const PackedFile *pFile1, const PackedFile *pFile2)
+    {
+        if (pFile1->groupIndex != pFile2->groupIndex)
+        {
+            return pFile1->groupIndex < pFile2->groupIndex;
+        }
+        else if (pFile1->groupOrder != pFile2->groupOrder)
+        {
+            return pFile1->groupOrder < pFile2->groupOrder;
+        }
+        else
+        {
+            return pFile1->normalizedFilePath < pFile2->normalizedFilePath;
+        }
+    }
+
+    bool ComparePackedFilesByHash(const PackedFile *pFile1, const PackedFile *pFile2)
+    {
+        if (pFile1->entry.filePathHash != pFile2->entry.filePathHash)
+        {
+            return pFile1->entry.filePathHash < pFile2->entry.filePathHash;
+        }
+        else
+        {
+            return pFile1->normalizedFilePath < pFile2->normalizedFilePath;
+        }
+    }
+
+    string NormalizeFilePath(string filePath)
+    {
+        for (unsigned int i = 0; i < filePath.length(); i++)
+        {
+            filePath[i] = NormalizeArchiveFilePathCharacter(filePath[i]);
+        }
+
+        return filePath;
+    }
+
+    string GetDirectory(const string &normalizedFilePath)
+    {
+        size_t lastSlashIndex = normalizedFilePath.find_last_of('/');
+        return lastSlashIndex == string::npos ? "" : normalizedFilePath.substr(0, lastSlashIndex);
+    }
+
+    bool ShouldStore(const string &normalizedFilePath)
+    {
+        size_t lastDotIndex = normalizedFilePath.find_last_of('.');
+
+        if (lastDotIndex == string::npos)
+        {
+            return false;
+        }
+
+        string extension = normalizedFilePath.substr(lastDotIndex + 1);
+
+        for (unsigned int i = 0; i < sizeof(StoredFileExtensions) / sizeof(StoredFileExtensions[0]); i++)
+        {
+            if (extension == StoredFileExtensions[i])
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // A group file lists the files that should sit next to each other in the pack -
+    // for example, everything a single location loads - so that they can be read sequentially.
+    // Each group starts with a line of the form "[Group name]", followed by one file path per line.
+    bool ReadGroupFile(const string &groupFilePath, map<string, pair<string, size_t> > *pGroupByFilePathMap)
+    {
+        ifstream groupFile(groupFilePath.c_str());
+
+        if (!groupFile)
+        {
+            return false;
+        }
+
+        string line;
+        string groupName = "";
+        size_t groupOrder = 0;
+
+        while (getline(groupFile, line))
+        {
+            while (!line.empty() && (line[line.length() - 1] == '\r' || line[line.length() - 1] == ' '))
+            {
+                line.erase(line.length() - 1);
+            }
+
+            if (line.empty())
+            {
+                continue;
+            }
+
+            if (line[0] == '[' && line[line.length() - 1] == ']')
+            {
+                groupName = line.substr(1, line.length() - 2);
+                continue;
+            }
+
+            string normalizedFilePath = NormalizeFilePath(line);
+
+            if (pGroupByFilePathMap->count(normalizedFilePath) == 0)
+            {
+                (*pGroupByFilePathMap)[normalizedFilePath] = pair<string, size_t>(groupName, groupOrder++);
+            }
+        }
+
+        return true;
+    }
+
+    bool WritePadding(FILE *pFile, mz_uint64 *pOffset, mz_uint64 alignment)
+    {
+        static const unsigned char zeroes[CasePackAlignment] = { 0 };
+        size_t paddingSize = (size_t)((alignment - (*pOffset % alignment)) % alignment);
+
+        if (paddingSize > 0 && fwrite(zeroes, 1, paddingSize, pFile) != paddingSize)
+        {
+            return false;
+        }
+
+        *pOffset += paddingSize;
+        return true;
+    }
+
+    double GetSecondsSince(clock_t startTime)
+    {
+        return (double)(clock() - startTime) / CLOCKS_PER_SEC;
+    }
+
+    bool ReadWholeFile(const string &filePath, vector<unsigned char> *pBytes)
+    {
+        FILE *pFile = fopen(filePath.c_str(), "rb");
+
+        if (pFile == NULL)
+        {
+            return false;
+        }
+
+        unsigned char buffer[65536];
+        size_t bytesRead = 0;
+
+        while ((bytesRead = fread(buffer, 1, sizeof(buffer), pFile)) > 0)
+        {
+            pBytes->insert(pBytes->end(), buffer, buffer + bytesRead);
+        }
+
+        fclose(pFile);
+        return true;
+    }
+
+    // Decodes every file from both the zip archive and the case pack, with both already in memory,
+    // so that the comparison is of decode cost rather than of disk speed.
+    void Benchmark(const string &inputFilePath, const string &outputFilePath)
+    {
+        vector<unsigned char> zipBytes;
+        vector<unsigned char> packBytes;
+
+        if (!ReadWholeFile(inputFilePath, &zipBytes) || !ReadWholeFile(outputFilePath, &packBytes) || zipBytes.empty() || packBytes.size() < CasePackHeaderSize)
+        {
+            cerr << "CasePacker: Couldn't read the archives back for benchmarking." << endl;
+            return;
+        }
+
+        mz_zip_archive zipArchive;
+        memset(&zipArchive, 0, sizeof(zipArchive));
+
+        if (!mz_zip_reader_init_mem(&zipArchive, &zipBytes[0], zipBytes.size(), 0))
+        {
+            cerr << "CasePacker: Couldn't open \"" << inputFilePath << "\" for benchmarking." << endl;
+            return;
+        }
+
+        mz_uint64 zipBytesDecoded = 0;
+        clock_t startTime = clock();
+
+        for (mz_uint i = 0; i < mz_zip_reader_get_num_files(&zipArchive); i++)
+        {
+            size_t size = 0;
+            void *p = mz_zip_reader_extract_to_heap(&zipArchive, i, &size, 0);
+
+            if (p != NULL)
+            {
+                zipBytesDecoded += size;
+                free(p);
+            }
+        }
+
+        double zipSeconds = GetSecondsSince(startTime);
+        mz_zip_reader_end(&zipArchive);
+
+        CasePackHeader header;
+        header.ReadFrom(&packBytes[0]);
+
+        mz_uint64 packBytesDecoded = 0;
+        unsigned int packFailureCount = 0;
+        startTime = clock();
+
+        for (mz_uint32 i = 0; i < header.entryCount; i++)
+        {
+            CasePackEntry entry;
+            entry.ReadFrom(&packBytes[(size_t)(header.entryTableOffset + i * CasePackEntrySize)]);
+
+            void *p = malloc(max((size_t)entry.size, (size_t)1));
+
+            if (DecodeCasePackEntry(entry, &packBytes[0] + entry.dataOffset, p))
+            {
+                packBytesDecoded += entry.size;
+            }
+            else
+            {
+                packFailureCount++;
+            }
+
+            free(p);
+        }
+
+        double packSeconds = GetSecondsSince(startTime);
+
+        cout << "Zip archive: " << zipBytes.size() / 1024 << " KB on disk, decoded "
+             << zipBytesDecoded / 1024 << " KB in " << zipSeconds * 1000.0 << " ms";
+
+        if (zipSeconds > 0)
+        {
+            cout << " (" << zipBytesDecoded / 1048576.0 / zipSeconds << " MB/s)";
+        }
+
+        cout << endl;
+
+        cout << "Case pack: " << packBytes.size() / 1024 << " KB on disk, decoded "
+             << packBytesDecoded / 1024 << " KB in " << packSeconds * 1000.0 << " ms";
+
+        if (packSeconds > 0)
+        {
+            cout << " (" << packBytesDecoded / 1048576.0 / packSeconds << " MB/s)";
+        }
+
+        cout << endl;
+
+        if (packFailureCount > 0)
+        {
+            cerr << "CasePacker: " << packFailureCount << " file(s) in the case pack failed to decode." << endl;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        cerr << "Usage: CasePacker <input .mlicase> <output file> [--groups <group file>] [--store-only] [--benchmark]" << endl;
+        cerr << endl;
+        cerr << "Converts a zip-based case file into a case pack, which the game reads in the same way." << endl;
+        cerr << "    --groups <group file>  Stores the files listed under each \"[Group name]\" line together, in the order listed." << endl;
+        cerr << "                           Files not listed in any group are grouped by directory." << endl;
+        cerr << "    --store-only           Stores every file uncompressed, so that all of them can be read in place." << endl;
+        cerr << "    --benchmark            Compares decode speed and size with the original archive afterwards." << endl;
+        return 1;
+    }
+
+    string inputFilePath = argv[1];
+    string outputFilePath = argv[2];
+    string groupFilePath = "";
+    bool storeOnly = false;
+    bool benchmark = false;
+
+    for (int i = 3; i < argc; i++)
+    {
+        string argument = argv[i];
+
+        if (argument == "--groups" && i + 1 < argc)
+        {
+            groupFilePath = argv[++i];
+        }
+        else if (argument == "--store-only")
+        {
+            storeOnly = true;
+        }
+        else if (argument == "--benchmark")
+        {
+            benchmark = true;
+        }
+        else
+        {
+            cerr << "CasePacker: Unrecognized argument \"" << argument << "\"." << endl;
+            return 1;
+        }
+    }
+
+    map<string, pair<string, size_t> > groupByFilePathMap;
+
+    if (!groupFilePath.empty() && !ReadGroupFile(groupFilePath, &groupByFilePathMap))
+    {
+        cerr << "CasePacker: Couldn't read group file \"" << groupFilePath << "\"." << endl;
+        return 1;
+    }
+
+    mz_zip_archive zipArchive;
+    memset(&zipArchive, 0, sizeof(zipArchive));
+
+    if (!mz_zip_reader_init_file(&zipArchive, inputFilePath.c_str(), 0))
+    {
+        cerr << "CasePacker: Couldn't open \"" << inputFilePath << "\" as a zip archive." << endl;
+        return 1;
+    }
+
+    vector<PackedFile *> fileList;
+    map<string, bool> filePathSeenMap;
+    map<string, mz_uint32> groupIndexByNameMap;
+    bool success = true;
+
+    mz_uint compressionFlags = tdefl_create_comp_flags_from_zip_params(MZ_BEST_COMPRESSION, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY);
+    mz_uint64 totalSize = 0;
+    mz_uint64 totalStoredSize = 0;
+
+    for (mz_uint i = 0; i < mz_zip_reader_get_num_files(&zipArchive) && success; i++)
+    {
+        mz_zip_archive_file_stat fileStat;
+
+        if (mz_zip_reader_is_file_a_directory(&zipArchive, i) || !mz_zip_reader_file_stat(&zipArchive, i, &fileStat))
+        {
+            continue;
+        }
+
+        string normalizedFilePath = NormalizeFilePath(fileStat.m_filename);
+
+        if (filePathSeenMap.count(normalizedFilePath) > 0)
+        {
+            cerr << "CasePacker: Skipping \"" << fileStat.m_filename << "\", since another file has the same path." << endl;
+            continue;
+        }
+
+        if (normalizedFilePath.length() > 0xFFFF)
+        {
+            cerr << "CasePacker: The path \"" << fileStat.m_filename << "\" is too long." << endl;
+            success = false;
+            break;
+        }
+
+        filePathSeenMap[normalizedFilePath] = true;
+
+        size_t size = 0;
+        void *pData = mz_zip_reader_extract_to_heap(&zipArchive, i, &size, 0);
+
+        if (pData == NULL)
+        {
+            cerr << "CasePacker: Couldn't extract \"" << fileStat.m_filename << "\"." << endl;
+            success = false;
+            break;
+        }
+
+        PackedFile *pFile = new PackedFile();
+        pFile->normalizedFilePath = normalizedFilePath;
+        pFile->entry.filePathHash = HashArchiveFilePath(normalizedFilePath.c_str());
+        pFile->entry.size = size;
+        pFile->entry.crc32 = (mz_uint32)mz_crc32(MZ_CRC32_INIT, static_cast<const unsigned char *>(pData), size);
+        pFile->entry.codec = CasePackCodecStore;
+        pFile->entry.storedSize = size;
+        pFile->pStoredData = pData;
+
+        if (!storeOnly && !ShouldStore(normalizedFilePath) && size > 0)
+        {
+            size_t compressedSize = 0;
+            void *pCompressedData = tdefl_compress_mem_to_heap(pData, size, &compressedSize, compressionFlags);
+
+            if (pCompressedData != NULL && compressedSize <= size * (1.0 - MinimumDeflateSavings))
+            {
+                free(pData);
+                pFile->entry.codec = CasePackCodecDeflate;
+                pFile->entry.storedSize = compressedSize;
+                pFile->pStoredData = pCompressedData;
+            }
+            else
+            {
+                free(pCompressedData);
+            }
+        }
+
+        map<string, pair<string, size_t> >::iterator groupIter = groupByFilePathMap.find(normalizedFilePath);
+
+        if (groupIter != groupByFilePathMap.end())
+        {
+            pFile->groupName = "[" + groupIter->second.first + "]";
+            pFile->groupOrder = groupIter->second.second;
+        }
+        else
+        {
+            pFile->groupName = GetDirectory(normalizedFilePath);
+            pFile->groupOrder = 0;
+        }
+
+        if (groupIndexByNameMap.count(pFile->groupName) == 0)
+        {
+            mz_uint32 groupIndex = (mz_uint32)groupIndexByNameMap.size();
+            groupIndexByNameMap[pFile->groupName] = groupIndex;
+        }
+
+        pFile->groupIndex = groupIndexByNameMap[pFile->groupName];
+        pFile->entry.groupIndex = pFile->groupIndex;
+
+        totalSize += pFile->entry.size;
+        totalStoredSize += pFile->entry.storedSize;
+
+        fileList.push_back(pFile);
+    }
+
+    mz_zip_reader_end(&zipArchive);
+
+    FILE *pOutputFile = success ? fopen(outputFilePath.c_str(), "wb") : NULL;
+
+    if (success && pOutputFile == NULL)
+    {
+        cerr << "CasePacker: Couldn't open \"" << outputFilePath << "\" for writing." << endl;
+        success = false;
+    }
+
+    if (success)
+    {
+        // Payloads go in group order, so that a group can be read front to back...
+        sort(fileList.begin(), fileList.end(), ComparePackedFilesByGroup);
+
+        unsigned char headerBytes[CasePackHeaderSize] = { 0 };
+        mz_uint64 offset = 0;
+
+        success = fwrite(headerBytes, 1, CasePackHeaderSize, pOutputFile) == CasePackHeaderSize;
+        offset += CasePackHeaderSize;
+
+        for (unsigned int i = 0; i < fileList.size() && success; i++)
+        {
+            PackedFile *pFile = fileList[i];
+
+            success = WritePadding(pOutputFile, &offset, CasePackAlignment);
+            pFile->entry.dataOffset = offset;
+
+            size_t storedSize = (size_t)pFile->entry.storedSize;
+            success = success && (storedSize == 0 || fwrite(pFile->pStoredData, 1, storedSize, pOutputFile) == storedSize);
+            offset += storedSize;
+        }
+
+        // ...while the entry table is sorted by hash, so that it can be searched without reading any names.
+        sort(fileList.begin(), fileList.end(), ComparePackedFilesByHash);
+
+        string nameTable;
+
+        for (unsigned int i = 0; i < fileList.size(); i++)
+        {
+            fileList[i]->entry.nameOffset = (mz_uint32)nameTable.length();
+            fileList[i]->entry.nameLength = (mz_uint16)fileList[i]->normalizedFilePath.length();
+            nameTable += fileList[i]->normalizedFilePath;
+        }
+
+        CasePackHeader header;
+        header.entryCount = (mz_uint32)fileList.size();
+        header.groupCount = (mz_uint32)groupIndexByNameMap.size();
+
+        success = success && WritePadding(pOutputFile, &offset, 8);
+        header.entryTableOffset = offset;
+
+        for (unsigned int i = 0; i < fileList.size() && success; i++)
+        {
+            unsigned char entryBytes[CasePackEntrySize];
+            fileList[i]->entry.WriteTo(entryBytes);
+            success = fwrite(entryBytes, 1, CasePackEntrySize, pOutputFile) == CasePackEntrySize;
+            offset += CasePackEntrySize;
+        }
+
+        header.nameTableOffset = offset;
+        header.nameTableSize = nameTable.length();
+
+        success = success && (nameTable.empty() || fwrite(nameTable.c_str(), 1, nameTable.length(), pOutputFile) == nameTable.length());
+
+        header.WriteTo(headerBytes);
+        success = success && fseek(pOutputFile, 0, SEEK_SET) == 0 && fwrite(headerBytes, 1, CasePackHeaderSize, pOutputFile) == CasePackHeaderSize;
+        success = fclose(pOutputFile) == 0 && success;
+
+        if (!success)
+        {
+            cerr << "CasePacker: Couldn't write to \"" << outputFilePath << "\"." << endl;
+        }
+        else
+        {
+            cout << "Packed " << fileList.size() << " files in " << header.groupCount << " groups: "
+                 << totalSize / 1024 << " KB of data stored as " << totalStoredSize / 1024 << " KB." << endl;
+        }
+    }
+
+    for (unsigned int i = 0; i < fileList.size(); i++)
+    {
+        free(fileList[i]->pStoredData);
+        delete fileList[i];
+    }
+
+    fileList.clear();
+
+    if (success && benchmark)
+    {
+        Benchmark(inputFilePath, outputFilePath);
+    }
+
+    return success ? 0 : 1;
+}
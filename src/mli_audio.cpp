@@ -49,6 +49,11 @@ string currentAmbianceToReport = "";
 
 volatile bool audioEnabled = true;
 
+// Audio is preloaded on worker threads while it's played from the main thread,
+// so the maps above are only touched while holding this.
+SDL_SpinLock audioMapLock = 0;
+AudioPreloadWaitCallback pAudioPreloadWaitCallback = NULL;
+
 SDL_Thread * fadeThread = NULL;
 
 volatile int fadeTime = 0;
@@ -84,6 +89,61 @@ void initAudio()
     }
 }
 
+void setAudioPreloadWaitCallback(AudioPreloadWaitCallback callback)
+{
+    pAudioPreloadWaitCallback = callback;
+}
+
+Mix_Music * findMusic(const string &id)
+{
+    Mix_Music *pMusic = NULL;
+
+    SDL_AtomicLock(&audioMapLock);
+    map<string, Mix_Music*>::iterator iter = music.find(id);
+    pMusic = iter != music.end() ? iter->second : NULL;
+    SDL_AtomicUnlock(&audioMapLock);
+
+    return pMusic;
+}
+
+Mix_Chunk * findChunk(map<string, Mix_Chunk*> &chunkMap, const string &id)
+{
+    Mix_Chunk *pChunk = NULL;
+
+    SDL_AtomicLock(&audioMapLock);
+    map<string, Mix_Chunk*>::iterator iter = chunkMap.find(id);
+    pChunk = iter != chunkMap.end() ? iter->second : NULL;
+    SDL_AtomicUnlock(&audioMapLock);
+
+    return pChunk;
+}
+
+Mix_Chunk * removeChunk(map<string, Mix_Chunk*> &chunkMap, const string &id)
+{
+    Mix_Chunk *pChunk = NULL;
+
+    SDL_AtomicLock(&audioMapLock);
+    map<string, Mix_Chunk*>::iterator iter = chunkMap.find(id);
+
+    if (iter != chunkMap.end())
+    {
+        pChunk = iter->second;
+        chunkMap.erase(iter);
+    }
+
+    SDL_AtomicUnlock(&audioMapLock);
+
+    return pChunk;
+}
+
+void waitForPreload(AudioType type, const string &id)
+{
+    if (pAudioPreloadWaitCallback != NULL)
+    {
+        pAudioPreloadWaitCallback(type, id);
+    }
+}
+
 void channelDone(int channel)
 {
     // Called whenever a channel is stopped.
@@ -98,7 +158,7 @@ void channelDone(int channel)
 void musicToPartB()
 {
     Mix_HookMusicFinished(NULL);
-    Mix_PlayMusic(music[currentMusic + "_B"], -1);
+    Mix_PlayMusic(findMusic(currentMusic + "_B"), -1);
 }
 
 bool preloadMusic(string id, SDL_RWops *pFileOpsA, SDL_RWops *pFileOpsB)
@@ -108,15 +168,24 @@ bool preloadMusic(string id, SDL_RWops *pFileOpsA, SDL_RWops *pFileOpsB)
     if(pMusicA == NULL) return false;
     Mix_Music *pMusicB = Mix_LoadMUS_RW(pFileOpsB, true);
     if(pMusicB == NULL) return false;
+    SDL_AtomicLock(&audioMapLock);
     music[id+"_A"] = pMusicA;
     music[id+"_B"] = pMusicB;
+    SDL_AtomicUnlock(&audioMapLock);
     return true;
 }
 
 void unloadMusic(string id)
 {
-    Mix_Music *pMusicA = music[id + "_A"];
-    Mix_Music *pMusicB = music[id + "_B"];
+    Mix_Music *pMusicA = NULL;
+    Mix_Music *pMusicB = NULL;
+
+    SDL_AtomicLock(&audioMapLock);
+    pMusicA = music[id + "_A"];
+    pMusicB = music[id + "_B"];
+    music.erase(id + "_A");
+    music.erase(id + "_B");
+    SDL_AtomicUnlock(&audioMapLock);
 
     if (pMusicA != NULL)
     {
@@ -127,9 +196,6 @@ void unloadMusic(string id)
     {
         Mix_FreeMusic(pMusicB);
     }
-
-    music.erase(id + "_A");
-    music.erase(id + "_B");
 }
 
 bool preloadSound(string id, SDL_RWops *pFileOps)
@@ -138,20 +204,20 @@ bool preloadSound(string id, SDL_RWops *pFileOps)
     Mix_Chunk *pSound = Mix_LoadWAV_RW(pFileOps, 1);
     if(pSound == NULL) return false;
     Mix_VolumeChunk(pSound, (int)(soundVol * MIX_MAX_VOLUME));
+    SDL_AtomicLock(&audioMapLock);
     sfx[id] = pSound;
+    SDL_AtomicUnlock(&audioMapLock);
     return true;
 }
 
 void unloadSound(string id)
 {
-    Mix_Chunk *pSound = sfx[id];
+    Mix_Chunk *pSound = removeChunk(sfx, id);
 
     if (pSound != NULL)
     {
         Mix_FreeChunk(pSound);
     }
-
-    sfx.erase(id);
 }
 
 bool preloadDialog(string id,SDL_RWops *pFileOps)
@@ -159,28 +225,29 @@ bool preloadDialog(string id,SDL_RWops *pFileOps)
     if (!audioEnabled) return false;
     Mix_Chunk *pSound = Mix_LoadWAV_RW(pFileOps, 1);
     if (pSound == NULL) return false;
+    SDL_AtomicLock(&audioMapLock);
     dialog[id] = pSound;
+    SDL_AtomicUnlock(&audioMapLock);
     return true;
 }
 
 void unloadDialog(string id)
 {
-    Mix_Chunk *pSound = dialog[id];
+    Mix_Chunk *pSound = removeChunk(dialog, id);
 
     if (pSound != NULL)
     {
         Mix_FreeChunk(pSound);
     }
-
-    dialog.erase(id);
 }
 
 bool playMusic(string id)
 {
     if (!audioEnabled) return false;
-    Mix_Music *pMusicA = music[id + "_A"];
+    waitForPreload(AudioTypeMusic, id);
+    Mix_Music *pMusicA = findMusic(id + "_A");
     if (!pMusicA) return false;
-    Mix_Music *pMusicB = music[id + "_B"];
+    Mix_Music *pMusicB = findMusic(id + "_B");
     if (!pMusicB) return false;
     if (currentMusic.length() > 0)
     {
@@ -242,7 +309,8 @@ bool playSound(string id)
 bool playSound(string id, double volume)
 {
     if (!audioEnabled) return false;
-    Mix_Chunk *pSound = sfx[id];
+    waitForPreload(AudioTypeSound, id);
+    Mix_Chunk *pSound = findChunk(sfx, id);
     if (!pSound) return false;
 
     int setVol = (int)(soundVol * volume * MIX_MAX_VOLUME);
@@ -254,7 +322,8 @@ bool playSound(string id, double volume)
 bool playAmbiance(string id)
 {
     if (!audioEnabled) return false;
-    Mix_Chunk *pSound = sfx[id];
+    waitForPreload(AudioTypeSound, id);
+    Mix_Chunk *pSound = findChunk(sfx, id);
     if (!pSound) return false;
 
     currentAmbiance = id;
@@ -294,7 +363,8 @@ bool playPartnerAbilityLoop(string id)
         return false;
     }
 
-    Mix_Chunk *pSound = sfx[id];
+    waitForPreload(AudioTypeSound, id);
+    Mix_Chunk *pSound = findChunk(sfx, id);
     if (!pSound) return false;
 
     Mix_HaltChannel(PARTNER_ABILITY_LOOP_CHANNEL);
@@ -327,7 +397,8 @@ bool playLoopingSound(string id, int relativeChannel)
         return false;
     }
 
-    Mix_Chunk *pSound = sfx[id];
+    waitForPreload(AudioTypeSound, id);
+    Mix_Chunk *pSound = findChunk(sfx, id);
     if (!pSound) return false;
 
     Mix_HaltChannel(SOUND_LOOP_CHANNEL_START + relativeChannel);
@@ -354,7 +425,8 @@ bool playDialog(string id)
 {
     if (!audioEnabled) return false;
     if (currentDialog.length() > 0) Mix_HaltChannel(DIALOG_CHANNEL);
-    Mix_Chunk *pSound = dialog[id];
+    waitForPreload(AudioTypeDialog, id);
+    Mix_Chunk *pSound = findChunk(dialog, id);
     if (!pSound) return false;
     currentDialog = id;
     if (Mix_PlayChannel(DIALOG_CHANNEL, pSound, 0) != DIALOG_CHANNEL)
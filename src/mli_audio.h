@@ -43,7 +43,19 @@
 
 using namespace std;
 
+enum AudioType
+{
+    AudioTypeMusic,
+    AudioTypeSound,
+    AudioTypeDialog,
+};
+
+// Called before we look up audio to play, so that whoever is loading it
+// in the background has the chance to finish doing so first.
+typedef void (*AudioPreloadWaitCallback)(AudioType type, const string &id);
+
 void initAudio();
+void setAudioPreloadWaitCallback(AudioPreloadWaitCallback callback);
 void channelDone(int channel);
 
 void musicToPartB();